@@ -0,0 +1,94 @@
+// Culls a synthetic scene of randomly placed instances against a camera frustum without a GL context.
+// Checks that the SSE and AVX paths agree with the scalar reference and prints the cost of each.
+//
+// Usage: frustum_culling_stress [instances = 100000] [iterations = 100]
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "FrustumCulling.h"
+
+namespace
+{
+    template<typename Function>
+    double MeasureMilliseconds(uint32_t iterations, Function function)
+    {
+        auto start = std::chrono::high_resolution_clock::now();
+        for (uint32_t i = 0; i < iterations; ++i)
+            function();
+        std::chrono::duration<double, std::milli> elapsed = std::chrono::high_resolution_clock::now() - start;
+        return elapsed.count() / iterations;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    uint32_t instancesCount = argc > 1 ? static_cast<uint32_t>(std::atoi(argv[1])) : 100000;
+    uint32_t iterations = argc > 2 ? static_cast<uint32_t>(std::atoi(argv[2])) : 100;
+
+    std::mt19937 generator(42);
+    std::uniform_real_distribution<float> positionDistribution(-500.f, 500.f);
+    std::uniform_real_distribution<float> radiusDistribution(0.5f, 10.f);
+
+    BoundingSpheres spheres;
+    spheres.Resize(instancesCount);
+    for (uint32_t i = 0; i < instancesCount; ++i)
+    {
+        glm::vec3 center(positionDistribution(generator), positionDistribution(generator), positionDistribution(generator));
+        spheres.Set(i, {center, radiusDistribution(generator)});
+    }
+
+    glm::mat4 projection = glm::perspective(glm::radians(90.f), 16.f / 9.f, 0.1f, 1000.f);
+    glm::mat4 view = glm::lookAt(glm::vec3(0.f), glm::vec3(0.f, 0.f, 1.f), glm::vec3(0.f, 1.f, 0.f));
+    Frustum frustum = Frustum::FromMatrix(projection * view);
+
+    std::vector<uint32_t> scalarVisible;
+    double scalarMilliseconds = MeasureMilliseconds(iterations, [&]()
+    {
+        FrustumCulling::CullSpheresScalar(frustum, spheres, scalarVisible);
+    });
+
+    std::printf("%u instances, %zu visible\n", instancesCount, scalarVisible.size());
+    std::printf("scalar: %.3f ms\n", scalarMilliseconds);
+
+    struct SimdPath
+    {
+        const char* name;
+        uint32_t (*cull)(const Frustum&, const BoundingSpheres&, std::vector<uint32_t>&);
+        bool isSupported;
+    };
+    const SimdPath paths[] = {
+        {"sse", FrustumCulling::CullSpheresSse, true},
+        {"avx", FrustumCulling::CullSpheresAvx, FrustumCulling::IsAvxSupported()},
+    };
+
+    int result = 0;
+    for (const SimdPath& path : paths)
+    {
+        if (!path.isSupported)
+        {
+            std::printf("%s: not supported by this CPU\n", path.name);
+            continue;
+        }
+
+        std::vector<uint32_t> simdVisible;
+        double simdMilliseconds = MeasureMilliseconds(iterations, [&]()
+        {
+            path.cull(frustum, spheres, simdVisible);
+        });
+        std::printf("%s: %.3f ms (%.2fx)\n", path.name, simdMilliseconds, scalarMilliseconds / simdMilliseconds);
+
+        if (scalarVisible != simdVisible)
+        {
+            std::printf("MISMATCH: scalar found %zu visible instances, %s %zu\n", scalarVisible.size(), path.name,
+                        simdVisible.size());
+            result = 1;
+        }
+    }
+
+    return result;
+}
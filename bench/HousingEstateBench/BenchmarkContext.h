@@ -0,0 +1,8 @@
+#pragma once
+
+// GL context shared by the benchmarks that upload to the GPU, created once in main.
+// Benchmarks skip themselves when no context could be created.
+namespace BenchmarkContext
+{
+    bool IsGLAvailable();
+}
@@ -0,0 +1,45 @@
+// Micro and macro benchmarks of the scene graph, renderer and loader hot paths.
+// GL benchmarks run on a headless context, results are printed and can be written as JSON:
+//
+// Usage: housing_estate_bench [--benchmark_filter=REGEX] [--benchmark_out=FILE --benchmark_out_format=json]
+
+#include <benchmark/benchmark.h>
+
+#include "BenchmarkContext.h"
+#include "HeadlessContext.h"
+#include "LoggingMacros.h"
+#include "MaterialSystem.h"
+#include "TextureStreamer.h"
+
+namespace
+{
+    bool isGLAvailable = false;
+}
+
+bool BenchmarkContext::IsGLAvailable()
+{
+    return isGLAvailable;
+}
+
+int main(int argc, char** argv)
+{
+    LoggingMacros::InitializeSPDLog();
+
+    benchmark::Initialize(&argc, argv);
+    if (benchmark::ReportUnrecognizedArguments(argc, argv))
+        return 1;
+
+    HeadlessContext context;
+    isGLAvailable = context.Create();
+
+    benchmark::RunSpecifiedBenchmarks();
+    benchmark::Shutdown();
+
+    if (isGLAvailable)
+    {
+        MaterialSystem::GetInstance().Shutdown();
+        TextureStreamer::GetInstance().Shutdown();
+    }
+
+    return 0;
+}
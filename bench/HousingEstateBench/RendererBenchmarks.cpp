@@ -0,0 +1,146 @@
+// Renderer and loader benchmarks on the headless GL context.
+
+#include <filesystem>
+#include <memory>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+#include "AssetRegistry.h"
+#include "BenchmarkContext.h"
+#include "MaterialSystem.h"
+#include "MeshCache.h"
+#include "Model.h"
+#include "ModelRenderer.h"
+#include "Nodes/ModelNode.h"
+#include "ShaderWrapper.h"
+#include "TextureStreamer.h"
+
+namespace
+{
+    const char* const ModelPaths[] = {"res/models/Tardis/tardis.obj", "res/models/nanosuit/nanosuit.obj"};
+
+    std::shared_ptr<ShaderWrapper> GetModelShader()
+    {
+        return AssetRegistry::GetInstance().GetShader("res/shaders/instanced.vert", "res/shaders/textured_model.frag");
+    }
+
+    bool SkipWithoutGL(benchmark::State& state)
+    {
+        if (BenchmarkContext::IsGLAvailable())
+            return false;
+
+        state.SkipWithError("No GL context");
+        return true;
+    }
+
+    // Drops textures of destroyed models so the decode queue does not grow between iterations
+    void SettleTextureStreamer()
+    {
+        TextureStreamer::GetInstance().Flush();
+        TextureStreamer::GetInstance().Update();
+        MaterialSystem::GetInstance().Update();
+    }
+
+    // Packs the world matrices of instancesCount ModelNodes, the given percentage of them moved before every call
+    void BM_UpdateMatrixBuffer(benchmark::State& state)
+    {
+        if (SkipWithoutGL(state))
+            return;
+
+        auto instancesCount = static_cast<uint32_t>(state.range(0));
+        auto dirtyStride = static_cast<uint32_t>(100 / state.range(1));
+
+        std::shared_ptr<Model> model = AssetRegistry::GetInstance().GetModel(ModelPaths[0], GetModelShader());
+
+        ModelRenderer renderer;
+        Node root;
+        std::vector<std::shared_ptr<ModelNode>> nodes;
+        for (uint32_t i = 0; i < instancesCount; ++i)
+        {
+            auto node = std::make_shared<ModelNode>(model, &renderer);
+            node->GetLocalTransform()->SetPosition({static_cast<float>(i % 100), 0.f, static_cast<float>(i / 100)});
+            root.AddChild(node);
+            nodes.push_back(node);
+        }
+        root.CalculateWorldTransform();
+
+        ModelInstances* instances = renderer.FindInstances(model.get());
+        uint32_t region = 0;
+        float offset = 0.f;
+        for (auto _ : state)
+        {
+            state.PauseTiming();
+            offset += 1.f;
+            for (uint32_t i = 0; i < instancesCount; i += dirtyStride)
+                nodes[i]->GetLocalTransform()->SetPosition({offset, 0.f, static_cast<float>(i)});
+            root.CalculateWorldTransform();
+            state.ResumeTiming();
+
+            renderer.GatherMovedSlots();
+            renderer.UpdateMatrixBuffer(model.get(), *instances, region);
+            region = (region + 1) % PersistentBuffer::RegionCount;
+        }
+
+        state.SetBytesProcessed(static_cast<int64_t>(renderer.GetStats().uploadedBytes));
+        state.counters["matrices"] = benchmark::Counter(static_cast<double>(renderer.GetStats().uploadedMatrices),
+                                                        benchmark::Counter::kAvgIterations);
+    }
+    BENCHMARK(BM_UpdateMatrixBuffer)->Args({1000, 100})->Args({10000, 100})->Args({10000, 10});
+
+    // Full assimp import of a bundled OBJ, including writing the mesh cache and uploading the meshes
+    void BM_ModelImport(benchmark::State& state)
+    {
+        if (SkipWithoutGL(state))
+            return;
+
+        const char* path = ModelPaths[state.range(0)];
+        state.SetLabel(path);
+        std::shared_ptr<ShaderWrapper> shader = GetModelShader();
+
+        for (auto _ : state)
+        {
+            state.PauseTiming();
+            std::filesystem::remove(MeshCache::GetCachePath(path));
+            state.ResumeTiming();
+
+            auto model = std::make_unique<Model>(path, shader);
+            benchmark::DoNotOptimize(model.get());
+
+            state.PauseTiming();
+            model.reset();
+            SettleTextureStreamer();
+            state.ResumeTiming();
+        }
+    }
+    BENCHMARK(BM_ModelImport)->DenseRange(0, 1)->Unit(benchmark::kMillisecond);
+
+    // Same models loaded from their memory-mapped mesh cache
+    void BM_ModelLoadCached(benchmark::State& state)
+    {
+        if (SkipWithoutGL(state))
+            return;
+
+        const char* path = ModelPaths[state.range(0)];
+        state.SetLabel(path);
+        std::shared_ptr<ShaderWrapper> shader = GetModelShader();
+
+        // Writes the cache if it is missing or outdated
+        {
+            Model warmUpModel(path, shader);
+        }
+        SettleTextureStreamer();
+
+        for (auto _ : state)
+        {
+            auto model = std::make_unique<Model>(path, shader);
+            benchmark::DoNotOptimize(model.get());
+
+            state.PauseTiming();
+            model.reset();
+            SettleTextureStreamer();
+            state.ResumeTiming();
+        }
+    }
+    BENCHMARK(BM_ModelLoadCached)->DenseRange(0, 1)->Unit(benchmark::kMillisecond);
+}
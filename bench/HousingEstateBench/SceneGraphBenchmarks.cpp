@@ -0,0 +1,136 @@
+// Transform and node hierarchy benchmarks, no GL context needed.
+// CalculateWorldTransform propagates every transform in the TransformStore, so each benchmark
+// builds its own tree and keeps no other nodes alive.
+
+#include <memory>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+#include "JobSystem.h"
+#include "Nodes/Node.h"
+#include "Transform.h"
+
+namespace
+{
+    // Root with a single chain of depth nodes below it
+    std::shared_ptr<Node> CreateDeepTree(uint32_t depth)
+    {
+        auto root = std::make_shared<Node>();
+        Node* tail = root.get();
+        for (uint32_t i = 0; i < depth; ++i)
+        {
+            auto child = std::make_shared<Node>();
+            child->GetLocalTransform()->SetPosition({0.f, 1.f, 0.f});
+            tail->AddChild(child);
+            tail = child.get();
+        }
+        return root;
+    }
+
+    // Root with width children, each with two leaves like a motorcycle with its wheels
+    std::shared_ptr<Node> CreateWideTree(uint32_t width)
+    {
+        auto root = std::make_shared<Node>();
+        for (uint32_t i = 0; i < width; ++i)
+        {
+            auto child = std::make_shared<Node>();
+            child->GetLocalTransform()->SetPosition({static_cast<float>(i), 0.f, 0.f});
+            for (int j = 0; j < 2; ++j)
+                child->AddChild(std::make_shared<Node>());
+            root->AddChild(child);
+        }
+        return root;
+    }
+
+    void BM_TransformGetMatrix(benchmark::State& state)
+    {
+        std::vector<Transform> transforms(static_cast<size_t>(state.range(0)));
+        for (size_t i = 0; i < transforms.size(); ++i)
+        {
+            transforms[i].SetPosition({static_cast<float>(i), 1.f, 2.f});
+            transforms[i].SetRotation(glm::angleAxis(static_cast<float>(i), glm::vec3(0.f, 1.f, 0.f)));
+            transforms[i].SetScale({1.f, 2.f, 1.f});
+        }
+
+        for (auto _ : state)
+        {
+            for (const Transform& transform : transforms)
+            {
+                glm::mat4 matrix = transform.GetMatrix();
+                benchmark::DoNotOptimize(matrix);
+            }
+        }
+        state.SetItemsProcessed(state.iterations() * state.range(0));
+    }
+    BENCHMARK(BM_TransformGetMatrix)->Arg(1)->Arg(1024);
+
+    // Moving the root dirties the whole tree every iteration
+    void RunCalculateWorldTransform(benchmark::State& state, Node& root, uint32_t nodesCount, JobSystem* jobSystem)
+    {
+        float offset = 0.f;
+        for (auto _ : state)
+        {
+            offset += 1.f;
+            root.GetLocalTransform()->SetPosition({offset, 0.f, 0.f});
+            root.CalculateWorldTransform(jobSystem);
+            benchmark::ClobberMemory();
+        }
+        state.SetItemsProcessed(state.iterations() * nodesCount);
+    }
+
+    void BM_CalculateWorldTransformDeep(benchmark::State& state)
+    {
+        auto depth = static_cast<uint32_t>(state.range(0));
+        std::shared_ptr<Node> root = CreateDeepTree(depth);
+        RunCalculateWorldTransform(state, *root, depth + 1, nullptr);
+    }
+    BENCHMARK(BM_CalculateWorldTransformDeep)->Arg(16)->Arg(256)->Arg(1024);
+
+    void BM_CalculateWorldTransformWide(benchmark::State& state)
+    {
+        auto width = static_cast<uint32_t>(state.range(0));
+        std::shared_ptr<Node> root = CreateWideTree(width);
+        RunCalculateWorldTransform(state, *root, width * 3 + 1, nullptr);
+    }
+    BENCHMARK(BM_CalculateWorldTransformWide)->Arg(1000)->Arg(10000)->Arg(100000);
+
+    void BM_CalculateWorldTransformWideParallel(benchmark::State& state)
+    {
+        auto width = static_cast<uint32_t>(state.range(0));
+        std::shared_ptr<Node> root = CreateWideTree(width);
+        JobSystem jobSystem;
+        RunCalculateWorldTransform(state, *root, width * 3 + 1, &jobSystem);
+    }
+    BENCHMARK(BM_CalculateWorldTransformWideParallel)->Arg(10000)->Arg(100000)->UseRealTime();
+
+    void BM_NodeClone(benchmark::State& state)
+    {
+        auto width = static_cast<uint32_t>(state.range(0));
+        std::shared_ptr<Node> root = CreateWideTree(width);
+
+        for (auto _ : state)
+        {
+            std::shared_ptr<Node> clone = root->Clone();
+            benchmark::DoNotOptimize(clone.get());
+        }
+        state.SetItemsProcessed(state.iterations() * (width * 3 + 1));
+    }
+    BENCHMARK(BM_NodeClone)->Arg(100)->Arg(10000);
+
+    void BM_GetAllNodes(benchmark::State& state)
+    {
+        auto width = static_cast<uint32_t>(state.range(0));
+        std::shared_ptr<Node> root = CreateWideTree(width);
+
+        std::vector<Node*> found;
+        for (auto _ : state)
+        {
+            found.clear();
+            root->GetAllNodes(found, [](Node* node) { return node->GetChildrenList().empty(); });
+            benchmark::DoNotOptimize(found.data());
+        }
+        state.SetItemsProcessed(state.iterations() * (width * 3 + 1));
+    }
+    BENCHMARK(BM_GetAllNodes)->Arg(100)->Arg(10000);
+}
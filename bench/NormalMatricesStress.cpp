@@ -0,0 +1,95 @@
+// Computes the normal matrices of a synthetic set of instance transforms without a GL context.
+// Checks that the SSE path agrees with the scalar reference and prints the cost of each.
+//
+// Usage: normal_matrices_stress [instances = 100000] [iterations = 100]
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include "InstanceData.h"
+
+namespace
+{
+    constexpr float Tolerance = 1e-4f;
+
+    template<typename Function>
+    double MeasureMilliseconds(uint32_t iterations, Function function)
+    {
+        auto start = std::chrono::high_resolution_clock::now();
+        for (uint32_t i = 0; i < iterations; ++i)
+            function();
+        std::chrono::duration<double, std::milli> elapsed = std::chrono::high_resolution_clock::now() - start;
+        return elapsed.count() / iterations;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    uint32_t instancesCount = argc > 1 ? static_cast<uint32_t>(std::atoi(argv[1])) : 100000;
+    uint32_t iterations = argc > 2 ? static_cast<uint32_t>(std::atoi(argv[2])) : 100;
+
+    std::mt19937 generator(42);
+    std::uniform_real_distribution<float> positionDistribution(-500.f, 500.f);
+    std::uniform_real_distribution<float> angleDistribution(-glm::pi<float>(), glm::pi<float>());
+    std::uniform_real_distribution<float> scaleDistribution(0.1f, 10.f);
+
+    // Every 100th transform is flattened along one axis, those take the cofactor fallback
+    std::vector<GpuInstance> instances(instancesCount);
+    for (uint32_t i = 0; i < instancesCount; ++i)
+    {
+        glm::vec3 position(positionDistribution(generator), positionDistribution(generator), positionDistribution(generator));
+        glm::quat rotation(glm::vec3(angleDistribution(generator), angleDistribution(generator), angleDistribution(generator)));
+        glm::vec3 scale(scaleDistribution(generator), scaleDistribution(generator), scaleDistribution(generator));
+        if (i % 100 == 0)
+            scale.y = 0.f;
+
+        instances[i].transform = glm::scale(glm::translate(glm::mat4(1.f), position) * glm::mat4_cast(rotation), scale);
+    }
+
+    std::vector<GpuInstance> scalarInstances = instances;
+    double scalarMilliseconds = MeasureMilliseconds(iterations, [&]()
+    {
+        InstanceData::ComputeNormalMatricesScalar(scalarInstances.data(), scalarInstances.size());
+    });
+
+    std::vector<GpuInstance> simdInstances = instances;
+    double simdMilliseconds = MeasureMilliseconds(iterations, [&]()
+    {
+        InstanceData::ComputeNormalMatrices(simdInstances.data(), simdInstances.size());
+    });
+
+    std::printf("%u instances\n", instancesCount);
+    std::printf("scalar: %.3f ms\n", scalarMilliseconds);
+    std::printf("simd: %.3f ms (%.2fx)\n", simdMilliseconds, scalarMilliseconds / simdMilliseconds);
+
+    uint32_t mismatchesCount = 0;
+    for (uint32_t i = 0; i < instancesCount; ++i)
+    {
+        for (uint32_t column = 0; column < 3; ++column)
+        {
+            glm::vec4 expected = scalarInstances[i].normalMatrix[column];
+            glm::vec4 difference = glm::abs(simdInstances[i].normalMatrix[column] - expected);
+            glm::vec4 limit = Tolerance * glm::max(glm::abs(expected), glm::vec4(1.f));
+            if (glm::any(glm::greaterThan(difference, limit)))
+            {
+                ++mismatchesCount;
+                break;
+            }
+        }
+    }
+
+    if (mismatchesCount > 0)
+    {
+        std::printf("MISMATCH: %u normal matrices differ from the scalar reference\n", mismatchesCount);
+        return 1;
+    }
+
+    return 0;
+}
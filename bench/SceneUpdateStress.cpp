@@ -0,0 +1,125 @@
+// Updates a scene of independent actors with 1..N threads and prints the frame cost of
+// Node::UpdateParallel and the world transform propagation for every thread count.
+//
+// Usage: scene_update_stress [actors = 10000] [frames = 200]
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+
+#include <glm/gtc/constants.hpp>
+
+#include "JobSystem.h"
+#include "Nodes/Node.h"
+
+namespace
+{
+    // Motorcycle-like actor: drives in a circle and spins its wheels
+    class StressActorNode : public Node
+    {
+    private:
+        std::shared_ptr<Node> body;
+        std::shared_ptr<Node> frontWheel;
+        std::shared_ptr<Node> backWheel;
+
+        float phase;
+
+    public:
+        explicit StressActorNode(float phase) : phase(phase)
+        {
+            body = std::make_shared<Node>();
+            AddChild(body);
+
+            frontWheel = std::make_shared<Node>();
+            frontWheel->GetLocalTransform()->SetPosition({-2.f, -2.3f, 0.f});
+            body->AddChild(frontWheel);
+
+            backWheel = std::make_shared<Node>();
+            backWheel->GetLocalTransform()->SetPosition({3.2f, 1.4f, 0.f});
+            body->AddChild(backWheel);
+        }
+
+        void Update(MainEngine* engine, float seconds, float deltaSeconds) override
+        {
+            Node::Update(engine, seconds, deltaSeconds);
+
+            float angle = seconds + phase;
+            GetLocalTransform()->SetPosition({glm::cos(angle) * 50.f, 0.f, glm::sin(angle) * 50.f});
+            GetLocalTransform()->SetRotation(glm::angleAxis(-angle, glm::vec3(0.f, 1.f, 0.f)));
+
+            for (const auto& wheel : {frontWheel, backWheel})
+            {
+                glm::quat newRotation = wheel->GetLocalTransform()->GetRotation();
+                newRotation *= glm::quat(glm::vec3(0.f, 0.f, 10.f * deltaSeconds));
+                wheel->GetLocalTransform()->SetRotation(glm::normalize(newRotation));
+            }
+        }
+    };
+
+    struct FrameTimes
+    {
+        double updateMilliseconds;
+        double propagationMilliseconds;
+    };
+
+    FrameTimes RunFrames(JobSystem& jobSystem, Node& sceneRoot, uint32_t frames)
+    {
+        using Clock = std::chrono::high_resolution_clock;
+
+        std::chrono::duration<double, std::milli> updateTime{0};
+        std::chrono::duration<double, std::milli> propagationTime{0};
+
+        const float deltaSeconds = 1.f / 60.f;
+        for (uint32_t frame = 0; frame < frames; ++frame)
+        {
+            auto start = Clock::now();
+            sceneRoot.UpdateParallel(jobSystem, nullptr, static_cast<float>(frame) * deltaSeconds, deltaSeconds);
+            auto updated = Clock::now();
+            sceneRoot.CalculateWorldTransform(&jobSystem);
+            auto propagated = Clock::now();
+
+            updateTime += updated - start;
+            propagationTime += propagated - updated;
+        }
+
+        return {updateTime.count() / frames, propagationTime.count() / frames};
+    }
+}
+
+int main(int argc, char** argv)
+{
+    uint32_t actorsCount = argc > 1 ? static_cast<uint32_t>(std::atoi(argv[1])) : 10000;
+    uint32_t framesCount = argc > 2 ? static_cast<uint32_t>(std::atoi(argv[2])) : 200;
+
+    Node sceneRoot;
+    for (uint32_t i = 0; i < actorsCount; ++i)
+    {
+        float phase = glm::two_pi<float>() * static_cast<float>(i) / static_cast<float>(actorsCount);
+        sceneRoot.AddChild(std::make_shared<StressActorNode>(phase));
+    }
+    sceneRoot.CalculateWorldTransform();
+
+    std::printf("%u actors (%u nodes), %u frames\n", actorsCount, actorsCount * 4 + 1, framesCount);
+    std::printf("%8s %12s %16s %9s\n", "threads", "update [ms]", "propagate [ms]", "speedup");
+
+    double singleThreadedMilliseconds = 0.0;
+    uint32_t maxWorkers = JobSystem::DefaultWorkerCount();
+    for (uint32_t workers = 0; workers <= maxWorkers; ++workers)
+    {
+        JobSystem jobSystem(workers);
+
+        // Warm up caches and the worker threads
+        RunFrames(jobSystem, sceneRoot, 10);
+        FrameTimes times = RunFrames(jobSystem, sceneRoot, framesCount);
+
+        double frameMilliseconds = times.updateMilliseconds + times.propagationMilliseconds;
+        if (workers == 0)
+            singleThreadedMilliseconds = frameMilliseconds;
+
+        std::printf("%8u %12.3f %16.3f %8.2fx\n", workers + 1, times.updateMilliseconds,
+                    times.propagationMilliseconds, singleThreadedMilliseconds / frameMilliseconds);
+    }
+
+    return 0;
+}
@@ -1,9 +1,9 @@
 #version 430 core
 
-uniform vec4 Color;
+in vec4 GizmoColor;
 
 out vec4 FragColor;
 
 void main() {
-    FragColor = Color;
+    FragColor = GizmoColor;
 }
@@ -1,12 +1,17 @@
 #version 430 core
 
 layout(location = 0) in vec3 Position;
+layout(location = 1) in mat4 Transform;
+layout(location = 5) in vec4 Color;
 
 layout(std140, binding = 0) uniform TransformationMatrices {
     mat4 Projection;
     mat4 View;
 };
 
+out vec4 GizmoColor;
+
 void main() {
-    gl_Position = Projection * View * vec4(Position, 1.0f);
+    GizmoColor = Color;
+    gl_Position = Projection * View * Transform * vec4(Position, 1.0f);
 }
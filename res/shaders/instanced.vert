@@ -1,10 +1,39 @@
 #version 430 core
 
+// Compact meshes deliver positions in [0, 1] of their bounds and the normal as octahedral coordinates in x and y
 layout(location = 0) in vec3 Position;
 layout(location = 1) in vec3 Normal;
 layout(location = 2) in vec2 TexCoord;
+// baseInstance of the indirect command, the index of the mesh within its model
+layout(location = 3) in uint DrawId;
 
-layout(location = 3) in mat4 Transform;
+// Normal matrix is the inverse transpose of the transform, computed on the CPU when the instance moves
+struct InstanceData {
+    mat4 Transform;
+    mat3 NormalMatrix;
+};
+
+layout(std430, binding = 2) readonly buffer Instances {
+    InstanceData InstanceTable[];
+};
+
+layout(std430, binding = 3) readonly buffer VisibleInstances {
+    uint VisibleIndices[];
+};
+
+// Visible instances are grouped by LOD, every LOD is drawn from its own offset
+uniform uint FirstVisibleInstance;
+
+struct DrawData {
+    vec3 PositionOffset;
+    uint MaterialIndex;
+    vec3 PositionScale;
+    uint IsCompact;
+};
+
+layout(std430, binding = 4) readonly buffer Draws {
+    DrawData DrawTable[];
+};
 
 layout(std140, binding = 0) uniform TransformationMatrices {
     mat4 Projection;
@@ -18,13 +47,30 @@ out VS_OUT {
     vec2 TexCoord;
 
     vec3 ViewPosition;
+    flat uint MaterialIndex;
 } vs_out;
 
+vec3 DecodeOctahedral(vec2 Encoded) {
+    vec3 Decoded = vec3(Encoded, 1.f - abs(Encoded.x) - abs(Encoded.y));
+    float Fold = max(-Decoded.z, 0.f);
+    Decoded.xy += vec2(Decoded.x >= 0.f ? -Fold : Fold, Decoded.y >= 0.f ? -Fold : Fold);
+    return normalize(Decoded);
+}
+
 void main() {
-    gl_Position = Projection * View * Transform * vec4(Position, 1.0f);
+    DrawData Draw = DrawTable[DrawId];
+    InstanceData Instance = InstanceTable[VisibleIndices[FirstVisibleInstance + gl_InstanceID]];
+    mat4 Transform = Instance.Transform;
+
+    // Full precision meshes have an identity scale and offset
+    vec3 MeshPosition = Position * Draw.PositionScale + Draw.PositionOffset;
+    vec3 MeshNormal = Draw.IsCompact != 0u ? DecodeOctahedral(Normal.xy) : Normal;
+
+    gl_Position = Projection * View * Transform * vec4(MeshPosition, 1.0f);
     vs_out.TexCoord = TexCoord;
-    vs_out.Position = vec3(Transform * vec4(Position, 1.0f));
-    vs_out.Normal = normalize(mat3(transpose(inverse(Transform))) * Normal);
+    vs_out.Position = vec3(Transform * vec4(MeshPosition, 1.0f));
+    vs_out.Normal = normalize(Instance.NormalMatrix * MeshNormal);
 
     vs_out.ViewPosition = ViewPosition;
+    vs_out.MaterialIndex = Draw.MaterialIndex;
 }
@@ -3,40 +3,74 @@
 in vec3 NormalVector;
 in vec2 TexCoordFragment;
 
-uniform sampler2D texture_diffuse0;
-uniform sampler2D texture_specular0;
-uniform sampler2D texture_normalmap0;
+// Texture locations are (array index << 16) | layer, negative when there is nothing to sample
+struct Material {
+    int DiffuseTexture;
+    int SpecularTexture;
+    int NormalTexture;
+    int Padding;
+};
+
+layout(std430, binding = 5) readonly buffer Materials {
+    Material MaterialTable[];
+};
+
+// Material textures grouped by size and format, bound to units 0..13 for the whole frame
+uniform sampler2DArray MaterialArrays[14];
+
+// Depth of the sun shadow cascades, one layer each
+uniform sampler2DArrayShadow ShadowMap;
 
 uniform samplerCube cubemap;
 
 out vec4 FragColor;
 
-struct DirectionalLight {
-    vec4 Color;
-    vec3 Direction;
-};
-
-struct PointLight {
+struct LocalLight {
     vec4 Color;
     vec3 Position;
+    float Range;
+    vec3 Direction;
     float Linear;
     float Quadratic;
+    float CosCutOff;
+    float CosOuterCutOff;
+    uint Type;
 };
 
-struct SpotLight {
-    vec4 Color;
-    vec3 Position;
-    vec3 Direction;
-    float Linear;
-    float Quadratic;
-    float CutOff;
-    float OuterCutOff;
+const uint PointLightType = 0;
+const uint SpotLightType = 1;
+
+layout(std140, binding = 0) uniform TransformationMatrices {
+    mat4 Projection;
+    mat4 View;
+    vec3 ViewPosition;
 };
 
 layout(std140, binding = 1) uniform Lights {
-    DirectionalLight Sun;   // 32   // 0
-    PointLight Bulb;        // 48   // 32
-    SpotLight SpotLights[2]; // 48   // 80
+    vec4 SunColor;
+    vec4 SunDirection;
+    uvec4 ClusterGrid;          // Clusters in x, y and z, lights count in w
+    vec4 ClusterParameters;     // Slice scale and bias, tile size in pixels
+};
+
+layout(std140, binding = 2) uniform Shadows {
+    mat4 CascadeMatrices[4];
+    vec4 CascadeSplits;         // Far view depth of every cascade
+    vec4 CascadeTexelSizes;     // World size of a shadow map texel
+    vec4 ShadowParameters;      // Cascades in use, depth bias, normal offset in texels
+};
+
+layout(std430, binding = 6) readonly buffer LightsData {
+    LocalLight LightTable[];
+};
+
+// Offset and count into LightIndices of every cluster
+layout(std430, binding = 7) readonly buffer Clusters {
+    uvec2 ClusterTable[];
+};
+
+layout(std430, binding = 8) readonly buffer LightIndices {
+    uint LightIndexTable[];
 };
 
 in VS_OUT {
@@ -45,14 +79,53 @@ in VS_OUT {
     vec2 TexCoord;
 
     vec3 ViewPosition;
+    flat uint MaterialIndex;
 } fs_in;
 
-vec4 CalculatePointLight(PointLight);
+// Sampler arrays may only be indexed with dynamically uniform expressions, and the material varies between the
+// draws of one multi-draw, so every array is sampled through a constant index. The gradients are taken before
+// branching because neighbouring fragments may pick different cases.
+vec4 SampleMaterialTexture(int Location, vec4 Fallback) {
+    vec2 Dx = dFdx(fs_in.TexCoord);
+    vec2 Dy = dFdy(fs_in.TexCoord);
+    if (Location < 0)
+        return Fallback;
+
+    vec3 Coordinates = vec3(fs_in.TexCoord, float(Location & 0xFFFF));
+    switch (Location >> 16) {
+        case 0: return textureGrad(MaterialArrays[0], Coordinates, Dx, Dy);
+        case 1: return textureGrad(MaterialArrays[1], Coordinates, Dx, Dy);
+        case 2: return textureGrad(MaterialArrays[2], Coordinates, Dx, Dy);
+        case 3: return textureGrad(MaterialArrays[3], Coordinates, Dx, Dy);
+        case 4: return textureGrad(MaterialArrays[4], Coordinates, Dx, Dy);
+        case 5: return textureGrad(MaterialArrays[5], Coordinates, Dx, Dy);
+        case 6: return textureGrad(MaterialArrays[6], Coordinates, Dx, Dy);
+        case 7: return textureGrad(MaterialArrays[7], Coordinates, Dx, Dy);
+        case 8: return textureGrad(MaterialArrays[8], Coordinates, Dx, Dy);
+        case 9: return textureGrad(MaterialArrays[9], Coordinates, Dx, Dy);
+        case 10: return textureGrad(MaterialArrays[10], Coordinates, Dx, Dy);
+        case 11: return textureGrad(MaterialArrays[11], Coordinates, Dx, Dy);
+        case 12: return textureGrad(MaterialArrays[12], Coordinates, Dx, Dy);
+        case 13: return textureGrad(MaterialArrays[13], Coordinates, Dx, Dy);
+    }
+    return Fallback;
+}
+
+vec4 SampleDiffuse() {
+    return SampleMaterialTexture(MaterialTable[fs_in.MaterialIndex].DiffuseTexture, vec4(1.f));
+}
 
 float LightAttenuation(float Distance, float Linear, float Quadratic) {
     return 1.f / (1.f + Linear * Distance + Quadratic * Distance * Distance);
 }
 
+// Fades the light out towards its range so nothing pops at the cluster borders
+float RangeFalloff(float Distance, float Range) {
+    float Ratio = Distance / Range;
+    float Window = clamp(1.f - Ratio * Ratio * Ratio * Ratio, 0.f, 1.f);
+    return Window * Window;
+}
+
 float CalculateSpecular(vec3 LightDirection) {
     vec3 ViewDir = normalize(fs_in.ViewPosition - fs_in.Position);
     vec3 HalfwayDir = normalize(LightDirection + ViewDir);
@@ -60,47 +133,88 @@ float CalculateSpecular(vec3 LightDirection) {
     return Spec;
 }
 
-vec4 CalculatePointLight(PointLight _PointLight) {
-    vec3 LightDir = normalize(_PointLight.Position - fs_in.Position);
+vec4 CalculatePointLight(LocalLight _Light) {
+    vec3 LightDir = normalize(_Light.Position - fs_in.Position);
     float Diff = max(dot(fs_in.Normal, LightDir), 0.f);
-    vec3 Diffuse = Diff * _PointLight.Color.xyz;
-    float Distance = length(_PointLight.Position - fs_in.Position);
-    return vec4(Diffuse + CalculateSpecular(LightDir), 1) * _PointLight.Color.w * LightAttenuation(Distance, _PointLight.Linear, _PointLight.Quadratic);
+    vec3 Diffuse = Diff * _Light.Color.xyz;
+    float Distance = length(_Light.Position - fs_in.Position);
+    float Attenuation = LightAttenuation(Distance, _Light.Linear, _Light.Quadratic) * RangeFalloff(Distance, _Light.Range);
+    return vec4(Diffuse + CalculateSpecular(LightDir), 1) * _Light.Color.w * Attenuation;
 }
 
-vec4 CalculateBulb() {
-    return CalculatePointLight(Bulb);
+float GetViewDepth() {
+    return -(View * vec4(fs_in.Position, 1.f)).z;
+}
+
+// 3x3 filtered comparisons, each of them already a bilinear 2x2 PCF
+float CalculateSunShadow() {
+    uint CascadesCount = uint(ShadowParameters.x);
+    float Depth = GetViewDepth();
+    uint Cascade = 0;
+    while (Cascade < CascadesCount && Depth > CascadeSplits[Cascade])
+        ++Cascade;
+    if (Cascade >= CascadesCount)
+        return 1.f;
+
+    // Pushing the position along the normal keeps surfaces from shadowing themselves at grazing angles
+    vec3 Offset = fs_in.Normal * CascadeTexelSizes[Cascade] * ShadowParameters.z;
+    vec4 LightPosition = CascadeMatrices[Cascade] * vec4(fs_in.Position + Offset, 1.f);
+    vec3 Coordinates = LightPosition.xyz / LightPosition.w * 0.5f + 0.5f;
+    float Reference = Coordinates.z - ShadowParameters.y;
+
+    vec2 TexelSize = 1.f / vec2(textureSize(ShadowMap, 0).xy);
+    float Lit = 0.f;
+    for (int y = -1; y <= 1; ++y) {
+        for (int x = -1; x <= 1; ++x) {
+            vec2 Sample = Coordinates.xy + vec2(x, y) * TexelSize;
+            Lit += texture(ShadowMap, vec4(Sample, float(Cascade), Reference));
+        }
+    }
+    return Lit / 9.f;
 }
 
 vec4 CalculateDirectionalLight() {
-    float AngleDifference = max(dot(fs_in.Normal, normalize(-Sun.Direction)), 0.f);
-    return (AngleDifference + CalculateSpecular(-Sun.Direction)) * vec4(vec3(Sun.Color), 1.f) * Sun.Color.w;
+    if (SunColor.w <= 0.f)
+        return vec4(0.f);
+
+    float AngleDifference = max(dot(fs_in.Normal, normalize(-SunDirection.xyz)), 0.f);
+    vec4 Sun = (AngleDifference + CalculateSpecular(-SunDirection.xyz)) * vec4(vec3(SunColor), 1.f) * SunColor.w;
+    return Sun * CalculateSunShadow();
 }
 
-vec4 CalculateSpotLight(SpotLight Light) {
-    vec3 LightDir = normalize(Light.Position - fs_in.Position);
-    float Epsilon =  cos(Light.CutOff) - cos(Light.OuterCutOff);
-    float Theta = dot(LightDir, normalize(-Light.Direction));
+vec4 CalculateSpotLight(LocalLight _Light) {
+    vec3 LightDir = normalize(_Light.Position - fs_in.Position);
+    float Epsilon = _Light.CosCutOff - _Light.CosOuterCutOff;
+    float Theta = dot(LightDir, normalize(-_Light.Direction));
 
-    PointLight PseudoPointLight;
-    PseudoPointLight.Position = Light.Position;
-    PseudoPointLight.Color = Light.Color;
-    PseudoPointLight.Linear = Light.Linear;
-    PseudoPointLight.Quadratic = Light.Quadratic;
+    float Intensity = clamp((Theta - _Light.CosOuterCutOff) / Epsilon, 0.f, 1.f);
+    return CalculatePointLight(_Light) * Intensity;
+}
 
-    float Intensity = clamp((Theta - cos(Light.OuterCutOff)) / Epsilon, 0.f, 1.f);
-    return CalculatePointLight(PseudoPointLight) * Intensity;
+uint GetClusterIndex() {
+    float Depth = max(GetViewDepth(), 1e-4f);
+    uint Slice = uint(clamp(log(Depth) * ClusterParameters.x + ClusterParameters.y, 0.f, float(ClusterGrid.z - 1)));
+    uvec2 Tile = min(uvec2(gl_FragCoord.xy / ClusterParameters.zw), ClusterGrid.xy - 1);
+    return (Slice * ClusterGrid.y + Tile.y) * ClusterGrid.x + Tile.x;
 }
 
-void main() {
-    vec4 CalculatedSpotLights = vec4(0.f);
-    for (int i = 0; i < 2; ++i) {
-        CalculatedSpotLights += CalculateSpotLight(SpotLights[i]);
+vec4 CalculateClusterLights() {
+    uvec2 Cluster = ClusterTable[GetClusterIndex()];
+    vec4 Result = vec4(0.f);
+    for (uint i = 0; i < Cluster.y; ++i) {
+        LocalLight _Light = LightTable[LightIndexTable[Cluster.x + i]];
+        if (_Light.Type == SpotLightType)
+            Result += CalculateSpotLight(_Light);
+        else
+            Result += CalculatePointLight(_Light);
     }
+    return Result;
+}
 
-    vec4 Light = CalculateBulb() + CalculateDirectionalLight() + CalculatedSpotLights;
+void main() {
+    vec4 Light = CalculateDirectionalLight() + CalculateClusterLights();
 
-    vec4 color = texture(texture_diffuse0, fs_in.TexCoord);
+    vec4 color = SampleDiffuse();
 
     if (length(color.xyz - vec3(0.416)) <= 0.05) {
         vec3 viewDirection = normalize(fs_in.Position - fs_in.ViewPosition);
@@ -0,0 +1,5 @@
+#version 430 core
+
+// Shadow cascades only keep depth
+void main() {
+}
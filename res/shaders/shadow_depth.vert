@@ -0,0 +1,41 @@
+#version 430 core
+
+// Depth only version of instanced.vert for the shadow cascades of the sun
+layout(location = 0) in vec3 Position;
+layout(location = 3) in uint DrawId;
+
+struct InstanceData {
+    mat4 Transform;
+    mat3 NormalMatrix;
+};
+
+layout(std430, binding = 2) readonly buffer Instances {
+    InstanceData InstanceTable[];
+};
+
+layout(std430, binding = 3) readonly buffer VisibleInstances {
+    uint VisibleIndices[];
+};
+
+// Every cascade culls into its own range of the visible instances
+uniform uint FirstVisibleInstance;
+uniform mat4 LightViewProjection;
+
+struct DrawData {
+    vec3 PositionOffset;
+    uint MaterialIndex;
+    vec3 PositionScale;
+    uint IsCompact;
+};
+
+layout(std430, binding = 4) readonly buffer Draws {
+    DrawData DrawTable[];
+};
+
+void main() {
+    DrawData Draw = DrawTable[DrawId];
+    mat4 Transform = InstanceTable[VisibleIndices[FirstVisibleInstance + gl_InstanceID]].Transform;
+
+    vec3 MeshPosition = Position * Draw.PositionScale + Draw.PositionOffset;
+    gl_Position = LightViewProjection * Transform * vec4(MeshPosition, 1.0f);
+}
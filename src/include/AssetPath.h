@@ -0,0 +1,10 @@
+#pragma once
+
+#include <string>
+
+namespace AssetPath
+{
+    // Canonical form of Path, so every spelling of one file gives the same cache key.
+    // Paths that do not exist yet are only normalized lexically.
+    std::string Resolve(const std::string& Path);
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <string>
+#include <unordered_map>
+
+class Model;
+class ShaderWrapper;
+
+struct AssetRegistryStats
+{
+    uint32_t loadedModelsCount = 0;
+    uint32_t reusedModelsCount = 0;
+    uint32_t loadedShadersCount = 0;
+    uint32_t reusedShadersCount = 0;
+};
+
+// Process-wide registry that loads every model and shader program once while something still references it.
+// Entries are weak, an asset is released with its last shared_ptr and loaded again on the next request.
+// Sharing one Model object lets ModelRenderer batch all of its instances into one instanced draw.
+class AssetRegistry
+{
+private:
+    std::unordered_map<std::string, std::weak_ptr<ShaderWrapper>> shaders;
+    std::map<std::pair<std::string, const ShaderWrapper*>, std::weak_ptr<Model>> models;
+    AssetRegistryStats stats;
+
+    AssetRegistry() = default;
+public:
+    static AssetRegistry& GetInstance();
+
+    std::shared_ptr<ShaderWrapper> GetShader(const std::string& VertexShaderPath, const std::string& FragmentShaderPath);
+    std::shared_ptr<ShaderWrapper> GetShader(const std::string& VertexShaderPath, const std::string& FragmentShaderPath,
+                                             const std::string& GeometryShaderPath);
+    std::shared_ptr<ShaderWrapper> GetComputeShader(const std::string& ComputeShaderPath);
+
+    // Models are keyed by their path and shader, the same file drawn with another shader is a separate Model
+    std::shared_ptr<Model> GetModel(const std::string& Path, const std::shared_ptr<ShaderWrapper>& Shader);
+
+    [[nodiscard]] const AssetRegistryStats& GetStats() const;
+};
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <cfloat>
+#include <glm/glm.hpp>
+
+struct AABB
+{
+    glm::vec3 min{FLT_MAX};
+    glm::vec3 max{-FLT_MAX};
+
+    void Extend(const glm::vec3& point)
+    {
+        min = glm::min(min, point);
+        max = glm::max(max, point);
+    }
+
+    void Extend(const AABB& other)
+    {
+        min = glm::min(min, other.min);
+        max = glm::max(max, other.max);
+    }
+
+    [[nodiscard]] bool IsValid() const
+    {
+        return min.x <= max.x && min.y <= max.y && min.z <= max.z;
+    }
+
+    [[nodiscard]] glm::vec3 GetCenter() const
+    {
+        return (min + max) * 0.5f;
+    }
+
+    [[nodiscard]] glm::vec3 GetExtents() const
+    {
+        return (max - min) * 0.5f;
+    }
+};
+
+struct BoundingSphere
+{
+    glm::vec3 center{0.f};
+    float radius = 0.f;
+
+    static BoundingSphere FromAABB(const AABB& box)
+    {
+        if (!box.IsValid())
+            return {};
+
+        return {box.GetCenter(), glm::length(box.GetExtents())};
+    }
+
+    // Conservative bounds of the sphere after an affine transform with non-uniform scale
+    [[nodiscard]] BoundingSphere Transformed(const glm::mat4& matrix) const
+    {
+        float MaxScaleSquared = glm::max(glm::dot(glm::vec3(matrix[0]), glm::vec3(matrix[0])),
+                                         glm::max(glm::dot(glm::vec3(matrix[1]), glm::vec3(matrix[1])),
+                                                  glm::dot(glm::vec3(matrix[2]), glm::vec3(matrix[2]))));
+        return {glm::vec3(matrix * glm::vec4(center, 1.f)), radius * glm::sqrt(MaxScaleSquared)};
+    }
+};
@@ -4,7 +4,13 @@
 #include <glm/glm.hpp>
 #include <glad/glad.h>
 
+#include "FrustumCulling.h"
+
 class Camera {
+public:
+    static constexpr float NearPlane = 0.1f;
+    static constexpr float FarPlane = 1000.f;
+
 private:
     static std::shared_ptr<Camera> instance;
 
@@ -12,7 +18,11 @@ private:
     glm::vec3 front;
     glm::vec3 up;
 
-    GLuint uboTransformMatrices;
+    // Derived matrices are rebuilt on first use after a change, however many setters ran in between
+    mutable glm::mat4 viewMatrix{1.f};
+    mutable glm::mat4 projectionMatrix{1.f};
+    mutable bool isViewDirty = true;
+    mutable bool isProjectionDirty = true;
 
     glm::vec<2, int> resolution{};
     float fow = 90.f;
@@ -34,14 +44,21 @@ public:
     void SetFow(float newFow);
 
     [[nodiscard]] glm::mat4 GetCameraProjectionMatrix(int resolutionX, int resolutionY) const;
+    [[nodiscard]] glm::mat4 GetProjectionMatrix() const;
+    [[nodiscard]] glm::mat4 GetViewMatrix() const;
+    [[nodiscard]] glm::mat4 GetViewProjectionMatrix() const;
+    [[nodiscard]] Frustum GetFrustum() const;
 
     [[nodiscard]] const glm::vec3& GetPosition() const;
+    [[nodiscard]] const glm::vec<2, int>& GetResolution() const;
+    // Vertical field of view in degrees
+    [[nodiscard]] float GetFow() const;
     const glm::vec3& GetFront() const;
     const glm::vec3& GetUp() const;
     glm::vec3 GetRight() const;
 
     virtual void Update(float deltaSeconds);
-private:
-    void UpdateProjection();
-    void UpdateView();
+
+    // Writes the TransformationMatrices block to the FrameConstants, only what changed since the last call
+    void WriteFrameConstants();
 };
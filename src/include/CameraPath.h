@@ -0,0 +1,31 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+struct CameraKeyframe
+{
+    float time;
+    glm::vec3 position;
+    glm::vec3 target;
+};
+
+// Camera flight through keyframes, linearly interpolated and clamped to the first and last one
+class CameraPath
+{
+private:
+    std::vector<CameraKeyframe> keyframes;
+
+public:
+    // One keyframe per line: "time px py pz tx ty tz", lines starting with # are skipped
+    bool LoadFromFile(const std::string& Path);
+    static CameraPath CreateOrbit(const glm::vec3& Center, float Radius, float Height, float Duration);
+
+    void AddKeyframe(const CameraKeyframe& Keyframe);
+    void Evaluate(float Time, glm::vec3& PositionOut, glm::vec3& TargetOut) const;
+
+    [[nodiscard]] bool IsEmpty() const;
+    [[nodiscard]] float GetDuration() const;
+};
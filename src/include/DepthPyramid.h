@@ -0,0 +1,69 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include "UniformHandle.h"
+
+class OffscreenFramebuffer;
+class ShaderWrapper;
+
+// Hierarchical depth of a rendered frame for occlusion culling.
+// Level 0 is a copy of the scene depth, of multisampled depth it keeps the farthest sample of every pixel.
+// Every further level halves the size (rounded down like any mip level) and keeps the farthest depth of the texels
+// it covers. The last texel of a level also covers the row or column an odd level before it has left over,
+// so pixel p of level 0 is covered by texel min(p >> level, size of level - 1).
+// Any sphere whose nearest depth lies behind the farthest depth over its screen rectangle is hidden.
+class DepthPyramid
+{
+public:
+    // Past the units of the model shaders, the culling compute shader samples the pyramid here
+    static constexpr GLint TextureUnit = 16;
+
+private:
+    static constexpr GLint SceneDepthUnit = TextureUnit + 1;
+    static constexpr GLint SceneDepthMultisampleUnit = TextureUnit + 2;
+    static constexpr GLuint ImageUnit = 0;
+    static constexpr GLuint WorkgroupSize = 8;
+
+    GLuint pyramidTexture = 0;
+    glm::ivec2 size{0};
+    uint32_t levelsCount = 0;
+
+    glm::mat4 viewProjection{1.f};
+    bool isValid = false;
+
+    std::shared_ptr<ShaderWrapper> reduceShader;
+    UniformHandle<int> sourceUniform;
+    UniformHandle<int> sourceLevelUniform;
+    UniformHandle<bool> isCopyUniform;
+    UniformHandle<int> samplesCountUniform;
+
+public:
+    DepthPyramid() = default;
+    ~DepthPyramid();
+
+    DepthPyramid(const DepthPyramid&) = delete;
+    DepthPyramid& operator=(const DepthPyramid&) = delete;
+
+    // Reduces the depth texture of source, rendered with viewProjection
+    void Build(const OffscreenFramebuffer& source, const glm::mat4& viewProjection);
+    // Dropped when the pyramid no longer matches what is on screen
+    void Invalidate();
+    void Bind() const;
+    // Deletes the textures and drops the reduction program, the next Build creates them again
+    void Shutdown();
+
+    // False until built, the culling then has nothing to test against
+    [[nodiscard]] bool IsValid() const;
+    [[nodiscard]] const glm::mat4& GetViewProjection() const;
+    [[nodiscard]] const glm::ivec2& GetSize() const;
+    [[nodiscard]] uint32_t GetLevelsCount() const;
+
+private:
+    void Resize(const glm::ivec2& newSize);
+    void Release();
+};
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+#include <glm/glm.hpp>
+
+// Startup configuration, filled from the command line in main
+struct EngineOptions
+{
+    // Render to an offscreen framebuffer without a window, ImGui and user input
+    bool isHeadless = false;
+    // Headless runs stop after this many frames, each advancing the scene by fixedDeltaSeconds
+    uint32_t framesCount = 600;
+    float fixedDeltaSeconds = 1.f / 60.f;
+    glm::ivec2 resolution = {1280, 720};
+    // Keyframes for the headless camera, an orbit around the scene is used when empty
+    std::string cameraPathFile;
+    // Frame timings are written here as JSON when set
+    std::string statsOutputPath;
+    // Every headless frame is recorded by the FrameProfiler and written here as a Chrome trace when set
+    std::string traceOutputPath;
+    // Meshes are stored as CompactVertex where the quantization error stays within budget
+    bool isVertexQuantizationEnabled = true;
+    // Instances are culled by compute shaders, the CPU path stays available to compare against
+    bool isGpuCullingEnabled = true;
+    // The GPU culling also rejects instances hidden behind the depth of the previous frame
+    bool isOcclusionCullingEnabled = true;
+    // Extra point lights scattered around the scene to stress the clustered lighting
+    uint32_t extraLightsCount = 0;
+
+    // Returns false and logs the problem on unknown or malformed arguments
+    bool Parse(int argc, char** argv);
+};
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <vector>
+
+#include <glad/glad.h>
+
+// Uniform blocks shared by every shader, the value is the uniform binding of the block
+enum class FrameBlock : uint32_t
+{
+    Camera = 0,
+    Lights = 1,
+    Shadows = 2,
+};
+
+struct FrameConstantsStats
+{
+    // Writes requested during the last frame and their bytes
+    uint32_t writesCount = 0;
+    size_t writtenBytes = 0;
+    // Writes that matched the data already in the buffer
+    uint32_t unchangedWritesCount = 0;
+    // What actually went to the GPU, one mapped range at most. The range spans the alignment gaps between the
+    // changed blocks, so it can exceed the written bytes
+    uint32_t uploadCallsCount = 0;
+    size_t uploadedBytes = 0;
+
+    [[nodiscard]] size_t GetSavedBytes() const { return writtenBytes > uploadedBytes ? writtenBytes - uploadedBytes : 0; }
+    [[nodiscard]] uint32_t GetSavedCalls() const { return writesCount - uploadCallsCount; }
+};
+
+// Per frame uniform blocks packed into one uniform buffer, each bound to its binding as a range.
+// Writes land in a CPU copy of the buffer and only extend the dirty range when they change something, Flush then
+// uploads the dirty range with one mapped write. Setting the same camera or light twice in a frame, or every frame
+// without changes, costs a compare instead of an upload.
+class FrameConstants
+{
+public:
+    static constexpr size_t BlocksCount = 3;
+    // Size reserved for each block, enough for the std140 block the shaders declare at its binding
+    static constexpr std::array<size_t, BlocksCount> BlockCapacities = {256, 256, 512};
+
+private:
+    GLuint buffer = 0;
+    std::array<size_t, BlocksCount> blockOffsets{};
+    std::vector<uint8_t> shadowCopy;
+
+    size_t dirtyBegin = SIZE_MAX;
+    size_t dirtyEnd = 0;
+
+    FrameConstantsStats frameStats;
+    FrameConstantsStats stats;
+
+    FrameConstants() = default;
+
+public:
+    static FrameConstants& GetInstance();
+
+    FrameConstants(const FrameConstants&) = delete;
+    FrameConstants& operator=(const FrameConstants&) = delete;
+
+    void Write(FrameBlock Block, size_t Offset, const void* Data, size_t Size);
+    // Uploads everything written since the last flush, has to run before the frame draws anything
+    void Flush();
+    void Shutdown();
+
+    // Counters of the last flushed frame
+    [[nodiscard]] const FrameConstantsStats& GetStats() const;
+
+private:
+    void Create();
+};
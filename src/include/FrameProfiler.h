@@ -0,0 +1,142 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include <glad/glad.h>
+
+// Fixed window of the latest samples of one value, in milliseconds
+class RollingSamples
+{
+public:
+    static constexpr uint32_t Capacity = 240;
+
+private:
+    std::array<float, Capacity> samples{};
+    uint32_t count = 0;
+    uint32_t next = 0;
+
+public:
+    void Push(float Sample);
+
+    // Nearest-rank percentile of the window, Fraction in [0, 1]
+    [[nodiscard]] float GetPercentile(float Fraction) const;
+    [[nodiscard]] float GetLatest() const;
+    [[nodiscard]] bool IsEmpty() const;
+};
+
+struct ProfilerScopeStats
+{
+    std::string_view name;
+    uint32_t depth = 0;
+    bool isGpuTimed = false;
+    RollingSamples cpuMilliseconds;
+    RollingSamples gpuMilliseconds;
+};
+
+// Hierarchical frame profiler for the render thread.
+// CPU and GPU timed scopes nest freely, GPU scopes are measured by a pair of GL_TIMESTAMP queries around them,
+// so passes inside an already timed scope get their own GPU time. Queries are double-buffered: a frame is resolved
+// FrameLatency frames later, when its results are available, and both its CPU and GPU timings enter the statistics
+// and the trace capture together.
+// Scopes with the same name are summed per frame. Names must outlive the profiler, string literals are expected.
+class FrameProfiler
+{
+public:
+    static constexpr uint32_t FrameLatency = 2;
+    static constexpr uint32_t InvalidScope = UINT32_MAX;
+
+private:
+    struct ScopeRecord
+    {
+        uint32_t statsIndex;
+        uint32_t depth;
+        int64_t startNanoseconds;
+        int64_t endNanoseconds;
+        // Start timestamp query, the end query follows it
+        int32_t queryIndex;
+    };
+
+    struct FrameRecord
+    {
+        std::vector<ScopeRecord> scopes;
+        std::vector<GLuint> queries;
+        uint32_t usedQueriesCount = 0;
+        bool isPending = false;
+    };
+
+    std::array<FrameRecord, FrameLatency> frames;
+    uint64_t frameIndex = 0;
+    bool isEnabled = true;
+    bool isFrameActive = false;
+    uint32_t depth = 0;
+
+    std::vector<ProfilerScopeStats> scopeStats;
+    std::unordered_map<std::string_view, uint32_t> statsIndices;
+    // Scopes of the last resolved frame in the order they were opened
+    std::vector<uint32_t> displayOrder;
+    std::vector<float> frameCpuTotals;
+    std::vector<float> frameGpuTotals;
+
+    std::string captureOutputPath;
+    uint32_t captureFramesLeft = 0;
+    int64_t captureOriginNanoseconds = -1;
+    std::string captureEvents;
+
+    FrameProfiler() = default;
+public:
+    static FrameProfiler& GetInstance();
+
+    void BeginFrame();
+    void EndFrame();
+
+    uint32_t BeginScope(std::string_view Name, bool IsGpuTimed);
+    void EndScope(uint32_t Scope);
+
+    // Records the next FramesCount resolved frames and writes them as a Chrome trace (chrome://tracing, Perfetto)
+    bool StartCapture(std::string OutputPath, uint32_t FramesCount);
+    [[nodiscard]] bool IsCapturing() const;
+
+    // Resolves every pending frame, waiting for the GPU
+    void Flush();
+    // Deletes the queries, must run while the GL context is still current
+    void Shutdown();
+
+    void DrawWidget();
+
+    [[nodiscard]] const std::vector<ProfilerScopeStats>& GetScopeStats() const;
+    [[nodiscard]] bool IsEnabled() const;
+    void SetEnabled(bool IsEnabled);
+
+private:
+    void ResolveFrame(FrameRecord& Frame);
+    void AppendTraceEvents(const FrameRecord& Frame, const std::vector<float>& GpuMilliseconds);
+    void FinishCapture();
+    uint32_t GetStatsIndex(std::string_view Name, uint32_t Depth, bool IsGpuTimed);
+    static int64_t GetNanoseconds();
+};
+
+// Times the enclosing block on the CPU and optionally on the GPU
+class ProfileScope
+{
+private:
+    uint32_t scope;
+
+public:
+    explicit ProfileScope(std::string_view Name, bool IsGpuTimed = false)
+    : scope(FrameProfiler::GetInstance().BeginScope(Name, IsGpuTimed))
+    {
+    }
+
+    ~ProfileScope()
+    {
+        FrameProfiler::GetInstance().EndScope(scope);
+    }
+
+    ProfileScope(const ProfileScope&) = delete;
+    ProfileScope& operator=(const ProfileScope&) = delete;
+};
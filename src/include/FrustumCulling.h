@@ -0,0 +1,53 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "Bounds.h"
+
+struct Frustum
+{
+    // Normalized planes with normals pointing inside: left, right, bottom, top, near, far
+    std::array<glm::vec4, 6> planes;
+
+    static Frustum FromMatrix(const glm::mat4& viewProjection);
+
+    [[nodiscard]] bool IsSphereVisible(const glm::vec3& center, float radius) const;
+};
+
+// World space bounding spheres stored as SoA so they can be tested several at a time
+struct BoundingSpheres
+{
+    std::vector<float> centersX;
+    std::vector<float> centersY;
+    std::vector<float> centersZ;
+    std::vector<float> radii;
+
+    void Resize(size_t size);
+    void Set(size_t index, const BoundingSphere& sphere);
+    void Move(size_t from, size_t to);
+    [[nodiscard]] BoundingSphere Get(size_t index) const;
+    [[nodiscard]] size_t GetSize() const;
+};
+
+namespace FrustumCulling
+{
+    // Writes indices of spheres intersecting the frustum to visibleIndices, returns their count.
+    // Uses AVX when the CPU supports it, SSE otherwise. All paths return the same indices.
+    uint32_t CullSpheres(const Frustum& frustum, const BoundingSpheres& spheres, std::vector<uint32_t>& visibleIndices);
+
+    uint32_t CullSpheresScalar(const Frustum& frustum, const BoundingSpheres& spheres,
+                               std::vector<uint32_t>& visibleIndices);
+    // Scalar where the target has no SSE2
+    uint32_t CullSpheresSse(const Frustum& frustum, const BoundingSpheres& spheres,
+                            std::vector<uint32_t>& visibleIndices);
+    // SSE where the CPU or the compiler has no AVX
+    uint32_t CullSpheresAvx(const Frustum& frustum, const BoundingSpheres& spheres,
+                            std::vector<uint32_t>& visibleIndices);
+
+    // Detected once from CPUID, AVX is compiled in regardless of the build flags
+    [[nodiscard]] bool IsAvxSupported();
+}
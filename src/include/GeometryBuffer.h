@@ -0,0 +1,120 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <map>
+#include <span>
+
+#include <glad/glad.h>
+
+#include "Vertex.h"
+
+// Layout consumed by glMultiDrawElementsIndirect
+struct DrawElementsIndirectCommand
+{
+    GLuint count;
+    GLuint instanceCount;
+    GLuint firstIndex;
+    GLint baseVertex;
+    GLuint baseInstance;
+};
+
+// Where a mesh lives in the GeometryBuffer, indices are relative to baseVertex
+struct GeometryRange
+{
+    GLint baseVertex = 0;
+    GLuint verticesCount = 0;
+    GLuint firstIndex = 0;
+    GLuint indicesCount = 0;
+    // Selects the vertex buffer baseVertex points into
+    VertexFormat format = VertexFormat::Full;
+};
+
+struct GeometryBufferStats
+{
+    uint32_t meshesCount = 0;
+    uint32_t compactMeshesCount = 0;
+    uint32_t usedIndices = 0;
+    uint32_t indexCapacity = 0;
+    // Vertex memory of both formats in bytes
+    size_t usedVertexBytes = 0;
+    size_t vertexCapacityBytes = 0;
+};
+
+// First-fit allocator of element ranges, neighbouring free ranges are merged on release
+class RangeAllocator
+{
+private:
+    // Offset to size of every free range
+    std::map<uint32_t, uint32_t> freeRanges;
+    uint32_t capacity = 0;
+
+public:
+    bool Allocate(uint32_t Count, uint32_t& OffsetOut);
+    void Release(uint32_t Offset, uint32_t Count);
+    void Grow(uint32_t NewCapacity);
+
+    [[nodiscard]] uint32_t GetCapacity() const;
+};
+
+// Static geometry of every mesh packed into one vertex buffer per VertexFormat and one shared index buffer.
+// Each format has its own VAO, so any set of meshes of one format can be drawn with one glMultiDrawElementsIndirect.
+// Buffers grow by copying on the GPU, ranges are recycled when meshes go away.
+//
+// Attribute DrawIdAttribute is an instanced uint that reads baseInstance of the current indirect command
+// (its divisor is never reached), which gives GL 4.3 shaders the index of the draw without gl_DrawID.
+class GeometryBuffer
+{
+public:
+    static constexpr GLuint DrawIdAttribute = 3;
+
+private:
+    static constexpr GLuint VertexBinding = 0;
+    static constexpr GLuint DrawIdBinding = 1;
+    static constexpr uint32_t MinimalVertexCapacity = 1 << 16;
+    static constexpr uint32_t MinimalIndexCapacity = 1 << 18;
+    static constexpr size_t VertexFormatsCount = 2;
+
+    struct VertexPool
+    {
+        GLuint vao = 0;
+        GLuint buffer = 0;
+        GLsizei stride = 0;
+        RangeAllocator ranges;
+    };
+
+    std::array<VertexPool, VertexFormatsCount> vertexPools;
+    GLuint indexBuffer = 0;
+    GLuint drawIdBuffer = 0;
+    uint32_t drawIdsCount = 0;
+    bool isCreated = false;
+
+    RangeAllocator indexRanges;
+    GeometryBufferStats stats;
+
+    GeometryBuffer() = default;
+public:
+    static GeometryBuffer& GetInstance();
+
+    GeometryRange Allocate(std::span<const Vertex> Vertices, std::span<const GLuint> Indices);
+    GeometryRange Allocate(std::span<const CompactVertex> Vertices, std::span<const GLuint> Indices);
+    void Release(const GeometryRange& Range);
+
+    // Draw ids 0..Count-1 become valid baseInstance values of indirect commands
+    void ReserveDrawIds(uint32_t Count);
+    void Bind(VertexFormat Format = VertexFormat::Full);
+
+    // Deletes the GL objects, must run while the GL context is still current
+    void Shutdown();
+
+    [[nodiscard]] const GeometryBufferStats& GetStats() const;
+
+private:
+    GeometryRange Allocate(VertexFormat Format, const void* Vertices, uint32_t VerticesCount,
+                           std::span<const GLuint> Indices);
+    void CreateVertexArrays();
+    static void SetVertexFormat(VertexFormat Format);
+    void GrowVertexBuffer(VertexPool& Pool, uint32_t RequiredCount);
+    void GrowIndexBuffer(uint32_t RequiredCount);
+    static GLuint ResizeBuffer(GLuint Buffer, GLsizeiptr OldSize, GLsizeiptr NewSize);
+};
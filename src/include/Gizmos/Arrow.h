@@ -9,5 +9,6 @@
 class Arrow: public Gizmo
 {
 public:
+    // Queues a line from Start to End with a fixed size tip at End
     static void Draw(glm::vec3 Start, glm::vec3 End, glm::vec4 Color);
 };
@@ -1,17 +1,70 @@
 #pragma once
 
 #include <memory>
+#include <vector>
+
 #include "glad/glad.h"
+#include "glm/glm.hpp"
 #include "ShaderWrapper.h"
 
+// One queued gizmo, matches the instance attributes of gizmos.vert
+struct GizmoInstance
+{
+    glm::mat4 transform;
+    glm::vec4 color;
+};
+
+struct GizmoStats
+{
+    uint32_t instancesCount = 0;
+    uint32_t drawCallsCount = 0;
+    size_t uploadedBytes = 0;
+};
+
+// Retained debug drawing.
+// Unit primitives are built once as line lists in shared vertex and index buffers, the Draw functions of the
+// gizmo types only queue an instance of them with a transform and a color. Render uploads every instance queued
+// during the frame as one stream and issues one instanced draw per primitive.
 class Gizmo
 {
 protected:
+    struct Primitive
+    {
+        GLint baseVertex = 0;
+        uint32_t firstIndex = 0;
+        uint32_t indicesCount = 0;
+        std::vector<GizmoInstance> instances;
+    };
+
     static GLuint VAO;
     static GLuint VBO;
     static GLuint EBO;
+    static GLuint InstanceBuffer;
     static std::shared_ptr<ShaderWrapper> Shader;
 
+    static std::vector<Primitive> Primitives;
+    static std::vector<glm::vec3> PrimitiveVertices;
+    static std::vector<GLuint> PrimitiveIndices;
+    static bool ArePrimitivesDirty;
+
+    static std::vector<GizmoInstance> InstanceStream;
+    static GizmoStats Stats;
+
 public:
     static void Initialize();
+    // Deletes the GL objects, the queued primitives stay and are uploaded again after the next Initialize
+    static void Shutdown();
+
+    // Draws everything queued since the last call
+    static void Render();
+
+    [[nodiscard]] static const GizmoStats& GetStats();
+
+protected:
+    // Returns the index of the new primitive, uploaded with the next Render
+    static uint32_t AddPrimitive(const std::vector<glm::vec3>& Vertices, const std::vector<GLuint>& LineIndices);
+    static void Queue(uint32_t PrimitiveIndex, const glm::mat4& Transform, const glm::vec4& Color);
+
+private:
+    static void UploadPrimitives();
 };
@@ -7,5 +7,6 @@
 class SphereGizmo: public Gizmo
 {
 public:
+    // Queues a wireframe sphere, the unit sphere of every LOD is built on its first use
     static void Draw(glm::vec3 Position, float Radius, uint16_t LOD, glm::vec4 Color);
 };
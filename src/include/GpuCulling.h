@@ -0,0 +1,167 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include "Bounds.h"
+#include "FrustumCulling.h"
+#include "GeometryBuffer.h"
+#include "MeshSimplifier.h"
+#include "PersistentBuffer.h"
+#include "UniformHandle.h"
+
+class ShaderWrapper;
+class DepthPyramid;
+
+// Instances are culled twice per frame when occlusion culling is on. The early phase tests against the depth
+// pyramid of the previous frame and keeps what it rejects, the late phase tests those again against the pyramid
+// built from what the early phase drew. Nothing that became visible is missed, it is only drawn a bit later.
+enum class CullingPhase : uint32_t
+{
+    Early = 0,
+    Late = 1,
+};
+
+struct GpuCullingCounters
+{
+    // Visible instances of both phases
+    std::array<uint32_t, MeshSimplifier::MaxLodsCount> lodInstancesCount{};
+    // Rejected by the previous depth and tested again
+    uint32_t retestedCount = 0;
+    // Still hidden behind the current depth, never drawn
+    uint32_t occludedCount = 0;
+};
+
+// Buffers of one model that only the GPU writes. Every phase has its own commands and visible slots, visible slots
+// of LOD i in phase p start at (p * MaxLodsCount + i) * capacity of visibleBuffer. commandBuffer holds the draw
+// commands of the model once per phase with their instance counts filled in by the GPU.
+// occludedBuffer keeps the slots the early phase rejected by occlusion for the late phase.
+// Counters are copied into the readback buffer of the frame's region and read back once its fence passed, every
+// region has its own buffer so reading one never waits for copies still queued into another.
+class GpuCullingBuffers
+{
+private:
+    GLuint visibleBuffer = 0;
+    GLuint commandBuffer = 0;
+    GLuint counterBuffer = 0;
+    GLuint occludedBuffer = 0;
+    std::array<GLuint, PersistentBuffer::RegionCount> readbackBuffers{};
+    uint32_t capacity = 0;
+    uint32_t commandsCount = 0;
+    uint8_t writtenRegionsMask = 0;
+
+    friend class GpuCulling;
+
+public:
+    GpuCullingBuffers() = default;
+    ~GpuCullingBuffers();
+
+    GpuCullingBuffers(const GpuCullingBuffers&) = delete;
+    GpuCullingBuffers& operator=(const GpuCullingBuffers&) = delete;
+    GpuCullingBuffers(GpuCullingBuffers&& other) noexcept;
+    GpuCullingBuffers& operator=(GpuCullingBuffers&& other) noexcept;
+
+    // Template commands with the counts, offsets and draw ids, the instance counts are replaced every frame
+    void SetCommands(const std::vector<DrawElementsIndirectCommand>& commands);
+    // The GPU may still read the old buffers, callers wait for every region first
+    void Resize(uint32_t capacity);
+
+    [[nodiscard]] GLuint GetVisibleBuffer() const;
+    [[nodiscard]] GLuint GetCommandBuffer() const;
+    [[nodiscard]] uint32_t GetCapacity() const;
+
+    // First visible slot of a LOD and first command of a phase within the buffers
+    [[nodiscard]] GLuint GetFirstVisible(CullingPhase phase, uint32_t lod) const;
+    [[nodiscard]] GLintptr GetCommandsOffset(CullingPhase phase) const;
+
+    // What the GPU counted when the region was last used, false until it was culled once
+    bool ReadCounters(uint32_t region, GpuCullingCounters& countersOut) const;
+
+private:
+    void Release();
+};
+
+// Frustum and occlusion culling and LOD selection of instances on the GPU.
+// One thread per instance tests the model's bounding sphere moved by the instance transform against the frustum,
+// then the box around it against a DepthPyramid, picks the LOD from its screen size, and appends the slot to the
+// range of the LOD with an atomic counter.
+// A second dispatch writes the counters into the instance counts of the model's indirect commands, so the draw
+// only needs glMultiDrawElementsIndirect and the CPU never touches the visible slots.
+class GpuCulling
+{
+public:
+    static constexpr GLuint CountersBinding = 9;
+    static constexpr GLuint CommandsBinding = 10;
+    static constexpr GLuint OccludedBinding = 11;
+    static constexpr GLuint WorkgroupSize = 64;
+
+    // What the instances are tested against, shared by every model of the frame
+    struct View
+    {
+        Frustum frustum{};
+        glm::vec3 position{0.f};
+        float projectionScale = 1.f;
+        bool isCullingEnabled = true;
+        // 1 without LODs, every instance then draws the full detail meshes
+        uint32_t maxLodsCount = MeshSimplifier::MaxLodsCount;
+    };
+
+    // Where the instances of a model are and how its commands are split between the LODs
+    struct Batch
+    {
+        GLuint instancesBuffer = 0;
+        GLintptr instancesOffset = 0;
+        GLsizeiptr instancesSize = 0;
+        uint32_t instancesCount = 0;
+        BoundingSphere bounds;
+        // First command of every LOD followed by the end of the last one
+        std::array<uint32_t, MeshSimplifier::MaxLodsCount + 1> lodFirstCommands{};
+        uint32_t lodsCount = 1;
+    };
+
+private:
+    std::shared_ptr<ShaderWrapper> cullShader;
+    std::shared_ptr<ShaderWrapper> commandsShader;
+
+    UniformHandle<GLuint> instancesCountUniform;
+    UniformHandle<GLuint> visibleCapacityUniform;
+    UniformHandle<glm::vec4> modelBoundsUniform;
+    UniformHandle<GLuint> lodsCountUniform;
+    std::array<UniformHandle<glm::vec4>, 6> frustumPlaneUniforms;
+    UniformHandle<bool> isCullingEnabledUniform;
+    UniformHandle<glm::vec4> lodViewUniform;
+    UniformHandle<glm::vec4> lodScreenSizesUniform;
+    UniformHandle<GLuint> phaseUniform;
+    UniformHandle<bool> isOcclusionEnabledUniform;
+    UniformHandle<glm::mat4> occlusionViewProjectionUniform;
+    UniformHandle<glm::vec2> pyramidSizeUniform;
+    UniformHandle<int> pyramidLevelsCountUniform;
+
+    UniformHandle<GLuint> commandsCountUniform;
+    UniformHandle<GLuint> commandsPhaseUniform;
+    UniformHandle<GLuint> lodBoundariesCountUniform;
+    std::array<UniformHandle<GLuint>, MeshSimplifier::MaxLodsCount - 1> lodFirstCommandUniforms;
+
+    uint32_t maxLodsCount = MeshSimplifier::MaxLodsCount;
+    bool isInitialized = false;
+    bool isSupported = false;
+
+public:
+    // Compiles the compute shaders on first use, false when they do not link and the CPU has to cull
+    bool Initialize();
+    // Drops the compute programs, the next Initialize loads them again
+    void Shutdown();
+
+    // Sets the view every Cull of the frame uses
+    void SetView(const View& view, const float (&lodScreenSizes)[MeshSimplifier::MaxLodsCount - 1]);
+    // Depth the following culls test against, nullptr turns occlusion culling off
+    void SetOcclusion(const DepthPyramid* pyramid);
+    // Culls the batch into buffers and fills the commands of the phase, the late phase only tests what the early
+    // phase rejected by occlusion. Region selects where the counters are read back from.
+    void Cull(const Batch& batch, GpuCullingBuffers& buffers, CullingPhase phase, uint32_t region);
+};
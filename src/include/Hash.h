@@ -0,0 +1,29 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+namespace Hash
+{
+    constexpr uint64_t Fnv1aOffsetBasis = 14695981039346656037ull;
+    constexpr uint64_t Fnv1aPrime = 1099511628211ull;
+
+    // 64-bit FNV-1a, pass the previous result as Seed to hash several blocks as one
+    inline uint64_t Fnv1a(const void* Data, size_t Size, uint64_t Seed = Fnv1aOffsetBasis)
+    {
+        auto* Bytes = static_cast<const uint8_t*>(Data);
+        uint64_t Result = Seed;
+        for (size_t i = 0; i < Size; ++i)
+        {
+            Result ^= Bytes[i];
+            Result *= Fnv1aPrime;
+        }
+        return Result;
+    }
+
+    inline uint64_t Fnv1a(std::string_view Text, uint64_t Seed = Fnv1aOffsetBasis)
+    {
+        return Fnv1a(Text.data(), Text.size(), Seed);
+    }
+}
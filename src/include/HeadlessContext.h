@@ -0,0 +1,30 @@
+#pragma once
+
+#include <cstdint>
+
+struct GLFWwindow;
+
+// OpenGL 4.3 core context without a visible window.
+// With HOUSING_ESTATE_EGL it is a surfaceless EGL context (Mesa llvmpipe works without any display server),
+// otherwise it falls back to a hidden GLFW window. Rendering has to go to an offscreen framebuffer.
+class HeadlessContext
+{
+private:
+#ifdef HOUSING_ESTATE_EGL
+    void* display = nullptr;
+    void* context = nullptr;
+#else
+    GLFWwindow* window = nullptr;
+#endif
+
+public:
+    HeadlessContext() = default;
+    ~HeadlessContext();
+
+    HeadlessContext(const HeadlessContext&) = delete;
+    HeadlessContext& operator=(const HeadlessContext&) = delete;
+
+    // Creates the context, makes it current and loads the GL functions
+    bool Create();
+    void Destroy();
+};
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <cstddef>
+
+#include <glm/glm.hpp>
+
+// One entry of the instance buffer, matches InstanceData in instanced.vert under std430.
+// The normal matrix is the inverse transpose of the upper 3x3 of the transform, stored as three padded columns
+// so the vertex shader never inverts a matrix.
+struct GpuInstance
+{
+    glm::mat4 transform;
+    glm::vec4 normalMatrix[3];
+};
+
+static_assert(sizeof(GpuInstance) == 112, "GpuInstance has to match the std430 layout of InstanceData");
+
+namespace InstanceData
+{
+    // Fills normalMatrix of every instance from its transform. Uses SSE when the build enables it.
+    // Columns of the inverse transpose are the cross products of the columns of the transform over its determinant,
+    // singular transforms get the cofactor matrix, which still gives the direction of the normals.
+    void ComputeNormalMatrices(GpuInstance* instances, size_t count);
+
+    // Reference the SSE path falls back to, normal_matrices_stress compares both
+    void ComputeNormalMatricesScalar(GpuInstance* instances, size_t count);
+}
@@ -0,0 +1,101 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Work-stealing thread pool.
+// Every worker owns a queue it pops from the back of, idle workers steal from the front of the others.
+// Threads that are not part of the pool share one extra queue and help executing jobs while they Wait.
+class JobSystem
+{
+public:
+    using Job = std::function<void()>;
+
+    class Counter
+    {
+    private:
+        std::atomic<uint32_t> pendingJobs{0};
+
+    public:
+        [[nodiscard]] bool IsDone() const;
+
+        friend class JobSystem;
+    };
+
+private:
+    struct QueuedJob
+    {
+        Job function;
+        Counter* counter;
+    };
+
+    struct WorkQueue
+    {
+        std::mutex mutex;
+        std::deque<QueuedJob> jobs;
+    };
+
+    std::vector<std::thread> workers;
+    std::vector<std::unique_ptr<WorkQueue>> queues;
+
+    std::atomic<uint32_t> queuedJobsCount{0};
+    std::atomic<bool> isRunning{true};
+
+    std::mutex sleepMutex;
+    std::condition_variable wakeCondition;
+
+public:
+    explicit JobSystem(uint32_t workerCount = DefaultWorkerCount());
+    ~JobSystem();
+
+    JobSystem(const JobSystem&) = delete;
+    JobSystem& operator=(const JobSystem&) = delete;
+
+    void Schedule(Counter& counter, Job job);
+    void Wait(Counter& counter);
+
+    // Splits [begin, end) into chunks of at most grainSize elements and blocks until all of them are done.
+    template<typename Function>
+    void ParallelFor(uint32_t begin, uint32_t end, uint32_t grainSize, Function function);
+
+    [[nodiscard]] uint32_t GetWorkerCount() const;
+    [[nodiscard]] bool IsWorkerThread() const;
+
+    static uint32_t DefaultWorkerCount();
+
+private:
+    void WorkerLoop(uint32_t queueIndex);
+    bool TryRunJob(uint32_t queueIndex);
+    bool TryPopJob(uint32_t queueIndex, QueuedJob& jobOut);
+
+    [[nodiscard]] uint32_t GetLocalQueueIndex() const;
+};
+
+template<typename Function>
+void JobSystem::ParallelFor(uint32_t begin, uint32_t end, uint32_t grainSize, Function function)
+{
+    if (end <= begin)
+        return;
+
+    if (workers.empty() || end - begin <= grainSize)
+    {
+        function(begin, end);
+        return;
+    }
+
+    Counter counter;
+    for (uint32_t chunkBegin = begin; chunkBegin < end; chunkBegin += grainSize)
+    {
+        uint32_t chunkEnd = std::min(end, chunkBegin + grainSize);
+        Schedule(counter, [&function, chunkBegin, chunkEnd]() { function(chunkBegin, chunkEnd); });
+    }
+    Wait(counter);
+}
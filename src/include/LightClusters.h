@@ -0,0 +1,128 @@
+#pragma once
+
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include "Bounds.h"
+
+class JobSystem;
+
+enum class LightType : uint32_t
+{
+    Point = 0,
+    Spot = 1
+};
+
+// Point or spot light as the shaders see it, matches LocalLight in the model fragment shaders under std430.
+// Range is where the attenuated light gets too dim to matter, lights are only assigned to clusters within it.
+struct GpuLight
+{
+    glm::vec4 color;
+    glm::vec3 position;
+    float range;
+    glm::vec3 direction;
+    float linear;
+    float quadratic;
+    float cosCutOff;
+    float cosOuterCutOff;
+    LightType type;
+};
+
+static_assert(sizeof(GpuLight) == 64, "GpuLight has to match the std430 layout of Light");
+
+struct LightClusterStats
+{
+    uint32_t lightsCount = 0;
+    uint32_t indicesCount = 0;
+    uint32_t occupiedClustersCount = 0;
+    uint32_t maxClusterLightsCount = 0;
+};
+
+// Clustered light lists for forward shading.
+// The view frustum is split into GridX x GridY screen tiles and GridZ slices spaced exponentially in depth.
+// Every frame the lights are tested against the view space bounds of every cluster on the CPU, one job per
+// slice and several lights at a time with SSE, and the result is uploaded as an offset and count per cluster
+// into one list of light indices. Fragments only shade the lights of the cluster they fall into.
+class LightClusters
+{
+public:
+    static constexpr uint32_t GridX = 16;
+    static constexpr uint32_t GridY = 9;
+    static constexpr uint32_t GridZ = 24;
+    static constexpr uint32_t ClustersCount = GridX * GridY * GridZ;
+
+    static constexpr GLuint ClustersBinding = 7;
+    static constexpr GLuint LightIndicesBinding = 8;
+
+private:
+    // Lights of a slice as SoA so the cluster tests can load several of them at once
+    struct SliceLights
+    {
+        std::vector<float> centersX;
+        std::vector<float> centersY;
+        std::vector<float> centersZ;
+        std::vector<float> radii;
+        std::vector<uint32_t> lights;
+        std::vector<uint32_t> indices;
+        std::vector<uint32_t> clusterCounts;
+    };
+
+    // Matches uvec2 of the Clusters SSBO
+    struct ClusterRange
+    {
+        uint32_t offset;
+        uint32_t count;
+    };
+
+    // View space bounds of the lights, spot lights are also culled by their cone
+    struct ViewLight
+    {
+        glm::vec3 center;
+        float radius;
+        glm::vec3 direction;
+        float cosAngle;
+        float sinAngle;
+        bool isSpot;
+    };
+
+    std::vector<AABB> clusterBounds;
+    std::vector<float> sliceDepths;
+    glm::vec2 cachedProjectionScale{0.f};
+    float cachedNear = 0.f;
+    float cachedFar = 0.f;
+
+    std::vector<ViewLight> viewLights;
+    std::vector<SliceLights> slices;
+    std::vector<ClusterRange> clusters;
+    std::vector<uint32_t> lightIndices;
+
+    GLuint clustersBuffer = 0;
+    GLuint lightIndicesBuffer = 0;
+
+    LightClusterStats stats;
+
+public:
+    LightClusters();
+    ~LightClusters();
+
+    LightClusters(const LightClusters&) = delete;
+    LightClusters& operator=(const LightClusters&) = delete;
+
+    // Lights are in world space, the projection has to be a symmetric perspective one
+    void Build(std::span<const GpuLight> Lights, const glm::mat4& View, const glm::mat4& Projection, float Near,
+               float Far, JobSystem* Jobs = nullptr);
+    void Upload();
+    void Bind() const;
+
+    // Slice of a view depth is log(depth) * x + y
+    [[nodiscard]] static glm::vec2 GetSliceParameters(float Near, float Far);
+    [[nodiscard]] const LightClusterStats& GetStats() const;
+
+private:
+    void UpdateClusterBounds(const glm::vec2& ProjectionScale, float Near, float Far);
+    void AssignSlice(uint32_t Slice);
+};
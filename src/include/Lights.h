@@ -1,8 +1,13 @@
 #pragma once
 
+#include <vector>
+
 #include "glm/glm.hpp"
 #include "glad/glad.h"
 
+#include "LightClusters.h"
+#include "ShadowCascades.h"
+
 struct DirectionalLight
 {
     glm::vec4 color;
@@ -21,7 +26,6 @@ struct SpotLight
 {
     glm::vec4 color;
     glm::vec3 position;
-    float _GAP;
     glm::vec3 direction;
     float linear;
     float quadratic;
@@ -29,38 +33,76 @@ struct SpotLight
     float outerCutOff;
 };
 
+// Matches the Lights uniform block of the model fragment shaders under std140
+struct GpuLightsBlock
+{
+    glm::vec4 sunColor;
+    glm::vec4 sunDirection;
+    // Cluster counts in x, y and z, lights count in w
+    uint32_t clusterGrid[4];
+    // Slice scale and bias, tile size in pixels
+    glm::vec4 clusterParameters;
+};
+
+// The sun lights everything, point and spot lights are only shaded by the fragments of the clusters they reach.
+// Lights are uploaded and clustered for the current camera by Update, only when they or the camera changed.
+// The Lights uniform block is written to the FrameConstants.
 class Lights
 {
 private:
-    GLuint uboLightData;
+    // Intensity under which an attenuated light is cut off
+    static constexpr float MinLightIntensity = 1.f / 256.f;
+
+    GLuint lightsBuffer;
+    GLsizeiptr lightsBufferSize = 0;
 
     DirectionalLight sun;
-    PointLight bulb;
-    SpotLight spotLights[2];
+    std::vector<PointLight> pointLights;
+    std::vector<SpotLight> spotLights;
+
+    std::vector<GpuLight> gpuLights;
+    // Set by any change of the local lights, clean lights are neither rebuilt nor uploaded
+    bool areLightsDirty = true;
+    LightClusters clusters;
+    // Clusters are kept while the lights and the camera they were built for stay the same
+    glm::mat4 clusteredView{0.f};
+    glm::mat4 clusteredProjection{0.f};
+    ShadowCascades shadows;
 
 public:
+    static constexpr GLuint LightsBinding = 6;
+
     Lights();
     virtual ~Lights();
 
+    // Clusters the lights and fits the sun shadow cascades for the camera, has to run before the models are drawn
+    void Update(const class Camera &camera, class JobSystem *jobSystem = nullptr);
+
     void DrawGizmos();
 
     [[nodiscard]] const DirectionalLight &GetSun() const;
-    [[nodiscard]] const PointLight &GetBulb() const;
-    [[nodiscard]] const SpotLight &GetSpotLightOne() const;
-    [[nodiscard]] const SpotLight &GetSpotLightTwo() const;
-
     void SetSun(const DirectionalLight &sun);
-    void SetBulb(const PointLight &bulb);
-    void SetSpotLightOne(const SpotLight &spotLightOne);
-    void SetSpotLightTwo(const SpotLight &spotLightTwo);
-    
+
+    uint32_t AddPointLight(const PointLight &light);
+    uint32_t AddSpotLight(const SpotLight &light);
+    void ClearLocalLights();
+
+    [[nodiscard]] const PointLight &GetPointLight(uint32_t index) const;
+    [[nodiscard]] const SpotLight &GetSpotLight(uint32_t index) const;
+    void SetPointLight(uint32_t index, const PointLight &light);
+    void SetSpotLight(uint32_t index, const SpotLight &light);
+
+    [[nodiscard]] uint32_t GetPointLightsCount() const;
+    [[nodiscard]] uint32_t GetSpotLightsCount() const;
+    [[nodiscard]] const LightClusterStats &GetClusterStats() const;
+    [[nodiscard]] ShadowCascades &GetShadows();
+
     static glm::vec3 DirectionVector(float pitch, float yaw);
 
+    // Distance at which the attenuation brings the light under MinLightIntensity, the far plane when it never does
+    static float GetLightRange(const glm::vec4 &color, float linear, float quadratic);
+
 private:
     void InitializeLights();
-
-    void UpdateSun();
-    void UpdateBulb();
-    void UpdateSpotLights();
-    void UpdateSpotLightTwo();
+    void BuildGpuLights();
 };
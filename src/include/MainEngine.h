@@ -1,6 +1,8 @@
 #pragma once
 
+#include <chrono>
 #include <memory>
+#include <vector>
 
 #include <cstdint>
 #include <GLFW/glfw3.h>
@@ -9,19 +11,29 @@
 #include "Nodes/Node.h"
 #include "glm/gtc/constants.hpp"
 #include "ModelRenderer.h"
+#include "JobSystem.h"
+#include "EngineOptions.h"
 
 class MainEngine {
 private:
+    static constexpr uint32_t SceneSamplesCount = 4;
 
-    GLFWwindow* window;
+    EngineOptions options;
+    GLFWwindow* window = nullptr;
+    std::unique_ptr<class HeadlessContext> headlessContext;
+    // Fixed size in headless mode, follows the window otherwise
+    std::unique_ptr<class OffscreenFramebuffer> sceneFramebuffer;
+    bool isImGuiInitialized = false;
+    std::chrono::high_resolution_clock::time_point initTimePoint;
 
     class CameraNode* currentCamera;
     class std::shared_ptr<class Skybox> skybox;
     std::shared_ptr<class Lights> sceneLight;
-    Node sceneRoot;
+    JobSystem jobSystem;
     ModelRenderer renderer;
+    Node sceneRoot;
 public:
-    explicit MainEngine();
+    explicit MainEngine(EngineOptions options = {});
     virtual ~MainEngine();
 
     int32_t Init();
@@ -29,6 +41,10 @@ public:
     int32_t MainLoop();
 
     GLFWwindow* GetWindow() const;
+    glm::ivec2 GetFramebufferSize() const;
+    // What the scene is drawn into, null while the window is minimized
+    const class OffscreenFramebuffer* GetSceneFramebuffer() const;
+    bool IsHeadless() const;
 
     unsigned int GetSkyboxTextureId();
     friend class CameraNode;
@@ -37,6 +53,12 @@ private:
 
     static void GLFWErrorCallback(int error, const char* description);
     int32_t InitializeWindow();
+    int32_t InitializeHeadless();
+    int32_t RunHeadless();
+    void RenderFrame(float seconds, float deltaSeconds);
+    // Recreates the scene framebuffer when the window changed its size
+    void UpdateSceneFramebuffer();
+    void WriteHeadlessStats(const std::vector<float>& frameMilliseconds, float startupMilliseconds) const;
     void InitializeImGui(const char* glslVersion);
     void UpdateWidget(float deltaSeconds);
     void CheckGLErrors();
@@ -0,0 +1,125 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <glad/glad.h>
+
+class SharedTexture;
+
+// Resolved paths of the diffuse, specular and normal map of a material, empty when the material has none
+using MaterialTextures = std::array<std::string, 3>;
+
+// Location of every texture of a material, (array index << 16) | layer or -1 while there is nothing to sample.
+// Matches Material in the model fragment shaders.
+struct GpuMaterial
+{
+    GLint diffuseTexture = -1;
+    GLint specularTexture = -1;
+    GLint normalTexture = -1;
+    GLint padding = 0;
+};
+
+struct MaterialSystemStats
+{
+    uint32_t materialsCount = 0;
+    uint32_t texturesCount = 0;
+    uint32_t pendingTexturesCount = 0;
+    uint32_t arraysCount = 0;
+    size_t residentBytes = 0;
+};
+
+// Every material texture lives in a layer of a GL_TEXTURE_2D_ARRAY shared by all textures of its size and format,
+// and every material is an entry of one SSBO holding the locations of its textures.
+// The arrays stay bound to units 0..MaxTextureArrays-1 for the whole frame, so draws of any material can be
+// batched together and nothing rebinds textures between them.
+// Textures are streamed as standalone 2D textures and copied into their array once uploaded, the standalone
+// copy is released right after. Materials and textures are reference counted and shared between models.
+class MaterialSystem
+{
+public:
+    // Unit 14 is left for the sun shadow cascades and 15 for the skybox cubemap
+    static constexpr uint32_t MaxTextureArrays = 14;
+    static constexpr GLuint MaterialsBinding = 5;
+
+private:
+    static constexpr uint32_t MinimalLayersCapacity = 4;
+
+    struct TextureArray
+    {
+        GLuint id = 0;
+        GLsizei width = 0;
+        GLsizei height = 0;
+        GLsizei levelsCount = 0;
+        GLenum internalFormat = 0;
+        size_t layerBytes = 0;
+        uint32_t capacity = 0;
+        uint32_t layersCount = 0;
+        std::vector<uint32_t> freeLayers;
+    };
+
+    struct TextureRecord
+    {
+        // Held only until the streamed texture is copied into its array
+        std::shared_ptr<SharedTexture> streamedTexture;
+        GLint location = -1;
+        uint32_t referencesCount = 0;
+    };
+
+    struct MaterialRecord
+    {
+        MaterialTextures texturePaths;
+        uint32_t referencesCount = 0;
+    };
+
+    std::vector<TextureArray> arrays;
+    std::unordered_map<std::string, TextureRecord> textures;
+    std::vector<std::string> pendingTextures;
+
+    std::vector<MaterialRecord> materials;
+    std::vector<GpuMaterial> gpuMaterials;
+    std::vector<uint32_t> freeMaterials;
+    std::map<MaterialTextures, uint32_t> materialIndices;
+
+    GLuint materialsBuffer = 0;
+    GLsizeiptr materialsBufferSize = 0;
+    bool isMaterialsBufferDirty = false;
+    GLint maxLayersCount = 0;
+    bool isShutdown = false;
+
+    MaterialSystemStats stats;
+
+    MaterialSystem() = default;
+public:
+    static MaterialSystem& GetInstance();
+
+    // Materials with the same textures share one index into the materials SSBO
+    uint32_t AcquireMaterial(const MaterialTextures& TexturePaths);
+    void ReleaseMaterial(uint32_t Material);
+
+    // Moves uploaded textures into their arrays, has to be called on the GL thread after TextureStreamer::Update
+    void Update();
+    // Binds the texture arrays and the materials SSBO, samplers MaterialArrays[i] of a program have to use unit i
+    void Bind();
+    void SetSamplerUniforms(const class ShaderWrapper& Shader) const;
+
+    // Deletes the GL objects, must run while the GL context is still current and before TextureStreamer::Shutdown
+    void Shutdown();
+
+    [[nodiscard]] const GpuMaterial& GetGpuMaterial(uint32_t Material) const;
+    [[nodiscard]] const MaterialSystemStats& GetStats() const;
+
+private:
+    void AcquireTexture(const std::string& Path);
+    void ReleaseTexture(const std::string& Path);
+    GLint AddToArray(GLuint TextureId);
+    uint32_t FindOrCreateArray(GLsizei Width, GLsizei Height, GLenum InternalFormat);
+    bool GrowArray(TextureArray& Array);
+    GpuMaterial ResolveMaterial(const MaterialTextures& TexturePaths) const;
+    void UploadMaterials();
+};
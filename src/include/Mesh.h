@@ -1,25 +1,47 @@
 #pragma once
 
-#include <string>
+#include <span>
 #include <vector>
 #include <glm/glm.hpp>
 #include <glad/glad.h>
 
-#include "VAOWrapper.h"
-#include "ShaderWrapper.h"
+#include "Vertex.h"
+#include "GeometryBuffer.h"
+#include "MaterialSystem.h"
+#include "VertexQuantization.h"
+
+// Triangles of one level of detail within the index buffer of the GeometryBuffer
+struct MeshLod
+{
+    uint32_t firstIndex = 0;
+    uint32_t indicesCount = 0;
+};
 
 class Mesh
 {
 private:
-    std::vector<Vertex> vertices;
-    std::vector<GLuint> indices;
-    std::vector<Texture> textures;
-
-    VAOWrapper vao;
+    GeometryRange geometry;
+    std::vector<MeshLod> lods;
+    PositionDequantization dequantization;
+    uint32_t material;
 public:
-    Mesh(const std::vector<Vertex>& Vertices, const std::vector<GLuint>& Indices, const std::vector<Texture>& Textures);
-    void Draw(ShaderWrapper& Shader) const;
+    // Geometry is uploaded straight from the given ranges into the GeometryBuffer and not kept on the CPU.
+    // Indices hold one triangle list per entry of LodIndicesCounts, all LODs share the vertices.
+    // With a Budget the mesh is stored as CompactVertex when quantizing it stays within the budget.
+    Mesh(std::span<const Vertex> Vertices, std::span<const GLuint> Indices, std::span<const uint32_t> LodIndicesCounts,
+         const MaterialTextures& Textures, const QuantizationBudget* Budget = nullptr);
+    ~Mesh();
+
+    Mesh(const Mesh&) = delete;
+    Mesh& operator=(const Mesh&) = delete;
+
+    // Draws the full detail LOD, expects the GeometryBuffer and the MaterialSystem to be bound.
+    // DrawId selects the material of the draw.
+    void Draw(uint32_t DrawId) const;
 
-    const VAOWrapper& GetVao() const;
-    void BindTextures(const ShaderWrapper& Shader) const;
+    [[nodiscard]] const GeometryRange& GetGeometry() const;
+    // Finest first, there is always at least one
+    [[nodiscard]] const std::vector<MeshLod>& GetLods() const;
+    [[nodiscard]] const PositionDequantization& GetDequantization() const;
+    [[nodiscard]] uint32_t GetMaterial() const;
 };
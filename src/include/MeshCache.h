@@ -0,0 +1,76 @@
+#pragma once
+
+#include <span>
+#include <string>
+#include <vector>
+
+#include "Bounds.h"
+#include "MappedFile.h"
+#include "Vertex.h"
+
+struct TextureReference
+{
+    std::string textureType;
+    std::string texturePath;
+};
+
+// Mesh geometry as produced by the importer.
+// Indices hold the triangle lists of all LODs one after another, finest first.
+struct MeshData
+{
+    std::vector<Vertex> vertices;
+    std::vector<GLuint> indices;
+    std::vector<uint32_t> lodIndicesCounts;
+    std::vector<TextureReference> textures;
+};
+
+// Mesh geometry pointing straight into a mapped cache file
+struct MeshView
+{
+    std::span<const Vertex> vertices;
+    std::span<const GLuint> indices;
+    std::vector<uint32_t> lodIndicesCounts;
+    std::vector<TextureReference> textures;
+};
+
+// Binary copy of an imported model stored next to its source as "<source>.meshcache".
+// The file holds interleaved vertex and index blobs that can be uploaded without any conversion,
+// and is keyed by the size, modification time and content hash of the source file and of the material libraries
+// an .obj source references. Files that only changed their modification time have it rewritten in the cache.
+class MeshCache
+{
+public:
+    // Version 2: triangles and vertices are stored in the MeshOptimizer order
+    // Version 3: meshes carry their LOD chain
+    // Version 4: every LOD is simplified from the full detail mesh
+    static constexpr uint32_t Version = 4;
+
+private:
+    MappedFile file;
+    std::vector<MeshView> meshes;
+    AABB bounds;
+    bool isValid = false;
+
+public:
+    // Maps the cache of SourcePath, it is not valid when missing, outdated or corrupt
+    explicit MeshCache(const std::string& SourcePath);
+
+    [[nodiscard]] bool IsValid() const;
+    [[nodiscard]] const std::vector<MeshView>& GetMeshes() const;
+    [[nodiscard]] const AABB& GetBounds() const;
+
+    static bool Write(const std::string& SourcePath, const std::vector<MeshData>& Meshes, const AABB& Bounds);
+    static std::string GetCachePath(const std::string& SourcePath);
+
+private:
+    // Modification time to store at offset of the cache file, for a file found unchanged by its contents
+    struct TimeUpdate
+    {
+        uint64_t offset;
+        int64_t time;
+    };
+
+    bool Parse(const std::string& SourcePath, std::vector<TimeUpdate>& TimeUpdatesOut);
+    // Replaces the cache with a copy holding the current times and maps that copy instead
+    void RewriteTimes(const std::string& SourcePath, const std::vector<TimeUpdate>& TimeUpdates);
+};
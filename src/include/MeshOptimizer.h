@@ -0,0 +1,40 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include <glad/glad.h>
+
+#include "Vertex.h"
+
+struct MeshOptimizationStats
+{
+    // Average cache miss ratio, vertex shader invocations per triangle on a FIFO cache of CacheSize entries
+    float acmrBefore = 0.f;
+    float acmrAfter = 0.f;
+    uint32_t clustersCount = 0;
+    uint32_t removedVerticesCount = 0;
+};
+
+// Import time reordering of triangle lists, run before upload so the mesh cache stores the optimized order.
+// Triangles are reordered with Tipsify for the post-transform cache, the resulting clusters are sorted from the
+// outside of the mesh inwards to reduce overdraw, and vertices are renumbered in the order they are first used.
+namespace MeshOptimizer
+{
+    constexpr uint32_t CacheSize = 16;
+    // Cluster sorting is dropped when it costs more than this ratio of the Tipsify ACMR
+    constexpr float MaxOverdrawAcmrRatio = 1.05f;
+
+    // Indices have to form a triangle list, returns false and leaves the mesh untouched otherwise
+    bool Optimize(std::vector<Vertex>& Vertices, std::vector<GLuint>& Indices, MeshOptimizationStats& StatsOut);
+
+    float ComputeAcmr(const std::vector<GLuint>& Indices, uint32_t VerticesCount, uint32_t Size = CacheSize);
+
+    // Returns the triangle list in the new order and the first triangle of every cluster
+    std::vector<GLuint> OptimizeVertexCache(const std::vector<GLuint>& Indices, uint32_t VerticesCount,
+                                            std::vector<uint32_t>& ClustersOut, uint32_t Size = CacheSize);
+    std::vector<GLuint> OptimizeOverdraw(const std::vector<Vertex>& Vertices, const std::vector<GLuint>& Indices,
+                                         const std::vector<uint32_t>& Clusters);
+    // Renumbers vertices by first use and drops the ones no triangle references
+    void OptimizeVertexFetch(std::vector<Vertex>& Vertices, std::vector<GLuint>& Indices);
+}
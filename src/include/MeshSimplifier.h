@@ -0,0 +1,31 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include <glad/glad.h>
+
+#include "Vertex.h"
+
+// Import time LOD generation with quadric error metrics (Garland, Heckbert 1997).
+// Vertices are collapsed onto a neighbour instead of a new position, so every LOD is only a new index list
+// into the vertex buffer of the full detail mesh. Vertices on borders and attribute seams never move.
+namespace MeshSimplifier
+{
+    constexpr uint32_t MaxLodsCount = 4;
+    // Every LOD aims for this ratio of the indices of the previous one
+    constexpr float LodReduction = 0.5f;
+    // Largest error of each coarser LOD relative to the diagonal of the mesh bounds
+    constexpr float LodMaxErrors[MaxLodsCount - 1] = {0.01f, 0.025f, 0.06f};
+
+    // Collapses edges by increasing error until TargetIndicesCount or MaxError is reached, ErrorOut is the
+    // largest distance of the result from the surface of Indices, as estimated by the quadrics of its triangles
+    std::vector<GLuint> Simplify(const std::vector<Vertex>& Vertices, const std::vector<GLuint>& Indices,
+                                 size_t TargetIndicesCount, float MaxError, float& ErrorOut);
+
+    // Appends the indices of coarser LODs to Indices, which holds the full detail triangle list.
+    // Every LOD is simplified from the full detail triangles, so its error is measured against the source mesh.
+    // LodIndicesCountsOut receives the indices count of every LOD, the full detail one included.
+    void BuildLodChain(const std::vector<Vertex>& Vertices, std::vector<GLuint>& Indices,
+                       std::vector<uint32_t>& LodIndicesCountsOut);
+}
@@ -1,9 +1,21 @@
 #pragma once
 
 #include "Mesh.h"
+#include "Bounds.h"
+#include "MeshCache.h"
+#include "ShaderWrapper.h"
 #include <assimp/scene.h>
 #include <assimp/postprocess.h>
 
+// Per mesh data the vertex shader looks up with the draw id, matches DrawData in instanced.vert
+struct GpuDrawData
+{
+    glm::vec3 positionOffset;
+    GLuint material;
+    glm::vec3 positionScale;
+    GLuint isCompact;
+};
+
 class Model
 {
 private:
@@ -11,17 +23,43 @@ private:
     std::vector<std::shared_ptr<Mesh>> meshes;
     std::string modelPath;
 
+    AABB bounds;
+    BoundingSphere boundingSphere;
+
+    // GpuDrawData of every mesh, indexed with the draw id in the shaders
+    GLuint drawDataBuffer = 0;
+    uint32_t lodsCount = 1;
+
+    static bool isVertexQuantizationEnabled;
+
 public:
     explicit Model(const std::string& Path, std::shared_ptr<ShaderWrapper> Shared);
+    ~Model();
+
+    Model(const Model&) = delete;
+    Model& operator=(const Model&) = delete;
+
     void Draw();
 
     [[nodiscard]] const std::shared_ptr<ShaderWrapper>& GetShader() const;
     [[nodiscard]] const std::vector<std::shared_ptr<Mesh>>& GetMeshes() const;
+    [[nodiscard]] const AABB& GetBounds() const;
+    [[nodiscard]] const BoundingSphere& GetBoundingSphere() const;
+    [[nodiscard]] GLuint GetDrawDataBuffer() const;
+    // Largest LOD count of the meshes, meshes with fewer LODs repeat their coarsest one
+    [[nodiscard]] uint32_t GetLodsCount() const;
+
+    // Meshes of models loaded afterwards are stored as CompactVertex when they fit the default QuantizationBudget
+    static void SetVertexQuantizationEnabled(bool IsEnabled);
 private:
-    void ProcessNode(aiNode* NodePtr, const aiScene* ScenePtr);
+    void BuildDrawData();
+    bool Import(std::vector<MeshData>& MeshesOut);
+    void ProcessNode(aiNode* NodePtr, const aiScene* ScenePtr, std::vector<MeshData>& MeshesOut);
 
-    std::shared_ptr<Mesh> ProcessMesh(aiMesh* MeshPtr, const aiScene* ScenePtr);
-    std::vector<Texture> LoadMaterialTextures(aiMaterial* Material, aiTextureType Type, const std::string& TypeName);
+    MeshData ProcessMesh(aiMesh* MeshPtr, const aiScene* ScenePtr);
+    static void GetMaterialTextures(aiMaterial* Material, aiTextureType Type, const std::string& TypeName,
+                                    std::vector<TextureReference>& TexturesOut);
     static Vertex GetVertexFromAIMesh(const aiMesh* MeshPtr, unsigned int i) ;
-    GLuint TextureFromFile(const std::string& Path);
+    static const QuantizationBudget* GetQuantizationBudget();
+    MaterialTextures ResolveMaterialTextures(const std::vector<TextureReference>& References) const;
 };
@@ -1,19 +1,192 @@
 #pragma once
 
+#include <array>
 #include <map>
-#include <set>
+#include <memory>
+#include <vector>
+
 #include "glad/glad.h"
+#include "PersistentBuffer.h"
+#include "GeometryBuffer.h"
+#include "DepthPyramid.h"
+#include "FrustumCulling.h"
+#include "GpuCulling.h"
+#include "InstanceData.h"
+#include "MeshSimplifier.h"
+#include "UniformHandle.h"
+
+struct ModelRendererStats
+{
+    size_t uploadedBytes = 0;
+    uint32_t uploadedMatrices = 0;
+    uint32_t instancesCount = 0;
+    uint32_t visibleInstancesCount = 0;
+    uint32_t drawsCount = 0;
+    uint32_t drawCallsCount = 0;
+    std::array<uint32_t, MeshSimplifier::MaxLodsCount> lodInstancesCount{};
+    // Instances hidden by the previous frame's depth and retested against the current one,
+    // and those of them the retest still found hidden
+    uint32_t retestedInstancesCount = 0;
+    uint32_t occlusionCulledCount = 0;
+    // The engine renders into a depth texture the occlusion culling can build its pyramid from
+    bool isOcclusionAvailable = false;
+    // Instances were culled by the compute path, its visible, LOD and occlusion counts lag
+    // PersistentBuffer::RegionCount frames
+    bool wasCulledOnGpu = false;
+};
+
+// What LOD selection needs to know about the camera
+struct LodView
+{
+    glm::vec3 position{0.f};
+    // Cotangent of half the vertical field of view, turns radius over distance into a ratio of the screen height
+    float projectionScale = 1.f;
+};
+
+// Every ModelNode owns a stable slot in the instance buffer of its model, holding its transform and normal matrix.
+// instanceData mirrors the buffer on the CPU, normal matrices are only recomputed for instances that moved.
+// Moved instances come from the handles the TransformStore recalculated, the renderer never scans every node.
+// The buffer is a ring of PersistentBuffer::RegionCount copies, each frame writes only the slots
+// that changed since that copy was last used and fences keep it from overwriting data still in use.
+// Slots that pass frustum culling are compacted into visibleSlots, which is what the draw iterates over.
+// Visible slots are grouped by the LOD picked from their screen size, lodOffsets[i] is where LOD i starts.
+// Every LOD draws all meshes of the model from the GeometryBuffer with one indirect command each, submitted
+// by one glMultiDrawElementsIndirect per vertex format the meshes use.
+// With GPU culling the visible slots and instance counts never reach the CPU, gpuCulling holds them instead.
+// Occlusion culling then draws in two phases: the early one draws what the previous frame's depth pyramid does not
+// hide, the late one retests the hidden instances against the pyramid of the early phase's depth.
+struct ModelInstances
+{
+    std::vector<class ModelNode*> nodes;
+    std::vector<uint8_t> staleRegions;
+    std::vector<uint32_t> dirtySlots;
+    std::vector<uint32_t> movedSlots;
+    std::vector<GpuInstance> instanceData;
+    BoundingSpheres worldBounds;
+    std::vector<uint32_t> visibleSlots;
+    std::array<uint32_t, MeshSimplifier::MaxLodsCount + 1> lodOffsets{};
+    std::vector<uint8_t> visibleLods;
+    std::vector<uint32_t> sortedSlots;
+
+    std::unique_ptr<PersistentBuffer> matrixBuffer;
+    std::unique_ptr<PersistentBuffer> visibleBuffer;
+    uint32_t capacity = 0;
+
+    // Commands are grouped by LOD, and within a LOD full precision meshes come before compact meshes
+    struct LodCommands
+    {
+        uint32_t firstCommand = 0;
+        uint32_t fullCommandsCount = 0;
+        uint32_t commandsCount = 0;
+    };
+    std::vector<DrawElementsIndirectCommand> commands;
+    std::vector<LodCommands> lodCommands;
+    std::unique_ptr<PersistentBuffer> commandBuffer;
+
+    // Casters of the shadow cascades, every cascade culls into and draws from its own range of the buffers
+    std::vector<uint32_t> shadowSlots;
+    std::vector<DrawElementsIndirectCommand> shadowCommands;
+    std::unique_ptr<PersistentBuffer> shadowVisibleBuffer;
+    std::unique_ptr<PersistentBuffer> shadowCommandBuffer;
+
+    GpuCullingBuffers gpuCulling;
+
+    UniformHandle<int> cubemapUniform;
+    UniformHandle<GLuint> firstVisibleUniform;
+};
 
 class ModelRenderer
 {
+public:
+    static constexpr GLuint InstancesBinding = 2;
+    static constexpr GLuint VisibleInstancesBinding = 3;
+    static constexpr GLuint DrawDataBinding = 4;
+    // An instance switches to LOD i + 1 once its bounding sphere is smaller than LodScreenSizes[i] of the screen height
+    static constexpr float LodScreenSizes[MeshSimplifier::MaxLodsCount - 1] = {0.25f, 0.12f, 0.05f};
+
 private:
-    std::map<class Model*, std::set<class ModelNode*>> nodesMap;
-    std::map<class Model*, GLuint> bufferMap;
+    std::map<class Model*, ModelInstances> nodesMap;
+
+    // Where the instance of a ModelNode lives, indexed by the TransformStore handle of the node
+    struct InstanceSlot
+    {
+        ModelInstances* instances = nullptr;
+        uint32_t slot = 0;
+    };
+    std::vector<InstanceSlot> instanceOfHandle;
+
+    std::array<GLsync, PersistentBuffer::RegionCount> regionFences{};
+    uint64_t frameIndex = 0;
+
+    class ShadowCascades* shadowCascades = nullptr;
+    std::shared_ptr<class ShaderWrapper> shadowShader;
+    UniformHandle<GLuint> shadowFirstVisibleUniform;
+    UniformHandle<glm::mat4> shadowViewProjectionUniform;
+
+    GpuCulling gpuCulling;
+    DepthPyramid depthPyramid;
+
+    ModelRendererStats stats;
+    bool isCullingEnabled = true;
+    bool isLodEnabled = true;
+    bool isGpuCullingEnabled = true;
+    bool isOcclusionCullingEnabled = true;
 public:
+    ModelRenderer() = default;
+    ~ModelRenderer();
+
+    // Deletes the GL objects of every model, must run while the GL context is still current.
+    // Model nodes destroyed afterwards are no longer registered and leave the renderer alone.
+    void Shutdown();
+
     void Draw(class MainEngine* engine);
 
     void AddNode(ModelNode* node);
     void RemoveNode(ModelNode* node);
-    void DrawModel(Model* model, std::set<struct ModelNode*>& nodeArray, MainEngine* engine);
-    void UpdateMatrixBuffer(Model* model, std::set<struct ModelNode*>& nodeArray);
+    void DrawModel(Model* model, ModelInstances& instances, uint32_t region, MainEngine* engine,
+                   CullingPhase phase = CullingPhase::Early);
+    // Renders the cascades whose cached depth is out of date, casters use the matrices uploaded for the region
+    void DrawShadows(uint32_t region);
+    // Hands the instances moved by the last TransformStore::CalculateWorldTransforms to their models,
+    // UpdateMatrixBuffer then refreshes only those
+    void GatherMovedSlots();
+    void UpdateMatrixBuffer(Model* model, ModelInstances& instances, uint32_t region);
+    void CullInstances(ModelInstances& instances, const Frustum& frustum);
+    // Culls and selects LODs with the compute path, the draw commands of the model end up filled in on the GPU
+    void CullInstancesOnGpu(Model* model, ModelInstances& instances, CullingPhase phase, uint32_t region);
+    // Groups the visible slots by LOD and uploads them
+    void SelectLods(ModelInstances& instances, const LodView& view, uint32_t region);
+    [[nodiscard]] ModelInstances* FindInstances(Model* model);
+
+    [[nodiscard]] const ModelRendererStats& GetStats() const;
+
+    [[nodiscard]] bool IsCullingEnabled() const;
+    void SetCullingEnabled(bool isEnabled);
+
+    // Moved casters invalidate the cascades they reach, nullptr disables the shadow pass
+    void SetShadowCascades(ShadowCascades* cascades);
+
+    [[nodiscard]] bool IsLodEnabled() const;
+    // Without LODs every instance draws the full detail meshes
+    void SetLodEnabled(bool isEnabled);
+
+    [[nodiscard]] bool IsGpuCullingEnabled() const;
+    // Falls back to culling on the CPU when disabled or when the compute shaders are not available
+    void SetGpuCullingEnabled(bool isEnabled);
+
+    [[nodiscard]] bool IsOcclusionCullingEnabled() const;
+    // Only the GPU culling tests occlusion, the CPU path ignores this
+    void SetOcclusionCullingEnabled(bool isEnabled);
+
+private:
+    void WaitForRegion(uint32_t region);
+    void WaitForAllRegions();
+    void GrowInstanceBuffers(ModelInstances& instances);
+    uint32_t DrawShadowCasters(Model* model, ModelInstances& instances, uint32_t cascade, const Frustum& frustum,
+                               uint32_t region);
+    // One glMultiDrawElementsIndirect over commands of one vertex format starting at baseOffset of the bound
+    // indirect buffer
+    void DrawCommands(GLintptr baseOffset, VertexFormat format, uint32_t firstCommand, uint32_t commandsCount);
+    static void CreateDrawCommands(Model* model, ModelInstances& instances);
+    static void MarkSlotStale(ModelInstances& instances, uint32_t slot);
 };
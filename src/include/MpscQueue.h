@@ -0,0 +1,85 @@
+#pragma once
+
+#include <atomic>
+#include <utility>
+#include <vector>
+
+// Lock-free multi-producer single-consumer queue.
+// Producers push onto an atomic list head, the consumer takes the whole list at once and restores the push order.
+template<typename T>
+class MpscQueue
+{
+private:
+    struct Item
+    {
+        T value;
+        Item* next;
+    };
+
+    std::atomic<Item*> head{nullptr};
+
+public:
+    MpscQueue() = default;
+    ~MpscQueue();
+
+    MpscQueue(const MpscQueue&) = delete;
+    MpscQueue& operator=(const MpscQueue&) = delete;
+
+    void Push(T value);
+
+    // Appends every queued value to valuesOut in push order, only one thread may call it at a time
+    void PopAll(std::vector<T>& valuesOut);
+
+    [[nodiscard]] bool IsEmpty() const;
+};
+
+template<typename T>
+MpscQueue<T>::~MpscQueue()
+{
+    Item* Current = head.load(std::memory_order_acquire);
+    while (Current)
+    {
+        Item* Next = Current->next;
+        delete Current;
+        Current = Next;
+    }
+}
+
+template<typename T>
+void MpscQueue<T>::Push(T value)
+{
+    auto* NewItem = new Item{std::move(value), head.load(std::memory_order_relaxed)};
+    while (!head.compare_exchange_weak(NewItem->next, NewItem, std::memory_order_release, std::memory_order_relaxed))
+    {
+    }
+}
+
+template<typename T>
+void MpscQueue<T>::PopAll(std::vector<T>& valuesOut)
+{
+    Item* Current = head.exchange(nullptr, std::memory_order_acquire);
+
+    // The list is newest first
+    Item* Reversed = nullptr;
+    while (Current)
+    {
+        Item* Next = Current->next;
+        Current->next = Reversed;
+        Reversed = Current;
+        Current = Next;
+    }
+
+    while (Reversed)
+    {
+        Item* Next = Reversed->next;
+        valuesOut.push_back(std::move(Reversed->value));
+        delete Reversed;
+        Reversed = Next;
+    }
+}
+
+template<typename T>
+bool MpscQueue<T>::IsEmpty() const
+{
+    return head.load(std::memory_order_relaxed) == nullptr;
+}
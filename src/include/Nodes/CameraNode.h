@@ -14,5 +14,6 @@ public:
     CameraNode(MainEngine* engine);
 
     void Update(struct MainEngine* engine, float seconds, float deltaSeconds) override;
+    [[nodiscard]] bool IsUpdateThreadSafe() const override;
     void SetActive();
 };
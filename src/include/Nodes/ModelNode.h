@@ -4,12 +4,15 @@
 #include <memory>
 
 #include "Node.h"
+#include "UniformHandle.h"
 
 class ModelNode: public Node
 {
 private:
     std::shared_ptr<class Model> ModelPtr;
     class ModelRenderer* Renderer;
+    // Resolved once, the model's shader does not change
+    UniformHandle<glm::mat4> TransformUniform;
 
 public:
     explicit ModelNode(std::shared_ptr<Model> ModelPtr, ModelRenderer* Renderer);
@@ -21,6 +21,7 @@ public:
     MotorcycleNode(class MainEngine* engine, class ModelRenderer* renderer);
 
     void Update(struct MainEngine* engine, float seconds, float deltaSeconds) override;
+    [[nodiscard]] bool IsUpdateThreadSafe() const override;
 
     void SetIsActive(bool isActive);
 
@@ -7,23 +7,29 @@
 
 class Node {
 private:
-    std::shared_ptr<Transform> localTransform;
-    glm::mat4 worldTransformMatrix;
+    Transform localTransform;
 
     Node* parent{};
     std::vector<std::shared_ptr<Node>> childrenList;
 
-    bool wasDirty{};
 public:
     explicit Node();
+    virtual ~Node();
 
-    void CalculateWorldTransform();
+    void CalculateWorldTransform(class JobSystem* jobSystem = nullptr);
     void Draw();
     virtual void Update(class MainEngine* engine, float seconds, float deltaSeconds);
 
+    // Updates the whole subtree, children that are safe to update off the main thread run as jobs.
+    // Returns once every node has been updated.
+    void UpdateParallel(class JobSystem& jobSystem, class MainEngine* engine, float seconds, float deltaSeconds);
+    [[nodiscard]] virtual bool IsUpdateThreadSafe() const;
+
     [[nodiscard]] virtual std::shared_ptr<Node> Clone() const;
 
     void AddChild(std::shared_ptr<Node> newChild);
+    // Detaches every child, children nobody else holds are destroyed
+    void ClearChildren();
 
     const std::vector<std::shared_ptr<Node>>& GetChildrenList() const;
 
@@ -48,8 +54,6 @@ public:
     Node* GetParent() const;
 protected:
     virtual void Draw(glm::mat4& parentTransform, bool isDirty);
-
-    void CalculateWorldTransform(glm::mat4& parentTransform, bool isDirty);
 };
 
 template<typename Predicate>
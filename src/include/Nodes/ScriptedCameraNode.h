@@ -0,0 +1,15 @@
+#pragma once
+
+#include "CameraNode.h"
+#include "CameraPath.h"
+
+// Camera that follows a CameraPath, used by the headless mode instead of user input
+class ScriptedCameraNode : public CameraNode {
+private:
+    CameraPath path;
+
+public:
+    ScriptedCameraNode(class MainEngine* engine, CameraPath path);
+
+    void Update(struct MainEngine* engine, float seconds, float deltaSeconds) override;
+};
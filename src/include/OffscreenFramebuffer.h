@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstdint>
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+// Color and depth render target the scene is drawn into instead of the default framebuffer.
+// Depth is a texture the depth pyramid reads, multisampled like the color when more than one sample is asked for.
+class OffscreenFramebuffer
+{
+private:
+    GLuint framebuffer = 0;
+    GLuint colorBuffer = 0;
+    GLuint depthTexture = 0;
+    glm::ivec2 size;
+    uint32_t samplesCount = 1;
+
+public:
+    // SamplesCount is clamped to what the driver supports for both color and depth
+    explicit OffscreenFramebuffer(const glm::ivec2& Size, uint32_t SamplesCount = 1);
+    ~OffscreenFramebuffer();
+
+    OffscreenFramebuffer(const OffscreenFramebuffer&) = delete;
+    OffscreenFramebuffer& operator=(const OffscreenFramebuffer&) = delete;
+
+    void Bind() const;
+    // Resolves the color into the default framebuffer, which has to be the same size
+    void BlitToDefault() const;
+
+    [[nodiscard]] bool IsComplete() const;
+    [[nodiscard]] GLuint GetId() const;
+    [[nodiscard]] const glm::ivec2& GetSize() const;
+    // GL_TEXTURE_2D_MULTISAMPLE when the samples count is above 1, GL_TEXTURE_2D otherwise
+    [[nodiscard]] GLuint GetDepthTexture() const;
+    [[nodiscard]] uint32_t GetSamplesCount() const;
+};
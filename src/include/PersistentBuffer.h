@@ -0,0 +1,38 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "glad/glad.h"
+
+// GPU buffer split into RegionCount equally sized regions, one per frame in flight.
+// With GL_ARB_buffer_storage, core since GL 4.4 but also exposed by many 4.3 drivers, it is persistently and
+// coherently mapped and written with memcpy, otherwise writes fall back to glBufferSubData.
+class PersistentBuffer
+{
+public:
+    static constexpr uint32_t RegionCount = 3;
+
+private:
+    GLuint bufferId = 0;
+    GLsizeiptr regionSize;
+    uint8_t* mappedData = nullptr;
+
+public:
+    explicit PersistentBuffer(GLsizeiptr regionSize);
+    ~PersistentBuffer();
+
+    PersistentBuffer(const PersistentBuffer&) = delete;
+    PersistentBuffer& operator=(const PersistentBuffer&) = delete;
+
+    void Write(uint32_t region, GLintptr offset, const void* data, GLsizeiptr size);
+
+    [[nodiscard]] GLuint GetId() const;
+    [[nodiscard]] GLsizeiptr GetRegionSize() const;
+    [[nodiscard]] GLintptr GetRegionOffset(uint32_t region) const;
+    [[nodiscard]] bool IsPersistentlyMapped() const;
+
+    // glad only loads glBufferStorage for GL 4.4 contexts, call once after gladLoadGLLoader with the same loader
+    static void LoadBufferStorage(GLADloadproc load);
+    static bool IsBufferStorageSupported();
+};
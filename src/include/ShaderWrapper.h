@@ -1,40 +1,98 @@
 #pragma once
 
 #include <glad/glad.h>
+#include <filesystem>
+#include <functional>
+#include <initializer_list>
 #include <string>
+#include <string_view>
+#include <unordered_map>
 #include <glm/glm.hpp>
 
+#include "UniformHandle.h"
 
 class ShaderWrapper
 {
 private:
+    struct StringHash
+    {
+        using is_transparent = void;
+
+        size_t operator()(std::string_view value) const
+        {
+            return std::hash<std::string_view>{}(value);
+        }
+    };
+
+    struct ProgramBinaryHeader
+    {
+        uint32_t magic;
+        GLenum format;
+        uint32_t length;
+    };
+
+    static constexpr uint32_t ProgramBinaryMagic = 0x42504548;
+    static constexpr const char* ProgramBinaryDirectory = "shader_cache";
+
     GLuint shaderProgramId = -1;
+    // Active uniforms reflected after linking, looked up without allocating
+    std::unordered_map<std::string, GLint, StringHash, std::equal_to<>> uniformLocations;
 
 public:
     ShaderWrapper(std::string vertexShaderPath, std::string fragmentShaderPath);
     ShaderWrapper(std::string vertexShaderPath, std::string fragmentShaderPath, std::string geometryShaderPath);
+    explicit ShaderWrapper(std::string computeShaderPath);
+    ~ShaderWrapper();
+
+    ShaderWrapper(const ShaderWrapper&) = delete;
+    ShaderWrapper& operator=(const ShaderWrapper&) = delete;
 
     void Activate() const;
 
-    void SetBool(const std::string& name, bool value) const;
-    void SetInt(const std::string& name, int value) const;
-    void SetFloat(const std::string& name, float value) const;
-    void SetVec4F(const std::string& name, glm::vec4 value) const;
-    void SetMat4F(const std::string& name, glm::mat4 value) const;
-    [[nodiscard]] GLint GetUniformLocation(const std::string& name) const;
+    void SetBool(std::string_view name, bool value) const;
+    void SetInt(std::string_view name, int value) const;
+    void SetFloat(std::string_view name, float value) const;
+    void SetVec4F(std::string_view name, glm::vec4 value) const;
+    void SetMat4F(std::string_view name, glm::mat4 value) const;
+    [[nodiscard]] GLint GetUniformLocation(std::string_view name) const;
 
-    GLint TrySetVec4f(const std::string& name, glm::vec4 value) const;
+    // Resolve once and keep the handle for per-frame updates
+    template<typename T>
+    [[nodiscard]] UniformHandle<T> GetUniform(std::string_view name) const;
+
+    GLint TrySetVec4f(std::string_view name, glm::vec4 value) const;
 
     GLuint GetShaderProgramId() const;
+    [[nodiscard]] bool IsLinked() const;
 
 private:
     static void LoadShader(std::string& shaderPath, std::string& shaderCodeOut);
 
-    static GLuint CompileVertexShader(std::string& vertexShaderPath);
-    static GLuint CompileFragmentShader(std::string& fragmentShaderPath);
-    static GLuint CompileGeometryShader(std::string& geometryShaderPath);
-    void LinkProgram(GLuint vertexShader, GLuint fragmentShader, GLuint geometryShader);
+    static GLuint CompileVertexShader(const std::string& vertexShaderCode);
+    static GLuint CompileFragmentShader(const std::string& fragmentShaderCode);
+    static GLuint CompileGeometryShader(const std::string& geometryShaderCode);
+    static GLuint CompileComputeShader(const std::string& computeShaderCode);
+    // Stages that were not used are 0
+    bool LinkProgram(std::initializer_list<GLuint> shaders);
+    void ReflectUniforms();
+
+    template<typename T>
+    void SetUniform(std::string_view name, const T& value) const;
+
+    static void CompileShader(const std::string& shaderCode, GLuint shader);
 
-    static void CompileShader(std::string& shaderPath, GLuint shader);
+    // Linked programs are kept in ProgramBinaryDirectory, keyed by their sources and the driver
+    static std::filesystem::path GetProgramBinaryPath(const std::string& vertexShaderCode,
+                                                      const std::string& fragmentShaderCode,
+                                                      const std::string& geometryShaderCode);
+    bool LoadProgramBinary(const std::filesystem::path& binaryPath);
+    void SaveProgramBinary(const std::filesystem::path& binaryPath) const;
+    static bool IsProgramBinarySupported();
     static void LogShaderError(GLuint geometryShader, const std::string& message);
 };
+
+template<typename T>
+UniformHandle<T> ShaderWrapper::GetUniform(std::string_view name) const
+{
+    return UniformHandle<T>(GetUniformLocation(name));
+}
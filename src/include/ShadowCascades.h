@@ -0,0 +1,128 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <functional>
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include "Bounds.h"
+#include "FrustumCulling.h"
+
+class Camera;
+class ShaderWrapper;
+
+struct ShadowCascadeStats
+{
+    // Far end of the cascade as a view depth
+    float splitDepth = 0.f;
+    // Casters drawn and GPU time of the last time the cascade was rendered
+    uint32_t castersCount = 0;
+    float gpuMilliseconds = 0.f;
+    // False when the cached depth was reused this frame
+    bool wasRendered = false;
+    uint32_t renderedFramesCount = 0;
+};
+
+// Matches the Shadows uniform block of the model fragment shaders under std140
+struct GpuShadowsBlock
+{
+    glm::mat4 cascadeMatrices[4];
+    glm::vec4 cascadeSplits;
+    glm::vec4 cascadeTexelSizes;
+    // Cascades in use, 0 without shadows, then the depth bias and the normal offset in texels
+    glm::vec4 parameters;
+};
+
+// Cascaded shadow maps of the sun, every cascade is a layer of one depth GL_TEXTURE_2D_ARRAY.
+// The camera frustum up to MaxShadowDistance is split between the cascades, each covered by an orthographic
+// projection around the bounding sphere of its slice. The sphere is padded and its projection kept while the
+// slice stays inside of it, so the depth of a cascade is cached and only rendered again once the camera leaves
+// the padding, the sun turns, or a caster inside the cascade moves, appears or disappears.
+// Projections are snapped to whole texels so re-centering a cascade does not make the shadow edges shimmer.
+// The Shadows uniform block is written to the FrameConstants, unchanged cascades upload nothing.
+class ShadowCascades
+{
+public:
+    static constexpr uint32_t CascadesCount = 4;
+    static constexpr GLsizei Resolution = 2048;
+    static constexpr GLint TextureUnit = 14;
+
+    static constexpr float MaxShadowDistance = 150.f;
+    // Blend between logarithmic (1) and uniform (0) splits
+    static constexpr float SplitLambda = 0.75f;
+    static constexpr float CascadePadding = 1.2f;
+    // Casters this far towards the sun from a cascade still shadow it
+    static constexpr float CasterDistance = 200.f;
+
+    // Draws the casters inside the frustum of a cascade and returns their count
+    using DrawCallback = std::function<uint32_t(uint32_t Cascade, const Frustum& CascadeFrustum,
+                                                const glm::mat4& ViewProjection)>;
+
+private:
+    static constexpr uint32_t QueryLatency = 3;
+
+    struct TimerQuery
+    {
+        GLuint start = 0;
+        GLuint end = 0;
+        bool isPending = false;
+    };
+
+    struct Cascade
+    {
+        glm::mat4 viewProjection{1.f};
+        Frustum frustum{};
+        BoundingSphere bounds;
+        float texelSize = 0.f;
+        bool isCached = false;
+
+        std::array<TimerQuery, QueryLatency> queries;
+        uint32_t nextQuery = 0;
+    };
+
+    std::array<Cascade, CascadesCount> cascades;
+    std::array<ShadowCascadeStats, CascadesCount> stats;
+
+    GLuint depthTexture = 0;
+    GLuint framebuffer = 0;
+
+    glm::vec3 sunDirection{0.f};
+    bool isSunVisible = false;
+    bool isEnabled = true;
+
+public:
+    ShadowCascades();
+    ~ShadowCascades();
+
+    ShadowCascades(const ShadowCascades&) = delete;
+    ShadowCascades& operator=(const ShadowCascades&) = delete;
+
+    // Fits the cascades to the camera and writes them to the FrameConstants, cascades that had to move lose their
+    // cached depth
+    void Update(const Camera& camera, const glm::vec3& direction, bool isVisible);
+    // Renders every cascade whose cached depth is out of date
+    void Render(const DrawCallback& drawCasters);
+    void Bind() const;
+
+    // A caster changed within the sphere, cascades it reaches are rendered again
+    void Invalidate(const BoundingSphere& sphere);
+    void InvalidateAll();
+
+    // Shadows are only rendered while they are enabled and the sun shines
+    [[nodiscard]] bool IsActive() const;
+    [[nodiscard]] bool IsEnabled() const;
+    void SetEnabled(bool isEnabled);
+
+    [[nodiscard]] const std::array<ShadowCascadeStats, CascadesCount>& GetStats() const;
+
+    // Samplers named ShadowMap have to use TextureUnit
+    static void SetSamplerUniform(const ShaderWrapper& shader);
+
+private:
+    void FitCascade(Cascade& cascade, const BoundingSphere& slice);
+    void ResolveQueries();
+    void ResolveQuery(uint32_t cascade, TimerQuery& query, bool shouldWait);
+    void WriteBlock();
+};
@@ -2,6 +2,7 @@
 
 
 #include "glad/glad.h"
+#include "UniformHandle.h"
 
 #include <array>
 #include <string>
@@ -14,9 +15,14 @@ private:
     unsigned int textureId;
 
     std::shared_ptr<class ShaderWrapper> shader;
+    UniformHandle<int> cubemapUniform;
 
 public:
     explicit Skybox(const std::array<std::string, 6>& cubeTextures, std::shared_ptr<ShaderWrapper> shader);
+    ~Skybox();
+
+    Skybox(const Skybox&) = delete;
+    Skybox& operator=(const Skybox&) = delete;
 
     void Draw();
 
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+
+#include <glad/glad.h>
+
+struct TextureCacheStats
+{
+    uint64_t requestsCount = 0;
+    uint64_t hitsCount = 0;
+    uint32_t residentTexturesCount = 0;
+    size_t residentBytes = 0;
+
+    [[nodiscard]] float GetHitRate() const
+    {
+        return requestsCount > 0 ? static_cast<float>(hitsCount) / static_cast<float>(requestsCount) : 0.f;
+    }
+};
+
+// GL texture shared by every mesh that references the same file, deleted with the last reference
+class SharedTexture
+{
+private:
+    GLuint id;
+    std::string path;
+    size_t residentBytes = 0;
+    bool isUploaded = false;
+
+public:
+    SharedTexture(GLuint Id, std::string Path);
+    ~SharedTexture();
+
+    SharedTexture(const SharedTexture&) = delete;
+    SharedTexture& operator=(const SharedTexture&) = delete;
+
+    [[nodiscard]] GLuint GetId() const;
+    [[nodiscard]] const std::string& GetPath() const;
+    // False while the texture still shows the streaming placeholder
+    [[nodiscard]] bool IsUploaded() const;
+
+    friend class TextureCache;
+};
+
+// Process-wide map from resolved texture paths to the textures currently alive.
+// Textures are streamed in on the first request and evicted when the last SharedTexture reference goes away.
+class TextureCache
+{
+private:
+    std::unordered_map<std::string, std::weak_ptr<SharedTexture>> textures;
+    TextureCacheStats stats;
+
+    TextureCache() = default;
+public:
+    static TextureCache& GetInstance();
+
+    // Textures are flipped vertically on load, as model texture coordinates expect
+    std::shared_ptr<SharedTexture> Acquire(const std::string& Path);
+
+    [[nodiscard]] const TextureCacheStats& GetStats() const;
+
+private:
+    void OnUploaded(const std::string& ResolvedPath, size_t UploadedBytes);
+    void Evict(SharedTexture& Texture);
+
+    friend class SharedTexture;
+};
@@ -0,0 +1,116 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include <glad/glad.h>
+
+#include "MpscQueue.h"
+
+struct TextureStreamerStats
+{
+    uint32_t pendingTexturesCount = 0;
+    uint32_t uploadedTexturesCount = 0;
+    size_t uploadedBytes = 0;
+};
+
+// Loads textures in the background.
+// Requests return a texture id right away that shows a 1x1 placeholder. Images are decoded on a pool of
+// decode threads, handed back through a lock-free queue and uploaded through a pixel buffer object by Update.
+class TextureStreamer
+{
+public:
+    // Called on the GL thread with the number of uploaded bytes once the image replaced the placeholder
+    using UploadCallback = std::function<void(size_t)>;
+
+private:
+    struct ImageDeleter
+    {
+        void operator()(uint8_t* pixels) const;
+    };
+
+    struct DecodedImage
+    {
+        std::unique_ptr<uint8_t, ImageDeleter> pixels;
+        int width = 0;
+        int height = 0;
+        int componentsCount = 0;
+    };
+
+    struct StreamRequest
+    {
+        GLuint textureId;
+        GLenum target;
+        bool isFlippedVertically;
+        bool isCancelled = false;
+        UploadCallback onUploaded;
+        std::vector<std::string> paths;
+        std::vector<DecodedImage> images;
+        std::atomic<uint32_t> remainingImagesCount;
+    };
+
+    struct DecodeJob
+    {
+        std::shared_ptr<StreamRequest> request;
+        uint32_t imageIndex;
+    };
+
+    static constexpr size_t UploadBudgetBytes = 32 * 1024 * 1024;
+
+    std::vector<std::thread> decoders;
+    std::deque<DecodeJob> decodeJobs;
+    std::mutex decodeMutex;
+    std::condition_variable decodeCondition;
+    bool isRunning = true;
+
+    MpscQueue<std::shared_ptr<StreamRequest>> decodedRequests;
+    std::vector<std::shared_ptr<StreamRequest>> readyRequests;
+    size_t readyRequestsBegin = 0;
+    std::unordered_map<GLuint, std::shared_ptr<StreamRequest>> pendingRequests;
+
+    GLuint pixelBuffer = 0;
+    TextureStreamerStats stats;
+
+    TextureStreamer() = default;
+public:
+    static TextureStreamer& GetInstance();
+
+    ~TextureStreamer();
+
+    TextureStreamer(const TextureStreamer&) = delete;
+    TextureStreamer& operator=(const TextureStreamer&) = delete;
+
+    GLuint RequestTexture(const std::string& Path, bool IsFlippedVertically, UploadCallback OnUploaded = {});
+    GLuint RequestCubeMap(const std::array<std::string, 6>& FacePaths);
+    // Deletes a requested texture, if it is still streaming the id stays reserved until its images arrive
+    void DeleteTexture(GLuint TextureId);
+
+    // Uploads decoded images within the per-frame budget, has to be called on the GL thread
+    void Update();
+    // Blocks until every requested texture is uploaded
+    void Flush();
+    // Stops the decode threads and releases GL objects, call it before the context is destroyed
+    void Shutdown();
+
+    [[nodiscard]] const TextureStreamerStats& GetStats() const;
+
+private:
+    std::shared_ptr<StreamRequest> CreateRequest(GLenum Target, std::vector<std::string> Paths, bool IsFlippedVertically,
+                                                 UploadCallback OnUploaded);
+    void DecoderLoop();
+    static void Decode(StreamRequest& Request, uint32_t ImageIndex);
+
+    bool UploadReadyRequests(size_t BudgetBytes);
+    size_t Upload(StreamRequest& Request);
+    void StopDecoders();
+};
@@ -4,17 +4,20 @@
 #include <glm/gtc/quaternion.hpp>
 #include <glm/gtx/quaternion.hpp>
 
+#include "TransformStore.h"
+
+// Handle to a local transform living in the TransformStore.
 class Transform {
 private:
-    glm::vec3 position;
-    glm::vec3 scale;
-    glm::quat rotation;
-
+    TransformStore::Handle handle;
 
-    bool isDirty;
 public:
     Transform();
+    Transform(const Transform& originalTransform);
     Transform(Transform* originalTransform);
+    ~Transform();
+
+    Transform& operator=(const Transform& otherTransform);
 
     [[nodiscard]] glm::vec3 GetPosition() const;
     [[nodiscard]] glm::quat GetRotation() const;
@@ -26,5 +29,7 @@ public:
 
     [[nodiscard]] glm::mat4 GetMatrix() const;
 
+    [[nodiscard]] TransformStore::Handle GetHandle() const;
+
     friend class Node;
 };
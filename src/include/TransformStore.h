@@ -0,0 +1,83 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <vector>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+// Flat storage for every node transform in the process.
+// Local transforms are kept as SoA arrays and slots are ordered topologically (parent slot < child slot),
+// so world matrices can be propagated with one linear pass starting at the first dirty slot.
+// Nodes refer to their transform through a stable handle; slots may move when the hierarchy is re-sorted.
+// Setters of different handles may be called concurrently, allocation and re-parenting must not.
+class TransformStore {
+public:
+    using Handle = uint32_t;
+    static constexpr Handle InvalidHandle = UINT32_MAX;
+
+private:
+    static constexpr uint32_t InvalidSlot = UINT32_MAX;
+
+    std::vector<uint32_t> slotOfHandle;
+    std::vector<Handle> freeHandles;
+
+    std::vector<Handle> handleOfSlot;
+    std::vector<uint32_t> parents;
+    std::vector<glm::vec3> positions;
+    std::vector<glm::quat> rotations;
+    std::vector<glm::vec3> scales;
+    std::vector<glm::mat4> worldMatrices;
+    std::vector<uint8_t> localDirty;
+    std::vector<uint8_t> wasDirty;
+    std::vector<uint32_t> subtreeEnds;
+    std::vector<Handle> dirtyHandles;
+    std::deque<std::vector<Handle>> jobDirtyHandles;
+
+    std::atomic<uint32_t> firstDirtySlot{InvalidSlot};
+    uint32_t deadSlotsCount = 0;
+    bool isOrderDirty = false;
+
+    TransformStore() = default;
+public:
+    static TransformStore& GetInstance();
+
+    Handle Allocate();
+    Handle Allocate(Handle source);
+    void Release(Handle handle);
+
+    void SetParent(Handle child, Handle parent);
+
+    [[nodiscard]] const glm::vec3& GetPosition(Handle handle) const;
+    [[nodiscard]] const glm::quat& GetRotation(Handle handle) const;
+    [[nodiscard]] const glm::vec3& GetScale(Handle handle) const;
+
+    void SetPosition(Handle handle, const glm::vec3& newPosition);
+    void SetRotation(Handle handle, const glm::quat& newRotation);
+    void SetScale(Handle handle, const glm::vec3& newScale);
+
+    // Pointer stays valid until the next Allocate or CalculateWorldTransforms call.
+    [[nodiscard]] const glm::mat4& GetWorldMatrix(Handle handle) const;
+    [[nodiscard]] bool IsLocalDirty(Handle handle) const;
+    [[nodiscard]] bool WasDirty(Handle handle) const;
+    // Handles whose world matrix was recalculated by the last CalculateWorldTransforms call, in no particular order.
+    // Handles released since then may still be listed.
+    [[nodiscard]] const std::vector<Handle>& GetDirtyHandles() const;
+
+    // With a job system, subtrees smaller than ParallelGrainSize are propagated as separate jobs.
+    void CalculateWorldTransforms(class JobSystem* jobSystem = nullptr);
+
+    [[nodiscard]] size_t GetSize() const;
+    [[nodiscard]] uint32_t GetSlot(Handle handle) const;
+
+    static glm::mat4 ComposeMatrix(const glm::vec3& position, const glm::quat& rotation, const glm::vec3& scale);
+
+private:
+    static constexpr uint32_t ParallelGrainSize = 1024;
+
+    void MarkDirty(uint32_t slot);
+    void CalculateWorldTransformsRange(uint32_t begin, uint32_t end, std::vector<Handle>& outDirtyHandles);
+    void SortTopologically();
+};
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/type_ptr.hpp>
+
+// Uniform location resolved once from ShaderWrapper::GetUniform, setting it is a single glUniform call.
+// Like the ShaderWrapper setters, Set writes to the currently active program.
+template<typename T>
+class UniformHandle
+{
+private:
+    GLint location = -1;
+
+public:
+    UniformHandle() = default;
+    explicit UniformHandle(GLint Location) : location(Location)
+    {
+    }
+
+    [[nodiscard]] bool IsValid() const
+    {
+        return location >= 0;
+    }
+
+    [[nodiscard]] GLint GetLocation() const
+    {
+        return location;
+    }
+
+    void Set(const T& value) const;
+};
+
+template<>
+inline void UniformHandle<bool>::Set(const bool& value) const
+{
+    glUniform1i(location, static_cast<GLint>(value));
+}
+
+template<>
+inline void UniformHandle<int>::Set(const int& value) const
+{
+    glUniform1i(location, value);
+}
+
+template<>
+inline void UniformHandle<GLuint>::Set(const GLuint& value) const
+{
+    glUniform1ui(location, value);
+}
+
+template<>
+inline void UniformHandle<float>::Set(const float& value) const
+{
+    glUniform1f(location, value);
+}
+
+template<>
+inline void UniformHandle<glm::vec2>::Set(const glm::vec2& value) const
+{
+    glUniform2fv(location, 1, glm::value_ptr(value));
+}
+
+template<>
+inline void UniformHandle<glm::vec3>::Set(const glm::vec3& value) const
+{
+    glUniform3fv(location, 1, glm::value_ptr(value));
+}
+
+template<>
+inline void UniformHandle<glm::vec4>::Set(const glm::vec4& value) const
+{
+    glUniform4fv(location, 1, glm::value_ptr(value));
+}
+
+template<>
+inline void UniformHandle<glm::mat4>::Set(const glm::mat4& value) const
+{
+    glUniformMatrix4fv(location, 1, GL_FALSE, glm::value_ptr(value));
+}
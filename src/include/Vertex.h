@@ -0,0 +1,29 @@
+#pragma once
+
+#include <cstdint>
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+struct Vertex
+{
+    glm::vec3 position;
+    glm::vec3 normal;
+    glm::vec2 texCoord;
+};
+
+// Half the size of Vertex. Position is quantized to 16 bits per axis against the mesh bounds, the normal is
+// octahedral encoded in the x and y of a GL_INT_2_10_10_10_REV and texture coordinates are half floats.
+struct CompactVertex
+{
+    uint16_t position[3];
+    uint16_t padding;
+    uint32_t normal;
+    uint16_t texCoord[2];
+};
+
+enum class VertexFormat : uint8_t
+{
+    Full,
+    Compact
+};
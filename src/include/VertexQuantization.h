@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "Vertex.h"
+
+// Largest error a compact mesh may introduce, positions are in mesh units and normals in radians
+struct QuantizationBudget
+{
+    float maxPositionError = 0.001f;
+    float maxNormalError = 0.01f;
+    // Half a texel of a 1024 texture, texture coordinates in [-2, 2] fit in half floats
+    float maxTexCoordError = 1.f / 2048.f;
+};
+
+// Maps positions of a compact mesh from [0, 1] back to mesh space, identity for full precision meshes
+struct PositionDequantization
+{
+    glm::vec3 offset{0.f};
+    glm::vec3 scale{1.f};
+};
+
+namespace VertexQuantization
+{
+    // Quantizes the vertices against their bounds, returns false when any of them would exceed the budget
+    bool Quantize(std::span<const Vertex> Vertices, const QuantizationBudget& Budget,
+                  std::vector<CompactVertex>& VerticesOut, PositionDequantization& DequantizationOut);
+
+    Vertex Dequantize(const CompactVertex& Compact, const PositionDequantization& Dequantization);
+
+    uint32_t EncodeNormal(const glm::vec3& Normal);
+    glm::vec3 DecodeNormal(uint32_t Packed);
+}
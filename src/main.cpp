@@ -1,13 +1,24 @@
 #include "MainEngine.h"
 #include "LoggingMacros.h"
 
-int main(int, char**)
+#include <cstdio>
+
+int main(int argc, char** argv)
 {
     LoggingMacros::InitializeSPDLog();
 
     std::srand(std::time(0));
 
-    MainEngine Engine = MainEngine();
+    EngineOptions Options;
+    if (!Options.Parse(argc, argv))
+    {
+        std::fprintf(stderr, "Usage: %s [--headless] [--frames N] [--width W] [--height H] "
+                             "[--camera-path FILE] [--stats FILE] [--trace FILE] [--full-precision-vertices]\n"
+                             "       [--lights N] [--cpu-culling] [--no-occlusion-culling]\n", argv[0]);
+        return 1;
+    }
+
+    MainEngine Engine(std::move(Options));
     if(Engine.Init() == 0)
     {
         Engine.PrepareScene();
@@ -0,0 +1,10 @@
+#include "AssetPath.h"
+
+#include <filesystem>
+
+std::string AssetPath::Resolve(const std::string& Path)
+{
+    std::error_code Error;
+    std::filesystem::path ResolvedPath = std::filesystem::weakly_canonical(Path, Error);
+    return Error ? std::filesystem::path(Path).lexically_normal().string() : ResolvedPath.string();
+}
@@ -0,0 +1,75 @@
+#include "AssetRegistry.h"
+
+#include "AssetPath.h"
+#include "Model.h"
+#include "ShaderWrapper.h"
+
+AssetRegistry& AssetRegistry::GetInstance()
+{
+    static AssetRegistry Instance;
+    return Instance;
+}
+
+std::shared_ptr<ShaderWrapper> AssetRegistry::GetShader(const std::string& VertexShaderPath,
+                                                        const std::string& FragmentShaderPath)
+{
+    return GetShader(VertexShaderPath, FragmentShaderPath, "${-1}");
+}
+
+std::shared_ptr<ShaderWrapper> AssetRegistry::GetShader(const std::string& VertexShaderPath,
+                                                        const std::string& FragmentShaderPath,
+                                                        const std::string& GeometryShaderPath)
+{
+    std::string Key = AssetPath::Resolve(VertexShaderPath) + '\n' + AssetPath::Resolve(FragmentShaderPath) +
+                      '\n' + GeometryShaderPath;
+
+    std::weak_ptr<ShaderWrapper>& Entry = shaders[Key];
+    if (std::shared_ptr<ShaderWrapper> Shader = Entry.lock())
+    {
+        stats.reusedShadersCount++;
+        return Shader;
+    }
+
+    auto Shader = std::make_shared<ShaderWrapper>(VertexShaderPath, FragmentShaderPath, GeometryShaderPath);
+    Entry = Shader;
+    stats.loadedShadersCount++;
+    return Shader;
+}
+
+std::shared_ptr<ShaderWrapper> AssetRegistry::GetComputeShader(const std::string& ComputeShaderPath)
+{
+    // Graphics keys always hold a newline, a compute key never does
+    std::string Key = AssetPath::Resolve(ComputeShaderPath);
+
+    std::weak_ptr<ShaderWrapper>& Entry = shaders[Key];
+    if (std::shared_ptr<ShaderWrapper> Shader = Entry.lock())
+    {
+        stats.reusedShadersCount++;
+        return Shader;
+    }
+
+    auto Shader = std::make_shared<ShaderWrapper>(ComputeShaderPath);
+    Entry = Shader;
+    stats.loadedShadersCount++;
+    return Shader;
+}
+
+std::shared_ptr<Model> AssetRegistry::GetModel(const std::string& Path, const std::shared_ptr<ShaderWrapper>& Shader)
+{
+    std::weak_ptr<Model>& Entry = models[{AssetPath::Resolve(Path), Shader.get()}];
+    if (std::shared_ptr<Model> LoadedModel = Entry.lock())
+    {
+        stats.reusedModelsCount++;
+        return LoadedModel;
+    }
+
+    auto LoadedModel = std::make_shared<Model>(Path, Shader);
+    Entry = LoadedModel;
+    stats.loadedModelsCount++;
+    return LoadedModel;
+}
+
+const AssetRegistryStats& AssetRegistry::GetStats() const
+{
+    return stats;
+}
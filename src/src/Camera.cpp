@@ -2,26 +2,48 @@
 #include "glad/glad.h"
 #include "glm/gtc/type_ptr.hpp"
 
+#include "FrameConstants.h"
 #include "LoggingMacros.h"
 
-Camera::Camera() : front(0.f, 0.f, 1.f), up(0.f, 1.f, 0.f), position(0.f), uboTransformMatrices(0),
-                   resolution({1280, 720})
+Camera::Camera() : front(0.f, 0.f, 1.f), up(0.f, 1.f, 0.f), position(0.f), resolution({1280, 720})
 {
-    glGenBuffers(1, &uboTransformMatrices);
-    glBindBuffer(GL_UNIFORM_BUFFER, uboTransformMatrices);
-    glBufferData(GL_UNIFORM_BUFFER, 2 * sizeof(glm::mat4) + sizeof(glm::vec4), nullptr, GL_DYNAMIC_DRAW);
-    glBindBufferBase(GL_UNIFORM_BUFFER, 0, uboTransformMatrices);
-    UpdateView();
 }
 
-Camera::~Camera()
+Camera::~Camera() = default;
+
+glm::mat4 Camera::GetCameraProjectionMatrix(int resolutionX, int resolutionY) const
 {
-    glDeleteBuffers(1, &uboTransformMatrices);
+    return glm::perspective(glm::radians(fow), static_cast<float>(resolutionX) / static_cast<float>(resolutionY), NearPlane, FarPlane);
 }
 
-glm::mat4 Camera::GetCameraProjectionMatrix(int resolutionX, int resolutionY) const
+glm::mat4 Camera::GetProjectionMatrix() const
+{
+    if (isProjectionDirty)
+    {
+        projectionMatrix = GetCameraProjectionMatrix(resolution.x, resolution.y);
+        isProjectionDirty = false;
+    }
+    return projectionMatrix;
+}
+
+glm::mat4 Camera::GetViewMatrix() const
+{
+    if (isViewDirty)
+    {
+        viewMatrix = glm::lookAt(position, position + front, up);
+        isViewDirty = false;
+    }
+    return viewMatrix;
+}
+
+glm::mat4 Camera::GetViewProjectionMatrix() const
+{
+    return GetProjectionMatrix() * GetViewMatrix();
+}
+
+Frustum Camera::GetFrustum() const
 {
-    return glm::perspective(glm::radians(fow), static_cast<float>(resolutionX) / static_cast<float>(resolutionY), 0.1f, 1000.f);
+    return Frustum::FromMatrix(GetViewProjectionMatrix());
 }
 
 void Camera::SetResolution(const glm::vec<2, int> &newResolution)
@@ -29,7 +51,7 @@ void Camera::SetResolution(const glm::vec<2, int> &newResolution)
     if (newResolution != resolution)
     {
         resolution = newResolution;
-        UpdateProjection();
+        isProjectionDirty = true;
     }
 }
 
@@ -38,31 +60,27 @@ void Camera::SetFow(float newFow)
     if (newFow != fow)
     {
         fow = newFow;
-        UpdateProjection();
+        isProjectionDirty = true;
     }
 }
 
-void Camera::UpdateProjection()
+void Camera::WriteFrameConstants()
 {
-    glBindBuffer(GL_UNIFORM_BUFFER, uboTransformMatrices);
-    glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(glm::mat4),
-                    glm::value_ptr(GetCameraProjectionMatrix(resolution.x, resolution.y)));
-    glBindBuffer(GL_UNIFORM_BUFFER, 0);
-}
+    // Projection, View and ViewPosition of the std140 block, FrameConstants drops the parts that did not change
+    glm::mat4 Projection = GetProjectionMatrix();
+    glm::mat4 View = GetViewMatrix();
+    glm::vec4 ViewPosition(position, 1.f);
 
-void Camera::UpdateView()
-{
-    glBindBuffer(GL_UNIFORM_BUFFER, uboTransformMatrices);
-    glm::mat4 ViewMatrix = glm::lookAt(position, position + front, up);
-    glBufferSubData(GL_UNIFORM_BUFFER, sizeof(glm::mat4), sizeof(glm::mat4), glm::value_ptr(ViewMatrix));
-    glBufferSubData(GL_UNIFORM_BUFFER, 2 * sizeof(glm::mat4), sizeof(glm::vec3), glm::value_ptr(position));
-    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    FrameConstants& Constants = FrameConstants::GetInstance();
+    Constants.Write(FrameBlock::Camera, 0, glm::value_ptr(Projection), sizeof(glm::mat4));
+    Constants.Write(FrameBlock::Camera, sizeof(glm::mat4), glm::value_ptr(View), sizeof(glm::mat4));
+    Constants.Write(FrameBlock::Camera, 2 * sizeof(glm::mat4), glm::value_ptr(ViewPosition), sizeof(glm::vec4));
 }
 
 void Camera::SetPosition(glm::vec3 newPosition)
 {
     position = newPosition;
-    UpdateView();
+    isViewDirty = true;
 }
 
 void Camera::SetRotation(float x, float y)
@@ -75,14 +93,14 @@ void Camera::SetRotation(float x, float y)
     glm::vec3 Right = glm::normalize(glm::cross(glm::vec3(0.f, 1.f, 0.f), front));
     up = glm::normalize(glm::cross(front, Right));
 
-    UpdateView();
+    isViewDirty = true;
 }
 
 void Camera::SetRotation(glm::vec3 frontVector, glm::vec3 upVector) {
     front = frontVector;
     up = upVector;
 
-    UpdateView();
+    isViewDirty = true;
 }
 
 void Camera::LookAt(glm::vec3 lookAtPosition)
@@ -91,7 +109,7 @@ void Camera::LookAt(glm::vec3 lookAtPosition)
     glm::vec3 Right = glm::normalize(glm::cross(glm::vec3(0.f, 1.f, 0.f), front));
     up = glm::normalize(glm::cross(front, Right));
 
-    UpdateView();
+    isViewDirty = true;
 }
 
 void Camera::Orbit(glm::vec3 origin, float pitch, float yaw, float radius)
@@ -109,6 +127,16 @@ const glm::vec3 &Camera::GetPosition() const
     return position;
 }
 
+const glm::vec<2, int> &Camera::GetResolution() const
+{
+    return resolution;
+}
+
+float Camera::GetFow() const
+{
+    return fow;
+}
+
 const glm::vec3 &Camera::GetFront() const
 {
     return front;
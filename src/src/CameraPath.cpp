@@ -0,0 +1,95 @@
+#include "CameraPath.h"
+
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+
+#include <glm/gtc/constants.hpp>
+
+#include "LoggingMacros.h"
+
+bool CameraPath::LoadFromFile(const std::string& Path)
+{
+    std::ifstream File(Path);
+    if (!File)
+    {
+        SPDLOG_ERROR("Failed to open camera path at path: {}", Path);
+        return false;
+    }
+
+    keyframes.clear();
+    std::string Line;
+    uint32_t LineNumber = 0;
+    while (std::getline(File, Line))
+    {
+        LineNumber++;
+        if (Line.empty() || Line[0] == '#')
+            continue;
+
+        CameraKeyframe Keyframe{};
+        std::istringstream LineStream(Line);
+        LineStream >> Keyframe.time >> Keyframe.position.x >> Keyframe.position.y >> Keyframe.position.z
+                   >> Keyframe.target.x >> Keyframe.target.y >> Keyframe.target.z;
+        if (!LineStream)
+        {
+            SPDLOG_ERROR("Invalid camera keyframe in {} at line {}", Path, LineNumber);
+            return false;
+        }
+        AddKeyframe(Keyframe);
+    }
+
+    return !keyframes.empty();
+}
+
+CameraPath CameraPath::CreateOrbit(const glm::vec3& Center, float Radius, float Height, float Duration)
+{
+    constexpr uint32_t KeyframesCount = 64;
+
+    CameraPath Orbit;
+    for (uint32_t i = 0; i <= KeyframesCount; ++i)
+    {
+        float Progress = static_cast<float>(i) / KeyframesCount;
+        float Angle = Progress * glm::two_pi<float>();
+        glm::vec3 Position = Center + glm::vec3(glm::cos(Angle) * Radius, Height, glm::sin(Angle) * Radius);
+        Orbit.AddKeyframe({Progress * Duration, Position, Center});
+    }
+    return Orbit;
+}
+
+void CameraPath::AddKeyframe(const CameraKeyframe& Keyframe)
+{
+    auto Position = std::upper_bound(keyframes.begin(), keyframes.end(), Keyframe.time,
+                                     [](float Time, const CameraKeyframe& Other) { return Time < Other.time; });
+    keyframes.insert(Position, Keyframe);
+}
+
+void CameraPath::Evaluate(float Time, glm::vec3& PositionOut, glm::vec3& TargetOut) const
+{
+    if (keyframes.empty())
+        return;
+
+    auto Next = std::upper_bound(keyframes.begin(), keyframes.end(), Time,
+                                 [](float Time, const CameraKeyframe& Other) { return Time < Other.time; });
+    if (Next == keyframes.begin() || Next == keyframes.end())
+    {
+        const CameraKeyframe& Keyframe = Next == keyframes.begin() ? keyframes.front() : keyframes.back();
+        PositionOut = Keyframe.position;
+        TargetOut = Keyframe.target;
+        return;
+    }
+
+    const CameraKeyframe& Previous = *(Next - 1);
+    float Alpha = (Time - Previous.time) / (Next->time - Previous.time);
+    PositionOut = glm::mix(Previous.position, Next->position, Alpha);
+    TargetOut = glm::mix(Previous.target, Next->target, Alpha);
+}
+
+bool CameraPath::IsEmpty() const
+{
+    return keyframes.empty();
+}
+
+float CameraPath::GetDuration() const
+{
+    return keyframes.empty() ? 0.f : keyframes.back().time;
+}
@@ -0,0 +1,131 @@
+#include "DepthPyramid.h"
+
+#include <algorithm>
+#include <bit>
+
+#include "AssetRegistry.h"
+#include "OffscreenFramebuffer.h"
+#include "ShaderWrapper.h"
+
+DepthPyramid::~DepthPyramid()
+{
+    Release();
+}
+
+void DepthPyramid::Build(const OffscreenFramebuffer& source, const glm::mat4& newViewProjection)
+{
+    if (!reduceShader)
+    {
+        reduceShader = AssetRegistry::GetInstance().GetComputeShader("res/shaders/depth_pyramid.comp");
+        sourceUniform = reduceShader->GetUniform<int>("Source");
+        sourceLevelUniform = reduceShader->GetUniform<int>("SourceLevel");
+        isCopyUniform = reduceShader->GetUniform<bool>("IsCopy");
+        samplesCountUniform = reduceShader->GetUniform<int>("SamplesCount");
+
+        reduceShader->Activate();
+        reduceShader->GetUniform<int>("SceneDepth").Set(SceneDepthUnit);
+        reduceShader->GetUniform<int>("SceneDepthMultisample").Set(SceneDepthMultisampleUnit);
+    }
+
+    if (source.GetSize() != size)
+        Resize(source.GetSize());
+
+    reduceShader->Activate();
+    sourceUniform.Set(TextureUnit);
+    samplesCountUniform.Set(static_cast<int>(source.GetSamplesCount()));
+
+    // Level 0 reads the scene depth, the sampler of the other kind stays on a unit of its own
+    bool IsMultisampled = source.GetSamplesCount() > 1;
+    glActiveTexture(GL_TEXTURE0 + (IsMultisampled ? SceneDepthMultisampleUnit : SceneDepthUnit));
+    glBindTexture(IsMultisampled ? GL_TEXTURE_2D_MULTISAMPLE : GL_TEXTURE_2D, source.GetDepthTexture());
+
+    // Every further level reads the one before it
+    glActiveTexture(GL_TEXTURE0 + TextureUnit);
+    glBindTexture(GL_TEXTURE_2D, pyramidTexture);
+
+    glm::ivec2 LevelSize = size;
+    for (uint32_t Level = 0; Level < levelsCount; ++Level)
+    {
+        sourceLevelUniform.Set(Level == 0 ? 0 : static_cast<int>(Level) - 1);
+        isCopyUniform.Set(Level == 0);
+        glBindImageTexture(ImageUnit, pyramidTexture, static_cast<GLint>(Level), GL_FALSE, 0, GL_WRITE_ONLY,
+                           GL_R32F);
+
+        glDispatchCompute((LevelSize.x + WorkgroupSize - 1) / WorkgroupSize,
+                          (LevelSize.y + WorkgroupSize - 1) / WorkgroupSize, 1);
+        glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT | GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+
+        LevelSize = glm::max(LevelSize / 2, glm::ivec2(1));
+    }
+
+    glBindImageTexture(ImageUnit, 0, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_R32F);
+    glActiveTexture(GL_TEXTURE0 + (IsMultisampled ? SceneDepthMultisampleUnit : SceneDepthUnit));
+    glBindTexture(IsMultisampled ? GL_TEXTURE_2D_MULTISAMPLE : GL_TEXTURE_2D, 0);
+    glActiveTexture(GL_TEXTURE0);
+
+    viewProjection = newViewProjection;
+    isValid = true;
+}
+
+void DepthPyramid::Invalidate()
+{
+    isValid = false;
+}
+
+void DepthPyramid::Bind() const
+{
+    glActiveTexture(GL_TEXTURE0 + TextureUnit);
+    glBindTexture(GL_TEXTURE_2D, pyramidTexture);
+    glActiveTexture(GL_TEXTURE0);
+}
+
+void DepthPyramid::Shutdown()
+{
+    Release();
+    reduceShader.reset();
+}
+
+bool DepthPyramid::IsValid() const
+{
+    return isValid;
+}
+
+const glm::mat4& DepthPyramid::GetViewProjection() const
+{
+    return viewProjection;
+}
+
+const glm::ivec2& DepthPyramid::GetSize() const
+{
+    return size;
+}
+
+uint32_t DepthPyramid::GetLevelsCount() const
+{
+    return levelsCount;
+}
+
+void DepthPyramid::Resize(const glm::ivec2& newSize)
+{
+    Release();
+    size = newSize;
+    levelsCount = std::bit_width(static_cast<uint32_t>(std::max(size.x, size.y)));
+
+    glGenTextures(1, &pyramidTexture);
+    glBindTexture(GL_TEXTURE_2D, pyramidTexture);
+    glTexStorage2D(GL_TEXTURE_2D, static_cast<GLsizei>(levelsCount), GL_R32F, size.x, size.y);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+void DepthPyramid::Release()
+{
+    if (pyramidTexture != 0)
+        glDeleteTextures(1, &pyramidTexture);
+
+    pyramidTexture = 0;
+    size = glm::ivec2(0);
+    levelsCount = 0;
+    isValid = false;
+}
@@ -0,0 +1,78 @@
+#include "EngineOptions.h"
+
+#include <charconv>
+#include <string_view>
+
+#include "LoggingMacros.h"
+
+namespace
+{
+    template<typename T>
+    bool ParseNumber(std::string_view text, T& valueOut)
+    {
+        auto [end, error] = std::from_chars(text.data(), text.data() + text.size(), valueOut);
+        return error == std::errc() && end == text.data() + text.size();
+    }
+}
+
+bool EngineOptions::Parse(int argc, char** argv)
+{
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string_view argument = argv[i];
+        const char* value = i + 1 < argc ? argv[i + 1] : nullptr;
+        bool isValueValid = value != nullptr;
+
+        if (argument == "--headless")
+        {
+            isHeadless = true;
+            continue;
+        }
+
+        if (argument == "--full-precision-vertices")
+        {
+            isVertexQuantizationEnabled = false;
+            continue;
+        }
+
+        if (argument == "--cpu-culling")
+        {
+            isGpuCullingEnabled = false;
+            continue;
+        }
+
+        if (argument == "--no-occlusion-culling")
+        {
+            isOcclusionCullingEnabled = false;
+            continue;
+        }
+
+        if (argument == "--frames")
+            isValueValid = isValueValid && ParseNumber(value, framesCount) && framesCount > 0;
+        else if (argument == "--width")
+            isValueValid = isValueValid && ParseNumber(value, resolution.x) && resolution.x > 0;
+        else if (argument == "--height")
+            isValueValid = isValueValid && ParseNumber(value, resolution.y) && resolution.y > 0;
+        else if (argument == "--lights")
+            isValueValid = isValueValid && ParseNumber(value, extraLightsCount);
+        else if (argument == "--camera-path" && isValueValid)
+            cameraPathFile = value;
+        else if (argument == "--stats" && isValueValid)
+            statsOutputPath = value;
+        else if (argument == "--trace" && isValueValid)
+            traceOutputPath = value;
+        else if (argument != "--camera-path" && argument != "--stats" && argument != "--trace")
+        {
+            SPDLOG_ERROR("Unknown argument: {}", argument);
+            return false;
+        }
+
+        if (!isValueValid)
+        {
+            SPDLOG_ERROR("Missing or invalid value for {}", argument);
+            return false;
+        }
+        ++i;
+    }
+    return true;
+}
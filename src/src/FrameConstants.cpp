@@ -0,0 +1,114 @@
+#include "FrameConstants.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include "LoggingMacros.h"
+
+FrameConstants& FrameConstants::GetInstance()
+{
+    static FrameConstants Instance;
+    return Instance;
+}
+
+void FrameConstants::Create()
+{
+    GLint Alignment = 256;
+    glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &Alignment);
+
+    size_t Size = 0;
+    for (size_t i = 0; i < BlocksCount; ++i)
+    {
+        blockOffsets[i] = Size;
+        Size += (BlockCapacities[i] + Alignment - 1) / Alignment * Alignment;
+    }
+    shadowCopy.assign(Size, 0);
+
+    glGenBuffers(1, &buffer);
+    glBindBuffer(GL_UNIFORM_BUFFER, buffer);
+    glBufferData(GL_UNIFORM_BUFFER, static_cast<GLsizeiptr>(shadowCopy.size()), shadowCopy.data(), GL_DYNAMIC_DRAW);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+
+    for (size_t i = 0; i < BlocksCount; ++i)
+    {
+        glBindBufferRange(GL_UNIFORM_BUFFER, static_cast<GLuint>(i), buffer,
+                          static_cast<GLintptr>(blockOffsets[i]), static_cast<GLsizeiptr>(BlockCapacities[i]));
+    }
+}
+
+void FrameConstants::Write(FrameBlock Block, size_t Offset, const void* Data, size_t Size)
+{
+    if (Offset + Size > BlockCapacities[static_cast<size_t>(Block)])
+    {
+        SPDLOG_ERROR("Frame constants write of {} B at {} overflows block {}", Size, Offset,
+                     static_cast<uint32_t>(Block));
+        return;
+    }
+
+    if (buffer == 0)
+        Create();
+
+    frameStats.writesCount++;
+    frameStats.writtenBytes += Size;
+
+    size_t Begin = blockOffsets[static_cast<size_t>(Block)] + Offset;
+    if (std::memcmp(shadowCopy.data() + Begin, Data, Size) == 0)
+    {
+        frameStats.unchangedWritesCount++;
+        return;
+    }
+
+    std::memcpy(shadowCopy.data() + Begin, Data, Size);
+    dirtyBegin = std::min(dirtyBegin, Begin);
+    dirtyEnd = std::max(dirtyEnd, Begin + Size);
+}
+
+void FrameConstants::Flush()
+{
+    if (buffer == 0)
+        Create();
+
+    if (dirtyBegin < dirtyEnd)
+    {
+        auto Size = static_cast<GLsizeiptr>(dirtyEnd - dirtyBegin);
+        glBindBuffer(GL_UNIFORM_BUFFER, buffer);
+        void* Mapped = glMapBufferRange(GL_UNIFORM_BUFFER, static_cast<GLintptr>(dirtyBegin), Size,
+                                        GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT);
+        if (Mapped != nullptr)
+        {
+            std::memcpy(Mapped, shadowCopy.data() + dirtyBegin, Size);
+            glUnmapBuffer(GL_UNIFORM_BUFFER);
+        }
+        else
+        {
+            SPDLOG_WARN("Failed to map the frame constants, falling back to glBufferSubData");
+            glBufferSubData(GL_UNIFORM_BUFFER, static_cast<GLintptr>(dirtyBegin), Size, shadowCopy.data() + dirtyBegin);
+        }
+        glBindBuffer(GL_UNIFORM_BUFFER, 0);
+
+        frameStats.uploadCallsCount++;
+        frameStats.uploadedBytes += Size;
+        dirtyBegin = SIZE_MAX;
+        dirtyEnd = 0;
+    }
+
+    stats = frameStats;
+    frameStats = FrameConstantsStats();
+}
+
+void FrameConstants::Shutdown()
+{
+    if (buffer == 0)
+        return;
+
+    glDeleteBuffers(1, &buffer);
+    buffer = 0;
+    shadowCopy.clear();
+    dirtyBegin = SIZE_MAX;
+    dirtyEnd = 0;
+}
+
+const FrameConstantsStats& FrameConstants::GetStats() const
+{
+    return stats;
+}
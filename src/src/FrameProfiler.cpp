@@ -0,0 +1,361 @@
+#include "FrameProfiler.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+
+#include <imgui.h>
+
+#include "LoggingMacros.h"
+
+namespace
+{
+    constexpr uint32_t CaptureThreadId = 1;
+    constexpr uint32_t CaptureGpuThreadId = 2;
+    constexpr uint32_t WidgetCaptureFramesCount = 300;
+    constexpr const char* WidgetCapturePath = "frame_trace.json";
+
+    void AppendTraceEvent(std::string& Events, std::string_view Name, const char* Category, uint32_t ThreadId,
+                          double StartMicroseconds, double DurationMicroseconds)
+    {
+        char Event[256];
+        int Length = std::snprintf(Event, sizeof(Event),
+                                   ",\n{\"name\":\"%.*s\",\"cat\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,"
+                                   "\"ts\":%.3f,\"dur\":%.3f}",
+                                   static_cast<int>(Name.size()), Name.data(), Category, ThreadId,
+                                   StartMicroseconds, DurationMicroseconds);
+        Events.append(Event, std::min<size_t>(Length, sizeof(Event) - 1));
+    }
+}
+
+void RollingSamples::Push(float Sample)
+{
+    samples[next] = Sample;
+    next = (next + 1) % Capacity;
+    count = std::min(count + 1, Capacity);
+}
+
+float RollingSamples::GetPercentile(float Fraction) const
+{
+    if (count == 0)
+        return 0.f;
+
+    std::array<float, Capacity> Sorted;
+    std::copy_n(samples.begin(), count, Sorted.begin());
+
+    auto Rank = static_cast<uint32_t>(Fraction * static_cast<float>(count - 1) + 0.5f);
+    std::nth_element(Sorted.begin(), Sorted.begin() + Rank, Sorted.begin() + count);
+    return Sorted[Rank];
+}
+
+float RollingSamples::GetLatest() const
+{
+    return count > 0 ? samples[(next + Capacity - 1) % Capacity] : 0.f;
+}
+
+bool RollingSamples::IsEmpty() const
+{
+    return count == 0;
+}
+
+FrameProfiler& FrameProfiler::GetInstance()
+{
+    static FrameProfiler Instance;
+    return Instance;
+}
+
+void FrameProfiler::BeginFrame()
+{
+    // The slot is reused FrameLatency frames after it was recorded, by then its queries are normally available
+    ResolveFrame(frames[frameIndex % FrameLatency]);
+
+    isFrameActive = isEnabled;
+    depth = 0;
+    BeginScope("Frame", false);
+}
+
+void FrameProfiler::EndFrame()
+{
+    if (isFrameActive)
+    {
+        FrameRecord& Frame = frames[frameIndex % FrameLatency];
+        EndScope(0);
+        Frame.isPending = true;
+        isFrameActive = false;
+    }
+    frameIndex++;
+}
+
+uint32_t FrameProfiler::BeginScope(std::string_view Name, bool IsGpuTimed)
+{
+    if (!isFrameActive)
+        return InvalidScope;
+
+    FrameRecord& Frame = frames[frameIndex % FrameLatency];
+
+    int32_t QueryIndex = -1;
+    if (IsGpuTimed)
+    {
+        if (Frame.usedQueriesCount == Frame.queries.size())
+        {
+            GLuint Queries[2];
+            glGenQueries(2, Queries);
+            Frame.queries.insert(Frame.queries.end(), std::begin(Queries), std::end(Queries));
+        }
+
+        QueryIndex = static_cast<int32_t>(Frame.usedQueriesCount);
+        Frame.usedQueriesCount += 2;
+        glQueryCounter(Frame.queries[QueryIndex], GL_TIMESTAMP);
+    }
+
+    auto Scope = static_cast<uint32_t>(Frame.scopes.size());
+    Frame.scopes.push_back({GetStatsIndex(Name, depth, QueryIndex >= 0), depth, GetNanoseconds(), 0, QueryIndex});
+    depth++;
+    return Scope;
+}
+
+void FrameProfiler::EndScope(uint32_t Scope)
+{
+    if (Scope == InvalidScope || !isFrameActive)
+        return;
+
+    FrameRecord& Frame = frames[frameIndex % FrameLatency];
+    ScopeRecord& Record = Frame.scopes[Scope];
+    if (Record.queryIndex >= 0)
+        glQueryCounter(Frame.queries[Record.queryIndex + 1], GL_TIMESTAMP);
+
+    Record.endNanoseconds = GetNanoseconds();
+    depth--;
+}
+
+void FrameProfiler::ResolveFrame(FrameRecord& Frame)
+{
+    if (!Frame.isPending)
+        return;
+
+    std::vector<float> GpuMilliseconds(Frame.scopes.size(), 0.f);
+    for (size_t i = 0; i < Frame.scopes.size(); ++i)
+    {
+        if (Frame.scopes[i].queryIndex < 0)
+            continue;
+
+        GLuint64 Start = 0;
+        GLuint64 End = 0;
+        glGetQueryObjectui64v(Frame.queries[Frame.scopes[i].queryIndex], GL_QUERY_RESULT, &Start);
+        glGetQueryObjectui64v(Frame.queries[Frame.scopes[i].queryIndex + 1], GL_QUERY_RESULT, &End);
+        GpuMilliseconds[i] = static_cast<float>(End - Start) / 1e6f;
+    }
+
+    frameCpuTotals.assign(scopeStats.size(), -1.f);
+    frameGpuTotals.assign(scopeStats.size(), 0.f);
+    displayOrder.clear();
+
+    for (size_t i = 0; i < Frame.scopes.size(); ++i)
+    {
+        const ScopeRecord& Record = Frame.scopes[i];
+        float& CpuTotal = frameCpuTotals[Record.statsIndex];
+        if (CpuTotal < 0.f)
+        {
+            CpuTotal = 0.f;
+            displayOrder.push_back(Record.statsIndex);
+        }
+
+        CpuTotal += static_cast<float>(Record.endNanoseconds - Record.startNanoseconds) / 1e6f;
+        frameGpuTotals[Record.statsIndex] += GpuMilliseconds[i];
+    }
+
+    for (uint32_t StatsIndex : displayOrder)
+    {
+        ProfilerScopeStats& Stats = scopeStats[StatsIndex];
+        Stats.cpuMilliseconds.Push(frameCpuTotals[StatsIndex]);
+        if (Stats.isGpuTimed)
+            Stats.gpuMilliseconds.Push(frameGpuTotals[StatsIndex]);
+    }
+
+    if (captureFramesLeft > 0)
+    {
+        AppendTraceEvents(Frame, GpuMilliseconds);
+        if (--captureFramesLeft == 0)
+            FinishCapture();
+    }
+
+    Frame.scopes.clear();
+    Frame.usedQueriesCount = 0;
+    Frame.isPending = false;
+}
+
+void FrameProfiler::AppendTraceEvents(const FrameRecord& Frame, const std::vector<float>& GpuMilliseconds)
+{
+    if (Frame.scopes.empty())
+        return;
+
+    if (captureOriginNanoseconds < 0)
+        captureOriginNanoseconds = Frame.scopes.front().startNanoseconds;
+
+    for (size_t i = 0; i < Frame.scopes.size(); ++i)
+    {
+        const ScopeRecord& Record = Frame.scopes[i];
+        std::string_view Name = scopeStats[Record.statsIndex].name;
+        double StartMicroseconds = static_cast<double>(Record.startNanoseconds - captureOriginNanoseconds) / 1e3;
+        double DurationMicroseconds = static_cast<double>(Record.endNanoseconds - Record.startNanoseconds) / 1e3;
+        AppendTraceEvent(captureEvents, Name, "cpu", CaptureThreadId, StartMicroseconds, DurationMicroseconds);
+
+        // GPU timestamps run on their own clock, GPU passes are drawn from the moment they were submitted
+        if (Record.queryIndex >= 0)
+            AppendTraceEvent(captureEvents, Name, "gpu", CaptureGpuThreadId, StartMicroseconds,
+                             static_cast<double>(GpuMilliseconds[i]) * 1e3);
+    }
+}
+
+bool FrameProfiler::StartCapture(std::string OutputPath, uint32_t FramesCount)
+{
+    if (IsCapturing() || FramesCount == 0)
+        return false;
+
+    captureOutputPath = std::move(OutputPath);
+    captureFramesLeft = FramesCount;
+    captureOriginNanoseconds = -1;
+    captureEvents.clear();
+    return true;
+}
+
+bool FrameProfiler::IsCapturing() const
+{
+    return captureFramesLeft > 0;
+}
+
+void FrameProfiler::FinishCapture()
+{
+    captureFramesLeft = 0;
+
+    std::ofstream Output(captureOutputPath, std::ios::trunc);
+    if (!Output)
+    {
+        SPDLOG_ERROR("Failed to write frame trace at path: {}", captureOutputPath);
+        captureEvents.clear();
+        return;
+    }
+
+    Output << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n"
+           << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << CaptureThreadId
+           << ",\"args\":{\"name\":\"CPU\"}},\n"
+           << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << CaptureGpuThreadId
+           << ",\"args\":{\"name\":\"GPU\"}}"
+           << captureEvents << "\n]}\n";
+
+    captureEvents.clear();
+    captureEvents.shrink_to_fit();
+}
+
+void FrameProfiler::Flush()
+{
+    for (uint32_t i = 0; i < FrameLatency; ++i)
+        ResolveFrame(frames[(frameIndex + i) % FrameLatency]);
+}
+
+void FrameProfiler::Shutdown()
+{
+    if (IsCapturing())
+        FinishCapture();
+
+    for (FrameRecord& Frame : frames)
+    {
+        if (!Frame.queries.empty())
+            glDeleteQueries(static_cast<GLsizei>(Frame.queries.size()), Frame.queries.data());
+
+        Frame = FrameRecord();
+    }
+    isFrameActive = false;
+}
+
+void FrameProfiler::DrawWidget()
+{
+    ImGui::Begin("Profiler");
+
+    bool IsProfilerEnabled = isEnabled;
+    if (ImGui::Checkbox("Enabled", &IsProfilerEnabled))
+        SetEnabled(IsProfilerEnabled);
+
+    ImGui::SameLine();
+    if (IsCapturing())
+        ImGui::Text("Capturing trace, %u frames left", captureFramesLeft);
+    else if (ImGui::Button("Capture trace"))
+        StartCapture(WidgetCapturePath, WidgetCaptureFramesCount);
+
+    ImGui::Text("Rolling window of %u frames, times in ms", RollingSamples::Capacity);
+
+    if (ImGui::BeginTable("Scopes", 7, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg))
+    {
+        ImGui::TableSetupColumn("Scope");
+        ImGui::TableSetupColumn("CPU p50");
+        ImGui::TableSetupColumn("CPU p95");
+        ImGui::TableSetupColumn("CPU p99");
+        ImGui::TableSetupColumn("GPU p50");
+        ImGui::TableSetupColumn("GPU p95");
+        ImGui::TableSetupColumn("GPU p99");
+        ImGui::TableHeadersRow();
+
+        for (uint32_t StatsIndex : displayOrder)
+        {
+            const ProfilerScopeStats& Stats = scopeStats[StatsIndex];
+
+            ImGui::TableNextRow();
+            ImGui::TableNextColumn();
+            ImGui::Text("%*s%.*s", static_cast<int>(Stats.depth * 2), "", static_cast<int>(Stats.name.size()),
+                        Stats.name.data());
+
+            for (float Fraction : {0.5f, 0.95f, 0.99f})
+            {
+                ImGui::TableNextColumn();
+                ImGui::Text("%.3f", Stats.cpuMilliseconds.GetPercentile(Fraction));
+            }
+
+            for (float Fraction : {0.5f, 0.95f, 0.99f})
+            {
+                ImGui::TableNextColumn();
+                if (Stats.isGpuTimed)
+                    ImGui::Text("%.3f", Stats.gpuMilliseconds.GetPercentile(Fraction));
+                else
+                    ImGui::Text("-");
+            }
+        }
+        ImGui::EndTable();
+    }
+
+    ImGui::End();
+}
+
+const std::vector<ProfilerScopeStats>& FrameProfiler::GetScopeStats() const
+{
+    return scopeStats;
+}
+
+bool FrameProfiler::IsEnabled() const
+{
+    return isEnabled;
+}
+
+void FrameProfiler::SetEnabled(bool IsEnabled)
+{
+    isEnabled = IsEnabled;
+}
+
+uint32_t FrameProfiler::GetStatsIndex(std::string_view Name, uint32_t Depth, bool IsGpuTimed)
+{
+    auto [Iterator, IsInserted] = statsIndices.try_emplace(Name, static_cast<uint32_t>(scopeStats.size()));
+    if (IsInserted)
+        scopeStats.push_back({Name, Depth});
+
+    ProfilerScopeStats& Stats = scopeStats[Iterator->second];
+    Stats.depth = Depth;
+    Stats.isGpuTimed = Stats.isGpuTimed || IsGpuTimed;
+    return Iterator->second;
+}
+
+int64_t FrameProfiler::GetNanoseconds()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+}
@@ -0,0 +1,269 @@
+#include "FrustumCulling.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define FRUSTUM_CULLING_SSE
+#include <emmintrin.h>
+#endif
+
+// The AVX path is compiled for its own function only and picked at runtime, the rest of the build keeps its flags
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define FRUSTUM_CULLING_AVX
+#define FRUSTUM_CULLING_AVX_TARGET __attribute__((target("avx")))
+#include <immintrin.h>
+#elif defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#define FRUSTUM_CULLING_AVX
+#define FRUSTUM_CULLING_AVX_TARGET
+#include <immintrin.h>
+#include <intrin.h>
+#endif
+
+Frustum Frustum::FromMatrix(const glm::mat4& viewProjection)
+{
+    // Gribb-Hartmann: every plane is the last row plus or minus one of the other rows
+    glm::mat4 Transposed = glm::transpose(viewProjection);
+
+    Frustum Result{};
+    Result.planes[0] = Transposed[3] + Transposed[0];
+    Result.planes[1] = Transposed[3] - Transposed[0];
+    Result.planes[2] = Transposed[3] + Transposed[1];
+    Result.planes[3] = Transposed[3] - Transposed[1];
+    Result.planes[4] = Transposed[3] + Transposed[2];
+    Result.planes[5] = Transposed[3] - Transposed[2];
+
+    for (glm::vec4& Plane : Result.planes)
+    {
+        Plane /= glm::length(glm::vec3(Plane));
+    }
+
+    return Result;
+}
+
+bool Frustum::IsSphereVisible(const glm::vec3& center, float radius) const
+{
+    for (const glm::vec4& Plane : planes)
+    {
+        // Same operation order as the SIMD paths so all of them agree on the boundary
+        float Distance = (Plane.x * center.x + Plane.y * center.y) + (Plane.z * center.z + Plane.w);
+        if (Distance < -radius)
+            return false;
+    }
+    return true;
+}
+
+void BoundingSpheres::Resize(size_t size)
+{
+    centersX.resize(size);
+    centersY.resize(size);
+    centersZ.resize(size);
+    radii.resize(size);
+}
+
+void BoundingSpheres::Set(size_t index, const BoundingSphere& sphere)
+{
+    centersX[index] = sphere.center.x;
+    centersY[index] = sphere.center.y;
+    centersZ[index] = sphere.center.z;
+    radii[index] = sphere.radius;
+}
+
+void BoundingSpheres::Move(size_t from, size_t to)
+{
+    centersX[to] = centersX[from];
+    centersY[to] = centersY[from];
+    centersZ[to] = centersZ[from];
+    radii[to] = radii[from];
+}
+
+BoundingSphere BoundingSpheres::Get(size_t index) const
+{
+    return {glm::vec3(centersX[index], centersY[index], centersZ[index]), radii[index]};
+}
+
+size_t BoundingSpheres::GetSize() const
+{
+    return radii.size();
+}
+
+namespace
+{
+    uint32_t CullSpheresRangeScalar(const Frustum& frustum, const BoundingSpheres& spheres, uint32_t begin,
+                                    uint32_t end, uint32_t* visibleOut)
+    {
+        uint32_t VisibleCount = 0;
+        for (uint32_t i = begin; i < end; ++i)
+        {
+            glm::vec3 Center(spheres.centersX[i], spheres.centersY[i], spheres.centersZ[i]);
+            if (frustum.IsSphereVisible(Center, spheres.radii[i]))
+                visibleOut[VisibleCount++] = i;
+        }
+        return VisibleCount;
+    }
+
+    // The SIMD ranges cull whole vectors from 0 on, advance end to where they stopped and leave the rest to the
+    // scalar range
+
+#if defined(FRUSTUM_CULLING_SSE)
+    uint32_t CullSpheresRangeSse(const Frustum& frustum, const BoundingSpheres& spheres, uint32_t& end,
+                                 uint32_t* visibleOut)
+    {
+        __m128 PlaneX[6], PlaneY[6], PlaneZ[6], PlaneW[6];
+        for (int Plane = 0; Plane < 6; ++Plane)
+        {
+            PlaneX[Plane] = _mm_set1_ps(frustum.planes[Plane].x);
+            PlaneY[Plane] = _mm_set1_ps(frustum.planes[Plane].y);
+            PlaneZ[Plane] = _mm_set1_ps(frustum.planes[Plane].z);
+            PlaneW[Plane] = _mm_set1_ps(frustum.planes[Plane].w);
+        }
+
+        auto Count = static_cast<uint32_t>(spheres.GetSize());
+        uint32_t VisibleCount = 0;
+        uint32_t i = 0;
+        for (; i + 4 <= Count; i += 4)
+        {
+            __m128 X = _mm_loadu_ps(&spheres.centersX[i]);
+            __m128 Y = _mm_loadu_ps(&spheres.centersY[i]);
+            __m128 Z = _mm_loadu_ps(&spheres.centersZ[i]);
+            __m128 NegativeRadius = _mm_sub_ps(_mm_setzero_ps(), _mm_loadu_ps(&spheres.radii[i]));
+
+            __m128 Inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+            for (int Plane = 0; Plane < 6; ++Plane)
+            {
+                __m128 Distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(PlaneX[Plane], X), _mm_mul_ps(PlaneY[Plane], Y)),
+                                             _mm_add_ps(_mm_mul_ps(PlaneZ[Plane], Z), PlaneW[Plane]));
+                Inside = _mm_and_ps(Inside, _mm_cmpge_ps(Distance, NegativeRadius));
+            }
+
+            // Branch-free compaction, every lane is written and the counter only advances for visible ones
+            int Mask = _mm_movemask_ps(Inside);
+            visibleOut[VisibleCount] = i;
+            VisibleCount += Mask & 1;
+            visibleOut[VisibleCount] = i + 1;
+            VisibleCount += (Mask >> 1) & 1;
+            visibleOut[VisibleCount] = i + 2;
+            VisibleCount += (Mask >> 2) & 1;
+            visibleOut[VisibleCount] = i + 3;
+            VisibleCount += (Mask >> 3) & 1;
+        }
+
+        end = i;
+        return VisibleCount;
+    }
+#endif
+
+#if defined(FRUSTUM_CULLING_AVX)
+    FRUSTUM_CULLING_AVX_TARGET
+    uint32_t CullSpheresRangeAvx(const Frustum& frustum, const BoundingSpheres& spheres, uint32_t& end,
+                                 uint32_t* visibleOut)
+    {
+        __m256 PlaneX[6], PlaneY[6], PlaneZ[6], PlaneW[6];
+        for (int Plane = 0; Plane < 6; ++Plane)
+        {
+            PlaneX[Plane] = _mm256_set1_ps(frustum.planes[Plane].x);
+            PlaneY[Plane] = _mm256_set1_ps(frustum.planes[Plane].y);
+            PlaneZ[Plane] = _mm256_set1_ps(frustum.planes[Plane].z);
+            PlaneW[Plane] = _mm256_set1_ps(frustum.planes[Plane].w);
+        }
+
+        auto Count = static_cast<uint32_t>(spheres.GetSize());
+        uint32_t VisibleCount = 0;
+        uint32_t i = 0;
+        for (; i + 8 <= Count; i += 8)
+        {
+            __m256 X = _mm256_loadu_ps(&spheres.centersX[i]);
+            __m256 Y = _mm256_loadu_ps(&spheres.centersY[i]);
+            __m256 Z = _mm256_loadu_ps(&spheres.centersZ[i]);
+            __m256 NegativeRadius = _mm256_sub_ps(_mm256_setzero_ps(), _mm256_loadu_ps(&spheres.radii[i]));
+
+            __m256 Inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+            for (int Plane = 0; Plane < 6; ++Plane)
+            {
+                __m256 Distance = _mm256_add_ps(
+                        _mm256_add_ps(_mm256_mul_ps(PlaneX[Plane], X), _mm256_mul_ps(PlaneY[Plane], Y)),
+                        _mm256_add_ps(_mm256_mul_ps(PlaneZ[Plane], Z), PlaneW[Plane]));
+                Inside = _mm256_and_ps(Inside, _mm256_cmp_ps(Distance, NegativeRadius, _CMP_GE_OQ));
+            }
+
+            // Branch-free compaction, every lane is written and the counter only advances for visible ones
+            int Mask = _mm256_movemask_ps(Inside);
+            for (uint32_t Lane = 0; Lane < 8; ++Lane)
+            {
+                visibleOut[VisibleCount] = i + Lane;
+                VisibleCount += (Mask >> Lane) & 1;
+            }
+        }
+
+        end = i;
+        return VisibleCount;
+    }
+#endif
+
+    bool DetectAvx()
+    {
+#if defined(FRUSTUM_CULLING_AVX) && defined(__GNUC__)
+        // Also checks that the OS saves the AVX registers
+        return __builtin_cpu_supports("avx");
+#elif defined(FRUSTUM_CULLING_AVX)
+        int Registers[4];
+        __cpuid(Registers, 1);
+        bool IsXsaveEnabled = (Registers[2] & (1 << 27)) != 0;
+        bool HasAvx = (Registers[2] & (1 << 28)) != 0;
+        return IsXsaveEnabled && HasAvx && (_xgetbv(0) & 0x6) == 0x6;
+#else
+        return false;
+#endif
+    }
+
+    using CullSpheresRange = uint32_t (*)(const Frustum&, const BoundingSpheres&, uint32_t&, uint32_t*);
+
+    uint32_t CullSpheresWith(CullSpheresRange cullRange, const Frustum& frustum, const BoundingSpheres& spheres,
+                             std::vector<uint32_t>& visibleIndices)
+    {
+        auto Count = static_cast<uint32_t>(spheres.GetSize());
+        visibleIndices.resize(Count);
+        uint32_t* VisibleOut = visibleIndices.data();
+
+        uint32_t End = 0;
+        uint32_t VisibleCount = cullRange ? cullRange(frustum, spheres, End, VisibleOut) : 0;
+        VisibleCount += CullSpheresRangeScalar(frustum, spheres, End, Count, VisibleOut + VisibleCount);
+        visibleIndices.resize(VisibleCount);
+        return VisibleCount;
+    }
+}
+
+bool FrustumCulling::IsAvxSupported()
+{
+    static const bool IsSupported = DetectAvx();
+    return IsSupported;
+}
+
+uint32_t FrustumCulling::CullSpheresScalar(const Frustum& frustum, const BoundingSpheres& spheres,
+                                           std::vector<uint32_t>& visibleIndices)
+{
+    return CullSpheresWith(nullptr, frustum, spheres, visibleIndices);
+}
+
+uint32_t FrustumCulling::CullSpheresSse(const Frustum& frustum, const BoundingSpheres& spheres,
+                                        std::vector<uint32_t>& visibleIndices)
+{
+#if defined(FRUSTUM_CULLING_SSE)
+    return CullSpheresWith(CullSpheresRangeSse, frustum, spheres, visibleIndices);
+#else
+    return CullSpheresWith(nullptr, frustum, spheres, visibleIndices);
+#endif
+}
+
+uint32_t FrustumCulling::CullSpheresAvx(const Frustum& frustum, const BoundingSpheres& spheres,
+                                        std::vector<uint32_t>& visibleIndices)
+{
+#if defined(FRUSTUM_CULLING_AVX)
+    if (IsAvxSupported())
+        return CullSpheresWith(CullSpheresRangeAvx, frustum, spheres, visibleIndices);
+#endif
+    return CullSpheresSse(frustum, spheres, visibleIndices);
+}
+
+uint32_t FrustumCulling::CullSpheres(const Frustum& frustum, const BoundingSpheres& spheres,
+                                     std::vector<uint32_t>& visibleIndices)
+{
+    return CullSpheresAvx(frustum, spheres, visibleIndices);
+}
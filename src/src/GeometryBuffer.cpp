@@ -0,0 +1,296 @@
+#include "GeometryBuffer.h"
+
+#include <algorithm>
+#include <numeric>
+#include <vector>
+
+#include "LoggingMacros.h"
+
+bool RangeAllocator::Allocate(uint32_t Count, uint32_t& OffsetOut)
+{
+    for (auto Iterator = freeRanges.begin(); Iterator != freeRanges.end(); ++Iterator)
+    {
+        auto [Offset, Size] = *Iterator;
+        if (Size < Count)
+            continue;
+
+        freeRanges.erase(Iterator);
+        if (Size > Count)
+            freeRanges.emplace(Offset + Count, Size - Count);
+
+        OffsetOut = Offset;
+        return true;
+    }
+    return false;
+}
+
+void RangeAllocator::Release(uint32_t Offset, uint32_t Count)
+{
+    if (Count == 0)
+        return;
+
+    auto Next = freeRanges.lower_bound(Offset);
+    if (Next != freeRanges.end() && Offset + Count == Next->first)
+    {
+        Count += Next->second;
+        Next = freeRanges.erase(Next);
+    }
+
+    if (Next != freeRanges.begin())
+    {
+        auto Previous = std::prev(Next);
+        if (Previous->first + Previous->second == Offset)
+        {
+            Previous->second += Count;
+            return;
+        }
+    }
+
+    freeRanges.emplace(Offset, Count);
+}
+
+void RangeAllocator::Grow(uint32_t NewCapacity)
+{
+    if (NewCapacity <= capacity)
+        return;
+
+    uint32_t OldCapacity = capacity;
+    capacity = NewCapacity;
+    Release(OldCapacity, NewCapacity - OldCapacity);
+}
+
+uint32_t RangeAllocator::GetCapacity() const
+{
+    return capacity;
+}
+
+GeometryBuffer& GeometryBuffer::GetInstance()
+{
+    static GeometryBuffer Instance;
+    return Instance;
+}
+
+GeometryRange GeometryBuffer::Allocate(std::span<const Vertex> Vertices, std::span<const GLuint> Indices)
+{
+    return Allocate(VertexFormat::Full, Vertices.data(), static_cast<uint32_t>(Vertices.size()), Indices);
+}
+
+GeometryRange GeometryBuffer::Allocate(std::span<const CompactVertex> Vertices, std::span<const GLuint> Indices)
+{
+    return Allocate(VertexFormat::Compact, Vertices.data(), static_cast<uint32_t>(Vertices.size()), Indices);
+}
+
+GeometryRange GeometryBuffer::Allocate(VertexFormat Format, const void* Vertices, uint32_t VerticesCount,
+                                       std::span<const GLuint> Indices)
+{
+    if (!isCreated)
+        CreateVertexArrays();
+
+    VertexPool& Pool = vertexPools[static_cast<size_t>(Format)];
+    auto IndicesCount = static_cast<uint32_t>(Indices.size());
+
+    uint32_t VertexOffset = 0;
+    if (!Pool.ranges.Allocate(VerticesCount, VertexOffset))
+    {
+        GrowVertexBuffer(Pool, VerticesCount);
+        Pool.ranges.Allocate(VerticesCount, VertexOffset);
+    }
+
+    uint32_t IndexOffset = 0;
+    if (!indexRanges.Allocate(IndicesCount, IndexOffset))
+    {
+        GrowIndexBuffer(IndicesCount);
+        indexRanges.Allocate(IndicesCount, IndexOffset);
+    }
+
+    // Uploaded through the copy target, binding GL_ELEMENT_ARRAY_BUFFER would change the bound VAO
+    auto VerticesSize = static_cast<GLsizeiptr>(VerticesCount) * Pool.stride;
+    glBindBuffer(GL_COPY_WRITE_BUFFER, Pool.buffer);
+    glBufferSubData(GL_COPY_WRITE_BUFFER, static_cast<GLintptr>(VertexOffset) * Pool.stride, VerticesSize, Vertices);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, indexBuffer);
+    glBufferSubData(GL_COPY_WRITE_BUFFER, static_cast<GLintptr>(IndexOffset) * sizeof(GLuint),
+                    static_cast<GLsizeiptr>(Indices.size_bytes()), Indices.data());
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+    stats.meshesCount++;
+    stats.compactMeshesCount += Format == VertexFormat::Compact ? 1 : 0;
+    stats.usedVertexBytes += VerticesSize;
+    stats.usedIndices += IndicesCount;
+
+    return {static_cast<GLint>(VertexOffset), VerticesCount, IndexOffset, IndicesCount, Format};
+}
+
+void GeometryBuffer::Release(const GeometryRange& Range)
+{
+    // Meshes outliving Shutdown have nothing left to give back
+    if (!isCreated)
+        return;
+
+    VertexPool& Pool = vertexPools[static_cast<size_t>(Range.format)];
+    Pool.ranges.Release(static_cast<uint32_t>(Range.baseVertex), Range.verticesCount);
+    indexRanges.Release(Range.firstIndex, Range.indicesCount);
+
+    stats.meshesCount--;
+    stats.compactMeshesCount -= Range.format == VertexFormat::Compact ? 1 : 0;
+    stats.usedVertexBytes -= static_cast<size_t>(Range.verticesCount) * Pool.stride;
+    stats.usedIndices -= Range.indicesCount;
+}
+
+void GeometryBuffer::ReserveDrawIds(uint32_t Count)
+{
+    if (Count <= drawIdsCount)
+        return;
+
+    if (!isCreated)
+        CreateVertexArrays();
+
+    uint32_t NewCount = std::max(Count, drawIdsCount * 2);
+    std::vector<GLuint> DrawIds(NewCount);
+    std::iota(DrawIds.begin(), DrawIds.end(), 0);
+
+    glBindBuffer(GL_COPY_WRITE_BUFFER, drawIdBuffer);
+    glBufferData(GL_COPY_WRITE_BUFFER, static_cast<GLsizeiptr>(NewCount * sizeof(GLuint)), DrawIds.data(), GL_STATIC_DRAW);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    drawIdsCount = NewCount;
+}
+
+void GeometryBuffer::Bind(VertexFormat Format)
+{
+    if (!isCreated)
+        CreateVertexArrays();
+
+    glBindVertexArray(vertexPools[static_cast<size_t>(Format)].vao);
+}
+
+void GeometryBuffer::Shutdown()
+{
+    if (!isCreated)
+        return;
+
+    for (VertexPool& Pool : vertexPools)
+    {
+        glDeleteVertexArrays(1, &Pool.vao);
+        glDeleteBuffers(1, &Pool.buffer);
+        Pool = VertexPool();
+    }
+    GLuint Buffers[] = {indexBuffer, drawIdBuffer};
+    glDeleteBuffers(2, Buffers);
+
+    indexBuffer = drawIdBuffer = 0;
+    drawIdsCount = 0;
+    isCreated = false;
+    indexRanges = RangeAllocator();
+    stats = GeometryBufferStats();
+}
+
+const GeometryBufferStats& GeometryBuffer::GetStats() const
+{
+    return stats;
+}
+
+void GeometryBuffer::CreateVertexArrays()
+{
+    isCreated = true;
+    glGenBuffers(1, &drawIdBuffer);
+
+    vertexPools[static_cast<size_t>(VertexFormat::Full)].stride = sizeof(Vertex);
+    vertexPools[static_cast<size_t>(VertexFormat::Compact)].stride = sizeof(CompactVertex);
+
+    for (size_t Format = 0; Format < VertexFormatsCount; ++Format)
+    {
+        glGenVertexArrays(1, &vertexPools[Format].vao);
+        glBindVertexArray(vertexPools[Format].vao);
+        SetVertexFormat(static_cast<VertexFormat>(Format));
+
+        glEnableVertexAttribArray(DrawIdAttribute);
+        glVertexAttribIFormat(DrawIdAttribute, 1, GL_UNSIGNED_INT, 0);
+        glVertexAttribBinding(DrawIdAttribute, DrawIdBinding);
+        glBindVertexBuffer(DrawIdBinding, drawIdBuffer, 0, sizeof(GLuint));
+        glVertexBindingDivisor(DrawIdBinding, UINT32_MAX);
+    }
+    glBindVertexArray(0);
+
+    for (VertexPool& Pool : vertexPools)
+        GrowVertexBuffer(Pool, MinimalVertexCapacity);
+    GrowIndexBuffer(MinimalIndexCapacity);
+    ReserveDrawIds(64);
+}
+
+void GeometryBuffer::SetVertexFormat(VertexFormat Format)
+{
+    for (GLuint Attribute = 0; Attribute < 3; ++Attribute)
+    {
+        glEnableVertexAttribArray(Attribute);
+        glVertexAttribBinding(Attribute, VertexBinding);
+    }
+
+    if (Format == VertexFormat::Full)
+    {
+        glVertexAttribFormat(0, 3, GL_FLOAT, GL_FALSE, offsetof(Vertex, position));
+        glVertexAttribFormat(1, 3, GL_FLOAT, GL_FALSE, offsetof(Vertex, normal));
+        glVertexAttribFormat(2, 2, GL_FLOAT, GL_FALSE, offsetof(Vertex, texCoord));
+        return;
+    }
+
+    // Positions arrive in [0, 1] and normals as the two octahedral coordinates, the vertex shader decodes both
+    glVertexAttribFormat(0, 3, GL_UNSIGNED_SHORT, GL_TRUE, offsetof(CompactVertex, position));
+    glVertexAttribFormat(1, 4, GL_INT_2_10_10_10_REV, GL_TRUE, offsetof(CompactVertex, normal));
+    glVertexAttribFormat(2, 2, GL_HALF_FLOAT, GL_FALSE, offsetof(CompactVertex, texCoord));
+}
+
+void GeometryBuffer::GrowVertexBuffer(VertexPool& Pool, uint32_t RequiredCount)
+{
+    uint32_t OldCapacity = Pool.ranges.GetCapacity();
+    uint32_t NewCapacity = std::max({OldCapacity * 2, OldCapacity + RequiredCount, MinimalVertexCapacity});
+
+    Pool.buffer = ResizeBuffer(Pool.buffer, static_cast<GLsizeiptr>(OldCapacity) * Pool.stride,
+                               static_cast<GLsizeiptr>(NewCapacity) * Pool.stride);
+    Pool.ranges.Grow(NewCapacity);
+    stats.vertexCapacityBytes += static_cast<size_t>(NewCapacity - OldCapacity) * Pool.stride;
+
+    glBindVertexArray(Pool.vao);
+    glBindVertexBuffer(VertexBinding, Pool.buffer, 0, Pool.stride);
+    glBindVertexArray(0);
+
+    SPDLOG_DEBUG("Geometry vertex buffer with {} byte vertices grown to {} vertices", Pool.stride, NewCapacity);
+}
+
+void GeometryBuffer::GrowIndexBuffer(uint32_t RequiredCount)
+{
+    uint32_t OldCapacity = indexRanges.GetCapacity();
+    uint32_t NewCapacity = std::max({OldCapacity * 2, OldCapacity + RequiredCount, MinimalIndexCapacity});
+
+    indexBuffer = ResizeBuffer(indexBuffer, static_cast<GLsizeiptr>(OldCapacity) * sizeof(GLuint),
+                               static_cast<GLsizeiptr>(NewCapacity) * sizeof(GLuint));
+    indexRanges.Grow(NewCapacity);
+    stats.indexCapacity = NewCapacity;
+
+    // Both vertex formats share the index buffer
+    for (const VertexPool& Pool : vertexPools)
+    {
+        glBindVertexArray(Pool.vao);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBuffer);
+    }
+    glBindVertexArray(0);
+
+    SPDLOG_DEBUG("Geometry index buffer grown to {} indices", NewCapacity);
+}
+
+GLuint GeometryBuffer::ResizeBuffer(GLuint Buffer, GLsizeiptr OldSize, GLsizeiptr NewSize)
+{
+    GLuint NewBuffer;
+    glGenBuffers(1, &NewBuffer);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, NewBuffer);
+    glBufferData(GL_COPY_WRITE_BUFFER, NewSize, nullptr, GL_STATIC_DRAW);
+
+    if (Buffer)
+    {
+        glBindBuffer(GL_COPY_READ_BUFFER, Buffer);
+        glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, OldSize);
+        glBindBuffer(GL_COPY_READ_BUFFER, 0);
+        glDeleteBuffers(1, &Buffer);
+    }
+
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    return NewBuffer;
+}
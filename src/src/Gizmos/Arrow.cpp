@@ -1,37 +1,46 @@
+#include <cmath>
 #include <vector>
 #include "Gizmos/Arrow.h"
-#include "ShaderWrapper.h"
 
-void Arrow::Draw(glm::vec3 Start, glm::vec3 End, glm::vec4 Color)
+namespace
 {
-    glm::vec3 Direction = glm::normalize(End - Start);
-
-    glm::vec3 RightVector;
+    constexpr float TipSize = 0.5f;
+    constexpr uint32_t NoPrimitive = UINT32_MAX;
 
-    if (std::abs(Direction.y) != 1.f)
-        RightVector = glm::cross(Direction, glm::vec3(0.f, 0.5f, 0.f));
-    else
-        RightVector = glm::vec3(0.5f, 0.0f, 0.f);
-
-    glm::vec3 TipOffset = -Direction * 0.5f;
-    glm::vec3 TipLeft = End - RightVector + TipOffset;
-    glm::vec3 TipRight = End + RightVector + TipOffset;
+    uint32_t LinePrimitive = NoPrimitive;
+    uint32_t TipPrimitive = NoPrimitive;
+}
 
-    std::vector<glm::vec3> Vertices = {Start, End, TipLeft, TipRight};
-    std::vector<GLuint> Indices = {0, 1, 2, 3, 1};
+void Arrow::Draw(glm::vec3 Start, glm::vec3 End, glm::vec4 Color)
+{
+    if (LinePrimitive == NoPrimitive)
+    {
+        // Unit segment along +Z and a tip at the origin pointing along +Z with its wings on X
+        LinePrimitive = AddPrimitive({glm::vec3(0.f), glm::vec3(0.f, 0.f, 1.f)}, {0, 1});
+        TipPrimitive = AddPrimitive({glm::vec3(0.f), glm::vec3(-1.f, 0.f, -1.f), glm::vec3(1.f, 0.f, -1.f)},
+                                    {0, 1, 1, 2, 2, 0});
+    }
 
-    glBindVertexArray(VAO);
-    glBindBuffer(GL_ARRAY_BUFFER, VBO);
-    glBufferData(GL_ARRAY_BUFFER, Vertices.size() * sizeof(glm::vec3), &Vertices[0], GL_DYNAMIC_DRAW);
+    glm::vec3 Line = End - Start;
+    float Length = glm::length(Line);
+    if (Length <= 0.f)
+        return;
 
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, Indices.size() * sizeof(int), &Indices[0], GL_DYNAMIC_DRAW);
+    glm::vec3 Direction = Line / Length;
 
-    Shader->Activate();
-    Shader->SetVec4F("Color", Color);
+    glm::vec3 RightVector;
+    if (std::abs(Direction.y) < 0.999f)
+        RightVector = glm::normalize(glm::cross(Direction, glm::vec3(0.f, 1.f, 0.f)));
+    else
+        RightVector = glm::vec3(1.f, 0.f, 0.f);
+    glm::vec3 UpVector = glm::cross(RightVector, Direction);
 
-    glDrawElements(GL_LINE_STRIP, Indices.size(), GL_UNSIGNED_INT, 0);
+    // Only the Z column matters for the segment, the others just keep the matrix invertible
+    glm::mat4 LineTransform(glm::vec4(RightVector, 0.f), glm::vec4(UpVector, 0.f), glm::vec4(Line, 0.f),
+                            glm::vec4(Start, 1.f));
+    glm::mat4 TipTransform(glm::vec4(RightVector * TipSize, 0.f), glm::vec4(UpVector * TipSize, 0.f),
+                           glm::vec4(Direction * TipSize, 0.f), glm::vec4(End, 1.f));
 
-    glBindVertexArray(0);
+    Queue(LinePrimitive, LineTransform, Color);
+    Queue(TipPrimitive, TipTransform, Color);
 }
-
@@ -1,11 +1,30 @@
 #include "Gizmos/Gizmo.h"
 
+#include <cstddef>
+
+#include "AssetRegistry.h"
+
+namespace
+{
+    constexpr GLuint PositionAttribute = 0;
+    constexpr GLuint TransformAttribute = 1;
+    constexpr GLuint ColorAttribute = 5;
+}
 
 GLuint Gizmo::VAO;
 GLuint Gizmo::VBO;
 GLuint Gizmo::EBO;
+GLuint Gizmo::InstanceBuffer;
 std::shared_ptr<ShaderWrapper> Gizmo::Shader;
 
+std::vector<Gizmo::Primitive> Gizmo::Primitives;
+std::vector<glm::vec3> Gizmo::PrimitiveVertices;
+std::vector<GLuint> Gizmo::PrimitiveIndices;
+bool Gizmo::ArePrimitivesDirty = false;
+
+std::vector<GizmoInstance> Gizmo::InstanceStream;
+GizmoStats Gizmo::Stats;
+
 void Gizmo::Initialize()
 {
     if (VAO != 0)
@@ -14,15 +33,132 @@ void Gizmo::Initialize()
     glGenVertexArrays(1, &VAO);
     glGenBuffers(1, &VBO);
     glGenBuffers(1, &EBO);
+    glGenBuffers(1, &InstanceBuffer);
 
     glBindVertexArray(VAO);
     glBindBuffer(GL_ARRAY_BUFFER, VBO);
     glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
 
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(glm::vec3), (void*) 0);
+    glEnableVertexAttribArray(PositionAttribute);
+    glVertexAttribPointer(PositionAttribute, 3, GL_FLOAT, GL_FALSE, sizeof(glm::vec3), (void*) 0);
+
+    // The transform takes one attribute per column, instances advance once per instance of the draw
+    glBindBuffer(GL_ARRAY_BUFFER, InstanceBuffer);
+    for (GLuint Column = 0; Column < 4; ++Column)
+    {
+        GLuint Attribute = TransformAttribute + Column;
+        glEnableVertexAttribArray(Attribute);
+        glVertexAttribPointer(Attribute, 4, GL_FLOAT, GL_FALSE, sizeof(GizmoInstance),
+                              (void*) (offsetof(GizmoInstance, transform) + Column * sizeof(glm::vec4)));
+        glVertexAttribDivisor(Attribute, 1);
+    }
+    glEnableVertexAttribArray(ColorAttribute);
+    glVertexAttribPointer(ColorAttribute, 4, GL_FLOAT, GL_FALSE, sizeof(GizmoInstance),
+                          (void*) offsetof(GizmoInstance, color));
+    glVertexAttribDivisor(ColorAttribute, 1);
+
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    Shader = AssetRegistry::GetInstance().GetShader("res/shaders/gizmos.vert", "res/shaders/gizmos.frag");
+}
+
+void Gizmo::Shutdown()
+{
+    if (VAO == 0)
+        return;
+
+    GLuint Buffers[] = {VBO, EBO, InstanceBuffer};
+    glDeleteBuffers(3, Buffers);
+    glDeleteVertexArrays(1, &VAO);
+
+    VAO = VBO = EBO = InstanceBuffer = 0;
+    Shader.reset();
+    ArePrimitivesDirty = true;
+}
+
+uint32_t Gizmo::AddPrimitive(const std::vector<glm::vec3>& Vertices, const std::vector<GLuint>& LineIndices)
+{
+    Primitive& Added = Primitives.emplace_back();
+    Added.baseVertex = static_cast<GLint>(PrimitiveVertices.size());
+    Added.firstIndex = static_cast<uint32_t>(PrimitiveIndices.size());
+    Added.indicesCount = static_cast<uint32_t>(LineIndices.size());
+
+    PrimitiveVertices.insert(PrimitiveVertices.end(), Vertices.begin(), Vertices.end());
+    PrimitiveIndices.insert(PrimitiveIndices.end(), LineIndices.begin(), LineIndices.end());
+    ArePrimitivesDirty = true;
+
+    return static_cast<uint32_t>(Primitives.size() - 1);
+}
+
+void Gizmo::Queue(uint32_t PrimitiveIndex, const glm::mat4& Transform, const glm::vec4& Color)
+{
+    Primitives[PrimitiveIndex].instances.push_back({Transform, Color});
+}
+
+void Gizmo::UploadPrimitives()
+{
+    // Primitives are only ever added, which happens a handful of times per run
+    glBindBuffer(GL_ARRAY_BUFFER, VBO);
+    glBufferData(GL_ARRAY_BUFFER, static_cast<GLsizeiptr>(PrimitiveVertices.size() * sizeof(glm::vec3)),
+                 PrimitiveVertices.data(), GL_STATIC_DRAW);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
 
+    glBindVertexArray(VAO);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, static_cast<GLsizeiptr>(PrimitiveIndices.size() * sizeof(GLuint)),
+                 PrimitiveIndices.data(), GL_STATIC_DRAW);
     glBindVertexArray(0);
 
-    Shader = std::make_shared<ShaderWrapper>("res/shaders/gizmos.vert", "res/shaders/gizmos.frag");
+    ArePrimitivesDirty = false;
+}
+
+void Gizmo::Render()
+{
+    Stats = GizmoStats();
+
+    InstanceStream.clear();
+    for (const Primitive& Current : Primitives)
+        InstanceStream.insert(InstanceStream.end(), Current.instances.begin(), Current.instances.end());
+
+    if (InstanceStream.empty())
+        return;
+
+    if (ArePrimitivesDirty)
+        UploadPrimitives();
+
+    // Gizmos are queued again every frame, the whole stream is replaced at this frame's size
+    auto StreamSize = static_cast<GLsizeiptr>(InstanceStream.size() * sizeof(GizmoInstance));
+    glBindBuffer(GL_ARRAY_BUFFER, InstanceBuffer);
+    glBufferData(GL_ARRAY_BUFFER, StreamSize, nullptr, GL_STREAM_DRAW);
+    glBufferSubData(GL_ARRAY_BUFFER, 0, StreamSize, InstanceStream.data());
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    Stats.uploadedBytes = StreamSize;
+    Stats.instancesCount = static_cast<uint32_t>(InstanceStream.size());
+
+    Shader->Activate();
+    glBindVertexArray(VAO);
+
+    // Instances are streamed in primitive order, every primitive draws its own range of them
+    GLuint BaseInstance = 0;
+    for (Primitive& Current : Primitives)
+    {
+        if (Current.instances.empty())
+            continue;
+
+        auto InstancesCount = static_cast<GLsizei>(Current.instances.size());
+        glDrawElementsInstancedBaseVertexBaseInstance(GL_LINES, static_cast<GLsizei>(Current.indicesCount),
+                                                      GL_UNSIGNED_INT,
+                                                      (void*) (Current.firstIndex * sizeof(GLuint)),
+                                                      InstancesCount, Current.baseVertex, BaseInstance);
+        BaseInstance += InstancesCount;
+        Stats.drawCallsCount++;
+        Current.instances.clear();
+    }
+
+    glBindVertexArray(0);
+}
+
+const GizmoStats& Gizmo::GetStats()
+{
+    return Stats;
 }
@@ -1,57 +1,71 @@
 #include "Gizmos/SphereGizmo.h"
 
+#include <algorithm>
+#include <unordered_map>
 #include <vector>
 
 #include <glm/glm.hpp>
 #include <glm/ext/scalar_constants.hpp>
 
-void SphereGizmo::Draw(glm::vec3 Position, float Radius, uint16_t LOD, glm::vec4 Color)
+namespace
 {
-    int i, j;
-    std::vector<GLfloat> Vertices;
-    std::vector<GLuint> Indices;
-    int indicator = 0;
-    for(i = 0; i <= LOD; i++)
+    std::unordered_map<uint16_t, uint32_t> SpherePrimitives;
+
+    // Latitude rings and meridians of a unit sphere around the origin, LOD segments each
+    void BuildUnitSphere(uint16_t LOD, std::vector<glm::vec3>& Vertices, std::vector<GLuint>& Indices)
     {
-        double lat0 = glm::pi<double>() * (-0.5 + (double) (i - 1) / LOD);
-        double z0 = glm::sin(lat0);
-        double zr0 = glm::cos(lat0);
+        uint32_t Rows = LOD + 1;
+        for (uint32_t i = 0; i < Rows; i++)
+        {
+            double Latitude = glm::pi<double>() * (-0.5 + (double) i / LOD);
+            double Z = glm::sin(Latitude);
+            double Radius = glm::cos(Latitude);
 
-        double lat1 = glm::pi<double>() * (-0.5 + (double) i / LOD);
-        double z1 = glm::sin(lat1);
-        double zr1 = glm::cos(lat1);
+            for (uint32_t j = 0; j < LOD; j++)
+            {
+                double Longitude = 2 * glm::pi<double>() * (double) j / LOD;
+                Vertices.emplace_back(glm::cos(Longitude) * Radius, glm::sin(Longitude) * Radius, Z);
+            }
+        }
 
-        for (j = 0; j <= LOD; j++)
+        for (uint32_t i = 0; i < Rows; i++)
         {
-            double lng = 2 * glm::pi<double>() * (double) (j - 1) / LOD;
-            double x = glm::cos(lng);
-            double y = glm::sin(lng);
-
-            Vertices.push_back(x * zr0 * Radius + Position.x);
-            Vertices.push_back(y * zr0 * Radius + Position.y);
-            Vertices.push_back(z0 * Radius + Position.z);
-            Indices.push_back(indicator);
-            indicator++;
-
-            Vertices.push_back(x * zr1 * Radius + Position.x);
-            Vertices.push_back(y * zr1 * Radius + Position.y);
-            Vertices.push_back(z1 * Radius + Position.z);
-            Indices.push_back(indicator);
-            indicator++;
+            for (uint32_t j = 0; j < LOD; j++)
+            {
+                GLuint Current = i * LOD + j;
+
+                // Rings at the poles collapse to a point
+                if (i > 0 && i < LOD)
+                {
+                    Indices.push_back(Current);
+                    Indices.push_back(i * LOD + (j + 1) % LOD);
+                }
+
+                if (i < LOD)
+                {
+                    Indices.push_back(Current);
+                    Indices.push_back(Current + LOD);
+                }
+            }
         }
     }
+}
 
-    glBindVertexArray(VAO);
-    glBindBuffer(GL_ARRAY_BUFFER, VBO);
-    glBufferData(GL_ARRAY_BUFFER, Vertices.size() * sizeof(GLfloat), &Vertices[0], GL_DYNAMIC_DRAW);
-
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, Indices.size() * sizeof(GLuint), &Indices[0], GL_DYNAMIC_DRAW);
+void SphereGizmo::Draw(glm::vec3 Position, float Radius, uint16_t LOD, glm::vec4 Color)
+{
+    LOD = std::max<uint16_t>(LOD, 3);
 
-    Shader->Activate();
-    Shader->SetVec4F("Color", Color);
+    auto Found = SpherePrimitives.find(LOD);
+    if (Found == SpherePrimitives.end())
+    {
+        std::vector<glm::vec3> Vertices;
+        std::vector<GLuint> Indices;
+        BuildUnitSphere(LOD, Vertices, Indices);
+        Found = SpherePrimitives.emplace(LOD, AddPrimitive(Vertices, Indices)).first;
+    }
 
-    glDrawElements(GL_LINE_STRIP, Indices.size(), GL_UNSIGNED_INT, 0);
+    glm::mat4 Transform(Radius);
+    Transform[3] = glm::vec4(Position, 1.f);
 
-    glBindVertexArray(0);
+    Queue(Found->second, Transform, Color);
 }
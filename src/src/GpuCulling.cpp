@@ -0,0 +1,287 @@
+#include "GpuCulling.h"
+
+#include <algorithm>
+#include <string>
+#include <utility>
+
+#include "AssetRegistry.h"
+#include "DepthPyramid.h"
+#include "LoggingMacros.h"
+#include "ModelRenderer.h"
+#include "ShaderWrapper.h"
+
+namespace
+{
+    constexpr uint32_t PhasesCount = 2;
+    // Visible instances per LOD of every phase, then the retested and the occluded instances
+    constexpr uint32_t RetestedCounter = PhasesCount * MeshSimplifier::MaxLodsCount;
+    constexpr uint32_t OccludedCounter = RetestedCounter + 1;
+    constexpr uint32_t CountersCount = OccludedCounter + 1;
+    constexpr GLsizeiptr CountersSize = CountersCount * sizeof(GLuint);
+
+    GLuint GetGroupsCount(uint32_t ThreadsCount)
+    {
+        return (ThreadsCount + GpuCulling::WorkgroupSize - 1) / GpuCulling::WorkgroupSize;
+    }
+}
+
+GpuCullingBuffers::~GpuCullingBuffers()
+{
+    Release();
+}
+
+GpuCullingBuffers::GpuCullingBuffers(GpuCullingBuffers&& other) noexcept
+{
+    *this = std::move(other);
+}
+
+GpuCullingBuffers& GpuCullingBuffers::operator=(GpuCullingBuffers&& other) noexcept
+{
+    if (this == &other)
+        return *this;
+
+    Release();
+    visibleBuffer = std::exchange(other.visibleBuffer, 0);
+    commandBuffer = std::exchange(other.commandBuffer, 0);
+    counterBuffer = std::exchange(other.counterBuffer, 0);
+    occludedBuffer = std::exchange(other.occludedBuffer, 0);
+    readbackBuffers = std::exchange(other.readbackBuffers, {});
+    capacity = std::exchange(other.capacity, 0);
+    commandsCount = std::exchange(other.commandsCount, 0);
+    writtenRegionsMask = std::exchange(other.writtenRegionsMask, 0);
+    return *this;
+}
+
+void GpuCullingBuffers::SetCommands(const std::vector<DrawElementsIndirectCommand>& commands)
+{
+    if (commandBuffer == 0)
+        glGenBuffers(1, &commandBuffer);
+
+    commandsCount = static_cast<uint32_t>(commands.size());
+    auto CommandsSize = static_cast<GLsizeiptr>(commands.size() * sizeof(DrawElementsIndirectCommand));
+    glBindBuffer(GL_COPY_WRITE_BUFFER, commandBuffer);
+    glBufferData(GL_COPY_WRITE_BUFFER, CommandsSize * PhasesCount, nullptr, GL_DYNAMIC_COPY);
+    for (uint32_t Phase = 0; Phase < PhasesCount; ++Phase)
+        glBufferSubData(GL_COPY_WRITE_BUFFER, CommandsSize * Phase, CommandsSize, commands.data());
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+}
+
+void GpuCullingBuffers::Resize(uint32_t newCapacity)
+{
+    if (visibleBuffer == 0)
+    {
+        glGenBuffers(1, &visibleBuffer);
+        glGenBuffers(1, &counterBuffer);
+        glGenBuffers(1, &occludedBuffer);
+        glGenBuffers(static_cast<GLsizei>(readbackBuffers.size()), readbackBuffers.data());
+
+        glBindBuffer(GL_COPY_WRITE_BUFFER, counterBuffer);
+        glBufferData(GL_COPY_WRITE_BUFFER, CountersSize, nullptr, GL_DYNAMIC_COPY);
+        for (GLuint Buffer : readbackBuffers)
+        {
+            glBindBuffer(GL_COPY_WRITE_BUFFER, Buffer);
+            glBufferData(GL_COPY_WRITE_BUFFER, CountersSize, nullptr, GL_STREAM_READ);
+        }
+    }
+
+    capacity = newCapacity;
+    glBindBuffer(GL_COPY_WRITE_BUFFER, visibleBuffer);
+    glBufferData(GL_COPY_WRITE_BUFFER,
+                 static_cast<GLsizeiptr>(capacity) * PhasesCount * MeshSimplifier::MaxLodsCount * sizeof(GLuint),
+                 nullptr, GL_DYNAMIC_COPY);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, occludedBuffer);
+    glBufferData(GL_COPY_WRITE_BUFFER, static_cast<GLsizeiptr>(capacity) * sizeof(GLuint), nullptr, GL_DYNAMIC_COPY);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+}
+
+GLuint GpuCullingBuffers::GetVisibleBuffer() const
+{
+    return visibleBuffer;
+}
+
+GLuint GpuCullingBuffers::GetCommandBuffer() const
+{
+    return commandBuffer;
+}
+
+uint32_t GpuCullingBuffers::GetCapacity() const
+{
+    return capacity;
+}
+
+GLuint GpuCullingBuffers::GetFirstVisible(CullingPhase phase, uint32_t lod) const
+{
+    return (static_cast<uint32_t>(phase) * MeshSimplifier::MaxLodsCount + lod) * capacity;
+}
+
+GLintptr GpuCullingBuffers::GetCommandsOffset(CullingPhase phase) const
+{
+    return static_cast<GLintptr>(static_cast<uint32_t>(phase) * commandsCount * sizeof(DrawElementsIndirectCommand));
+}
+
+bool GpuCullingBuffers::ReadCounters(uint32_t region, GpuCullingCounters& countersOut) const
+{
+    if (!(writtenRegionsMask & (1 << region)))
+        return false;
+
+    std::array<GLuint, CountersCount> Counters{};
+    glBindBuffer(GL_COPY_READ_BUFFER, readbackBuffers[region]);
+    glGetBufferSubData(GL_COPY_READ_BUFFER, 0, CountersSize, Counters.data());
+    glBindBuffer(GL_COPY_READ_BUFFER, 0);
+
+    for (uint32_t Lod = 0; Lod < MeshSimplifier::MaxLodsCount; ++Lod)
+    {
+        countersOut.lodInstancesCount[Lod] = 0;
+        for (uint32_t Phase = 0; Phase < PhasesCount; ++Phase)
+            countersOut.lodInstancesCount[Lod] += Counters[Phase * MeshSimplifier::MaxLodsCount + Lod];
+    }
+    countersOut.retestedCount = Counters[RetestedCounter];
+    countersOut.occludedCount = Counters[OccludedCounter];
+    return true;
+}
+
+void GpuCullingBuffers::Release()
+{
+    for (GLuint* Buffer : {&visibleBuffer, &commandBuffer, &counterBuffer, &occludedBuffer})
+    {
+        if (*Buffer != 0)
+            glDeleteBuffers(1, Buffer);
+        *Buffer = 0;
+    }
+    if (readbackBuffers[0] != 0)
+        glDeleteBuffers(static_cast<GLsizei>(readbackBuffers.size()), readbackBuffers.data());
+    readbackBuffers = {};
+    capacity = 0;
+    commandsCount = 0;
+    writtenRegionsMask = 0;
+}
+
+bool GpuCulling::Initialize()
+{
+    if (isInitialized)
+        return isSupported;
+
+    isInitialized = true;
+    cullShader = AssetRegistry::GetInstance().GetComputeShader("res/shaders/cull_instances.comp");
+    commandsShader = AssetRegistry::GetInstance().GetComputeShader("res/shaders/write_draw_commands.comp");
+    isSupported = cullShader->IsLinked() && commandsShader->IsLinked();
+    if (!isSupported)
+    {
+        SPDLOG_WARN("Culling compute shaders failed to link, instances are culled on the CPU");
+        return false;
+    }
+
+    instancesCountUniform = cullShader->GetUniform<GLuint>("InstancesCount");
+    visibleCapacityUniform = cullShader->GetUniform<GLuint>("VisibleCapacity");
+    modelBoundsUniform = cullShader->GetUniform<glm::vec4>("ModelBounds");
+    lodsCountUniform = cullShader->GetUniform<GLuint>("LodsCount");
+    for (size_t i = 0; i < frustumPlaneUniforms.size(); ++i)
+        frustumPlaneUniforms[i] = cullShader->GetUniform<glm::vec4>("FrustumPlanes[" + std::to_string(i) + "]");
+    isCullingEnabledUniform = cullShader->GetUniform<bool>("IsCullingEnabled");
+    lodViewUniform = cullShader->GetUniform<glm::vec4>("LodView");
+    lodScreenSizesUniform = cullShader->GetUniform<glm::vec4>("LodScreenSizes");
+    phaseUniform = cullShader->GetUniform<GLuint>("Phase");
+    isOcclusionEnabledUniform = cullShader->GetUniform<bool>("IsOcclusionEnabled");
+    occlusionViewProjectionUniform = cullShader->GetUniform<glm::mat4>("OcclusionViewProjection");
+    pyramidSizeUniform = cullShader->GetUniform<glm::vec2>("PyramidSize");
+    pyramidLevelsCountUniform = cullShader->GetUniform<int>("PyramidLevelsCount");
+
+    cullShader->Activate();
+    cullShader->GetUniform<int>("DepthPyramid").Set(DepthPyramid::TextureUnit);
+    isOcclusionEnabledUniform.Set(false);
+
+    commandsCountUniform = commandsShader->GetUniform<GLuint>("CommandsCount");
+    commandsPhaseUniform = commandsShader->GetUniform<GLuint>("Phase");
+    lodBoundariesCountUniform = commandsShader->GetUniform<GLuint>("LodBoundariesCount");
+    for (size_t i = 0; i < lodFirstCommandUniforms.size(); ++i)
+    {
+        lodFirstCommandUniforms[i] = commandsShader->GetUniform<GLuint>(
+                "LodFirstCommands[" + std::to_string(i) + "]");
+    }
+
+    return true;
+}
+
+void GpuCulling::Shutdown()
+{
+    cullShader.reset();
+    commandsShader.reset();
+    isInitialized = false;
+    isSupported = false;
+}
+
+void GpuCulling::SetView(const View& view, const float (&lodScreenSizes)[MeshSimplifier::MaxLodsCount - 1])
+{
+    // Uniforms stay with the program, the draws in between use other programs
+    cullShader->Activate();
+    for (size_t i = 0; i < frustumPlaneUniforms.size(); ++i)
+        frustumPlaneUniforms[i].Set(view.frustum.planes[i]);
+    isCullingEnabledUniform.Set(view.isCullingEnabled);
+    lodViewUniform.Set(glm::vec4(view.position, view.projectionScale));
+    lodScreenSizesUniform.Set(glm::vec4(lodScreenSizes[0], lodScreenSizes[1], lodScreenSizes[2], 0.f));
+    maxLodsCount = std::max(view.maxLodsCount, 1u);
+}
+
+void GpuCulling::SetOcclusion(const DepthPyramid* pyramid)
+{
+    cullShader->Activate();
+    isOcclusionEnabledUniform.Set(pyramid != nullptr);
+    if (!pyramid)
+        return;
+
+    occlusionViewProjectionUniform.Set(pyramid->GetViewProjection());
+    pyramidSizeUniform.Set(glm::vec2(pyramid->GetSize()));
+    pyramidLevelsCountUniform.Set(static_cast<int>(pyramid->GetLevelsCount()));
+    pyramid->Bind();
+}
+
+void GpuCulling::Cull(const Batch& batch, GpuCullingBuffers& buffers, CullingPhase phase, uint32_t region)
+{
+    if (batch.instancesCount == 0 || buffers.commandsCount == 0)
+        return;
+
+    // The late phase counts on top of the early one
+    if (phase == CullingPhase::Early)
+    {
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, buffers.counterBuffer);
+        glClearBufferData(GL_SHADER_STORAGE_BUFFER, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, nullptr);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+    }
+
+    // The model shaders read the instances and visible slots from the same bindings
+    glBindBufferRange(GL_SHADER_STORAGE_BUFFER, ModelRenderer::InstancesBinding, batch.instancesBuffer,
+                      batch.instancesOffset, batch.instancesSize);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, ModelRenderer::VisibleInstancesBinding, buffers.visibleBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, CountersBinding, buffers.counterBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, OccludedBinding, buffers.occludedBuffer);
+
+    cullShader->Activate();
+    phaseUniform.Set(static_cast<GLuint>(phase));
+    instancesCountUniform.Set(batch.instancesCount);
+    visibleCapacityUniform.Set(buffers.capacity);
+    modelBoundsUniform.Set(glm::vec4(batch.bounds.center, batch.bounds.radius));
+    lodsCountUniform.Set(std::min(batch.lodsCount, maxLodsCount));
+    glDispatchCompute(GetGroupsCount(batch.instancesCount), 1, 1);
+
+    // Counters are complete once every instance was culled
+    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, CommandsBinding, buffers.commandBuffer);
+    commandsShader->Activate();
+    commandsCountUniform.Set(buffers.commandsCount);
+    commandsPhaseUniform.Set(static_cast<GLuint>(phase));
+    lodBoundariesCountUniform.Set(batch.lodsCount - 1);
+    for (uint32_t i = 0; i + 1 < batch.lodsCount; ++i)
+        lodFirstCommandUniforms[i].Set(batch.lodFirstCommands[i + 1]);
+    glDispatchCompute(GetGroupsCount(buffers.commandsCount), 1, 1);
+
+    // The draws read the commands as indirect arguments and the visible slots as storage, the copy reads counters
+    glMemoryBarrier(GL_COMMAND_BARRIER_BIT | GL_SHADER_STORAGE_BARRIER_BIT | GL_BUFFER_UPDATE_BARRIER_BIT);
+
+    glBindBuffer(GL_COPY_READ_BUFFER, buffers.counterBuffer);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, buffers.readbackBuffers[region]);
+    glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, CountersSize);
+    glBindBuffer(GL_COPY_READ_BUFFER, 0);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    buffers.writtenRegionsMask |= 1 << region;
+}
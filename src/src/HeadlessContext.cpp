@@ -0,0 +1,160 @@
+#include "HeadlessContext.h"
+
+#include <glad/glad.h>
+
+#include "LoggingMacros.h"
+#include "PersistentBuffer.h"
+
+#ifdef HOUSING_ESTATE_EGL
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+
+#ifndef EGL_PLATFORM_SURFACELESS_MESA
+#define EGL_PLATFORM_SURFACELESS_MESA 0x31DD
+#endif
+
+namespace
+{
+    void* GetProcAddress(const char* name)
+    {
+        return reinterpret_cast<void*>(eglGetProcAddress(name));
+    }
+}
+#else
+#include <GLFW/glfw3.h>
+#endif
+
+HeadlessContext::~HeadlessContext()
+{
+    Destroy();
+}
+
+#ifdef HOUSING_ESTATE_EGL
+bool HeadlessContext::Create()
+{
+    // The surfaceless platform needs neither X11 nor a GPU, fall back to the default display without it
+    auto GetPlatformDisplay = reinterpret_cast<PFNEGLGETPLATFORMDISPLAYEXTPROC>(
+            eglGetProcAddress("eglGetPlatformDisplayEXT"));
+    EGLDisplay Display = EGL_NO_DISPLAY;
+    if (GetPlatformDisplay)
+        Display = GetPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+    if (Display == EGL_NO_DISPLAY)
+        Display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+
+    EGLint MajorVersion, MinorVersion;
+    if (Display == EGL_NO_DISPLAY || !eglInitialize(Display, &MajorVersion, &MinorVersion))
+    {
+        SPDLOG_ERROR("Failed to initialize EGL display");
+        return false;
+    }
+    display = Display;
+
+    if (!eglBindAPI(EGL_OPENGL_API))
+    {
+        SPDLOG_ERROR("EGL does not support desktop OpenGL");
+        return false;
+    }
+
+    const EGLint ConfigAttributes[] = {
+            EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+            EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+            EGL_RED_SIZE, 8,
+            EGL_GREEN_SIZE, 8,
+            EGL_BLUE_SIZE, 8,
+            EGL_DEPTH_SIZE, 24,
+            EGL_NONE
+    };
+    EGLConfig Config;
+    EGLint ConfigsCount = 0;
+    if (!eglChooseConfig(Display, ConfigAttributes, &Config, 1, &ConfigsCount) || ConfigsCount == 0)
+    {
+        SPDLOG_ERROR("No matching EGL config");
+        return false;
+    }
+
+    const EGLint ContextAttributes[] = {
+            EGL_CONTEXT_MAJOR_VERSION, 4,
+            EGL_CONTEXT_MINOR_VERSION, 3,
+            EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+            EGL_NONE
+    };
+    EGLContext Context = eglCreateContext(Display, Config, EGL_NO_CONTEXT, ContextAttributes);
+    if (Context == EGL_NO_CONTEXT)
+    {
+        SPDLOG_ERROR("Failed to create an OpenGL 4.3 EGL context");
+        return false;
+    }
+    context = Context;
+
+    // Requires EGL_KHR_surfaceless_context, all drawing goes to framebuffer objects
+    if (!eglMakeCurrent(Display, EGL_NO_SURFACE, EGL_NO_SURFACE, Context))
+    {
+        SPDLOG_ERROR("Failed to make the surfaceless EGL context current");
+        return false;
+    }
+
+    if (!gladLoadGLLoader(GetProcAddress))
+    {
+        SPDLOG_ERROR("Failed to initialize GLAD!");
+        return false;
+    }
+    PersistentBuffer::LoadBufferStorage(GetProcAddress);
+    return true;
+}
+
+void HeadlessContext::Destroy()
+{
+    if (!display)
+        return;
+
+    eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+    if (context)
+        eglDestroyContext(display, context);
+    eglTerminate(display);
+
+    context = nullptr;
+    display = nullptr;
+}
+#else
+bool HeadlessContext::Create()
+{
+    if (!glfwInit())
+        return false;
+
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+    glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
+    glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+
+    window = glfwCreateWindow(1, 1, "Housing Estate", nullptr, nullptr);
+    if (!window)
+    {
+        SPDLOG_ERROR("Failed to create hidden OpenGL Window");
+        glfwTerminate();
+        return false;
+    }
+    glfwMakeContextCurrent(window);
+
+    if (!gladLoadGLLoader((GLADloadproc) glfwGetProcAddress))
+    {
+        SPDLOG_ERROR("Failed to initialize GLAD!");
+        glfwDestroyWindow(window);
+        window = nullptr;
+        glfwTerminate();
+        return false;
+    }
+    PersistentBuffer::LoadBufferStorage((GLADloadproc) glfwGetProcAddress);
+    return true;
+}
+
+void HeadlessContext::Destroy()
+{
+    if (!window)
+        return;
+
+    glfwDestroyWindow(window);
+    glfwTerminate();
+    window = nullptr;
+}
+#endif
@@ -0,0 +1,83 @@
+#include "InstanceData.h"
+
+#include <cmath>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define INSTANCE_DATA_SSE
+#include <emmintrin.h>
+#endif
+
+namespace
+{
+    constexpr float MinDeterminant = 1e-20f;
+
+#if defined(INSTANCE_DATA_SSE)
+    // Lanes are x, y, z, w with w ignored by the cross products and forced to 0 in the result
+    __m128 Cross(__m128 u, __m128 v)
+    {
+        __m128 UYZX = _mm_shuffle_ps(u, u, _MM_SHUFFLE(3, 0, 2, 1));
+        __m128 VYZX = _mm_shuffle_ps(v, v, _MM_SHUFFLE(3, 0, 2, 1));
+        __m128 Result = _mm_sub_ps(_mm_mul_ps(u, VYZX), _mm_mul_ps(UYZX, v));
+        return _mm_shuffle_ps(Result, Result, _MM_SHUFFLE(3, 0, 2, 1));
+    }
+
+    __m128 Dot3(__m128 u, __m128 v)
+    {
+        __m128 Product = _mm_mul_ps(u, v);
+        __m128 Y = _mm_shuffle_ps(Product, Product, _MM_SHUFFLE(1, 1, 1, 1));
+        __m128 Z = _mm_shuffle_ps(Product, Product, _MM_SHUFFLE(2, 2, 2, 2));
+        __m128 X = _mm_shuffle_ps(Product, Product, _MM_SHUFFLE(0, 0, 0, 0));
+        return _mm_add_ps(_mm_add_ps(X, Y), Z);
+    }
+#endif
+}
+
+void InstanceData::ComputeNormalMatricesScalar(GpuInstance* instances, size_t count)
+{
+    for (size_t i = 0; i < count; ++i)
+    {
+        GpuInstance& Instance = instances[i];
+        glm::vec3 A(Instance.transform[0]), B(Instance.transform[1]), C(Instance.transform[2]);
+
+        glm::vec3 BC = glm::cross(B, C), CA = glm::cross(C, A), AB = glm::cross(A, B);
+        float Determinant = glm::dot(A, BC);
+        float Scale = std::abs(Determinant) > MinDeterminant ? 1.f / Determinant : 1.f;
+
+        Instance.normalMatrix[0] = glm::vec4(BC * Scale, 0.f);
+        Instance.normalMatrix[1] = glm::vec4(CA * Scale, 0.f);
+        Instance.normalMatrix[2] = glm::vec4(AB * Scale, 0.f);
+    }
+}
+
+void InstanceData::ComputeNormalMatrices(GpuInstance* instances, size_t count)
+{
+#if defined(INSTANCE_DATA_SSE)
+    const __m128 WMask = _mm_castsi128_ps(_mm_set_epi32(0, -1, -1, -1));
+    const __m128 One = _mm_set1_ps(1.f);
+    const __m128 MinDeterminantVector = _mm_set1_ps(MinDeterminant);
+    const __m128 AbsMask = _mm_castsi128_ps(_mm_set1_epi32(0x7FFFFFFF));
+
+    for (size_t i = 0; i < count; ++i)
+    {
+        GpuInstance& Instance = instances[i];
+        __m128 A = _mm_and_ps(_mm_loadu_ps(&Instance.transform[0][0]), WMask);
+        __m128 B = _mm_and_ps(_mm_loadu_ps(&Instance.transform[1][0]), WMask);
+        __m128 C = _mm_and_ps(_mm_loadu_ps(&Instance.transform[2][0]), WMask);
+
+        __m128 BC = Cross(B, C);
+        __m128 CA = Cross(C, A);
+        __m128 AB = Cross(A, B);
+
+        // Division only where the determinant is usable, the rest keeps the cofactors
+        __m128 Determinant = Dot3(A, BC);
+        __m128 IsRegular = _mm_cmpgt_ps(_mm_and_ps(Determinant, AbsMask), MinDeterminantVector);
+        __m128 Scale = _mm_or_ps(_mm_and_ps(IsRegular, _mm_div_ps(One, Determinant)), _mm_andnot_ps(IsRegular, One));
+
+        _mm_storeu_ps(&Instance.normalMatrix[0][0], _mm_mul_ps(BC, Scale));
+        _mm_storeu_ps(&Instance.normalMatrix[1][0], _mm_mul_ps(CA, Scale));
+        _mm_storeu_ps(&Instance.normalMatrix[2][0], _mm_mul_ps(AB, Scale));
+    }
+#else
+    ComputeNormalMatricesScalar(instances, count);
+#endif
+}
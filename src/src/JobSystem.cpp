@@ -0,0 +1,152 @@
+#include "JobSystem.h"
+
+namespace
+{
+    thread_local const JobSystem* currentJobSystem = nullptr;
+    thread_local uint32_t currentQueueIndex = 0;
+}
+
+bool JobSystem::Counter::IsDone() const
+{
+    return pendingJobs.load(std::memory_order_acquire) == 0;
+}
+
+JobSystem::JobSystem(uint32_t workerCount)
+{
+    // The last queue is shared by every thread outside of the pool
+    for (uint32_t i = 0; i < workerCount + 1; ++i)
+    {
+        queues.push_back(std::make_unique<WorkQueue>());
+    }
+
+    workers.reserve(workerCount);
+    for (uint32_t i = 0; i < workerCount; ++i)
+    {
+        workers.emplace_back(&JobSystem::WorkerLoop, this, i);
+    }
+}
+
+JobSystem::~JobSystem()
+{
+    {
+        std::lock_guard<std::mutex> Lock(sleepMutex);
+        isRunning = false;
+    }
+    wakeCondition.notify_all();
+
+    for (std::thread& Worker : workers)
+    {
+        Worker.join();
+    }
+}
+
+uint32_t JobSystem::DefaultWorkerCount()
+{
+    uint32_t HardwareThreads = std::thread::hardware_concurrency();
+    return HardwareThreads > 1 ? HardwareThreads - 1 : 0;
+}
+
+void JobSystem::Schedule(Counter& counter, Job job)
+{
+    counter.pendingJobs.fetch_add(1, std::memory_order_relaxed);
+
+    WorkQueue& Queue = *queues[GetLocalQueueIndex()];
+    {
+        std::lock_guard<std::mutex> Lock(Queue.mutex);
+        queuedJobsCount.fetch_add(1, std::memory_order_release);
+        Queue.jobs.push_back({std::move(job), &counter});
+    }
+
+    // Taking the lock orders this notify after a worker that is about to sleep has checked its predicate
+    {
+        std::lock_guard<std::mutex> Lock(sleepMutex);
+    }
+    wakeCondition.notify_one();
+}
+
+void JobSystem::Wait(Counter& counter)
+{
+    uint32_t QueueIndex = GetLocalQueueIndex();
+    while (!counter.IsDone())
+    {
+        if (!TryRunJob(QueueIndex))
+            std::this_thread::yield();
+    }
+}
+
+uint32_t JobSystem::GetWorkerCount() const
+{
+    return static_cast<uint32_t>(workers.size());
+}
+
+bool JobSystem::IsWorkerThread() const
+{
+    return currentJobSystem == this;
+}
+
+uint32_t JobSystem::GetLocalQueueIndex() const
+{
+    return IsWorkerThread() ? currentQueueIndex : static_cast<uint32_t>(workers.size());
+}
+
+void JobSystem::WorkerLoop(uint32_t queueIndex)
+{
+    currentJobSystem = this;
+    currentQueueIndex = queueIndex;
+
+    while (isRunning)
+    {
+        if (TryRunJob(queueIndex))
+            continue;
+
+        std::unique_lock<std::mutex> Lock(sleepMutex);
+        wakeCondition.wait(Lock, [this]()
+        {
+            return !isRunning || queuedJobsCount.load(std::memory_order_acquire) > 0;
+        });
+    }
+}
+
+bool JobSystem::TryRunJob(uint32_t queueIndex)
+{
+    QueuedJob Job;
+    if (!TryPopJob(queueIndex, Job))
+        return false;
+
+    Job.function();
+    Job.counter->pendingJobs.fetch_sub(1, std::memory_order_release);
+    return true;
+}
+
+bool JobSystem::TryPopJob(uint32_t queueIndex, QueuedJob& jobOut)
+{
+    // Own queue is used as a stack to stay cache warm
+    {
+        WorkQueue& Queue = *queues[queueIndex];
+        std::lock_guard<std::mutex> Lock(Queue.mutex);
+        if (!Queue.jobs.empty())
+        {
+            jobOut = std::move(Queue.jobs.back());
+            Queue.jobs.pop_back();
+            queuedJobsCount.fetch_sub(1, std::memory_order_relaxed);
+            return true;
+        }
+    }
+
+    // Steal the oldest, usually the biggest, job from somebody else
+    auto QueuesCount = static_cast<uint32_t>(queues.size());
+    for (uint32_t i = 1; i < QueuesCount; ++i)
+    {
+        WorkQueue& Queue = *queues[(queueIndex + i) % QueuesCount];
+        std::lock_guard<std::mutex> Lock(Queue.mutex);
+        if (!Queue.jobs.empty())
+        {
+            jobOut = std::move(Queue.jobs.front());
+            Queue.jobs.pop_front();
+            queuedJobsCount.fetch_sub(1, std::memory_order_relaxed);
+            return true;
+        }
+    }
+
+    return false;
+}
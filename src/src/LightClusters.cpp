@@ -0,0 +1,264 @@
+#include "LightClusters.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "JobSystem.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define LIGHT_CLUSTERS_SSE
+#include <emmintrin.h>
+#endif
+
+namespace
+{
+    bool IsSphereInsideCone(const glm::vec3& Center, float Radius, const glm::vec3& Apex, const glm::vec3& Direction,
+                            float Range, float CosAngle, float SinAngle)
+    {
+        // "Cull that cone", Bart Wronski 2017
+        glm::vec3 ToCenter = Center - Apex;
+        float DistanceSquared = glm::dot(ToCenter, ToCenter);
+        float AxisDistance = glm::dot(ToCenter, Direction);
+        float ClosestDistance = CosAngle * std::sqrt(std::max(DistanceSquared - AxisDistance * AxisDistance, 0.f)) -
+                                AxisDistance * SinAngle;
+
+        bool IsOutsideAngle = ClosestDistance > Radius;
+        bool IsInFront = AxisDistance > Radius + Range;
+        bool IsBehind = AxisDistance < -Radius;
+        return !(IsOutsideAngle || IsInFront || IsBehind);
+    }
+
+    bool IsSphereInsideBox(const AABB& Box, float X, float Y, float Z, float Radius)
+    {
+        float DX = std::max({Box.min.x - X, X - Box.max.x, 0.f});
+        float DY = std::max({Box.min.y - Y, Y - Box.max.y, 0.f});
+        float DZ = std::max({Box.min.z - Z, Z - Box.max.z, 0.f});
+        return DX * DX + DY * DY + DZ * DZ <= Radius * Radius;
+    }
+}
+
+LightClusters::LightClusters()
+: slices(GridZ), clusters(ClustersCount)
+{
+    glGenBuffers(1, &clustersBuffer);
+    glGenBuffers(1, &lightIndicesBuffer);
+}
+
+LightClusters::~LightClusters()
+{
+    glDeleteBuffers(1, &clustersBuffer);
+    glDeleteBuffers(1, &lightIndicesBuffer);
+}
+
+void LightClusters::Build(std::span<const GpuLight> Lights, const glm::mat4& View, const glm::mat4& Projection,
+                          float Near, float Far, JobSystem* Jobs)
+{
+    UpdateClusterBounds(glm::vec2(Projection[0][0], Projection[1][1]), Near, Far);
+
+    viewLights.resize(Lights.size());
+    for (size_t i = 0; i < Lights.size(); ++i)
+    {
+        const GpuLight& Light = Lights[i];
+        ViewLight& Bounds = viewLights[i];
+        Bounds.center = glm::vec3(View * glm::vec4(Light.position, 1.f));
+        Bounds.radius = Light.range;
+        Bounds.isSpot = Light.type == LightType::Spot;
+        if (Bounds.isSpot)
+        {
+            Bounds.direction = glm::normalize(glm::vec3(View * glm::vec4(Light.direction, 0.f)));
+            Bounds.cosAngle = Light.cosOuterCutOff;
+            Bounds.sinAngle = std::sqrt(std::max(1.f - Light.cosOuterCutOff * Light.cosOuterCutOff, 0.f));
+        }
+    }
+
+    if (Jobs)
+    {
+        Jobs->ParallelFor(0, GridZ, 1, [this](uint32_t Begin, uint32_t End)
+        {
+            for (uint32_t Slice = Begin; Slice < End; ++Slice)
+                AssignSlice(Slice);
+        });
+    }
+    else
+    {
+        for (uint32_t Slice = 0; Slice < GridZ; ++Slice)
+            AssignSlice(Slice);
+    }
+
+    // Slices are concatenated in cluster order, the offsets are only known once all of them are done
+    stats = LightClusterStats();
+    stats.lightsCount = static_cast<uint32_t>(Lights.size());
+    lightIndices.clear();
+    for (uint32_t Slice = 0; Slice < GridZ; ++Slice)
+    {
+        const SliceLights& Current = slices[Slice];
+        uint32_t ClusterOffset = static_cast<uint32_t>(lightIndices.size());
+        for (uint32_t Tile = 0; Tile < GridX * GridY; ++Tile)
+        {
+            uint32_t Count = Current.clusterCounts[Tile];
+            clusters[Slice * GridX * GridY + Tile] = {ClusterOffset, Count};
+            ClusterOffset += Count;
+
+            stats.occupiedClustersCount += Count > 0 ? 1 : 0;
+            stats.maxClusterLightsCount = std::max(stats.maxClusterLightsCount, Count);
+        }
+        lightIndices.insert(lightIndices.end(), Current.indices.begin(), Current.indices.end());
+    }
+    stats.indicesCount = static_cast<uint32_t>(lightIndices.size());
+}
+
+void LightClusters::AssignSlice(uint32_t Slice)
+{
+    SliceLights& Current = slices[Slice];
+    Current.centersX.clear();
+    Current.centersY.clear();
+    Current.centersZ.clear();
+    Current.radii.clear();
+    Current.lights.clear();
+    Current.indices.clear();
+    Current.clusterCounts.assign(GridX * GridY, 0);
+
+    // Lights reaching the depth range of the slice, the camera looks down -Z
+    float SliceNear = sliceDepths[Slice];
+    float SliceFar = sliceDepths[Slice + 1];
+    for (uint32_t i = 0; i < viewLights.size(); ++i)
+    {
+        const ViewLight& Light = viewLights[i];
+        float Depth = -Light.center.z;
+        if (Light.radius <= 0.f || Depth + Light.radius < SliceNear || Depth - Light.radius > SliceFar)
+            continue;
+
+        Current.centersX.push_back(Light.center.x);
+        Current.centersY.push_back(Light.center.y);
+        Current.centersZ.push_back(Light.center.z);
+        Current.radii.push_back(Light.radius);
+        Current.lights.push_back(i);
+    }
+
+    auto CandidatesCount = static_cast<uint32_t>(Current.lights.size());
+    if (CandidatesCount == 0)
+        return;
+
+    for (uint32_t Tile = 0; Tile < GridX * GridY; ++Tile)
+    {
+        const AABB& Box = clusterBounds[Slice * GridX * GridY + Tile];
+        glm::vec3 BoxCenter = Box.GetCenter();
+        float BoxRadius = glm::length(Box.GetExtents());
+        auto FirstIndex = static_cast<uint32_t>(Current.indices.size());
+
+        auto AddCandidate = [&](uint32_t Candidate)
+        {
+            uint32_t LightIndex = Current.lights[Candidate];
+            const ViewLight& Light = viewLights[LightIndex];
+            if (Light.isSpot && !IsSphereInsideCone(BoxCenter, BoxRadius, Light.center, Light.direction, Light.radius,
+                                                     Light.cosAngle, Light.sinAngle))
+                return;
+
+            Current.indices.push_back(LightIndex);
+        };
+
+        uint32_t i = 0;
+#if defined(LIGHT_CLUSTERS_SSE)
+        __m128 MinX = _mm_set1_ps(Box.min.x), MinY = _mm_set1_ps(Box.min.y), MinZ = _mm_set1_ps(Box.min.z);
+        __m128 MaxX = _mm_set1_ps(Box.max.x), MaxY = _mm_set1_ps(Box.max.y), MaxZ = _mm_set1_ps(Box.max.z);
+        __m128 Zero = _mm_setzero_ps();
+        for (; i + 4 <= CandidatesCount; i += 4)
+        {
+            __m128 X = _mm_loadu_ps(&Current.centersX[i]);
+            __m128 Y = _mm_loadu_ps(&Current.centersY[i]);
+            __m128 Z = _mm_loadu_ps(&Current.centersZ[i]);
+            __m128 Radius = _mm_loadu_ps(&Current.radii[i]);
+
+            // Distance from the sphere center to the box along every axis, zero inside of it
+            __m128 DX = _mm_max_ps(_mm_max_ps(_mm_sub_ps(MinX, X), _mm_sub_ps(X, MaxX)), Zero);
+            __m128 DY = _mm_max_ps(_mm_max_ps(_mm_sub_ps(MinY, Y), _mm_sub_ps(Y, MaxY)), Zero);
+            __m128 DZ = _mm_max_ps(_mm_max_ps(_mm_sub_ps(MinZ, Z), _mm_sub_ps(Z, MaxZ)), Zero);
+            __m128 DistanceSquared = _mm_add_ps(_mm_add_ps(_mm_mul_ps(DX, DX), _mm_mul_ps(DY, DY)), _mm_mul_ps(DZ, DZ));
+
+            int Mask = _mm_movemask_ps(_mm_cmple_ps(DistanceSquared, _mm_mul_ps(Radius, Radius)));
+            for (uint32_t Lane = 0; Mask != 0; ++Lane, Mask >>= 1)
+            {
+                if (Mask & 1)
+                    AddCandidate(i + Lane);
+            }
+        }
+#endif
+        for (; i < CandidatesCount; ++i)
+        {
+            if (IsSphereInsideBox(Box, Current.centersX[i], Current.centersY[i], Current.centersZ[i],
+                                  Current.radii[i]))
+                AddCandidate(i);
+        }
+
+        Current.clusterCounts[Tile] = static_cast<uint32_t>(Current.indices.size()) - FirstIndex;
+    }
+}
+
+void LightClusters::UpdateClusterBounds(const glm::vec2& ProjectionScale, float Near, float Far)
+{
+    if (ProjectionScale == cachedProjectionScale && Near == cachedNear && Far == cachedFar)
+        return;
+
+    cachedProjectionScale = ProjectionScale;
+    cachedNear = Near;
+    cachedFar = Far;
+
+    sliceDepths.resize(GridZ + 1);
+    for (uint32_t Slice = 0; Slice <= GridZ; ++Slice)
+        sliceDepths[Slice] = Near * std::pow(Far / Near, static_cast<float>(Slice) / GridZ);
+
+    // Corners of a tile at a view depth are its NDC coordinates scaled by the depth over the projection scale
+    clusterBounds.resize(ClustersCount);
+    for (uint32_t Slice = 0; Slice < GridZ; ++Slice)
+    {
+        for (uint32_t Y = 0; Y < GridY; ++Y)
+        {
+            for (uint32_t X = 0; X < GridX; ++X)
+            {
+                glm::vec2 NdcMin(-1.f + 2.f * X / GridX, -1.f + 2.f * Y / GridY);
+                glm::vec2 NdcMax(-1.f + 2.f * (X + 1) / GridX, -1.f + 2.f * (Y + 1) / GridY);
+
+                AABB Box;
+                for (float Depth : {sliceDepths[Slice], sliceDepths[Slice + 1]})
+                {
+                    Box.Extend(glm::vec3(NdcMin * Depth / ProjectionScale, -Depth));
+                    Box.Extend(glm::vec3(NdcMax * Depth / ProjectionScale, -Depth));
+                }
+                clusterBounds[(Slice * GridY + Y) * GridX + X] = Box;
+            }
+        }
+    }
+}
+
+void LightClusters::Upload()
+{
+    // Orphaned every frame, the driver hands out fresh storage while the previous frame still reads the old one
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, clustersBuffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, static_cast<GLsizeiptr>(clusters.size() * sizeof(ClusterRange)),
+                 clusters.data(), GL_STREAM_DRAW);
+
+    // Empty buffers can not be bound, there is always at least one index
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, lightIndicesBuffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, static_cast<GLsizeiptr>(std::max<size_t>(lightIndices.size(), 1) *
+                                                                   sizeof(uint32_t)), nullptr, GL_STREAM_DRAW);
+    glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, static_cast<GLsizeiptr>(lightIndices.size() * sizeof(uint32_t)),
+                    lightIndices.data());
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+}
+
+void LightClusters::Bind() const
+{
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, ClustersBinding, clustersBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, LightIndicesBinding, lightIndicesBuffer);
+}
+
+glm::vec2 LightClusters::GetSliceParameters(float Near, float Far)
+{
+    float Scale = static_cast<float>(GridZ) / std::log(Far / Near);
+    return {Scale, -Scale * std::log(Near)};
+}
+
+const LightClusterStats& LightClusters::GetStats() const
+{
+    return stats;
+}
@@ -1,4 +1,11 @@
 #include "Lights.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#include "Camera.h"
+#include "FrameConstants.h"
 #include "Gizmos/Arrow.h"
 #include "Gizmos/SphereGizmo.h"
 
@@ -6,15 +13,7 @@ Lights::Lights()
 {
     InitializeLights();
 
-    glGenBuffers(1, &uboLightData);
-    glBindBuffer(GL_UNIFORM_BUFFER, uboLightData);
-    glBufferData(GL_UNIFORM_BUFFER, 208, nullptr, GL_DYNAMIC_DRAW);
-    glBindBufferBase(GL_UNIFORM_BUFFER, 1, uboLightData);
-    glBindBuffer(GL_UNIFORM_BUFFER, 0);
-
-    UpdateSun();
-    UpdateBulb();
-    UpdateSpotLights();
+    glGenBuffers(1, &lightsBuffer);
 }
 
 void Lights::InitializeLights()
@@ -22,50 +21,132 @@ void Lights::InitializeLights()
     sun.color = glm::vec4(0.f);
     sun.direction = glm::normalize(glm::vec3(-0.5f, -0.5f, -0.5f));
 
+    PointLight bulb;
     bulb.color = glm::vec4(1.f);
     bulb.position = glm::vec3(-2.f, 2.f, -5.f);
     bulb.linear = 0.07f;
     bulb.quadratic = 0.017f;
+    AddPointLight(bulb);
 
-    spotLights[0].color = glm::vec4(0.f);
-    spotLights[0].position = glm::vec3(-5.f, 4.5f, 18.8f);
-    spotLights[0].direction = glm::normalize(glm::vec3(-0.5f, -0.5f, 0.5f));
-    spotLights[0].linear = 0;
-    spotLights[0].quadratic = 0;
-    spotLights[0].cutOff = glm::radians(12.5f);
-    spotLights[0].outerCutOff = glm::radians(17.5f);
+    SpotLight spotLight;
+    spotLight.color = glm::vec4(0.f);
+    spotLight.position = glm::vec3(-5.f, 4.5f, 18.8f);
+    spotLight.direction = glm::normalize(glm::vec3(-0.5f, -0.5f, 0.5f));
+    spotLight.linear = 0;
+    spotLight.quadratic = 0;
+    spotLight.cutOff = glm::radians(12.5f);
+    spotLight.outerCutOff = glm::radians(17.5f);
+    AddSpotLight(spotLight);
 
-    spotLights[1].color = glm::vec4(0.f);
-    spotLights[1].position = glm::vec3(-3.3f, 4.6f, 10.5f);
-    spotLights[1].direction = glm::normalize(glm::vec3(0.5f, -0.5f, 0.5f));
-    spotLights[1].linear = 0;
-    spotLights[1].quadratic = 0.017f;
-    spotLights[1].cutOff = glm::radians(12.5f);
-    spotLights[1].outerCutOff = glm::radians(17.5f);
+    spotLight.position = glm::vec3(-3.3f, 4.6f, 10.5f);
+    spotLight.direction = glm::normalize(glm::vec3(0.5f, -0.5f, 0.5f));
+    spotLight.quadratic = 0.017f;
+    AddSpotLight(spotLight);
 }
 
-void Lights::UpdateSun()
+void Lights::Update(const Camera &camera, JobSystem *jobSystem)
 {
-    glBindBuffer(GL_UNIFORM_BUFFER, uboLightData);
-    glBufferSubData(GL_UNIFORM_BUFFER, 0, 32, &sun);
-    glBindBuffer(GL_UNIFORM_BUFFER, 0);
-}
+    glm::ivec2 Resolution = glm::max(camera.GetResolution(), glm::ivec2(1));
+    glm::mat4 View = camera.GetViewMatrix();
+    glm::mat4 Projection = camera.GetCameraProjectionMatrix(Resolution.x, Resolution.y);
+    bool HasCameraChanged = View != clusteredView || Projection != clusteredProjection;
 
-void Lights::UpdateBulb()
-{
-    glBindBuffer(GL_UNIFORM_BUFFER, uboLightData);
-    glBufferSubData(GL_UNIFORM_BUFFER, 32, 48, &bulb);
-    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    if (areLightsDirty || HasCameraChanged)
+    {
+        if (areLightsDirty)
+            BuildGpuLights();
+
+        clusters.Build(gpuLights, View, Projection, Camera::NearPlane, Camera::FarPlane, jobSystem);
+        clusters.Upload();
+        clusteredView = View;
+        clusteredProjection = Projection;
+    }
+    clusters.Bind();
+
+    if (areLightsDirty)
+    {
+        auto Size = static_cast<GLsizeiptr>(std::max<size_t>(gpuLights.size(), 1) * sizeof(GpuLight));
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, lightsBuffer);
+        if (Size != lightsBufferSize)
+        {
+            glBufferData(GL_SHADER_STORAGE_BUFFER, Size, nullptr, GL_DYNAMIC_DRAW);
+            lightsBufferSize = Size;
+        }
+        glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, static_cast<GLsizeiptr>(gpuLights.size() * sizeof(GpuLight)),
+                        gpuLights.data());
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+        areLightsDirty = false;
+    }
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, LightsBinding, lightsBuffer);
+
+    glm::vec2 SliceParameters = LightClusters::GetSliceParameters(Camera::NearPlane, Camera::FarPlane);
+    GpuLightsBlock Block{};
+    Block.sunColor = sun.color;
+    Block.sunDirection = glm::vec4(sun.direction, 0.f);
+    Block.clusterGrid[0] = LightClusters::GridX;
+    Block.clusterGrid[1] = LightClusters::GridY;
+    Block.clusterGrid[2] = LightClusters::GridZ;
+    Block.clusterGrid[3] = static_cast<uint32_t>(gpuLights.size());
+    Block.clusterParameters = glm::vec4(SliceParameters.x, SliceParameters.y,
+                                        static_cast<float>(Resolution.x) / LightClusters::GridX,
+                                        static_cast<float>(Resolution.y) / LightClusters::GridY);
+
+    FrameConstants::GetInstance().Write(FrameBlock::Lights, 0, &Block, sizeof(GpuLightsBlock));
+
+    bool IsSunVisible = std::max({sun.color.x, sun.color.y, sun.color.z}) * sun.color.w > 0.f;
+    shadows.Update(camera, sun.direction, IsSunVisible);
+    shadows.Bind();
 }
 
-void Lights::UpdateSpotLights()
+void Lights::BuildGpuLights()
 {
-    glBindBuffer(GL_UNIFORM_BUFFER, uboLightData);
-    for (size_t i = 0; i < 2; i++)
+    gpuLights.clear();
+    gpuLights.reserve(pointLights.size() + spotLights.size());
+
+    for (const PointLight &light : pointLights)
     {
-        glBufferSubData(GL_UNIFORM_BUFFER, 80 + i * 64, 64, &spotLights[i]);
+        GpuLight &Light = gpuLights.emplace_back();
+        Light.color = light.color;
+        Light.position = light.position;
+        Light.range = GetLightRange(light.color, light.linear, light.quadratic);
+        Light.direction = glm::vec3(0.f, -1.f, 0.f);
+        Light.linear = light.linear;
+        Light.quadratic = light.quadratic;
+        Light.cosCutOff = -1.f;
+        Light.cosOuterCutOff = -1.f;
+        Light.type = LightType::Point;
     }
-    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+
+    for (const SpotLight &light : spotLights)
+    {
+        GpuLight &Light = gpuLights.emplace_back();
+        Light.color = light.color;
+        Light.position = light.position;
+        Light.range = GetLightRange(light.color, light.linear, light.quadratic);
+        Light.direction = glm::normalize(light.direction);
+        Light.linear = light.linear;
+        Light.quadratic = light.quadratic;
+        Light.cosCutOff = std::cos(light.cutOff);
+        Light.cosOuterCutOff = std::cos(light.outerCutOff);
+        Light.type = LightType::Spot;
+    }
+}
+
+float Lights::GetLightRange(const glm::vec4 &color, float linear, float quadratic)
+{
+    // Solves intensity / (1 + linear * d + quadratic * d^2) = MinLightIntensity for d
+    float Intensity = std::max({color.x, color.y, color.z}) * color.w;
+    float Constant = 1.f - Intensity / MinLightIntensity;
+    if (Constant >= 0.f)
+        return 0.f;
+
+    float Range = Camera::FarPlane;
+    if (quadratic > 0.f)
+        Range = (-linear + std::sqrt(linear * linear - 4.f * quadratic * Constant)) / (2.f * quadratic);
+    else if (linear > 0.f)
+        Range = -Constant / linear;
+
+    return std::min(Range, Camera::FarPlane);
 }
 
 const DirectionalLight &Lights::GetSun() const
@@ -73,53 +154,90 @@ const DirectionalLight &Lights::GetSun() const
     return sun;
 }
 
-const PointLight &Lights::GetBulb() const
+void Lights::SetSun(const DirectionalLight &sun)
 {
-    return bulb;
+    Lights::sun = sun;
 }
 
-const SpotLight &Lights::GetSpotLightOne() const
+uint32_t Lights::AddPointLight(const PointLight &light)
 {
-    return spotLights[0];
+    pointLights.push_back(light);
+    areLightsDirty = true;
+    return static_cast<uint32_t>(pointLights.size() - 1);
 }
 
-const SpotLight &Lights::GetSpotLightTwo() const
+uint32_t Lights::AddSpotLight(const SpotLight &light)
 {
-    return spotLights[1];
+    spotLights.push_back(light);
+    areLightsDirty = true;
+    return static_cast<uint32_t>(spotLights.size() - 1);
 }
 
-void Lights::SetSun(const DirectionalLight &sun)
+void Lights::ClearLocalLights()
 {
-    Lights::sun = sun;
-    UpdateSun();
+    pointLights.clear();
+    spotLights.clear();
+    areLightsDirty = true;
+}
+
+const PointLight &Lights::GetPointLight(uint32_t index) const
+{
+    return pointLights[index];
+}
+
+const SpotLight &Lights::GetSpotLight(uint32_t index) const
+{
+    return spotLights[index];
+}
+
+void Lights::SetPointLight(uint32_t index, const PointLight &light)
+{
+    // Lights are plain floats without padding, so comparing their bytes tells whether anything changed
+    if (std::memcmp(&pointLights[index], &light, sizeof(PointLight)) == 0)
+        return;
+
+    pointLights[index] = light;
+    areLightsDirty = true;
+}
+
+void Lights::SetSpotLight(uint32_t index, const SpotLight &light)
+{
+    if (std::memcmp(&spotLights[index], &light, sizeof(SpotLight)) == 0)
+        return;
+
+    spotLights[index] = light;
+    areLightsDirty = true;
+}
+
+uint32_t Lights::GetPointLightsCount() const
+{
+    return static_cast<uint32_t>(pointLights.size());
 }
 
-void Lights::SetBulb(const PointLight &bulb)
+uint32_t Lights::GetSpotLightsCount() const
 {
-    Lights::bulb = bulb;
-    UpdateBulb();
+    return static_cast<uint32_t>(spotLights.size());
 }
 
-void Lights::SetSpotLightOne(const SpotLight &spotLightOne)
+const LightClusterStats &Lights::GetClusterStats() const
 {
-    spotLights[0] = spotLightOne;
-    UpdateSpotLights();
+    return clusters.GetStats();
 }
 
-void Lights::SetSpotLightTwo(const SpotLight &spotLightTwo)
+ShadowCascades &Lights::GetShadows()
 {
-    spotLights[1] = spotLightTwo;
-    UpdateSpotLights();
+    return shadows;
 }
 
 Lights::~Lights()
 {
-    glDeleteBuffers(1, &uboLightData);
+    glDeleteBuffers(1, &lightsBuffer);
 }
 
 void Lights::DrawGizmos()
 {
-    SphereGizmo::Draw(bulb.position, 1.0f, 24, bulb.color);
+    for (const PointLight &light : pointLights)
+        SphereGizmo::Draw(light.position, 1.0f, 24, light.color);
 }
 
 glm::vec3 Lights::DirectionVector(float pitch, float yaw) {
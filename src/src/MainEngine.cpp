@@ -17,14 +17,36 @@
 #include "Lights.h"
 #include "Gizmos/Gizmo.h"
 #include "Skybox.h"
+#include "PersistentBuffer.h"
+#include "TextureStreamer.h"
+#include "TextureCache.h"
+#include "AssetRegistry.h"
+#include "HeadlessContext.h"
+#include "OffscreenFramebuffer.h"
+#include "CameraPath.h"
+#include "FrameProfiler.h"
+#include "GeometryBuffer.h"
+#include "MaterialSystem.h"
+#include "FrameConstants.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
 
 #include "effolkronium/random.hpp"
 #include "Nodes/FreeCameraNode.h"
+#include "Nodes/ScriptedCameraNode.h"
 
 using Random = effolkronium::random_static;
 
 int32_t MainEngine::Init()
 {
+    initTimePoint = std::chrono::high_resolution_clock::now();
+    Model::SetVertexQuantizationEnabled(options.isVertexQuantizationEnabled);
+
+    if (options.isHeadless)
+        return InitializeHeadless();
+
     glfwSetErrorCallback(MainEngine::GLFWErrorCallback);
     if (!glfwInit())
         return 1;
@@ -35,7 +57,8 @@ int32_t MainEngine::Init()
     glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);  // 3.2+ only
     glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);            // 3.0+ only
 
-    glfwWindowHint(GLFW_SAMPLES, 4);
+    // The window only receives the resolved scene, multisampling happens in the scene framebuffer
+    glfwWindowHint(GLFW_SAMPLES, 0);
 
     if (InitializeWindow() != 0)
         return 1;
@@ -45,6 +68,7 @@ int32_t MainEngine::Init()
         SPDLOG_ERROR("Failed to initialize GLAD!");
         return 1;
     }
+    PersistentBuffer::LoadBufferStorage((GLADloadproc) glfwGetProcAddress);
     SPDLOG_DEBUG("Successfully initialized OpenGL loader!");
 
 
@@ -75,6 +99,30 @@ int32_t MainEngine::InitializeWindow()
     return 0;
 }
 
+int32_t MainEngine::InitializeHeadless()
+{
+    headlessContext = std::make_unique<HeadlessContext>();
+    if (!headlessContext->Create())
+        return 1;
+
+    SPDLOG_DEBUG("Headless rendering on {} ({})", reinterpret_cast<const char*>(glGetString(GL_RENDERER)),
+                 reinterpret_cast<const char*>(glGetString(GL_VERSION)));
+
+    sceneFramebuffer = std::make_unique<OffscreenFramebuffer>(options.resolution);
+    if (!sceneFramebuffer->IsComplete())
+    {
+        SPDLOG_ERROR("Offscreen framebuffer is incomplete");
+        return 1;
+    }
+
+    glEnable(GL_DEPTH_TEST);
+    glEnable(GL_CULL_FACE);
+
+    Gizmo::Initialize();
+
+    return 0;
+}
+
 void MainEngine::GLFWErrorCallback(int error, const char* description)
 {
     SPDLOG_ERROR("GLFW error {}: {}", error, description);
@@ -82,6 +130,9 @@ void MainEngine::GLFWErrorCallback(int error, const char* description)
 
 int32_t MainEngine::MainLoop()
 {
+    if (options.isHeadless)
+        return RunHeadless();
+
     auto startProgramTimePoint = std::chrono::high_resolution_clock::now();
     float previousFrameSeconds = 0;
 
@@ -97,40 +148,230 @@ int32_t MainEngine::MainLoop()
         float deltaSeconds = seconds - previousFrameSeconds;
         previousFrameSeconds = seconds;
 
-        glClearDepth(1.0f);
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        RenderFrame(seconds, deltaSeconds);
+
+        glfwSwapBuffers(window);
+        glfwPollEvents();
+    }
+
+    return 0;
+}
+
+void MainEngine::RenderFrame(float seconds, float deltaSeconds)
+{
+    FrameProfiler& profiler = FrameProfiler::GetInstance();
+    profiler.BeginFrame();
+
+    {
+        ProfileScope scope("TextureStreamer::Update");
+        TextureStreamer::GetInstance().Update();
+        MaterialSystem::GetInstance().Update();
+    }
+
+    // The scene goes into a framebuffer of its own, its depth is what the occlusion culling reads
+    if (!options.isHeadless)
+        UpdateSceneFramebuffer();
+    if (sceneFramebuffer)
+        sceneFramebuffer->Bind();
+    else
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+    glClearDepth(1.0f);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-        // Start the Dear ImGui frame
+    // Start the Dear ImGui frame
+    if (isImGuiInitialized)
+    {
         ImGui_ImplOpenGL3_NewFrame();
         ImGui_ImplGlfw_NewFrame();
         ImGui::NewFrame();
+    }
 
-        int displayX, displayY;
-        glfwMakeContextCurrent(window);
-        glfwGetFramebufferSize(window, &displayX, &displayY);
-        glViewport(0, 0, displayX, displayY);
+    glm::ivec2 display = GetFramebufferSize();
+    glViewport(0, 0, display.x, display.y);
 
-        sceneRoot.Update(this, seconds, deltaSeconds);
-        sceneRoot.CalculateWorldTransform();
+    {
+        ProfileScope scope("Update");
+        sceneRoot.UpdateParallel(jobSystem, this, seconds, deltaSeconds);
+    }
+    {
+        ProfileScope scope("CalculateWorldTransform");
+        sceneRoot.CalculateWorldTransform(&jobSystem);
+    }
+    {
+        ProfileScope scope("Lights::Update");
+        sceneLight->Update(*Camera::GetInstance(), &jobSystem);
+    }
+    {
+        // Camera and lights settle during the updates above, their blocks go to the GPU once before any draw
+        ProfileScope scope("FrameConstants::Flush");
+        Camera::GetInstance()->WriteFrameConstants();
+        FrameConstants::GetInstance().Flush();
+    }
+    {
+        ProfileScope scope("Node::Draw", true);
         sceneRoot.Draw();
-
+    }
+    {
+        ProfileScope scope("ModelRenderer::Draw", true);
         renderer.Draw(this);
+    }
+    {
+        ProfileScope scope("Gizmos", true);
         sceneLight->DrawGizmos();
+        Gizmo::Render();
+    }
+
+    if (skybox)
+    {
+        ProfileScope scope("Skybox", true);
+        skybox->Draw();
+    }
 
-        if (skybox)
-            skybox->Draw();
+    if (sceneFramebuffer && !options.isHeadless)
+    {
+        ProfileScope scope("ResolveScene", true);
+        sceneFramebuffer->BlitToDefault();
+    }
 
+    if (isImGuiInitialized)
+    {
+        ProfileScope scope("ImGui", true);
         UpdateWidget(deltaSeconds);
+        profiler.DrawWidget();
         ImGui::Render();
         ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
+    }
 
-        glfwSwapBuffers(window);
-        glfwPollEvents();
+    profiler.EndFrame();
+}
+
+int32_t MainEngine::RunHeadless()
+{
+    // Textures requested by the scene are resident before the first measured frame
+    TextureStreamer::GetInstance().Flush();
+    TextureStreamer::GetInstance().Update();
+
+    std::chrono::duration<float, std::milli> startupDuration = std::chrono::high_resolution_clock::now() - initTimePoint;
+
+#ifdef DEBUG
+    CheckGLErrors();
+#endif
+
+    if (!options.traceOutputPath.empty())
+        FrameProfiler::GetInstance().StartCapture(options.traceOutputPath, options.framesCount);
+
+    std::vector<float> frameMilliseconds;
+    frameMilliseconds.reserve(options.framesCount);
+
+    for (uint32_t frame = 0; frame < options.framesCount; ++frame)
+    {
+        auto frameStartTimePoint = std::chrono::high_resolution_clock::now();
+
+        RenderFrame(static_cast<float>(frame) * options.fixedDeltaSeconds, options.fixedDeltaSeconds);
+        // Without a swap nothing bounds the frame, wait for the GPU so the timing covers the whole frame
+        glFinish();
+
+        std::chrono::duration<float, std::milli> frameDuration = std::chrono::high_resolution_clock::now() - frameStartTimePoint;
+        frameMilliseconds.push_back(frameDuration.count());
     }
+    FrameProfiler::GetInstance().Flush();
 
+#ifdef DEBUG
+    CheckGLErrors();
+#endif
+
+    WriteHeadlessStats(frameMilliseconds, startupDuration.count());
     return 0;
 }
 
+void MainEngine::WriteHeadlessStats(const std::vector<float>& frameMilliseconds, float startupMilliseconds) const
+{
+    if (frameMilliseconds.empty())
+        return;
+
+    std::vector<float> sorted = frameMilliseconds;
+    std::sort(sorted.begin(), sorted.end());
+
+    auto percentile = [&sorted](float fraction) {
+        size_t index = static_cast<size_t>(fraction * static_cast<float>(sorted.size() - 1) + 0.5f);
+        return sorted[index];
+    };
+
+    float total = 0;
+    for (float milliseconds : sorted)
+        total += milliseconds;
+    float average = total / static_cast<float>(sorted.size());
+
+    std::printf("Renderer: %s\n", reinterpret_cast<const char*>(glGetString(GL_RENDERER)));
+    std::printf("Startup:  %.2f ms\n", startupMilliseconds);
+    std::printf("Frames:   %zu at %dx%d\n", sorted.size(), options.resolution.x, options.resolution.y);
+    std::printf("Average:  %.3f ms (%.1f FPS)\n", average, 1000.f / average);
+    std::printf("Min:      %.3f ms\n", sorted.front());
+    std::printf("P50:      %.3f ms\n", percentile(0.5f));
+    std::printf("P95:      %.3f ms\n", percentile(0.95f));
+    std::printf("P99:      %.3f ms\n", percentile(0.99f));
+    std::printf("Max:      %.3f ms\n", sorted.back());
+
+    const ModelRendererStats& rendererStats = renderer.GetStats();
+    std::printf("Culling:  %s, %u of %u instances visible\n", rendererStats.wasCulledOnGpu ? "GPU" : "CPU",
+                rendererStats.visibleInstancesCount, rendererStats.instancesCount);
+    if (rendererStats.isOcclusionAvailable)
+        std::printf("Occlusion: %u instances retested, %u rejected on the last frame\n",
+                    rendererStats.retestedInstancesCount, rendererStats.occlusionCulledCount);
+    else
+        std::printf("Occlusion: unavailable\n");
+
+    const auto& cascadeStats = sceneLight->GetShadows().GetStats();
+    for (uint32_t i = 0; i < ShadowCascades::CascadesCount; ++i)
+    {
+        std::printf("Cascade %u: %u renders, %u casters, %.3f ms GPU\n", i, cascadeStats[i].renderedFramesCount,
+                    cascadeStats[i].castersCount, cascadeStats[i].gpuMilliseconds);
+    }
+
+    const FrameConstantsStats& constantsStats = FrameConstants::GetInstance().GetStats();
+    std::printf("Frame constants: %zu/%zu B uploaded in %u/%u calls on the last frame\n", constantsStats.uploadedBytes,
+                constantsStats.writtenBytes, constantsStats.uploadCallsCount, constantsStats.writesCount);
+
+    if (options.statsOutputPath.empty())
+        return;
+
+    std::ofstream output(options.statsOutputPath, std::ios::trunc);
+    if (!output)
+    {
+        SPDLOG_ERROR("Failed to write headless stats at path: {}", options.statsOutputPath);
+        return;
+    }
+
+    output << "{\n"
+           << "  \"renderer\": \"" << reinterpret_cast<const char*>(glGetString(GL_RENDERER)) << "\",\n"
+           << "  \"width\": " << options.resolution.x << ",\n"
+           << "  \"height\": " << options.resolution.y << ",\n"
+           << "  \"startupMs\": " << startupMilliseconds << ",\n"
+           << "  \"framesCount\": " << sorted.size() << ",\n"
+           << "  \"averageMs\": " << average << ",\n"
+           << "  \"minMs\": " << sorted.front() << ",\n"
+           << "  \"p50Ms\": " << percentile(0.5f) << ",\n"
+           << "  \"p95Ms\": " << percentile(0.95f) << ",\n"
+           << "  \"p99Ms\": " << percentile(0.99f) << ",\n"
+           << "  \"maxMs\": " << sorted.back() << ",\n"
+           << "  \"gpuCulling\": " << (rendererStats.wasCulledOnGpu ? "true" : "false") << ",\n"
+           << "  \"occlusionRetested\": " << rendererStats.retestedInstancesCount << ",\n"
+           << "  \"occlusionCulled\": " << rendererStats.occlusionCulledCount << ",\n"
+           << "  \"shadowCascades\": [";
+    for (uint32_t i = 0; i < ShadowCascades::CascadesCount; ++i)
+    {
+        output << (i > 0 ? ", " : "") << "{\"renders\": " << cascadeStats[i].renderedFramesCount
+               << ", \"casters\": " << cascadeStats[i].castersCount
+               << ", \"gpuMs\": " << cascadeStats[i].gpuMilliseconds << "}";
+    }
+    output << "],\n"
+           << "  \"frameMs\": [";
+    for (size_t i = 0; i < frameMilliseconds.size(); ++i)
+        output << (i > 0 ? ", " : "") << frameMilliseconds[i];
+    output << "]\n}\n";
+}
+
 void MainEngine::UpdateWidget(float deltaSeconds)
 {
     ImGui::Begin("Hi");
@@ -139,15 +380,99 @@ void MainEngine::UpdateWidget(float deltaSeconds)
 
     ImGui::Text("Framerate: %.3f (%.1f FPS)", deltaSeconds, 1 / deltaSeconds);
 
+    const ModelRendererStats& RendererStats = renderer.GetStats();
+    ImGui::Text("Instances: %u (%u visible)", RendererStats.instancesCount, RendererStats.visibleInstancesCount);
+    ImGui::Text("Instance upload: %u matrices (%zu B)", RendererStats.uploadedMatrices, RendererStats.uploadedBytes);
+    ImGui::Text("Draws: %u meshes in %u multi-draw calls", RendererStats.drawsCount, RendererStats.drawCallsCount);
+
+    const GeometryBufferStats& GeometryStats = GeometryBuffer::GetInstance().GetStats();
+    ImGui::Text("Geometry: %u meshes (%u compact), %zu/%zu B vertices, %u/%u indices", GeometryStats.meshesCount,
+                GeometryStats.compactMeshesCount, GeometryStats.usedVertexBytes, GeometryStats.vertexCapacityBytes,
+                GeometryStats.usedIndices, GeometryStats.indexCapacity);
+
+    bool IsCullingEnabled = renderer.IsCullingEnabled();
+    if (ImGui::Checkbox("Frustum culling", &IsCullingEnabled))
+        renderer.SetCullingEnabled(IsCullingEnabled);
+    ImGui::SameLine();
+    bool IsGpuCullingEnabled = renderer.IsGpuCullingEnabled();
+    if (ImGui::Checkbox("On the GPU", &IsGpuCullingEnabled))
+        renderer.SetGpuCullingEnabled(IsGpuCullingEnabled);
+    if (IsGpuCullingEnabled && !RendererStats.wasCulledOnGpu)
+        ImGui::Text("Compute culling is unavailable, culling on the CPU");
+
+    bool IsOcclusionCullingEnabled = renderer.IsOcclusionCullingEnabled();
+    if (ImGui::Checkbox("Occlusion culling", &IsOcclusionCullingEnabled))
+        renderer.SetOcclusionCullingEnabled(IsOcclusionCullingEnabled);
+    if (RendererStats.wasCulledOnGpu && IsOcclusionCullingEnabled)
+    {
+        if (RendererStats.isOcclusionAvailable)
+            ImGui::Text("Occluded: %u rejected (%u retested)", RendererStats.occlusionCulledCount,
+                        RendererStats.retestedInstancesCount);
+        else
+            ImGui::Text("Occlusion unavailable, there is no scene depth to test against");
+    }
+
+    ImGui::Text("LOD instances: %u / %u / %u / %u", RendererStats.lodInstancesCount[0],
+                RendererStats.lodInstancesCount[1], RendererStats.lodInstancesCount[2],
+                RendererStats.lodInstancesCount[3]);
+    bool IsLodEnabled = renderer.IsLodEnabled();
+    if (ImGui::Checkbox("Mesh LODs", &IsLodEnabled))
+        renderer.SetLodEnabled(IsLodEnabled);
+
+    const TextureStreamerStats& StreamerStats = TextureStreamer::GetInstance().GetStats();
+    ImGui::Text("Textures: %u streamed (%zu B), %u pending", StreamerStats.uploadedTexturesCount,
+                StreamerStats.uploadedBytes, StreamerStats.pendingTexturesCount);
+
+    const TextureCacheStats& CacheStats = TextureCache::GetInstance().GetStats();
+    ImGui::Text("Texture cache: %u resident (%zu B), %.1f%% hit rate", CacheStats.residentTexturesCount,
+                CacheStats.residentBytes, CacheStats.GetHitRate() * 100.f);
+
+    const MaterialSystemStats& MaterialStats = MaterialSystem::GetInstance().GetStats();
+    ImGui::Text("Materials: %u, %u textures in %u arrays (%zu B), %u pending", MaterialStats.materialsCount,
+                MaterialStats.texturesCount, MaterialStats.arraysCount, MaterialStats.residentBytes,
+                MaterialStats.pendingTexturesCount);
+
+    const AssetRegistryStats& AssetStats = AssetRegistry::GetInstance().GetStats();
+    ImGui::Text("Assets: %u models (%u reused), %u shaders (%u reused)", AssetStats.loadedModelsCount,
+                AssetStats.reusedModelsCount, AssetStats.loadedShadersCount, AssetStats.reusedShadersCount);
+
     ImGui::Separator();
 
+    const LightClusterStats& ClusterStats = sceneLight->GetClusterStats();
+    ImGui::Text("Lights: %u in %u clusters, %u indices, at most %u per cluster", ClusterStats.lightsCount,
+                ClusterStats.occupiedClustersCount, ClusterStats.indicesCount, ClusterStats.maxClusterLightsCount);
+    const FrameConstantsStats& ConstantsStats = FrameConstants::GetInstance().GetStats();
+    ImGui::Text("Frame constants: %zu/%zu B in %u/%u uploads (%zu B, %u calls saved)", ConstantsStats.uploadedBytes,
+                ConstantsStats.writtenBytes, ConstantsStats.uploadCallsCount, ConstantsStats.writesCount,
+                ConstantsStats.GetSavedBytes(), ConstantsStats.GetSavedCalls());
+    const GizmoStats& GizmosStats = Gizmo::GetStats();
+    ImGui::Text("Gizmos: %u in %u draws", GizmosStats.instancesCount, GizmosStats.drawCallsCount);
+
+    ImGui::Text("Sun");
+    DirectionalLight sun = sceneLight->GetSun();
+    ImGui::ColorEdit4("Sun Color", (float*)&sun.color);
+    ImGui::DragFloat3("Sun Direction", (float*)&sun.direction, 0.01f, -1.f, 1.f);
+    sceneLight->SetSun(sun);
+
+    ShadowCascades& shadows = sceneLight->GetShadows();
+    bool isShadowEnabled = shadows.IsEnabled();
+    if (ImGui::Checkbox("Sun shadows", &isShadowEnabled))
+        shadows.SetEnabled(isShadowEnabled);
+    const auto& cascadeStats = shadows.GetStats();
+    for (uint32_t i = 0; i < ShadowCascades::CascadesCount; ++i)
+    {
+        ImGui::Text("Cascade %u: to %.1f, %u casters, %.3f ms GPU, %u renders%s", i, cascadeStats[i].splitDepth,
+                    cascadeStats[i].castersCount, cascadeStats[i].gpuMilliseconds,
+                    cascadeStats[i].renderedFramesCount, cascadeStats[i].wasRendered ? "" : " (cached)");
+    }
+
     ImGui::Text("Point Light");
-    PointLight bulb = sceneLight->GetBulb();
+    PointLight bulb = sceneLight->GetPointLight(0);
     ImGui::ColorEdit4("Point Light Color", (float*)&bulb.color);
     ImGui::DragFloat3("Point Light Position", (float*)&bulb.position);
     ImGui::DragFloat("Point Light Linear", &bulb.linear);
     ImGui::DragFloat("Point Light Quadratic", &bulb.quadratic);
-    sceneLight->SetBulb(bulb);
+    sceneLight->SetPointLight(0, bulb);
 
     static glm::vec4 backgroundColor;
     ImGui::Text("Background");
@@ -160,7 +485,7 @@ void MainEngine::UpdateWidget(float deltaSeconds)
     ImGui::End();
 }
 
-MainEngine::MainEngine() : sceneRoot()
+MainEngine::MainEngine(EngineOptions options) : options(std::move(options)), sceneRoot()
 {
 }
 
@@ -178,6 +503,7 @@ void MainEngine::InitializeImGui(const char* glslVersion)
 
     // Setup style
     ImGui::StyleColorsDark();
+    isImGuiInitialized = true;
 }
 
 MainEngine::~MainEngine()
@@ -187,15 +513,39 @@ MainEngine::~MainEngine()
 
 void MainEngine::Stop()
 {
-    ImGui_ImplOpenGL3_Shutdown();
-    ImGui_ImplGlfw_Shutdown();
-    ImGui::DestroyContext();
+    // The scene owns meshes, buffers and textures that go back to the systems below, release it while they and
+    // the GL context are still there
+    sceneRoot.ClearChildren();
+    currentCamera = nullptr;
+    renderer.Shutdown();
+    sceneLight.reset();
+    skybox.reset();
+    Gizmo::Shutdown();
+
+    MaterialSystem::GetInstance().Shutdown();
+    TextureStreamer::GetInstance().Shutdown();
+    FrameProfiler::GetInstance().Shutdown();
+    GeometryBuffer::GetInstance().Shutdown();
+    FrameConstants::GetInstance().Shutdown();
+
+    if (isImGuiInitialized)
+    {
+        ImGui_ImplOpenGL3_Shutdown();
+        ImGui_ImplGlfw_Shutdown();
+        ImGui::DestroyContext();
+        isImGuiInitialized = false;
+    }
+
+    // GL objects have to go before the context that owns them
+    sceneFramebuffer.reset();
+    headlessContext.reset();
 
     if (!window)
         return;
 
     glfwDestroyWindow(window);
     glfwTerminate();
+    window = nullptr;
 }
 
 void MainEngine::CheckGLErrors()
@@ -208,30 +558,95 @@ void MainEngine::CheckGLErrors()
 
 void MainEngine::PrepareScene()
 {
-    auto camera = std::make_shared<FreeCameraNode>(this);
+    std::shared_ptr<CameraNode> camera;
+    if (options.isHeadless)
+    {
+        CameraPath path;
+        if (options.cameraPathFile.empty() || !path.LoadFromFile(options.cameraPathFile))
+            path = CameraPath::CreateOrbit({0, 0, 0}, 25, 5, static_cast<float>(options.framesCount) * options.fixedDeltaSeconds);
+        camera = std::make_shared<ScriptedCameraNode>(this, std::move(path));
+    }
+    else
+        camera = std::make_shared<FreeCameraNode>(this);
+
     sceneRoot.AddChild(camera);
     camera->GetLocalTransform()->SetPosition({0, 0, -20});
     camera->SetActive();
 
-    auto modelShader = std::make_shared<ShaderWrapper>("res/shaders/instanced.vert", "res/shaders/textured_model.frag");
+    AssetRegistry& assets = AssetRegistry::GetInstance();
+    auto modelShader = assets.GetShader("res/shaders/instanced.vert", "res/shaders/textured_model.frag");
 
-    auto tardisModel = std::make_shared<Model>("res/models/Tardis/tardis.obj", modelShader);
+    auto tardisModel = assets.GetModel("res/models/Tardis/tardis.obj", modelShader);
     auto tardisNode = std::make_shared<ModelNode>(tardisModel, &renderer);
     sceneRoot.AddChild(tardisNode);
 
-    auto crysisModel = std::make_shared<Model>("res/models/nanosuit/nanosuit.obj", modelShader);
+    auto crysisModel = assets.GetModel("res/models/nanosuit/nanosuit.obj", modelShader);
     auto crysisNode = std::make_shared<ModelNode>(crysisModel, &renderer);
     sceneRoot.AddChild(crysisNode);
     crysisNode->GetLocalTransform()->SetPosition({-10, -10, 0});
     crysisNode->GetLocalTransform()->SetRotation(glm::quat({0, glm::pi<float>(), 0}));
 
     sceneLight = std::make_shared<Lights>();
+    renderer.SetShadowCascades(&sceneLight->GetShadows());
+    renderer.SetGpuCullingEnabled(options.isGpuCullingEnabled);
+    renderer.SetOcclusionCullingEnabled(options.isOcclusionCullingEnabled);
+    if (options.isHeadless)
+    {
+        // Nothing turns the sun on without the widget, headless runs light it so the shadow cascades are rendered
+        DirectionalLight sun = sceneLight->GetSun();
+        sun.color = glm::vec4(1.f, 0.95f, 0.85f, 0.5f);
+        sceneLight->SetSun(sun);
+    }
+    for (uint32_t i = 0; i < options.extraLightsCount; ++i)
+    {
+        PointLight light;
+        light.color = glm::vec4(Random::get(0.2f, 1.f), Random::get(0.2f, 1.f), Random::get(0.2f, 1.f), 1.f);
+        light.position = glm::vec3(Random::get(-40.f, 40.f), Random::get(-10.f, 10.f), Random::get(-40.f, 40.f));
+        light.linear = 0.35f;
+        light.quadratic = 0.44f;
+        sceneLight->AddPointLight(light);
+    }
 }
 
 GLFWwindow* MainEngine::GetWindow() const {
     return window;
 }
 
+glm::ivec2 MainEngine::GetFramebufferSize() const {
+    if (options.isHeadless)
+        return sceneFramebuffer->GetSize();
+
+    glm::ivec2 size{};
+    glfwGetFramebufferSize(window, &size.x, &size.y);
+    return size;
+}
+
+const OffscreenFramebuffer* MainEngine::GetSceneFramebuffer() const {
+    return sceneFramebuffer.get();
+}
+
+void MainEngine::UpdateSceneFramebuffer() {
+    glm::ivec2 size = GetFramebufferSize();
+    if (sceneFramebuffer && sceneFramebuffer->GetSize() == size)
+        return;
+
+    // A minimized window has nothing to draw into
+    sceneFramebuffer.reset();
+    if (size.x <= 0 || size.y <= 0)
+        return;
+
+    sceneFramebuffer = std::make_unique<OffscreenFramebuffer>(size, SceneSamplesCount);
+    if (!sceneFramebuffer->IsComplete())
+    {
+        SPDLOG_ERROR("Scene framebuffer is incomplete");
+        sceneFramebuffer.reset();
+    }
+}
+
+bool MainEngine::IsHeadless() const {
+    return options.isHeadless;
+}
+
 unsigned int MainEngine::GetSkyboxTextureId() {
     return skybox->GetTextureId();
 }
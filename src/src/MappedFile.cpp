@@ -0,0 +1,127 @@
+#include "MappedFile.h"
+
+#include <utility>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::MappedFile(const std::string& Path)
+{
+#ifdef _WIN32
+    // Sharing deletion lets writers of a new version rename it over this one
+    HANDLE File = CreateFileA(Path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, nullptr,
+                              OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (File == INVALID_HANDLE_VALUE)
+        return;
+    fileHandle = File;
+
+    LARGE_INTEGER FileSize;
+    if (!GetFileSizeEx(File, &FileSize) || FileSize.QuadPart == 0)
+    {
+        Close();
+        return;
+    }
+
+    mappingHandle = CreateFileMappingA(File, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (!mappingHandle)
+    {
+        Close();
+        return;
+    }
+
+    data = static_cast<const uint8_t*>(MapViewOfFile(mappingHandle, FILE_MAP_READ, 0, 0, 0));
+    size = data ? static_cast<size_t>(FileSize.QuadPart) : 0;
+#else
+    fileDescriptor = open(Path.c_str(), O_RDONLY);
+    if (fileDescriptor < 0)
+        return;
+
+    struct stat FileStat{};
+    if (fstat(fileDescriptor, &FileStat) != 0 || FileStat.st_size == 0)
+    {
+        Close();
+        return;
+    }
+
+    void* Mapping = mmap(nullptr, static_cast<size_t>(FileStat.st_size), PROT_READ, MAP_PRIVATE, fileDescriptor, 0);
+    if (Mapping == MAP_FAILED)
+    {
+        Close();
+        return;
+    }
+
+    data = static_cast<const uint8_t*>(Mapping);
+    size = static_cast<size_t>(FileStat.st_size);
+#endif
+}
+
+MappedFile::~MappedFile()
+{
+    Close();
+}
+
+MappedFile::MappedFile(MappedFile&& Other) noexcept
+{
+    *this = std::move(Other);
+}
+
+MappedFile& MappedFile::operator=(MappedFile&& Other) noexcept
+{
+    if (this != &Other)
+    {
+        Close();
+        data = std::exchange(Other.data, nullptr);
+        size = std::exchange(Other.size, 0);
+#ifdef _WIN32
+        fileHandle = std::exchange(Other.fileHandle, nullptr);
+        mappingHandle = std::exchange(Other.mappingHandle, nullptr);
+#else
+        fileDescriptor = std::exchange(Other.fileDescriptor, -1);
+#endif
+    }
+    return *this;
+}
+
+void MappedFile::Close()
+{
+#ifdef _WIN32
+    if (data)
+        UnmapViewOfFile(data);
+    if (mappingHandle)
+        CloseHandle(mappingHandle);
+    if (fileHandle)
+        CloseHandle(fileHandle);
+    mappingHandle = nullptr;
+    fileHandle = nullptr;
+#else
+    if (data)
+        munmap(const_cast<uint8_t*>(data), size);
+    if (fileDescriptor >= 0)
+        close(fileDescriptor);
+    fileDescriptor = -1;
+#endif
+    data = nullptr;
+    size = 0;
+}
+
+bool MappedFile::IsOpen() const
+{
+    return data != nullptr;
+}
+
+const uint8_t* MappedFile::GetData() const
+{
+    return data;
+}
+
+size_t MappedFile::GetSize() const
+{
+    return size;
+}
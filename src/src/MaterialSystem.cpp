@@ -0,0 +1,374 @@
+#include "MaterialSystem.h"
+
+#include <algorithm>
+#include <bit>
+
+#include "LoggingMacros.h"
+#include "ShaderWrapper.h"
+#include "TextureCache.h"
+
+namespace
+{
+    constexpr uint32_t LayerBits = 16;
+    constexpr uint32_t LayerMask = (1 << LayerBits) - 1;
+
+    size_t GetTexelSize(GLenum InternalFormat)
+    {
+        switch (InternalFormat)
+        {
+            case GL_R8:
+                return 1;
+            case GL_RG8:
+                return 2;
+            case GL_RGB8:
+                return 3;
+            default:
+                return 4;
+        }
+    }
+
+    // Length of the full mip chain, as produced by glGenerateMipmap
+    GLsizei GetLevelsCount(GLsizei Width, GLsizei Height)
+    {
+        return static_cast<GLsizei>(std::bit_width(static_cast<uint32_t>(std::max(Width, Height))));
+    }
+}
+
+MaterialSystem& MaterialSystem::GetInstance()
+{
+    static MaterialSystem Instance;
+    return Instance;
+}
+
+uint32_t MaterialSystem::AcquireMaterial(const MaterialTextures& TexturePaths)
+{
+    auto [Iterator, IsNewMaterial] = materialIndices.try_emplace(TexturePaths, 0);
+    if (!IsNewMaterial)
+    {
+        materials[Iterator->second].referencesCount++;
+        return Iterator->second;
+    }
+
+    uint32_t Material;
+    if (!freeMaterials.empty())
+    {
+        Material = freeMaterials.back();
+        freeMaterials.pop_back();
+    }
+    else
+    {
+        Material = static_cast<uint32_t>(materials.size());
+        materials.emplace_back();
+        gpuMaterials.emplace_back();
+    }
+    Iterator->second = Material;
+
+    materials[Material] = {TexturePaths, 1};
+    for (const std::string& Path : TexturePaths)
+        AcquireTexture(Path);
+
+    gpuMaterials[Material] = ResolveMaterial(TexturePaths);
+    isMaterialsBufferDirty = true;
+    stats.materialsCount++;
+    return Material;
+}
+
+void MaterialSystem::ReleaseMaterial(uint32_t Material)
+{
+    // Materials outliving Shutdown have nothing left to give back
+    if (isShutdown)
+        return;
+
+    MaterialRecord& Record = materials[Material];
+    if (--Record.referencesCount > 0)
+        return;
+
+    for (const std::string& Path : Record.texturePaths)
+        ReleaseTexture(Path);
+
+    materialIndices.erase(Record.texturePaths);
+    Record = MaterialRecord();
+    gpuMaterials[Material] = GpuMaterial();
+    freeMaterials.push_back(Material);
+    isMaterialsBufferDirty = true;
+    stats.materialsCount--;
+}
+
+void MaterialSystem::AcquireTexture(const std::string& Path)
+{
+    if (Path.empty())
+        return;
+
+    TextureRecord& Record = textures[Path];
+    if (Record.referencesCount++ > 0)
+        return;
+
+    Record.streamedTexture = TextureCache::GetInstance().Acquire(Path);
+    pendingTextures.push_back(Path);
+    stats.texturesCount++;
+    stats.pendingTexturesCount++;
+}
+
+void MaterialSystem::ReleaseTexture(const std::string& Path)
+{
+    auto Iterator = textures.find(Path);
+    if (Iterator == textures.end() || --Iterator->second.referencesCount > 0)
+        return;
+
+    // A texture still streaming is dropped from pendingTextures by the next Update
+    GLint Location = Iterator->second.location;
+    if (Location >= 0)
+    {
+        TextureArray& Array = arrays[Location >> LayerBits];
+        Array.freeLayers.push_back(Location & LayerMask);
+        stats.residentBytes -= Array.layerBytes;
+    }
+    else
+    {
+        stats.pendingTexturesCount--;
+    }
+
+    textures.erase(Iterator);
+    stats.texturesCount--;
+}
+
+void MaterialSystem::Update()
+{
+    bool IsAnyTextureResolved = false;
+    std::erase_if(pendingTextures, [this, &IsAnyTextureResolved](const std::string& Path)
+    {
+        auto Iterator = textures.find(Path);
+        if (Iterator == textures.end() || !Iterator->second.streamedTexture)
+            return true;
+
+        TextureRecord& Record = Iterator->second;
+        if (!Record.streamedTexture->IsUploaded())
+            return false;
+
+        Record.location = AddToArray(Record.streamedTexture->GetId());
+        Record.streamedTexture.reset();
+        stats.pendingTexturesCount--;
+        IsAnyTextureResolved = true;
+        return true;
+    });
+
+    if (!IsAnyTextureResolved)
+        return;
+
+    for (uint32_t Material = 0; Material < materials.size(); ++Material)
+    {
+        if (materials[Material].referencesCount > 0)
+            gpuMaterials[Material] = ResolveMaterial(materials[Material].texturePaths);
+    }
+    isMaterialsBufferDirty = true;
+}
+
+void MaterialSystem::Bind()
+{
+    if (isMaterialsBufferDirty)
+        UploadMaterials();
+
+    for (uint32_t Unit = 0; Unit < arrays.size(); ++Unit)
+    {
+        glActiveTexture(GL_TEXTURE0 + Unit);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, arrays[Unit].id);
+    }
+    glActiveTexture(GL_TEXTURE0);
+
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, MaterialsBinding, materialsBuffer);
+}
+
+void MaterialSystem::SetSamplerUniforms(const ShaderWrapper& Shader) const
+{
+    Shader.Activate();
+    for (uint32_t Unit = 0; Unit < MaxTextureArrays; ++Unit)
+    {
+        UniformHandle<int> Sampler = Shader.GetUniform<int>("MaterialArrays[" + std::to_string(Unit) + "]");
+        if (Sampler.IsValid())
+            Sampler.Set(static_cast<int>(Unit));
+    }
+}
+
+GLint MaterialSystem::AddToArray(GLuint TextureId)
+{
+    GLint Width = 0, Height = 0, InternalFormat = 0;
+    glBindTexture(GL_TEXTURE_2D, TextureId);
+    glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_WIDTH, &Width);
+    glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_HEIGHT, &Height);
+    glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_INTERNAL_FORMAT, &InternalFormat);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    uint32_t ArrayIndex = FindOrCreateArray(Width, Height, static_cast<GLenum>(InternalFormat));
+    if (ArrayIndex == UINT32_MAX)
+        return -1;
+
+    TextureArray& Array = arrays[ArrayIndex];
+    uint32_t Layer;
+    if (!Array.freeLayers.empty())
+    {
+        Layer = Array.freeLayers.back();
+        Array.freeLayers.pop_back();
+    }
+    else
+    {
+        if (Array.layersCount == Array.capacity && !GrowArray(Array))
+            return -1;
+        Layer = Array.layersCount++;
+    }
+
+    for (GLsizei Level = 0; Level < Array.levelsCount; ++Level)
+    {
+        glCopyImageSubData(TextureId, GL_TEXTURE_2D, Level, 0, 0, 0,
+                           Array.id, GL_TEXTURE_2D_ARRAY, Level, 0, 0, static_cast<GLint>(Layer),
+                           std::max(Width >> Level, 1), std::max(Height >> Level, 1), 1);
+    }
+    stats.residentBytes += Array.layerBytes;
+
+    return static_cast<GLint>((ArrayIndex << LayerBits) | Layer);
+}
+
+uint32_t MaterialSystem::FindOrCreateArray(GLsizei Width, GLsizei Height, GLenum InternalFormat)
+{
+    for (uint32_t i = 0; i < arrays.size(); ++i)
+    {
+        if (arrays[i].width == Width && arrays[i].height == Height && arrays[i].internalFormat == InternalFormat)
+            return i;
+    }
+
+    if (arrays.size() == MaxTextureArrays)
+    {
+        SPDLOG_ERROR("Out of texture arrays for {}x{} textures of format {:#x}", Width, Height, InternalFormat);
+        return UINT32_MAX;
+    }
+
+    if (!maxLayersCount)
+    {
+        glGetIntegerv(GL_MAX_ARRAY_TEXTURE_LAYERS, &maxLayersCount);
+        maxLayersCount = std::min(maxLayersCount, static_cast<GLint>(LayerMask + 1));
+    }
+
+    TextureArray& Array = arrays.emplace_back();
+    Array.width = Width;
+    Array.height = Height;
+    Array.levelsCount = GetLevelsCount(Width, Height);
+    Array.internalFormat = InternalFormat;
+    // The mip chain adds a third of the base level
+    size_t BaseLevelBytes = static_cast<size_t>(Width) * Height * GetTexelSize(InternalFormat);
+    Array.layerBytes = BaseLevelBytes + BaseLevelBytes / 3;
+    stats.arraysCount++;
+
+    SPDLOG_DEBUG("Texture array {} created for {}x{} textures", arrays.size() - 1, Width, Height);
+    return static_cast<uint32_t>(arrays.size() - 1);
+}
+
+bool MaterialSystem::GrowArray(TextureArray& Array)
+{
+    auto NewCapacity = std::min(std::max(MinimalLayersCapacity, Array.capacity * 2),
+                                static_cast<uint32_t>(maxLayersCount));
+    if (NewCapacity <= Array.capacity)
+    {
+        SPDLOG_ERROR("Texture array of {}x{} textures is full", Array.width, Array.height);
+        return false;
+    }
+
+    GLuint NewArray;
+    glGenTextures(1, &NewArray);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, NewArray);
+    glTexStorage3D(GL_TEXTURE_2D_ARRAY, Array.levelsCount, Array.internalFormat, Array.width, Array.height,
+                   static_cast<GLsizei>(NewCapacity));
+
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+
+    // Immutable storage can not be resized, every level of the used layers moves over in one copy
+    if (Array.id)
+    {
+        for (GLsizei Level = 0; Level < Array.levelsCount && Array.layersCount > 0; ++Level)
+        {
+            glCopyImageSubData(Array.id, GL_TEXTURE_2D_ARRAY, Level, 0, 0, 0,
+                               NewArray, GL_TEXTURE_2D_ARRAY, Level, 0, 0, 0,
+                               std::max(Array.width >> Level, 1), std::max(Array.height >> Level, 1),
+                               static_cast<GLsizei>(Array.layersCount));
+        }
+        glDeleteTextures(1, &Array.id);
+    }
+
+    Array.id = NewArray;
+    Array.capacity = NewCapacity;
+    return true;
+}
+
+GpuMaterial MaterialSystem::ResolveMaterial(const MaterialTextures& TexturePaths) const
+{
+    auto GetLocation = [this](const std::string& Path) -> GLint
+    {
+        auto Iterator = textures.find(Path);
+        return Iterator != textures.end() ? Iterator->second.location : -1;
+    };
+
+    GpuMaterial Material;
+    Material.diffuseTexture = GetLocation(TexturePaths[0]);
+    Material.specularTexture = GetLocation(TexturePaths[1]);
+    Material.normalTexture = GetLocation(TexturePaths[2]);
+    return Material;
+}
+
+void MaterialSystem::UploadMaterials()
+{
+    isMaterialsBufferDirty = false;
+    if (gpuMaterials.empty())
+        return;
+
+    auto Size = static_cast<GLsizeiptr>(gpuMaterials.size() * sizeof(GpuMaterial));
+    if (!materialsBuffer)
+        glGenBuffers(1, &materialsBuffer);
+
+    glBindBuffer(GL_COPY_WRITE_BUFFER, materialsBuffer);
+    if (Size > materialsBufferSize)
+    {
+        glBufferData(GL_COPY_WRITE_BUFFER, Size, gpuMaterials.data(), GL_DYNAMIC_DRAW);
+        materialsBufferSize = Size;
+    }
+    else
+    {
+        glBufferSubData(GL_COPY_WRITE_BUFFER, 0, Size, gpuMaterials.data());
+    }
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+}
+
+void MaterialSystem::Shutdown()
+{
+    if (isShutdown)
+        return;
+
+    for (TextureArray& Array : arrays)
+        glDeleteTextures(1, &Array.id);
+    if (materialsBuffer)
+        glDeleteBuffers(1, &materialsBuffer);
+
+    // Textures still streaming go back to the TextureCache here, while the TextureStreamer can still delete them
+    arrays.clear();
+    textures.clear();
+    pendingTextures.clear();
+    materials.clear();
+    gpuMaterials.clear();
+    freeMaterials.clear();
+    materialIndices.clear();
+    materialsBuffer = 0;
+    materialsBufferSize = 0;
+    stats = MaterialSystemStats();
+    isShutdown = true;
+}
+
+const GpuMaterial& MaterialSystem::GetGpuMaterial(uint32_t Material) const
+{
+    return gpuMaterials[Material];
+}
+
+const MaterialSystemStats& MaterialSystem::GetStats() const
+{
+    return stats;
+}
@@ -1,44 +1,66 @@
 #include "Mesh.h"
 
-Mesh::Mesh(const std::vector<Vertex>& Vertices, const std::vector<GLuint>& Indices,
-           const std::vector<Texture>& Textures) : vertices(Vertices), indices(Indices), textures(Textures),
-                                                   vao(Vertices, Indices, Textures)
+Mesh::Mesh(std::span<const Vertex> Vertices, std::span<const GLuint> Indices,
+           std::span<const uint32_t> LodIndicesCounts, const MaterialTextures& Textures,
+           const QuantizationBudget* Budget)
+: material(MaterialSystem::GetInstance().AcquireMaterial(Textures))
 {
+    std::vector<CompactVertex> CompactVertices;
+    if (Budget && VertexQuantization::Quantize(Vertices, *Budget, CompactVertices, dequantization))
+    {
+        geometry = GeometryBuffer::GetInstance().Allocate(std::span<const CompactVertex>(CompactVertices), Indices);
+    }
+    else
+    {
+        dequantization = PositionDequantization();
+        geometry = GeometryBuffer::GetInstance().Allocate(Vertices, Indices);
+    }
+
+    if (LodIndicesCounts.empty())
+    {
+        lods.push_back({geometry.firstIndex, geometry.indicesCount});
+        return;
+    }
+
+    uint32_t FirstIndex = geometry.firstIndex;
+    for (uint32_t IndicesCount : LodIndicesCounts)
+    {
+        lods.push_back({FirstIndex, IndicesCount});
+        FirstIndex += IndicesCount;
+    }
 }
 
-void Mesh::Draw(ShaderWrapper& Shader) const
+Mesh::~Mesh()
 {
-    BindTextures(Shader);
+    GeometryBuffer::GetInstance().Release(geometry);
+    MaterialSystem::GetInstance().ReleaseMaterial(material);
+}
 
-    vao.Draw();
+void Mesh::Draw(uint32_t DrawId) const
+{
+    const MeshLod& FullDetail = lods.front();
+    glDrawElementsInstancedBaseVertexBaseInstance(GL_TRIANGLES, static_cast<GLsizei>(FullDetail.indicesCount),
+                                                  GL_UNSIGNED_INT,
+                                                  reinterpret_cast<void*>(FullDetail.firstIndex * sizeof(GLuint)), 1,
+                                                  geometry.baseVertex, DrawId);
 }
 
-void Mesh::BindTextures(const ShaderWrapper& Shader) const
+const GeometryRange& Mesh::GetGeometry() const
 {
-    uint16_t TextureIndex = 0;
-    uint16_t DiffuseIndex = 0;
-    uint16_t SpecularIndex = 0;
+    return geometry;
+}
 
-    for (const Texture & Item : textures)
-    {
-        glActiveTexture(GL_TEXTURE0 + TextureIndex);
-
-        std::string Number;
-        if(Item.textureType == "texture_diffuse")
-            Number = std::to_string(DiffuseIndex++);
-        else if(Item.textureType == "texture_specular")
-            Number = std::to_string(SpecularIndex++);
-        else if (Item.textureType == "texture_normalmap")
-            Number = std::to_string(0);
-
-        Shader.SetFloat(Item.textureType + Number, TextureIndex);
-        glBindTexture(GL_TEXTURE_2D, Item.id);
-        TextureIndex++;
-    }
-    glActiveTexture(GL_TEXTURE0);
+const std::vector<MeshLod>& Mesh::GetLods() const
+{
+    return lods;
+}
+
+const PositionDequantization& Mesh::GetDequantization() const
+{
+    return dequantization;
 }
 
-const VAOWrapper& Mesh::GetVao() const
+uint32_t Mesh::GetMaterial() const
 {
-    return vao;
+    return material;
 }
@@ -0,0 +1,496 @@
+#include "MeshCache.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstddef>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <numeric>
+#include <random>
+#include <string_view>
+#include <type_traits>
+
+#include "Hash.h"
+#include "LoggingMacros.h"
+#include "MeshSimplifier.h"
+
+namespace
+{
+    constexpr char Magic[4] = {'H', 'E', 'M', 'C'};
+    constexpr uint64_t BlobAlignment = 16;
+
+    // All offsets are in bytes from the start of the file
+    struct FileHeader
+    {
+        char magic[4];
+        uint32_t version;
+        uint32_t vertexSize;
+        uint32_t meshesCount;
+        uint32_t texturesCount;
+        uint32_t dependenciesCount;
+        uint32_t stringsSize;
+        // Explicit so no byte of the header is padding left uninitialized
+        uint32_t reserved;
+        uint64_t fileSize;
+
+        uint64_t sourceSize;
+        int64_t sourceTime;
+        uint64_t sourceHash;
+
+        float boundsMin[3];
+        float boundsMax[3];
+    };
+
+    struct MeshEntry
+    {
+        uint64_t verticesOffset;
+        uint64_t indicesOffset;
+        uint32_t verticesCount;
+        uint32_t indicesCount;
+        uint32_t firstTexture;
+        uint32_t texturesCount;
+        // Indices of the LODs follow each other in the indices blob
+        uint32_t lodsCount;
+        uint32_t lodIndicesCounts[MeshSimplifier::MaxLodsCount];
+        // Explicit so the entry ends without uninitialized padding
+        uint32_t reserved;
+    };
+
+    // Offsets are relative to the string table that follows the dependency entries
+    struct TextureEntry
+    {
+        uint32_t typeOffset;
+        uint32_t typeLength;
+        uint32_t pathOffset;
+        uint32_t pathLength;
+    };
+
+    // A file the import read besides the source, such as the material libraries of an .obj
+    struct DependencyEntry
+    {
+        uint32_t pathOffset;
+        uint32_t pathLength;
+        uint64_t size;
+        int64_t time;
+        uint64_t hash;
+    };
+
+    // Every byte of the written structs belongs to a member, so importing a model twice gives identical caches
+    static_assert(sizeof(FileHeader) ==
+                  sizeof(Magic) + 7 * sizeof(uint32_t) + 4 * sizeof(uint64_t) + 6 * sizeof(float),
+                  "FileHeader must not contain padding");
+    static_assert(std::has_unique_object_representations_v<MeshEntry>, "MeshEntry must not contain padding");
+    static_assert(std::has_unique_object_representations_v<TextureEntry>, "TextureEntry must not contain padding");
+    static_assert(std::has_unique_object_representations_v<DependencyEntry>,
+                  "DependencyEntry must not contain padding");
+
+    // Size of a dependency that did not exist when the cache was written
+    constexpr uint64_t MissingFileSize = UINT64_MAX;
+
+    struct SourceKey
+    {
+        uint64_t size = 0;
+        int64_t time = 0;
+    };
+
+    bool GetSourceKey(const std::string& SourcePath, SourceKey& KeyOut)
+    {
+        std::error_code Error;
+        uintmax_t Size = std::filesystem::file_size(SourcePath, Error);
+        if (Error)
+            return false;
+
+        std::filesystem::file_time_type Time = std::filesystem::last_write_time(SourcePath, Error);
+        if (Error)
+            return false;
+
+        KeyOut.size = Size;
+        KeyOut.time = static_cast<int64_t>(Time.time_since_epoch().count());
+        return true;
+    }
+
+    // FNV-1a, only computed when the size or modification time of the source does not match
+    uint64_t HashFile(const std::string& Path)
+    {
+        MappedFile Source(Path);
+        return Hash::Fnv1a(Source.GetData(), Source.GetSize());
+    }
+
+    // A fresh checkout touches every file, fall back to comparing contents before re-importing.
+    // CurrentTimeOut receives the modification time the file has now.
+    bool IsFileUnchanged(const std::string& Path, uint64_t Size, int64_t Time, uint64_t ContentHash,
+                         int64_t& CurrentTimeOut)
+    {
+        CurrentTimeOut = Time;
+        SourceKey Key;
+        if (!GetSourceKey(Path, Key))
+            return Size == MissingFileSize;
+
+        CurrentTimeOut = Key.time;
+        return Key.size == Size && (Key.time == Time || HashFile(Path) == ContentHash);
+    }
+
+    // Written under a temporary name so a concurrent start never maps a partially written cache,
+    // the random suffix keeps two processes importing the same model from writing into one file
+    template<typename WriteContents>
+    bool WriteCacheFile(const std::string& CachePath, WriteContents Contents)
+    {
+        std::string TemporaryPath = CachePath + "." + std::to_string(std::random_device{}()) + ".tmp";
+        {
+            std::ofstream Output(TemporaryPath, std::ios::binary | std::ios::trunc);
+            if (!Output)
+            {
+                SPDLOG_WARN("Failed to create mesh cache at path: {}", TemporaryPath);
+                return false;
+            }
+
+            Contents(Output);
+
+            if (!Output)
+            {
+                SPDLOG_WARN("Failed to write mesh cache at path: {}", TemporaryPath);
+                Output.close();
+                std::filesystem::remove(TemporaryPath);
+                return false;
+            }
+        }
+
+        std::error_code Error;
+        std::filesystem::rename(TemporaryPath, CachePath, Error);
+        if (Error)
+        {
+            SPDLOG_WARN("Failed to move mesh cache to path: {}", CachePath);
+            std::filesystem::remove(TemporaryPath, Error);
+            return false;
+        }
+        return true;
+    }
+
+    // Material libraries named by the mtllib lines of an .obj, relative to its directory
+    std::vector<std::string> FindDependencies(const std::string& SourcePath)
+    {
+        std::vector<std::string> Dependencies;
+        std::filesystem::path Source(SourcePath);
+        std::string Extension = Source.extension().string();
+        std::transform(Extension.begin(), Extension.end(), Extension.begin(),
+                       [](unsigned char Character) { return static_cast<char>(std::tolower(Character)); });
+        if (Extension != ".obj")
+            return Dependencies;
+
+        std::ifstream Input(SourcePath);
+        std::string Line;
+        while (std::getline(Input, Line))
+        {
+            // The importer takes the rest of the line as one file name, spaces included
+            constexpr std::string_view Keyword = "mtllib";
+            size_t Start = Line.find_first_not_of(" \t");
+            if (Start == std::string::npos || Line.compare(Start, Keyword.size(), Keyword) != 0)
+                continue;
+
+            size_t NameStart = Line.find_first_not_of(" \t", Start + Keyword.size());
+            size_t NameEnd = Line.find_last_not_of(" \t\r");
+            if (NameStart == std::string::npos || NameStart == Start + Keyword.size() || NameEnd < NameStart)
+                continue;
+
+            std::filesystem::path Library = Source.parent_path() / Line.substr(NameStart, NameEnd - NameStart + 1);
+            Dependencies.push_back(Library.string());
+        }
+        return Dependencies;
+    }
+
+    uint64_t AlignOffset(uint64_t Offset)
+    {
+        return (Offset + BlobAlignment - 1) & ~(BlobAlignment - 1);
+    }
+
+    bool IsRangeInside(uint64_t Offset, uint64_t Size, uint64_t FileSize)
+    {
+        return Offset <= FileSize && Size <= FileSize - Offset;
+    }
+}
+
+MeshCache::MeshCache(const std::string& SourcePath)
+: file(GetCachePath(SourcePath))
+{
+    if (!file.IsOpen())
+        return;
+
+    std::vector<TimeUpdate> TimeUpdates;
+    isValid = Parse(SourcePath, TimeUpdates);
+    if (isValid && !TimeUpdates.empty())
+        RewriteTimes(SourcePath, TimeUpdates);
+
+    if (!isValid)
+    {
+        meshes.clear();
+        file = MappedFile();
+    }
+}
+
+bool MeshCache::Parse(const std::string& SourcePath, std::vector<TimeUpdate>& TimeUpdatesOut)
+{
+    const uint8_t* Data = file.GetData();
+    uint64_t FileSize = file.GetSize();
+
+    if (FileSize < sizeof(FileHeader))
+        return false;
+
+    FileHeader Header{};
+    std::memcpy(&Header, Data, sizeof(FileHeader));
+
+    if (std::memcmp(Header.magic, Magic, sizeof(Magic)) != 0 || Header.version != Version ||
+        Header.vertexSize != sizeof(Vertex) || Header.fileSize != FileSize)
+    {
+        SPDLOG_WARN("Mesh cache of {} has an incompatible format, re-importing", SourcePath);
+        return false;
+    }
+
+    int64_t CurrentTime = 0;
+    if (!IsFileUnchanged(SourcePath, Header.sourceSize, Header.sourceTime, Header.sourceHash, CurrentTime))
+    {
+        SPDLOG_DEBUG("Mesh cache of {} is outdated", SourcePath);
+        return false;
+    }
+    if (CurrentTime != Header.sourceTime)
+        TimeUpdatesOut.push_back({offsetof(FileHeader, sourceTime), CurrentTime});
+
+    uint64_t MeshesOffset = sizeof(FileHeader);
+    uint64_t TexturesOffset = MeshesOffset + uint64_t(Header.meshesCount) * sizeof(MeshEntry);
+    uint64_t DependenciesOffset = TexturesOffset + uint64_t(Header.texturesCount) * sizeof(TextureEntry);
+    uint64_t StringsOffset = DependenciesOffset + uint64_t(Header.dependenciesCount) * sizeof(DependencyEntry);
+    if (!IsRangeInside(StringsOffset, Header.stringsSize, FileSize))
+        return false;
+
+    auto* MeshEntries = reinterpret_cast<const MeshEntry*>(Data + MeshesOffset);
+    auto* TextureEntries = reinterpret_cast<const TextureEntry*>(Data + TexturesOffset);
+    auto* DependencyEntries = reinterpret_cast<const DependencyEntry*>(Data + DependenciesOffset);
+    auto* Strings = reinterpret_cast<const char*>(Data + StringsOffset);
+
+    // Edited materials change the textures the meshes reference
+    for (uint32_t i = 0; i < Header.dependenciesCount; ++i)
+    {
+        const DependencyEntry& Dependency = DependencyEntries[i];
+        if (!IsRangeInside(Dependency.pathOffset, Dependency.pathLength, Header.stringsSize))
+            return false;
+
+        std::string Path(Strings + Dependency.pathOffset, Dependency.pathLength);
+        if (!IsFileUnchanged(Path, Dependency.size, Dependency.time, Dependency.hash, CurrentTime))
+        {
+            SPDLOG_DEBUG("Mesh cache of {} is outdated, {} changed", SourcePath, Path);
+            return false;
+        }
+        if (CurrentTime != Dependency.time)
+        {
+            TimeUpdatesOut.push_back({DependenciesOffset + uint64_t(i) * sizeof(DependencyEntry) +
+                                      offsetof(DependencyEntry, time), CurrentTime});
+        }
+    }
+
+    meshes.resize(Header.meshesCount);
+    for (uint32_t i = 0; i < Header.meshesCount; ++i)
+    {
+        const MeshEntry& Entry = MeshEntries[i];
+        if (!IsRangeInside(Entry.verticesOffset, uint64_t(Entry.verticesCount) * sizeof(Vertex), FileSize) ||
+            !IsRangeInside(Entry.indicesOffset, uint64_t(Entry.indicesCount) * sizeof(GLuint), FileSize) ||
+            uint64_t(Entry.firstTexture) + Entry.texturesCount > Header.texturesCount ||
+            Entry.lodsCount > MeshSimplifier::MaxLodsCount)
+            return false;
+
+        MeshView& View = meshes[i];
+        View.vertices = {reinterpret_cast<const Vertex*>(Data + Entry.verticesOffset), Entry.verticesCount};
+        View.indices = {reinterpret_cast<const GLuint*>(Data + Entry.indicesOffset), Entry.indicesCount};
+        View.lodIndicesCounts.assign(Entry.lodIndicesCounts, Entry.lodIndicesCounts + Entry.lodsCount);
+        if (std::accumulate(View.lodIndicesCounts.begin(), View.lodIndicesCounts.end(), uint64_t(0)) !=
+            Entry.indicesCount)
+            return false;
+
+        View.textures.reserve(Entry.texturesCount);
+        for (uint32_t j = Entry.firstTexture; j < Entry.firstTexture + Entry.texturesCount; ++j)
+        {
+            const TextureEntry& Texture = TextureEntries[j];
+            if (!IsRangeInside(Texture.typeOffset, Texture.typeLength, Header.stringsSize) ||
+                !IsRangeInside(Texture.pathOffset, Texture.pathLength, Header.stringsSize))
+                return false;
+
+            View.textures.push_back({std::string(Strings + Texture.typeOffset, Texture.typeLength),
+                                     std::string(Strings + Texture.pathOffset, Texture.pathLength)});
+        }
+    }
+
+    bounds.min = glm::vec3(Header.boundsMin[0], Header.boundsMin[1], Header.boundsMin[2]);
+    bounds.max = glm::vec3(Header.boundsMax[0], Header.boundsMax[1], Header.boundsMax[2]);
+    return true;
+}
+
+void MeshCache::RewriteTimes(const std::string& SourcePath, const std::vector<TimeUpdate>& TimeUpdates)
+{
+    std::string CachePath = GetCachePath(SourcePath);
+    WriteCacheFile(CachePath, [&](std::ofstream& Output)
+    {
+        Output.write(reinterpret_cast<const char*>(file.GetData()), static_cast<std::streamsize>(file.GetSize()));
+        for (const TimeUpdate& Update : TimeUpdates)
+        {
+            Output.seekp(static_cast<std::streamoff>(Update.offset));
+            Output.write(reinterpret_cast<const char*>(&Update.time), sizeof(Update.time));
+        }
+
+        // Windows can not replace a file that is still mapped
+        meshes.clear();
+        file = MappedFile();
+    });
+
+    // Whether or not the new file made it, the meshes are parsed again from whatever is in place now
+    if (file.IsOpen())
+        return;
+
+    std::vector<TimeUpdate> IgnoredUpdates;
+    file = MappedFile(CachePath);
+    isValid = file.IsOpen() && Parse(SourcePath, IgnoredUpdates);
+}
+
+bool MeshCache::Write(const std::string& SourcePath, const std::vector<MeshData>& Meshes, const AABB& Bounds)
+{
+    FileHeader Header{};
+    std::memcpy(Header.magic, Magic, sizeof(Magic));
+    Header.version = Version;
+    Header.vertexSize = sizeof(Vertex);
+    Header.meshesCount = static_cast<uint32_t>(Meshes.size());
+
+    SourceKey Key;
+    if (!GetSourceKey(SourcePath, Key))
+        return false;
+    Header.sourceSize = Key.size;
+    Header.sourceTime = Key.time;
+    Header.sourceHash = HashFile(SourcePath);
+
+    for (int i = 0; i < 3; ++i)
+    {
+        Header.boundsMin[i] = Bounds.min[i];
+        Header.boundsMax[i] = Bounds.max[i];
+    }
+
+    std::vector<MeshEntry> MeshEntries(Meshes.size());
+    std::vector<TextureEntry> TextureEntries;
+    std::vector<DependencyEntry> DependencyEntries;
+    std::string Strings;
+
+    for (const std::string& Dependency : FindDependencies(SourcePath))
+    {
+        DependencyEntry& Entry = DependencyEntries.emplace_back();
+        Entry.pathOffset = static_cast<uint32_t>(Strings.size());
+        Entry.pathLength = static_cast<uint32_t>(Dependency.size());
+        Strings += Dependency;
+
+        SourceKey DependencyKey;
+        if (GetSourceKey(Dependency, DependencyKey))
+        {
+            Entry.size = DependencyKey.size;
+            Entry.time = DependencyKey.time;
+            Entry.hash = HashFile(Dependency);
+        }
+        else
+        {
+            // Creating the library later has to invalidate the cache as well
+            Entry.size = MissingFileSize;
+            Entry.time = 0;
+            Entry.hash = 0;
+        }
+    }
+    Header.dependenciesCount = static_cast<uint32_t>(DependencyEntries.size());
+
+    for (size_t i = 0; i < Meshes.size(); ++i)
+    {
+        MeshEntries[i].firstTexture = static_cast<uint32_t>(TextureEntries.size());
+        MeshEntries[i].texturesCount = static_cast<uint32_t>(Meshes[i].textures.size());
+
+        for (const TextureReference& Texture : Meshes[i].textures)
+        {
+            TextureEntry& Entry = TextureEntries.emplace_back();
+            Entry.typeOffset = static_cast<uint32_t>(Strings.size());
+            Entry.typeLength = static_cast<uint32_t>(Texture.textureType.size());
+            Strings += Texture.textureType;
+            Entry.pathOffset = static_cast<uint32_t>(Strings.size());
+            Entry.pathLength = static_cast<uint32_t>(Texture.texturePath.size());
+            Strings += Texture.texturePath;
+        }
+    }
+    Header.texturesCount = static_cast<uint32_t>(TextureEntries.size());
+    Header.stringsSize = static_cast<uint32_t>(Strings.size());
+
+    uint64_t Offset = sizeof(FileHeader) + MeshEntries.size() * sizeof(MeshEntry) +
+                      TextureEntries.size() * sizeof(TextureEntry) +
+                      DependencyEntries.size() * sizeof(DependencyEntry) + Strings.size();
+    for (size_t i = 0; i < Meshes.size(); ++i)
+    {
+        MeshEntries[i].verticesOffset = Offset = AlignOffset(Offset);
+        MeshEntries[i].verticesCount = static_cast<uint32_t>(Meshes[i].vertices.size());
+        Offset += Meshes[i].vertices.size() * sizeof(Vertex);
+
+        MeshEntries[i].indicesOffset = Offset = AlignOffset(Offset);
+        MeshEntries[i].indicesCount = static_cast<uint32_t>(Meshes[i].indices.size());
+        Offset += Meshes[i].indices.size() * sizeof(GLuint);
+
+        // Meshes without a LOD chain are a single LOD
+        const std::vector<uint32_t>& LodIndicesCounts = Meshes[i].lodIndicesCounts;
+        if (LodIndicesCounts.empty())
+        {
+            MeshEntries[i].lodsCount = 1;
+            MeshEntries[i].lodIndicesCounts[0] = MeshEntries[i].indicesCount;
+        }
+        else
+        {
+            MeshEntries[i].lodsCount = static_cast<uint32_t>(LodIndicesCounts.size());
+            std::copy(LodIndicesCounts.begin(), LodIndicesCounts.end(), MeshEntries[i].lodIndicesCounts);
+        }
+    }
+    Header.fileSize = Offset;
+
+    return WriteCacheFile(GetCachePath(SourcePath), [&](std::ofstream& Output)
+    {
+        auto WriteBytes = [&Output](const void* Bytes, uint64_t Size)
+        {
+            Output.write(static_cast<const char*>(Bytes), static_cast<std::streamsize>(Size));
+        };
+        auto WritePadding = [&Output]()
+        {
+            static constexpr char Zeros[BlobAlignment] = {};
+            auto Position = static_cast<uint64_t>(Output.tellp());
+            Output.write(Zeros, static_cast<std::streamsize>(AlignOffset(Position) - Position));
+        };
+
+        WriteBytes(&Header, sizeof(FileHeader));
+        WriteBytes(MeshEntries.data(), MeshEntries.size() * sizeof(MeshEntry));
+        WriteBytes(TextureEntries.data(), TextureEntries.size() * sizeof(TextureEntry));
+        WriteBytes(DependencyEntries.data(), DependencyEntries.size() * sizeof(DependencyEntry));
+        WriteBytes(Strings.data(), Strings.size());
+
+        for (const MeshData& Mesh : Meshes)
+        {
+            WritePadding();
+            WriteBytes(Mesh.vertices.data(), Mesh.vertices.size() * sizeof(Vertex));
+            WritePadding();
+            WriteBytes(Mesh.indices.data(), Mesh.indices.size() * sizeof(GLuint));
+        }
+    });
+}
+
+std::string MeshCache::GetCachePath(const std::string& SourcePath)
+{
+    return SourcePath + ".meshcache";
+}
+
+bool MeshCache::IsValid() const
+{
+    return isValid;
+}
+
+const std::vector<MeshView>& MeshCache::GetMeshes() const
+{
+    return meshes;
+}
+
+const AABB& MeshCache::GetBounds() const
+{
+    return bounds;
+}
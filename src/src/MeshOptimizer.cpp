@@ -0,0 +1,282 @@
+#include "MeshOptimizer.h"
+
+#include <algorithm>
+#include <numeric>
+
+#include <glm/glm.hpp>
+
+namespace
+{
+    constexpr uint32_t NoVertex = UINT32_MAX;
+
+    // Triangles using each vertex, as offsets into one flat array
+    struct VertexAdjacency
+    {
+        std::vector<uint32_t> offsets;
+        std::vector<uint32_t> triangles;
+
+        VertexAdjacency(const std::vector<GLuint>& Indices, uint32_t VerticesCount)
+        : offsets(VerticesCount + 1, 0), triangles(Indices.size())
+        {
+            for (GLuint Index : Indices)
+                ++offsets[Index + 1];
+
+            std::partial_sum(offsets.begin(), offsets.end(), offsets.begin());
+
+            std::vector<uint32_t> Cursors(offsets.begin(), offsets.end() - 1);
+            for (size_t i = 0; i < Indices.size(); ++i)
+                triangles[Cursors[Indices[i]]++] = static_cast<uint32_t>(i / 3);
+        }
+
+        [[nodiscard]] uint32_t GetCount(uint32_t Vertex) const
+        {
+            return offsets[Vertex + 1] - offsets[Vertex];
+        }
+    };
+
+    bool IsTriangleList(const std::vector<GLuint>& Indices, size_t VerticesCount)
+    {
+        if (Indices.empty() || Indices.size() % 3 != 0)
+            return false;
+
+        return std::all_of(Indices.begin(), Indices.end(), [VerticesCount](GLuint Index)
+        {
+            return Index < VerticesCount;
+        });
+    }
+}
+
+bool MeshOptimizer::Optimize(std::vector<Vertex>& Vertices, std::vector<GLuint>& Indices,
+                             MeshOptimizationStats& StatsOut)
+{
+    if (!IsTriangleList(Indices, Vertices.size()))
+        return false;
+
+    auto VerticesCount = static_cast<uint32_t>(Vertices.size());
+    StatsOut.acmrBefore = ComputeAcmr(Indices, VerticesCount);
+
+    std::vector<uint32_t> Clusters;
+    std::vector<GLuint> CacheOrder = OptimizeVertexCache(Indices, VerticesCount, Clusters);
+    std::vector<GLuint> OverdrawOrder = OptimizeOverdraw(Vertices, CacheOrder, Clusters);
+
+    // Clusters start at cache flushes so sorting them rarely costs anything, but keep the cache order if it does
+    float CacheAcmr = ComputeAcmr(CacheOrder, VerticesCount);
+    bool IsOverdrawOrderKept = ComputeAcmr(OverdrawOrder, VerticesCount) <= CacheAcmr * MaxOverdrawAcmrRatio;
+    Indices = IsOverdrawOrderKept ? std::move(OverdrawOrder) : std::move(CacheOrder);
+
+    OptimizeVertexFetch(Vertices, Indices);
+
+    StatsOut.acmrAfter = ComputeAcmr(Indices, static_cast<uint32_t>(Vertices.size()));
+    StatsOut.clustersCount = IsOverdrawOrderKept ? static_cast<uint32_t>(Clusters.size()) : 1;
+    StatsOut.removedVerticesCount = VerticesCount - static_cast<uint32_t>(Vertices.size());
+    return true;
+}
+
+float MeshOptimizer::ComputeAcmr(const std::vector<GLuint>& Indices, uint32_t VerticesCount, uint32_t Size)
+{
+    if (Indices.size() < 3)
+        return 0.f;
+
+    // A vertex is in the FIFO when it entered less than Size misses ago
+    std::vector<uint32_t> InsertedAt(VerticesCount, 0);
+    uint32_t MissesCount = 0;
+    for (GLuint Index : Indices)
+    {
+        if (InsertedAt[Index] == 0 || MissesCount - InsertedAt[Index] + 1 > Size)
+        {
+            ++MissesCount;
+            InsertedAt[Index] = MissesCount;
+        }
+    }
+    return static_cast<float>(MissesCount) / static_cast<float>(Indices.size() / 3);
+}
+
+// Tipsify from "Fast Triangle Reordering for Vertex Locality and Reduced Overdraw" (Sander, Nehab, Barczak 2007)
+std::vector<GLuint> MeshOptimizer::OptimizeVertexCache(const std::vector<GLuint>& Indices, uint32_t VerticesCount,
+                                                       std::vector<uint32_t>& ClustersOut, uint32_t Size)
+{
+    VertexAdjacency Adjacency(Indices, VerticesCount);
+    size_t TrianglesCount = Indices.size() / 3;
+
+    std::vector<uint32_t> LiveTriangles(VerticesCount);
+    for (uint32_t Vertex = 0; Vertex < VerticesCount; ++Vertex)
+        LiveTriangles[Vertex] = Adjacency.GetCount(Vertex);
+
+    std::vector<uint32_t> CacheTime(VerticesCount, 0);
+    std::vector<bool> IsEmitted(TrianglesCount, false);
+    std::vector<uint32_t> DeadEnds;
+    std::vector<uint32_t> Candidates;
+
+    std::vector<GLuint> Result;
+    Result.reserve(Indices.size());
+    ClustersOut.clear();
+
+    uint32_t Time = Size + 1;
+    uint32_t Cursor = 0;
+    uint32_t Fanning = 0;
+    bool IsHardBoundary = true;
+
+    while (Fanning != NoVertex)
+    {
+        Candidates.clear();
+        for (uint32_t i = Adjacency.offsets[Fanning]; i < Adjacency.offsets[Fanning + 1]; ++i)
+        {
+            uint32_t Triangle = Adjacency.triangles[i];
+            if (IsEmitted[Triangle])
+                continue;
+
+            if (IsHardBoundary)
+            {
+                ClustersOut.push_back(static_cast<uint32_t>(Result.size() / 3));
+                IsHardBoundary = false;
+            }
+
+            for (size_t Corner = 0; Corner < 3; ++Corner)
+            {
+                GLuint Vertex = Indices[Triangle * 3 + Corner];
+                Result.push_back(Vertex);
+                DeadEnds.push_back(Vertex);
+                Candidates.push_back(Vertex);
+                --LiveTriangles[Vertex];
+
+                if (Time - CacheTime[Vertex] > Size)
+                    CacheTime[Vertex] = Time++;
+            }
+            IsEmitted[Triangle] = true;
+        }
+
+        // Prefers the candidate that stays in the cache the longest while all of its triangles are emitted
+        uint32_t Next = NoVertex;
+        int64_t BestPriority = -1;
+        for (uint32_t Candidate : Candidates)
+        {
+            if (LiveTriangles[Candidate] == 0)
+                continue;
+
+            int64_t Priority = 0;
+            if (Time - CacheTime[Candidate] + 2 * LiveTriangles[Candidate] <= Size)
+                Priority = Time - CacheTime[Candidate];
+
+            if (Priority > BestPriority)
+            {
+                BestPriority = Priority;
+                Next = Candidate;
+            }
+        }
+
+        if (Next == NoVertex)
+        {
+            // Dead end, the cache no longer helps so the next triangles start a new cluster
+            IsHardBoundary = true;
+            while (!DeadEnds.empty() && Next == NoVertex)
+            {
+                uint32_t Vertex = DeadEnds.back();
+                DeadEnds.pop_back();
+                if (LiveTriangles[Vertex] > 0)
+                    Next = Vertex;
+            }
+
+            while (Next == NoVertex && Cursor < VerticesCount)
+            {
+                if (LiveTriangles[Cursor] > 0)
+                    Next = Cursor;
+                ++Cursor;
+            }
+        }
+        Fanning = Next;
+    }
+    return Result;
+}
+
+std::vector<GLuint> MeshOptimizer::OptimizeOverdraw(const std::vector<Vertex>& Vertices,
+                                                    const std::vector<GLuint>& Indices,
+                                                    const std::vector<uint32_t>& Clusters)
+{
+    auto TrianglesCount = static_cast<uint32_t>(Indices.size() / 3);
+    if (Clusters.size() < 2)
+        return Indices;
+
+    struct Cluster
+    {
+        uint32_t firstTriangle = 0;
+        uint32_t trianglesCount = 0;
+        glm::vec3 centroid{0.f};
+        glm::vec3 normal{0.f};
+        float area = 0.f;
+        float sortKey = 0.f;
+    };
+
+    std::vector<Cluster> SortedClusters(Clusters.size());
+    glm::vec3 MeshCentroid(0.f);
+    float MeshArea = 0.f;
+
+    for (size_t i = 0; i < Clusters.size(); ++i)
+    {
+        Cluster& Current = SortedClusters[i];
+        Current.firstTriangle = Clusters[i];
+        Current.trianglesCount = (i + 1 < Clusters.size() ? Clusters[i + 1] : TrianglesCount) - Clusters[i];
+
+        // Centroid and normal are area weighted
+        for (uint32_t Triangle = Current.firstTriangle; Triangle < Current.firstTriangle + Current.trianglesCount;
+             ++Triangle)
+        {
+            const glm::vec3& A = Vertices[Indices[Triangle * 3]].position;
+            const glm::vec3& B = Vertices[Indices[Triangle * 3 + 1]].position;
+            const glm::vec3& C = Vertices[Indices[Triangle * 3 + 2]].position;
+
+            glm::vec3 Normal = glm::cross(B - A, C - A);
+            float Area = glm::length(Normal) * 0.5f;
+            Current.centroid += (A + B + C) * (Area / 3.f);
+            Current.normal += Normal;
+            Current.area += Area;
+        }
+
+        MeshCentroid += Current.centroid;
+        MeshArea += Current.area;
+        if (Current.area > 0.f)
+            Current.centroid /= Current.area;
+    }
+
+    if (MeshArea > 0.f)
+        MeshCentroid /= MeshArea;
+
+    // Clusters facing away from the center are on the outside of the mesh and occlude the ones drawn after them
+    for (Cluster& Current : SortedClusters)
+    {
+        float NormalLength = glm::length(Current.normal);
+        if (NormalLength > 0.f)
+            Current.sortKey = glm::dot(Current.centroid - MeshCentroid, Current.normal / NormalLength);
+    }
+
+    std::stable_sort(SortedClusters.begin(), SortedClusters.end(), [](const Cluster& Left, const Cluster& Right)
+    {
+        return Left.sortKey > Right.sortKey;
+    });
+
+    std::vector<GLuint> Result;
+    Result.reserve(Indices.size());
+    for (const Cluster& Current : SortedClusters)
+    {
+        auto First = Indices.begin() + Current.firstTriangle * 3;
+        Result.insert(Result.end(), First, First + Current.trianglesCount * 3);
+    }
+    return Result;
+}
+
+void MeshOptimizer::OptimizeVertexFetch(std::vector<Vertex>& Vertices, std::vector<GLuint>& Indices)
+{
+    std::vector<GLuint> Remap(Vertices.size(), NoVertex);
+    std::vector<Vertex> Reordered;
+    Reordered.reserve(Vertices.size());
+
+    for (GLuint& Index : Indices)
+    {
+        if (Remap[Index] == NoVertex)
+        {
+            Remap[Index] = static_cast<GLuint>(Reordered.size());
+            Reordered.push_back(Vertices[Index]);
+        }
+        Index = Remap[Index];
+    }
+    Vertices = std::move(Reordered);
+}
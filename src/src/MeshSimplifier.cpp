@@ -0,0 +1,284 @@
+#include "MeshSimplifier.h"
+
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+#include <unordered_map>
+
+#include "Bounds.h"
+#include "LoggingMacros.h"
+#include "MeshOptimizer.h"
+
+namespace
+{
+    constexpr uint32_t MaxPassesCount = 64;
+    // LODs that do not remove at least this ratio of the previous indices are not worth a level
+    constexpr float MinLodReduction = 0.8f;
+
+    // Symmetric 4x4 matrix of the summed squared distances to the planes of the surrounding triangles
+    struct Quadric
+    {
+        double a00 = 0, a01 = 0, a02 = 0, a03 = 0;
+        double a11 = 0, a12 = 0, a13 = 0;
+        double a22 = 0, a23 = 0;
+        double a33 = 0;
+        double weight = 0;
+
+        static Quadric FromPlane(const glm::vec3& Normal, float Distance, float Weight)
+        {
+            double X = Normal.x, Y = Normal.y, Z = Normal.z, D = Distance, W = Weight;
+            return {X * X * W, X * Y * W, X * Z * W, X * D * W,
+                    Y * Y * W, Y * Z * W, Y * D * W,
+                    Z * Z * W, Z * D * W,
+                    D * D * W,
+                    W};
+        }
+
+        void Add(const Quadric& Other)
+        {
+            a00 += Other.a00; a01 += Other.a01; a02 += Other.a02; a03 += Other.a03;
+            a11 += Other.a11; a12 += Other.a12; a13 += Other.a13;
+            a22 += Other.a22; a23 += Other.a23;
+            a33 += Other.a33;
+            weight += Other.weight;
+        }
+
+        [[nodiscard]] double Evaluate(const glm::vec3& Point) const
+        {
+            double X = Point.x, Y = Point.y, Z = Point.z;
+            return a00 * X * X + 2 * a01 * X * Y + 2 * a02 * X * Z + 2 * a03 * X +
+                   a11 * Y * Y + 2 * a12 * Y * Z + 2 * a13 * Y +
+                   a22 * Z * Z + 2 * a23 * Z +
+                   a33;
+        }
+    };
+
+    struct Collapse
+    {
+        double cost;
+        GLuint from;
+        GLuint to;
+    };
+
+    uint64_t GetEdgeKey(GLuint A, GLuint B)
+    {
+        return (uint64_t(std::min(A, B)) << 32) | std::max(A, B);
+    }
+
+    // Squared distance per unit of area, so errors of both endpoints are comparable
+    double GetCollapseCost(const std::vector<Quadric>& Quadrics, const std::vector<Vertex>& Vertices,
+                           GLuint From, GLuint To)
+    {
+        Quadric Merged = Quadrics[From];
+        Merged.Add(Quadrics[To]);
+        double Cost = Merged.Evaluate(Vertices[To].position);
+        return Merged.weight > 0 ? std::max(Cost / Merged.weight, 0.0) : 0.0;
+    }
+
+    // Offsets into a flat array of the triangles using every vertex
+    void BuildAdjacency(const std::vector<GLuint>& Indices, size_t VerticesCount, std::vector<uint32_t>& OffsetsOut,
+                        std::vector<uint32_t>& TrianglesOut)
+    {
+        OffsetsOut.assign(VerticesCount + 1, 0);
+        for (GLuint Index : Indices)
+            ++OffsetsOut[Index + 1];
+        std::partial_sum(OffsetsOut.begin(), OffsetsOut.end(), OffsetsOut.begin());
+
+        TrianglesOut.resize(Indices.size());
+        std::vector<uint32_t> Cursors(OffsetsOut.begin(), OffsetsOut.end() - 1);
+        for (size_t i = 0; i < Indices.size(); ++i)
+            TrianglesOut[Cursors[Indices[i]]++] = static_cast<uint32_t>(i / 3);
+    }
+}
+
+std::vector<GLuint> MeshSimplifier::Simplify(const std::vector<Vertex>& Vertices, const std::vector<GLuint>& Indices,
+                                             size_t TargetIndicesCount, float MaxError, float& ErrorOut)
+{
+    ErrorOut = 0.f;
+    size_t VerticesCount = Vertices.size();
+    std::vector<GLuint> Result = Indices;
+
+    // Edges of a single triangle are borders, or seams where vertices are split for their attributes.
+    // Edges shared by more than two triangles are not manifold, vertices of both kinds stay in place.
+    std::unordered_map<uint64_t, uint32_t> EdgeUses;
+    std::vector<Quadric> Quadrics(VerticesCount);
+    for (size_t i = 0; i < Indices.size(); i += 3)
+    {
+        GLuint Corners[3] = {Indices[i], Indices[i + 1], Indices[i + 2]};
+        for (size_t Corner = 0; Corner < 3; ++Corner)
+            ++EdgeUses[GetEdgeKey(Corners[Corner], Corners[(Corner + 1) % 3])];
+
+        const glm::vec3& A = Vertices[Corners[0]].position;
+        glm::vec3 Normal = glm::cross(Vertices[Corners[1]].position - A, Vertices[Corners[2]].position - A);
+        float Length = glm::length(Normal);
+        if (Length == 0.f)
+            continue;
+
+        Normal /= Length;
+        Quadric Plane = Quadric::FromPlane(Normal, -glm::dot(Normal, A), Length * 0.5f);
+        for (GLuint Vertex : Corners)
+            Quadrics[Vertex].Add(Plane);
+    }
+
+    std::vector<bool> IsLocked(VerticesCount, false);
+    for (const auto& [Key, UsesCount] : EdgeUses)
+    {
+        if (UsesCount == 2)
+            continue;
+
+        IsLocked[Key >> 32] = true;
+        IsLocked[Key & 0xFFFFFFFF] = true;
+    }
+
+    double MaxCost = double(MaxError) * double(MaxError);
+    std::vector<uint32_t> AdjacencyOffsets;
+    std::vector<uint32_t> AdjacentTriangles;
+    std::vector<uint64_t> Edges;
+    std::vector<Collapse> Collapses;
+    std::vector<GLuint> Remap(VerticesCount);
+    std::vector<bool> IsTouched;
+
+    // The triangles around a collapsed vertex are frozen for the rest of the pass, so every collapse of a pass
+    // sees the connectivity it was priced with
+    for (uint32_t Pass = 0; Pass < MaxPassesCount && Result.size() > TargetIndicesCount; ++Pass)
+    {
+        BuildAdjacency(Result, VerticesCount, AdjacencyOffsets, AdjacentTriangles);
+
+        Edges.clear();
+        for (size_t i = 0; i < Result.size(); i += 3)
+        {
+            for (size_t Corner = 0; Corner < 3; ++Corner)
+                Edges.push_back(GetEdgeKey(Result[i + Corner], Result[i + (Corner + 1) % 3]));
+        }
+        std::sort(Edges.begin(), Edges.end());
+        Edges.erase(std::unique(Edges.begin(), Edges.end()), Edges.end());
+
+        Collapses.clear();
+        for (uint64_t Key : Edges)
+        {
+            auto A = static_cast<GLuint>(Key >> 32);
+            auto B = static_cast<GLuint>(Key & 0xFFFFFFFF);
+            double CostAB = IsLocked[A] ? INFINITY : GetCollapseCost(Quadrics, Vertices, A, B);
+            double CostBA = IsLocked[B] ? INFINITY : GetCollapseCost(Quadrics, Vertices, B, A);
+            if (CostAB <= CostBA && CostAB <= MaxCost)
+                Collapses.push_back({CostAB, A, B});
+            else if (CostBA < CostAB && CostBA <= MaxCost)
+                Collapses.push_back({CostBA, B, A});
+        }
+
+        if (Collapses.empty())
+            break;
+
+        std::sort(Collapses.begin(), Collapses.end(), [](const Collapse& Left, const Collapse& Right)
+        {
+            return Left.cost < Right.cost;
+        });
+
+        std::iota(Remap.begin(), Remap.end(), 0);
+        IsTouched.assign(VerticesCount, false);
+
+        // An interior collapse removes two triangles
+        size_t ExpectedIndicesCount = Result.size();
+        uint32_t CollapsesCount = 0;
+        for (const Collapse& Candidate : Collapses)
+        {
+            if (ExpectedIndicesCount <= TargetIndicesCount)
+                break;
+            if (IsTouched[Candidate.from] || IsTouched[Candidate.to])
+                continue;
+
+            // Triangles that keep existing must not turn over when From moves onto To
+            bool IsFlipping = false;
+            const glm::vec3& Target = Vertices[Candidate.to].position;
+            for (uint32_t i = AdjacencyOffsets[Candidate.from]; i < AdjacencyOffsets[Candidate.from + 1]; ++i)
+            {
+                const GLuint* Triangle = &Result[AdjacentTriangles[i] * 3];
+                if (Triangle[0] == Candidate.to || Triangle[1] == Candidate.to || Triangle[2] == Candidate.to)
+                    continue;
+
+                glm::vec3 Corners[3];
+                for (size_t Corner = 0; Corner < 3; ++Corner)
+                    Corners[Corner] = Vertices[Triangle[Corner]].position;
+                glm::vec3 OldNormal = glm::cross(Corners[1] - Corners[0], Corners[2] - Corners[0]);
+
+                for (size_t Corner = 0; Corner < 3; ++Corner)
+                {
+                    if (Triangle[Corner] == Candidate.from)
+                        Corners[Corner] = Target;
+                }
+                glm::vec3 NewNormal = glm::cross(Corners[1] - Corners[0], Corners[2] - Corners[0]);
+
+                if (glm::dot(OldNormal, NewNormal) <= 0.f)
+                {
+                    IsFlipping = true;
+                    break;
+                }
+            }
+            if (IsFlipping)
+                continue;
+
+            Remap[Candidate.from] = Candidate.to;
+            Quadrics[Candidate.to].Add(Quadrics[Candidate.from]);
+            for (uint32_t i = AdjacencyOffsets[Candidate.from]; i < AdjacencyOffsets[Candidate.from + 1]; ++i)
+            {
+                const GLuint* Triangle = &Result[AdjacentTriangles[i] * 3];
+                IsTouched[Triangle[0]] = IsTouched[Triangle[1]] = IsTouched[Triangle[2]] = true;
+            }
+
+            ErrorOut = std::max(ErrorOut, static_cast<float>(std::sqrt(Candidate.cost)));
+            ExpectedIndicesCount -= std::min<size_t>(ExpectedIndicesCount, 6);
+            ++CollapsesCount;
+        }
+
+        if (CollapsesCount == 0)
+            break;
+
+        size_t Written = 0;
+        for (size_t i = 0; i < Result.size(); i += 3)
+        {
+            GLuint A = Remap[Result[i]], B = Remap[Result[i + 1]], C = Remap[Result[i + 2]];
+            if (A == B || B == C || A == C)
+                continue;
+
+            Result[Written++] = A;
+            Result[Written++] = B;
+            Result[Written++] = C;
+        }
+        Result.resize(Written);
+    }
+    return Result;
+}
+
+void MeshSimplifier::BuildLodChain(const std::vector<Vertex>& Vertices, std::vector<GLuint>& Indices,
+                                   std::vector<uint32_t>& LodIndicesCountsOut)
+{
+    LodIndicesCountsOut.assign(1, static_cast<uint32_t>(Indices.size()));
+
+    AABB Bounds;
+    for (const Vertex& Item : Vertices)
+        Bounds.Extend(Item.position);
+    float Diagonal = glm::length(Bounds.max - Bounds.min);
+
+    // Every LOD starts from the full detail triangles, simplifying the previous LOD would measure its error
+    // against that LOD and let the errors add up along the chain
+    const std::vector<GLuint> Source = Indices;
+    size_t PreviousIndicesCount = Source.size();
+    std::vector<uint32_t> Clusters;
+    for (uint32_t Lod = 1; Lod < MaxLodsCount; ++Lod)
+    {
+        size_t TargetIndicesCount = static_cast<size_t>(PreviousIndicesCount / 3 * LodReduction) * 3;
+        float Error = 0.f;
+        std::vector<GLuint> Simplified = Simplify(Vertices, Source, TargetIndicesCount,
+                                                  Diagonal * LodMaxErrors[Lod - 1], Error);
+        if (Simplified.empty() || Simplified.size() > PreviousIndicesCount * MinLodReduction)
+            break;
+
+        SPDLOG_DEBUG("LOD {}: {} -> {} indices, error {:.4f} of the bounds diagonal", Lod, PreviousIndicesCount,
+                     Simplified.size(), Diagonal > 0.f ? Error / Diagonal : 0.f);
+
+        Simplified = MeshOptimizer::OptimizeVertexCache(Simplified, static_cast<uint32_t>(Vertices.size()), Clusters);
+        Indices.insert(Indices.end(), Simplified.begin(), Simplified.end());
+        LodIndicesCountsOut.push_back(static_cast<uint32_t>(Simplified.size()));
+        PreviousIndicesCount = Simplified.size();
+    }
+}
@@ -1,86 +1,177 @@
 #include "Model.h"
 
+#include <algorithm>
 #include <assimp/Importer.hpp>
 #include <filesystem>
 
+#include "AssetPath.h"
 #include "LoggingMacros.h"
-#include "stb_image.h"
+#include "MeshOptimizer.h"
+#include "MeshSimplifier.h"
+#include "ModelRenderer.h"
+
+bool Model::isVertexQuantizationEnabled = true;
 
 void Model::Draw()
 {
-    for (std::shared_ptr<Mesh> Item: meshes)
+    MaterialSystem::GetInstance().Bind();
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, ModelRenderer::DrawDataBinding, drawDataBuffer);
+
+    for (uint32_t DrawIndex = 0; DrawIndex < meshes.size(); ++DrawIndex)
     {
-        Item->Draw(*GetShader());
+        GeometryBuffer::GetInstance().Bind(meshes[DrawIndex]->GetGeometry().format);
+        meshes[DrawIndex]->Draw(DrawIndex);
     }
+    glBindVertexArray(0);
 }
 
 Model::Model(const std::string& Path, std::shared_ptr<ShaderWrapper> Shader)
 : modelPath(Path), shader(Shader)
+{
+    // Warm start: the cached blobs are uploaded directly from the mapped file
+    MeshCache Cache(Path);
+    if (Cache.IsValid())
+    {
+        for (const MeshView& View : Cache.GetMeshes())
+        {
+            meshes.push_back(std::make_shared<Mesh>(View.vertices, View.indices, View.lodIndicesCounts,
+                                                    ResolveMaterialTextures(View.textures), GetQuantizationBudget()));
+        }
+
+        bounds = Cache.GetBounds();
+        boundingSphere = BoundingSphere::FromAABB(bounds);
+        BuildDrawData();
+        return;
+    }
+
+    std::vector<MeshData> ImportedMeshes;
+    if (!Import(ImportedMeshes))
+        return;
+
+    for (const MeshData& Data : ImportedMeshes)
+    {
+        meshes.push_back(std::make_shared<Mesh>(Data.vertices, Data.indices, Data.lodIndicesCounts,
+                                                ResolveMaterialTextures(Data.textures), GetQuantizationBudget()));
+    }
+    boundingSphere = BoundingSphere::FromAABB(bounds);
+    BuildDrawData();
+
+    MeshCache::Write(Path, ImportedMeshes, bounds);
+}
+
+Model::~Model()
+{
+    glDeleteBuffers(1, &drawDataBuffer);
+}
+
+void Model::BuildDrawData()
+{
+    if (meshes.empty())
+        return;
+
+    std::vector<GpuDrawData> DrawData;
+    DrawData.reserve(meshes.size());
+    uint32_t CompactMeshesCount = 0;
+    for (const std::shared_ptr<Mesh>& Item : meshes)
+    {
+        const PositionDequantization& Dequantization = Item->GetDequantization();
+        bool IsCompact = Item->GetGeometry().format == VertexFormat::Compact;
+        DrawData.push_back({Dequantization.offset, Item->GetMaterial(), Dequantization.scale, IsCompact ? 1u : 0u});
+        CompactMeshesCount += IsCompact ? 1 : 0;
+        lodsCount = std::max(lodsCount, static_cast<uint32_t>(Item->GetLods().size()));
+    }
+
+    glGenBuffers(1, &drawDataBuffer);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, drawDataBuffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, static_cast<GLsizeiptr>(DrawData.size() * sizeof(GpuDrawData)),
+                 DrawData.data(), GL_STATIC_DRAW);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+    // Indirect commands of the model use the mesh index as baseInstance
+    GeometryBuffer::GetInstance().ReserveDrawIds(static_cast<uint32_t>(meshes.size()));
+
+    SPDLOG_DEBUG("{}: {} of {} meshes use compact vertices", modelPath, CompactMeshesCount, meshes.size());
+}
+
+void Model::SetVertexQuantizationEnabled(bool IsEnabled)
+{
+    isVertexQuantizationEnabled = IsEnabled;
+}
+
+bool Model::Import(std::vector<MeshData>& MeshesOut)
 {
     Assimp::Importer AssimpImporter;
 
     uint32_t AssimpProcessFlags = aiProcess_Triangulate  | aiProcess_GenNormals | aiProcess_OptimizeMeshes;
 
-    const aiScene* AssimpScene = AssimpImporter.ReadFile(Path, AssimpProcessFlags);
+    const aiScene* AssimpScene = AssimpImporter.ReadFile(modelPath, AssimpProcessFlags);
 
     if (!AssimpScene || AssimpScene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !AssimpScene->mRootNode)
     {
         SPDLOG_ERROR("ASSIMP {}", AssimpImporter.GetErrorString());
-        return;
+        return false;
     }
 
-    ProcessNode(AssimpScene->mRootNode, AssimpScene);
+    ProcessNode(AssimpScene->mRootNode, AssimpScene, MeshesOut);
+    return true;
 }
 
-void Model::ProcessNode(aiNode* NodePtr, const aiScene* ScenePtr)
+void Model::ProcessNode(aiNode* NodePtr, const aiScene* ScenePtr, std::vector<MeshData>& MeshesOut)
 {
     for (uint32_t i = 0; i < NodePtr->mNumMeshes; ++i)
     {
         aiMesh* MeshPtr = ScenePtr->mMeshes[NodePtr->mMeshes[i]];
-        meshes.push_back(ProcessMesh(MeshPtr, ScenePtr));
+        MeshesOut.push_back(ProcessMesh(MeshPtr, ScenePtr));
     }
 
     for (int i = 0; i < NodePtr->mNumChildren; ++i)
     {
-        ProcessNode(NodePtr->mChildren[i], ScenePtr);
+        ProcessNode(NodePtr->mChildren[i], ScenePtr, MeshesOut);
     }
 }
 
-std::shared_ptr<Mesh> Model::ProcessMesh(aiMesh* MeshPtr, const aiScene* ScenePtr)
+MeshData Model::ProcessMesh(aiMesh* MeshPtr, const aiScene* ScenePtr)
 {
-    std::vector<Vertex> Vertices;
-    std::vector<GLuint> Indices;
-    std::vector<Texture> Textures;
+    MeshData Data;
 
+    Data.vertices.resize(MeshPtr->mNumVertices);
     for (uint32_t i = 0; i < MeshPtr->mNumVertices; i++)
     {
-        Vertices.push_back(GetVertexFromAIMesh(MeshPtr, i));
+        Data.vertices[i] = GetVertexFromAIMesh(MeshPtr, i);
+        bounds.Extend(Data.vertices[i].position);
     }
 
+    // Faces are triangles after aiProcess_Triangulate, except for point and line primitives
+    Data.indices.reserve(MeshPtr->mNumFaces * 3);
     for (uint32_t i = 0; i < MeshPtr->mNumFaces; i++)
     {
-        aiFace face = MeshPtr->mFaces[i];
-        for (uint32_t j = 0; j < face.mNumIndices; j++)
-        {
-            Indices.push_back(face.mIndices[j]);
-        }
+        const aiFace& Face = MeshPtr->mFaces[i];
+        Data.indices.insert(Data.indices.end(), Face.mIndices, Face.mIndices + Face.mNumIndices);
     }
 
-    if (MeshPtr->mMaterialIndex >= 0)
+    bool IsTriangleList = MeshPtr->mPrimitiveTypes == aiPrimitiveType_TRIANGLE;
+    MeshOptimizationStats OptimizationStats;
+    if (IsTriangleList && MeshOptimizer::Optimize(Data.vertices, Data.indices, OptimizationStats))
     {
-        aiMaterial* Material = ScenePtr->mMaterials[MeshPtr->mMaterialIndex];
+        SPDLOG_DEBUG("{} mesh '{}': ACMR {:.3f} -> {:.3f}, {} clusters, {} unused vertices removed", modelPath,
+                     MeshPtr->mName.C_Str(), OptimizationStats.acmrBefore, OptimizationStats.acmrAfter,
+                     OptimizationStats.clustersCount, OptimizationStats.removedVerticesCount);
 
-        std::vector<Texture> DiffuseMaps = LoadMaterialTextures(Material, aiTextureType_DIFFUSE, "texture_diffuse");
-        Textures.insert(Textures.end(), DiffuseMaps.begin(), DiffuseMaps.end());
+        MeshSimplifier::BuildLodChain(Data.vertices, Data.indices, Data.lodIndicesCounts);
+        SPDLOG_DEBUG("{} mesh '{}': {} LODs, {} triangles at the coarsest", modelPath, MeshPtr->mName.C_Str(),
+                     Data.lodIndicesCounts.size(), Data.lodIndicesCounts.back() / 3);
+    }
 
-        std::vector<Texture> SpecularMaps = LoadMaterialTextures(Material, aiTextureType_SPECULAR, "texture_specular");
-        Textures.insert(Textures.end(), SpecularMaps.begin(), SpecularMaps.end());
+    if (MeshPtr->mMaterialIndex >= 0)
+    {
+        aiMaterial* Material = ScenePtr->mMaterials[MeshPtr->mMaterialIndex];
 
-        std::vector<Texture> NormalMaps = LoadMaterialTextures(Material, aiTextureType_HEIGHT, "texture_normalmap");
-        Textures.insert(Textures.end(), NormalMaps.begin(), NormalMaps.end());
+        GetMaterialTextures(Material, aiTextureType_DIFFUSE, "texture_diffuse", Data.textures);
+        GetMaterialTextures(Material, aiTextureType_SPECULAR, "texture_specular", Data.textures);
+        GetMaterialTextures(Material, aiTextureType_HEIGHT, "texture_normalmap", Data.textures);
     }
 
-    return std::make_shared<Mesh>(Vertices, Indices, Textures);
+    return Data;
 }
 
 Vertex Model::GetVertexFromAIMesh(const aiMesh* MeshPtr, unsigned int i)
@@ -115,62 +206,39 @@ Vertex Model::GetVertexFromAIMesh(const aiMesh* MeshPtr, unsigned int i)
     return NewVertex;
 }
 
-std::vector<Texture> Model::LoadMaterialTextures(aiMaterial* Material, aiTextureType Type, const std::string& TypeName)
+void Model::GetMaterialTextures(aiMaterial* Material, aiTextureType Type, const std::string& TypeName,
+                                std::vector<TextureReference>& TexturesOut)
 {
-    std::vector<Texture> Textures;
     for (uint32_t i = 0; i < Material->GetTextureCount(Type); i++)
     {
         aiString Path;
         Material->GetTexture(Type, i, &Path);
-        Texture Texture;
-        Texture.id = TextureFromFile(Path.C_Str());
-        Texture.textureType = TypeName;
-        Texture.texturePath = Path.C_Str();
-        Textures.push_back(Texture);
+        TexturesOut.push_back({TypeName, Path.C_Str()});
     }
-    return Textures;
 }
 
-GLuint Model::TextureFromFile(const std::string& Path)
+const QuantizationBudget* Model::GetQuantizationBudget()
 {
+    static const QuantizationBudget DefaultBudget;
+    return isVertexQuantizationEnabled ? &DefaultBudget : nullptr;
+}
 
-    unsigned int TextureID;
-    glGenTextures(1, &TextureID);
-
-    std::filesystem::path PathFromExecutable = std::filesystem::path{modelPath}.parent_path() / Path;
-    SPDLOG_DEBUG("Loading texture at path: {}", PathFromExecutable.string());
-
-    int Width, Height, NumberOfComponents;
-    stbi_set_flip_vertically_on_load(true);
-    uint8_t* ImageData = stbi_load(PathFromExecutable.string().c_str(), &Width, &Height, &NumberOfComponents, 0);
-    if (ImageData)
-    {
-        GLenum ColorFormat;
-        if (NumberOfComponents == 1)
-            ColorFormat = (GL_RED);
-        else if (NumberOfComponents == 3)
-            ColorFormat = (GL_RGB);
-        else if (NumberOfComponents == 4)
-            ColorFormat = (GL_RGBA);
-
-        glBindTexture(GL_TEXTURE_2D, TextureID);
-        glTexImage2D(GL_TEXTURE_2D, 0, ColorFormat, Width, Height, 0, ColorFormat, GL_UNSIGNED_BYTE, ImageData);
-        glGenerateMipmap(GL_TEXTURE_2D);
-
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-        stbi_image_free(ImageData);
-    }
-    else
+MaterialTextures Model::ResolveMaterialTextures(const std::vector<TextureReference>& References) const
+{
+    // The shaders sample the first texture of each type
+    MaterialTextures Textures;
+    for (const TextureReference& Reference : References)
     {
-        SPDLOG_ERROR("Failed to load texture at path: {}", PathFromExecutable.string());
-        stbi_image_free(ImageData);
+        size_t Slot = Reference.textureType == "texture_diffuse" ? 0 :
+                      Reference.textureType == "texture_specular" ? 1 : 2;
+        if (!Textures[Slot].empty())
+            continue;
+
+        std::filesystem::path PathFromExecutable = std::filesystem::path{modelPath}.parent_path() / Reference.texturePath;
+        SPDLOG_DEBUG("Loading texture at path: {}", PathFromExecutable.string());
+        Textures[Slot] = AssetPath::Resolve(PathFromExecutable.string());
     }
-
-    return TextureID;
+    return Textures;
 }
 
 const std::shared_ptr<ShaderWrapper>& Model::GetShader() const
@@ -183,3 +251,22 @@ const std::vector<std::shared_ptr<Mesh>>& Model::GetMeshes() const
     return meshes;
 }
 
+const AABB& Model::GetBounds() const
+{
+    return bounds;
+}
+
+const BoundingSphere& Model::GetBoundingSphere() const
+{
+    return boundingSphere;
+}
+
+uint32_t Model::GetLodsCount() const
+{
+    return lodsCount;
+}
+
+GLuint Model::GetDrawDataBuffer() const
+{
+    return drawDataBuffer;
+}
@@ -1,106 +1,773 @@
 #include "ModelRenderer.h"
 
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+
 #include "Nodes/ModelNode.h"
 #include "Model.h"
 #include "LoggingMacros.h"
 #include "MainEngine.h"
+#include "Camera.h"
+#include "FrameProfiler.h"
+#include "MaterialSystem.h"
+#include "OffscreenFramebuffer.h"
+#include "ShadowCascades.h"
+#include "AssetRegistry.h"
+#include "TransformStore.h"
 
-void ModelRenderer::Draw(MainEngine* engine)
+namespace
+{
+    constexpr uint8_t AllRegionsMask = (1 << PersistentBuffer::RegionCount) - 1;
+    constexpr uint32_t MinimalCapacity = 64;
+    constexpr GLint CubemapTextureUnit = 15;
+}
+
+ModelRenderer::~ModelRenderer()
+{
+    Shutdown();
+}
+
+void ModelRenderer::Shutdown()
 {
-    for (auto& [Model, NodeArray] : nodesMap)
+    for (GLsync& Fence : regionFences)
     {
-        DrawModel(Model, NodeArray, engine);
+        if (Fence)
+            glDeleteSync(Fence);
+        Fence = nullptr;
     }
+
+    instanceOfHandle.clear();
+    nodesMap.clear();
+    shadowCascades = nullptr;
+    shadowShader.reset();
+    gpuCulling.Shutdown();
+    depthPyramid.Shutdown();
 }
 
-void ModelRenderer::DrawModel(Model* model, std::set<struct ModelNode*>& nodeArray, MainEngine* engine)
+void ModelRenderer::Draw(MainEngine* engine)
 {
-    for (auto& Node: nodeArray)
+    uint32_t Region = frameIndex % PersistentBuffer::RegionCount;
     {
-        if (Node->WasDirtyThisFrame())
+        ProfileScope Scope("WaitForRegion");
+        WaitForRegion(Region);
+    }
+
+    std::shared_ptr<Camera> MainCamera = Camera::GetInstance();
+    Frustum CameraFrustum = MainCamera->GetFrustum();
+    LodView View{MainCamera->GetPosition(), 1.f / std::tan(glm::radians(MainCamera->GetFow()) * 0.5f)};
+
+    stats = ModelRendererStats();
+    stats.wasCulledOnGpu = isGpuCullingEnabled && gpuCulling.Initialize();
+    if (stats.wasCulledOnGpu)
+    {
+        GpuCulling::View CullingView{CameraFrustum, View.position, View.projectionScale, isCullingEnabled,
+                                     isLodEnabled ? MeshSimplifier::MaxLodsCount : 1};
+        gpuCulling.SetView(CullingView, LodScreenSizes);
+    }
+
+    {
+        ProfileScope Scope("GatherMovedSlots");
+        GatherMovedSlots();
+    }
+    for (auto& [Model, Instances] : nodesMap)
+    {
+        ProfileScope Scope("UpdateMatrixBuffer");
+        UpdateMatrixBuffer(Model, Instances, Region);
+    }
+
+    // Moved casters have invalidated their cascades by now
+    if (shadowCascades && shadowCascades->IsActive())
+    {
+        ProfileScope Scope("DrawShadows");
+        DrawShadows(Region);
+    }
+
+    // Material textures stay bound for every model drawn this frame
+    MaterialSystem::GetInstance().Bind();
+
+    // Without an engine owned scene depth there is nothing to build a pyramid from
+    const OffscreenFramebuffer* SceneFramebuffer = engine ? engine->GetSceneFramebuffer() : nullptr;
+    stats.isOcclusionAvailable = SceneFramebuffer != nullptr;
+
+    // Without a pyramid from the previous frame the early phase draws everything, there is nothing to retest
+    bool IsOcclusionTested = stats.wasCulledOnGpu && isOcclusionCullingEnabled && depthPyramid.IsValid();
+    if (stats.wasCulledOnGpu)
+        gpuCulling.SetOcclusion(IsOcclusionTested ? &depthPyramid : nullptr);
+
+    for (auto& [Model, Instances] : nodesMap)
+    {
+        if (stats.wasCulledOnGpu)
         {
-            UpdateMatrixBuffer(model, nodeArray);
-            break;
+            ProfileScope Scope("CullInstancesOnGpu", true);
+            CullInstancesOnGpu(Model, Instances, CullingPhase::Early, Region);
+        }
+        else
+        {
+            {
+                ProfileScope Scope("CullInstances");
+                CullInstances(Instances, CameraFrustum);
+            }
+            {
+                ProfileScope Scope("SelectLods");
+                SelectLods(Instances, View, Region);
+            }
+        }
+        ProfileScope Scope("DrawModel");
+        DrawModel(Model, Instances, Region, engine);
+    }
+
+    if (stats.wasCulledOnGpu && isOcclusionCullingEnabled && SceneFramebuffer)
+    {
+        // Next frame's early phase tests against this one as well
+        ProfileScope Scope("DepthPyramid::Build", true);
+        glm::ivec2 Resolution = SceneFramebuffer->GetSize();
+        depthPyramid.Build(*SceneFramebuffer, MainCamera->GetCameraProjectionMatrix(Resolution.x, Resolution.y) *
+                                              MainCamera->GetViewMatrix());
+    }
+    else
+    {
+        depthPyramid.Invalidate();
+    }
+
+    if (IsOcclusionTested && depthPyramid.IsValid())
+    {
+        gpuCulling.SetOcclusion(&depthPyramid);
+        for (auto& [Model, Instances] : nodesMap)
+        {
+            {
+                ProfileScope Scope("CullInstancesOnGpu", true);
+                CullInstancesOnGpu(Model, Instances, CullingPhase::Late, Region);
+            }
+            ProfileScope Scope("DrawModel");
+            DrawModel(Model, Instances, Region, engine, CullingPhase::Late);
         }
     }
 
+    regionFences[Region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    frameIndex++;
+}
+
+void ModelRenderer::DrawModel(Model* model, ModelInstances& instances, uint32_t region, MainEngine* engine,
+                              CullingPhase phase)
+{
+    bool IsCulledOnGpu = stats.wasCulledOnGpu;
+    if (instances.commands.empty() || (!IsCulledOnGpu && instances.visibleSlots.empty()))
+        return;
+
     model->GetShader()->Activate();
 
-    for (const auto& Mesh : model->GetMeshes())
+    PersistentBuffer& MatrixBuffer = *instances.matrixBuffer;
+    glBindBufferRange(GL_SHADER_STORAGE_BUFFER, InstancesBinding, MatrixBuffer.GetId(),
+                      MatrixBuffer.GetRegionOffset(region), MatrixBuffer.GetRegionSize());
+
+    if (IsCulledOnGpu)
+    {
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, VisibleInstancesBinding, instances.gpuCulling.GetVisibleBuffer());
+    }
+    else
+    {
+        PersistentBuffer& VisibleBuffer = *instances.visibleBuffer;
+        glBindBufferRange(GL_SHADER_STORAGE_BUFFER, VisibleInstancesBinding, VisibleBuffer.GetId(),
+                          VisibleBuffer.GetRegionOffset(region), VisibleBuffer.GetRegionSize());
+    }
+
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, DrawDataBinding, model->GetDrawDataBuffer());
+
+    // Material texture arrays start at unit 0, the cubemap unit is never touched by them
+    if (engine && instances.cubemapUniform.IsValid())
     {
-        Mesh->BindTextures(*model->GetShader());
+        glActiveTexture(GL_TEXTURE0 + CubemapTextureUnit);
+        instances.cubemapUniform.Set(CubemapTextureUnit);
+        glBindTexture(GL_TEXTURE_CUBE_MAP, engine->GetSkyboxTextureId());
+        glActiveTexture(GL_TEXTURE0);
+    }
 
-        if (engine && model->GetShader()->GetUniformLocation("cubemap") >= 0)
+    if (IsCulledOnGpu)
+    {
+        // Instance counts are only known to the GPU, every LOD an instance may have picked is drawn
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, instances.gpuCulling.GetCommandBuffer());
+        GLintptr CommandsOffset = instances.gpuCulling.GetCommandsOffset(phase);
+        auto LodsCount = static_cast<uint32_t>(isLodEnabled ? instances.lodCommands.size() : 1);
+        for (uint32_t Lod = 0; Lod < LodsCount; ++Lod)
         {
-            glActiveTexture(GL_TEXTURE0 + 15);
-            model->GetShader()->SetInt("cubemap", 15);
-            glBindTexture(GL_TEXTURE_CUBE_MAP, engine->GetSkyboxTextureId());
-            glActiveTexture(GL_TEXTURE0);
+            const ModelInstances::LodCommands& Commands = instances.lodCommands[Lod];
+            instances.firstVisibleUniform.Set(instances.gpuCulling.GetFirstVisible(phase, Lod));
+            DrawCommands(CommandsOffset, VertexFormat::Full, Commands.firstCommand, Commands.fullCommandsCount);
+            DrawCommands(CommandsOffset, VertexFormat::Compact, Commands.firstCommand + Commands.fullCommandsCount,
+                         Commands.commandsCount - Commands.fullCommandsCount);
+            stats.drawsCount += Commands.commandsCount;
         }
 
-        glBindVertexArray(Mesh->GetVao().GetVaoId());
-        glDrawElementsInstanced(GL_TRIANGLES, Mesh->GetVao().GetIndicesCount(), GL_UNSIGNED_INT, 0, nodeArray.size());
         glBindVertexArray(0);
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+        return;
     }
+
+    // Every mesh of a LOD draws all instances of that LOD, only the instance counts change between frames
+    for (uint32_t Lod = 0; Lod < instances.lodCommands.size(); ++Lod)
+    {
+        const ModelInstances::LodCommands& Commands = instances.lodCommands[Lod];
+        GLuint VisibleCount = instances.lodOffsets[Lod + 1] - instances.lodOffsets[Lod];
+        for (uint32_t i = Commands.firstCommand; i < Commands.firstCommand + Commands.commandsCount; ++i)
+            instances.commands[i].instanceCount = VisibleCount;
+    }
+
+    PersistentBuffer& CommandBuffer = *instances.commandBuffer;
+    auto CommandsSize = static_cast<GLsizeiptr>(instances.commands.size() * sizeof(DrawElementsIndirectCommand));
+    CommandBuffer.Write(region, 0, instances.commands.data(), CommandsSize);
+    stats.uploadedBytes += CommandsSize;
+
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, CommandBuffer.GetId());
+
+    for (uint32_t Lod = 0; Lod < instances.lodCommands.size(); ++Lod)
+    {
+        if (instances.lodOffsets[Lod + 1] == instances.lodOffsets[Lod])
+            continue;
+
+        const ModelInstances::LodCommands& Commands = instances.lodCommands[Lod];
+        instances.firstVisibleUniform.Set(instances.lodOffsets[Lod]);
+        DrawCommands(CommandBuffer.GetRegionOffset(region), VertexFormat::Full, Commands.firstCommand,
+                     Commands.fullCommandsCount);
+        DrawCommands(CommandBuffer.GetRegionOffset(region), VertexFormat::Compact,
+                     Commands.firstCommand + Commands.fullCommandsCount,
+                     Commands.commandsCount - Commands.fullCommandsCount);
+        stats.drawsCount += Commands.commandsCount;
+    }
+
+    glBindVertexArray(0);
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+}
+
+void ModelRenderer::DrawShadows(uint32_t region)
+{
+    shadowShader->Activate();
+    shadowCascades->Render([this, region](uint32_t Cascade, const Frustum& CascadeFrustum,
+                                          const glm::mat4& ViewProjection)
+    {
+        shadowViewProjectionUniform.Set(ViewProjection);
+
+        uint32_t CastersCount = 0;
+        for (auto& [Model, Instances] : nodesMap)
+            CastersCount += DrawShadowCasters(Model, Instances, Cascade, CascadeFrustum, region);
+        return CastersCount;
+    });
+
+    glBindVertexArray(0);
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+}
+
+uint32_t ModelRenderer::DrawShadowCasters(Model* model, ModelInstances& instances, uint32_t cascade,
+                                          const Frustum& frustum, uint32_t region)
+{
+    if (instances.commands.empty())
+        return 0;
+
+    FrustumCulling::CullSpheres(frustum, instances.worldBounds, instances.shadowSlots);
+    auto CastersCount = static_cast<uint32_t>(instances.shadowSlots.size());
+    if (CastersCount == 0)
+        return 0;
+
+    GLuint FirstCaster = cascade * instances.capacity;
+    auto SlotsSize = static_cast<GLsizeiptr>(CastersCount * sizeof(uint32_t));
+    instances.shadowVisibleBuffer->Write(region, static_cast<GLintptr>(FirstCaster * sizeof(uint32_t)),
+                                         instances.shadowSlots.data(), SlotsSize);
+    stats.uploadedBytes += SlotsSize;
+
+    // Farther cascades spread a texel over more of the world and get away with coarser LODs
+    uint32_t Lod = isLodEnabled ? std::min<uint32_t>(cascade, instances.lodCommands.size() - 1) : 0;
+    const ModelInstances::LodCommands& Commands = instances.lodCommands[Lod];
+    auto First = instances.commands.begin() + Commands.firstCommand;
+    instances.shadowCommands.assign(First, First + Commands.commandsCount);
+    for (DrawElementsIndirectCommand& Command : instances.shadowCommands)
+        Command.instanceCount = CastersCount;
+
+    // Every LOD has a command per mesh, which is the stride between the cascades
+    PersistentBuffer& CommandBuffer = *instances.shadowCommandBuffer;
+    auto CascadeOffset = static_cast<GLintptr>(cascade * Commands.commandsCount *
+                                               sizeof(DrawElementsIndirectCommand));
+    auto CommandsSize = static_cast<GLsizeiptr>(Commands.commandsCount * sizeof(DrawElementsIndirectCommand));
+    CommandBuffer.Write(region, CascadeOffset, instances.shadowCommands.data(), CommandsSize);
+    stats.uploadedBytes += CommandsSize;
+
+    PersistentBuffer& MatrixBuffer = *instances.matrixBuffer;
+    glBindBufferRange(GL_SHADER_STORAGE_BUFFER, InstancesBinding, MatrixBuffer.GetId(),
+                      MatrixBuffer.GetRegionOffset(region), MatrixBuffer.GetRegionSize());
+
+    PersistentBuffer& VisibleBuffer = *instances.shadowVisibleBuffer;
+    glBindBufferRange(GL_SHADER_STORAGE_BUFFER, VisibleInstancesBinding, VisibleBuffer.GetId(),
+                      VisibleBuffer.GetRegionOffset(region), VisibleBuffer.GetRegionSize());
+
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, DrawDataBinding, model->GetDrawDataBuffer());
+    shadowFirstVisibleUniform.Set(FirstCaster);
+
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, CommandBuffer.GetId());
+    GLintptr BaseOffset = CommandBuffer.GetRegionOffset(region) + CascadeOffset;
+    DrawCommands(BaseOffset, VertexFormat::Full, 0, Commands.fullCommandsCount);
+    DrawCommands(BaseOffset, VertexFormat::Compact, Commands.fullCommandsCount,
+                 Commands.commandsCount - Commands.fullCommandsCount);
+    stats.drawsCount += Commands.commandsCount;
+
+    return CastersCount;
+}
+
+void ModelRenderer::DrawCommands(GLintptr baseOffset, VertexFormat format, uint32_t firstCommand,
+                                 uint32_t commandsCount)
+{
+    if (commandsCount == 0)
+        return;
+
+    GeometryBuffer::GetInstance().Bind(format);
+    GLintptr Offset = baseOffset + static_cast<GLintptr>(firstCommand * sizeof(DrawElementsIndirectCommand));
+    glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, reinterpret_cast<const void*>(Offset),
+                                static_cast<GLsizei>(commandsCount), 0);
+    stats.drawCallsCount++;
 }
 
-void ModelRenderer::UpdateMatrixBuffer(Model* model, std::set<ModelNode*>& nodeArray)
+void ModelRenderer::CreateDrawCommands(Model* model, ModelInstances& instances)
 {
-    std::vector<glm::mat4> Matrices;
-    for (ModelNode* Node : nodeArray)
+    const auto& Meshes = model->GetMeshes();
+    uint32_t LodsCount = model->GetLodsCount();
+    instances.commands.clear();
+    instances.commands.reserve(Meshes.size() * LodsCount);
+    instances.lodCommands.assign(LodsCount, {});
+    for (uint32_t Lod = 0; Lod < LodsCount; ++Lod)
     {
-        Matrices.push_back(*Node->GetWorldTransformMatrix());
+        ModelInstances::LodCommands& Commands = instances.lodCommands[Lod];
+        Commands.firstCommand = static_cast<uint32_t>(instances.commands.size());
+        for (VertexFormat Format : {VertexFormat::Full, VertexFormat::Compact})
+        {
+            for (uint32_t i = 0; i < Meshes.size(); ++i)
+            {
+                const GeometryRange& Geometry = Meshes[i]->GetGeometry();
+                if (Geometry.format != Format)
+                    continue;
+
+                // baseInstance is the draw index, the shaders look the material and dequantization of the mesh up
+                // with it. Meshes with a shorter LOD chain keep drawing their coarsest LOD.
+                const std::vector<MeshLod>& Lods = Meshes[i]->GetLods();
+                const MeshLod& MeshLevel = Lods[std::min<size_t>(Lod, Lods.size() - 1)];
+                instances.commands.push_back({MeshLevel.indicesCount, 0, MeshLevel.firstIndex, Geometry.baseVertex, i});
+            }
+
+            if (Format == VertexFormat::Full)
+                Commands.fullCommandsCount = static_cast<uint32_t>(instances.commands.size()) - Commands.firstCommand;
+        }
+        Commands.commandsCount = static_cast<uint32_t>(instances.commands.size()) - Commands.firstCommand;
+    }
+
+    if (!instances.commands.empty())
+    {
+        instances.commandBuffer = std::make_unique<PersistentBuffer>(
+                static_cast<GLsizeiptr>(instances.commands.size() * sizeof(DrawElementsIndirectCommand)));
+        instances.shadowCommandBuffer = std::make_unique<PersistentBuffer>(static_cast<GLsizeiptr>(
+                instances.lodCommands[0].commandsCount * ShadowCascades::CascadesCount *
+                sizeof(DrawElementsIndirectCommand)));
+        instances.gpuCulling.SetCommands(instances.commands);
     }
 
-    GLuint Buffer = bufferMap[model];
-    glBindBuffer(GL_ARRAY_BUFFER, Buffer);
-    glBufferData(GL_ARRAY_BUFFER, Matrices.size() * sizeof(glm::mat4), &Matrices[0], GL_DYNAMIC_DRAW);
-    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    MaterialSystem::GetInstance().SetSamplerUniforms(*model->GetShader());
+    ShadowCascades::SetSamplerUniform(*model->GetShader());
 }
 
-void ModelRenderer::AddNode(ModelNode* node)
+void ModelRenderer::GatherMovedSlots()
+{
+    for (TransformStore::Handle Handle : TransformStore::GetInstance().GetDirtyHandles())
+    {
+        if (Handle >= instanceOfHandle.size())
+            continue;
+
+        const InstanceSlot& Instance = instanceOfHandle[Handle];
+        if (Instance.instances)
+            Instance.instances->movedSlots.push_back(Instance.slot);
+    }
+}
+
+void ModelRenderer::UpdateMatrixBuffer(Model* model, ModelInstances& instances, uint32_t region)
+{
+    auto InstancesCount = static_cast<uint32_t>(instances.nodes.size());
+    stats.instancesCount += InstancesCount;
+
+    // Normal matrices of moved instances are computed in batches over runs of neighbouring slots
+    uint32_t MovedStart = 0;
+    uint32_t MovedCount = 0;
+    auto ComputeMovedRun = [&]()
+    {
+        InstanceData::ComputeNormalMatrices(instances.instanceData.data() + MovedStart, MovedCount);
+        MovedCount = 0;
+    };
+
+    std::sort(instances.movedSlots.begin(), instances.movedSlots.end());
+    const BoundingSphere& ModelBounds = model->GetBoundingSphere();
+    for (uint32_t Slot : instances.movedSlots)
+    {
+        ModelNode* Node = instances.nodes[Slot];
+        MarkSlotStale(instances, Slot);
+        BoundingSphere Bounds = ModelBounds.Transformed(*Node->GetWorldTransformMatrix());
+        if (shadowCascades)
+        {
+            // Shadows change both where the caster was and where it is now
+            shadowCascades->Invalidate(instances.worldBounds.Get(Slot));
+            shadowCascades->Invalidate(Bounds);
+        }
+        instances.worldBounds.Set(Slot, Bounds);
+        instances.instanceData[Slot].transform = *Node->GetWorldTransformMatrix();
+
+        if (MovedCount > 0 && MovedStart + MovedCount != Slot)
+            ComputeMovedRun();
+        if (MovedCount == 0)
+            MovedStart = Slot;
+        ++MovedCount;
+    }
+    ComputeMovedRun();
+    instances.movedSlots.clear();
+
+    if (InstancesCount > instances.capacity)
+        GrowInstanceBuffers(instances);
+
+    if (instances.dirtySlots.empty())
+        return;
+
+    // Neighbouring slots are written with one call, that matters for the glBufferSubData fallback
+    std::sort(instances.dirtySlots.begin(), instances.dirtySlots.end());
+
+    uint8_t RegionBit = 1 << region;
+    uint32_t RunStart = 0;
+    uint32_t RunCount = 0;
+    auto FlushRun = [&]()
+    {
+        if (RunCount == 0)
+            return;
+
+        GLsizeiptr Size = static_cast<GLsizeiptr>(RunCount * sizeof(GpuInstance));
+        instances.matrixBuffer->Write(region, RunStart * sizeof(GpuInstance), instances.instanceData.data() + RunStart,
+                                      Size);
+        stats.uploadedBytes += Size;
+        stats.uploadedMatrices += RunCount;
+        RunCount = 0;
+    };
+
+    for (uint32_t Slot : instances.dirtySlots)
+    {
+        if (!(instances.staleRegions[Slot] & RegionBit))
+            continue;
+
+        if (RunCount > 0 && RunStart + RunCount != Slot)
+            FlushRun();
+        if (RunCount == 0)
+            RunStart = Slot;
+
+        ++RunCount;
+        instances.staleRegions[Slot] &= ~RegionBit;
+    }
+    FlushRun();
+
+    std::erase_if(instances.dirtySlots, [&instances](uint32_t Slot)
+    {
+        return instances.staleRegions[Slot] == 0;
+    });
+}
+
+void ModelRenderer::CullInstances(ModelInstances& instances, const Frustum& frustum)
 {
-    nodesMap[node->GetModel()].insert(node);
-    if (bufferMap.find(node->GetModel()) == bufferMap.end())
+    if (isCullingEnabled)
+    {
+        FrustumCulling::CullSpheres(frustum, instances.worldBounds, instances.visibleSlots);
+    }
+    else
     {
-        unsigned int MatrixBuffer;
-        glGenBuffers(1, &MatrixBuffer);
-        glBindBuffer(GL_ARRAY_BUFFER, MatrixBuffer);
+        instances.visibleSlots.resize(instances.nodes.size());
+        std::iota(instances.visibleSlots.begin(), instances.visibleSlots.end(), 0);
+    }
+}
 
-        bufferMap[node->GetModel()] = MatrixBuffer;
+void ModelRenderer::CullInstancesOnGpu(Model* model, ModelInstances& instances, CullingPhase phase,
+                                       uint32_t region)
+{
+    // The region's fence has passed, so the counters it culled into last time are ready without a stall
+    GpuCullingCounters Counters;
+    if (phase == CullingPhase::Early && instances.gpuCulling.ReadCounters(region, Counters))
+    {
+        for (uint32_t Lod = 0; Lod < MeshSimplifier::MaxLodsCount; ++Lod)
+        {
+            stats.lodInstancesCount[Lod] += Counters.lodInstancesCount[Lod];
+            stats.visibleInstancesCount += Counters.lodInstancesCount[Lod];
+        }
+        stats.retestedInstancesCount += Counters.retestedCount;
+        stats.occlusionCulledCount += Counters.occludedCount;
+    }
+
+    if (instances.lodCommands.empty())
+        return;
+
+    GpuCulling::Batch Batch;
+    Batch.instancesBuffer = instances.matrixBuffer->GetId();
+    Batch.instancesOffset = instances.matrixBuffer->GetRegionOffset(region);
+    Batch.instancesSize = instances.matrixBuffer->GetRegionSize();
+    Batch.instancesCount = static_cast<uint32_t>(instances.nodes.size());
+    Batch.bounds = model->GetBoundingSphere();
+    Batch.lodsCount = static_cast<uint32_t>(instances.lodCommands.size());
+    for (uint32_t Lod = 0; Lod < Batch.lodsCount; ++Lod)
+        Batch.lodFirstCommands[Lod] = instances.lodCommands[Lod].firstCommand;
+    Batch.lodFirstCommands[Batch.lodsCount] = static_cast<uint32_t>(instances.commands.size());
+
+    gpuCulling.Cull(Batch, instances.gpuCulling, phase, region);
+}
+
+void ModelRenderer::SelectLods(ModelInstances& instances, const LodView& view, uint32_t region)
+{
+    auto VisibleCount = static_cast<uint32_t>(instances.visibleSlots.size());
+    auto LodsCount = static_cast<uint32_t>(instances.lodCommands.size());
+    if (!isLodEnabled)
+        LodsCount = std::min(LodsCount, 1u);
 
-        for (const auto& Mesh : node->GetModel()->GetMeshes())
+    std::array<uint32_t, MeshSimplifier::MaxLodsCount> LodCounts{};
+    if (LodsCount > 1)
+    {
+        instances.visibleLods.resize(VisibleCount);
+        const BoundingSpheres& Bounds = instances.worldBounds;
+        for (uint32_t i = 0; i < VisibleCount; ++i)
         {
-            glBindVertexArray(Mesh->GetVao().GetVaoId());
-            GLsizei SizeOfVec4 = sizeof(glm::vec4);
-            glEnableVertexAttribArray(3);
-            glVertexAttribPointer(3, 4, GL_FLOAT, GL_FALSE, 4 * SizeOfVec4, (void*)0);
-            glEnableVertexAttribArray(4);
-            glVertexAttribPointer(4, 4, GL_FLOAT, GL_FALSE, 4 * SizeOfVec4, (void*)(SizeOfVec4));
-            glEnableVertexAttribArray(5);
-            glVertexAttribPointer(5, 4, GL_FLOAT, GL_FALSE, 4 * SizeOfVec4, (void*)(2 * SizeOfVec4));
-            glEnableVertexAttribArray(6);
-            glVertexAttribPointer(6, 4, GL_FLOAT, GL_FALSE, 4 * SizeOfVec4, (void*)(3 * SizeOfVec4));
-
-            glVertexAttribDivisor(3, 1);
-            glVertexAttribDivisor(4, 1);
-            glVertexAttribDivisor(5, 1);
-            glVertexAttribDivisor(6, 1);
-
-            glBindVertexArray(0);
+            uint32_t Slot = instances.visibleSlots[i];
+            glm::vec3 Center(Bounds.centersX[Slot], Bounds.centersY[Slot], Bounds.centersZ[Slot]);
+            float Radius = Bounds.radii[Slot];
+            float Distance = glm::length(Center - view.position);
+
+            // Instances the camera is inside of always get the full detail
+            uint32_t Lod = 0;
+            if (Distance > Radius)
+            {
+                float ScreenSize = Radius * view.projectionScale / Distance;
+                while (Lod + 1 < LodsCount && ScreenSize < LodScreenSizes[Lod])
+                    ++Lod;
+            }
+
+            instances.visibleLods[i] = static_cast<uint8_t>(Lod);
+            LodCounts[Lod]++;
         }
     }
+    else
+    {
+        LodCounts[0] = VisibleCount;
+    }
+
+    instances.lodOffsets[0] = 0;
+    for (uint32_t Lod = 0; Lod < MeshSimplifier::MaxLodsCount; ++Lod)
+    {
+        instances.lodOffsets[Lod + 1] = instances.lodOffsets[Lod] + LodCounts[Lod];
+        stats.lodInstancesCount[Lod] += LodCounts[Lod];
+    }
+
+    // Counting sort keeps slots in order within every LOD
+    if (LodsCount > 1 && LodCounts[0] != VisibleCount)
+    {
+        std::array<uint32_t, MeshSimplifier::MaxLodsCount> Cursors;
+        std::copy_n(instances.lodOffsets.begin(), Cursors.size(), Cursors.begin());
+
+        instances.sortedSlots.resize(VisibleCount);
+        for (uint32_t i = 0; i < VisibleCount; ++i)
+            instances.sortedSlots[Cursors[instances.visibleLods[i]]++] = instances.visibleSlots[i];
+        std::swap(instances.sortedSlots, instances.visibleSlots);
+    }
+
+    if (instances.visibleSlots.empty())
+        return;
+
+    auto Size = static_cast<GLsizeiptr>(instances.visibleSlots.size() * sizeof(uint32_t));
+    instances.visibleBuffer->Write(region, 0, instances.visibleSlots.data(), Size);
+    stats.uploadedBytes += Size;
+    stats.visibleInstancesCount += instances.visibleSlots.size();
+}
+
+void ModelRenderer::MarkSlotStale(ModelInstances& instances, uint32_t slot)
+{
+    if (instances.staleRegions[slot] == 0)
+        instances.dirtySlots.push_back(slot);
+
+    instances.staleRegions[slot] = AllRegionsMask;
+}
+
+void ModelRenderer::GrowInstanceBuffers(ModelInstances& instances)
+{
+    uint32_t NewCapacity = std::max(MinimalCapacity, instances.capacity);
+    while (NewCapacity < instances.nodes.size())
+        NewCapacity *= 2;
+
+    // Immutable storage can not be resized, the old buffer may only go away once the GPU is done with it
+    WaitForAllRegions();
+
+    instances.matrixBuffer = std::make_unique<PersistentBuffer>(NewCapacity * sizeof(GpuInstance));
+    instances.visibleBuffer = std::make_unique<PersistentBuffer>(NewCapacity * sizeof(uint32_t));
+    instances.shadowVisibleBuffer = std::make_unique<PersistentBuffer>(
+            NewCapacity * ShadowCascades::CascadesCount * sizeof(uint32_t));
+    instances.gpuCulling.Resize(NewCapacity);
+    instances.capacity = NewCapacity;
+
+    instances.dirtySlots.clear();
+    std::fill(instances.staleRegions.begin(), instances.staleRegions.end(), 0);
+    for (uint32_t Slot = 0; Slot < instances.nodes.size(); ++Slot)
+        MarkSlotStale(instances, Slot);
+}
+
+void ModelRenderer::WaitForRegion(uint32_t region)
+{
+    GLsync& Fence = regionFences[region];
+    if (!Fence)
+        return;
+
+    constexpr GLuint64 TimeoutNanoseconds = 1'000'000'000;
+    GLenum WaitResult = glClientWaitSync(Fence, GL_SYNC_FLUSH_COMMANDS_BIT, TimeoutNanoseconds);
+    while (WaitResult == GL_TIMEOUT_EXPIRED)
+    {
+        SPDLOG_WARN("Waiting for instance buffer region {} takes longer than a second", region);
+        WaitResult = glClientWaitSync(Fence, GL_SYNC_FLUSH_COMMANDS_BIT, TimeoutNanoseconds);
+    }
+
+    glDeleteSync(Fence);
+    Fence = nullptr;
+}
+
+void ModelRenderer::WaitForAllRegions()
+{
+    for (uint32_t Region = 0; Region < PersistentBuffer::RegionCount; ++Region)
+        WaitForRegion(Region);
+}
+
+void ModelRenderer::AddNode(ModelNode* node)
+{
+    ModelInstances& Instances = nodesMap[node->GetModel()];
+    if (Instances.nodes.empty())
+    {
+        Instances.cubemapUniform = node->GetModel()->GetShader()->GetUniform<int>("cubemap");
+        Instances.firstVisibleUniform = node->GetModel()->GetShader()->GetUniform<GLuint>("FirstVisibleInstance");
+        CreateDrawCommands(node->GetModel(), Instances);
+    }
+
+    auto Slot = static_cast<uint32_t>(Instances.nodes.size());
+    Instances.nodes.push_back(node);
+    Instances.staleRegions.push_back(0);
+    MarkSlotStale(Instances, Slot);
+
+    GpuInstance& Instance = Instances.instanceData.emplace_back();
+    Instance.transform = *node->GetWorldTransformMatrix();
+    InstanceData::ComputeNormalMatrices(&Instance, 1);
+
+    BoundingSphere Bounds = node->GetModel()->GetBoundingSphere().Transformed(*node->GetWorldTransformMatrix());
+    Instances.worldBounds.Resize(Slot + 1);
+    Instances.worldBounds.Set(Slot, Bounds);
+    if (shadowCascades)
+        shadowCascades->Invalidate(Bounds);
+
+    TransformStore::Handle Handle = node->GetLocalTransform()->GetHandle();
+    if (Handle >= instanceOfHandle.size())
+        instanceOfHandle.resize(Handle + 1);
+    instanceOfHandle[Handle] = {&Instances, Slot};
 }
 
 void ModelRenderer::RemoveNode(ModelNode* node)
 {
-    auto NodesSet = nodesMap[node->GetModel()];
-    NodesSet.erase(node);
-    if (NodesSet.empty())
+    TransformStore::Handle Handle = node->GetLocalTransform()->GetHandle();
+    if (Handle >= instanceOfHandle.size() || !instanceOfHandle[Handle].instances)
+        return;
+
+    auto InstancesIterator = nodesMap.find(node->GetModel());
+    ModelInstances& Instances = InstancesIterator->second;
+
+    // The last instance takes over the freed slot so the drawn range stays contiguous
+    uint32_t Slot = instanceOfHandle[Handle].slot;
+    uint32_t LastSlot = static_cast<uint32_t>(Instances.nodes.size()) - 1;
+    instanceOfHandle[Handle] = {};
+
+    if (shadowCascades)
+        shadowCascades->Invalidate(Instances.worldBounds.Get(Slot));
+
+    if (Slot != LastSlot)
+    {
+        ModelNode* MovedNode = Instances.nodes[LastSlot];
+        Instances.nodes[Slot] = MovedNode;
+        instanceOfHandle[MovedNode->GetLocalTransform()->GetHandle()].slot = Slot;
+        MarkSlotStale(Instances, Slot);
+        Instances.worldBounds.Move(LastSlot, Slot);
+        Instances.instanceData[Slot] = Instances.instanceData[LastSlot];
+    }
+
+    Instances.nodes.pop_back();
+    Instances.staleRegions.pop_back();
+    Instances.instanceData.pop_back();
+    Instances.worldBounds.Resize(LastSlot);
+    std::erase(Instances.dirtySlots, LastSlot);
+    std::erase(Instances.movedSlots, LastSlot);
+
+    if (Instances.nodes.empty())
+    {
+        WaitForAllRegions();
+        nodesMap.erase(InstancesIterator);
+    }
+}
+
+ModelInstances* ModelRenderer::FindInstances(Model* model)
+{
+    auto Iterator = nodesMap.find(model);
+    return Iterator != nodesMap.end() ? &Iterator->second : nullptr;
+}
+
+const ModelRendererStats& ModelRenderer::GetStats() const
+{
+    return stats;
+}
+
+bool ModelRenderer::IsCullingEnabled() const
+{
+    return isCullingEnabled;
+}
+
+void ModelRenderer::SetCullingEnabled(bool isEnabled)
+{
+    isCullingEnabled = isEnabled;
+}
+
+void ModelRenderer::SetShadowCascades(ShadowCascades* cascades)
+{
+    shadowCascades = cascades;
+    if (!shadowCascades)
+        return;
+
+    if (!shadowShader)
     {
-        nodesMap.erase(node->GetModel());
-        GLuint Buffer = bufferMap[node->GetModel()];
-        glDeleteBuffers(1, &Buffer);
-        bufferMap.erase(node->GetModel());
+        shadowShader = AssetRegistry::GetInstance().GetShader("res/shaders/shadow_depth.vert",
+                                                              "res/shaders/shadow_depth.frag");
+        shadowFirstVisibleUniform = shadowShader->GetUniform<GLuint>("FirstVisibleInstance");
+        shadowViewProjectionUniform = shadowShader->GetUniform<glm::mat4>("LightViewProjection");
     }
+    shadowCascades->InvalidateAll();
+}
+
+bool ModelRenderer::IsLodEnabled() const
+{
+    return isLodEnabled;
+}
+
+void ModelRenderer::SetLodEnabled(bool isEnabled)
+{
+    isLodEnabled = isEnabled;
+}
+
+bool ModelRenderer::IsGpuCullingEnabled() const
+{
+    return isGpuCullingEnabled;
+}
+
+void ModelRenderer::SetGpuCullingEnabled(bool isEnabled)
+{
+    isGpuCullingEnabled = isEnabled;
+}
+
+bool ModelRenderer::IsOcclusionCullingEnabled() const
+{
+    return isOcclusionCullingEnabled;
+}
+
+void ModelRenderer::SetOcclusionCullingEnabled(bool isEnabled)
+{
+    isOcclusionCullingEnabled = isEnabled;
 }
@@ -12,15 +12,17 @@ void CameraNode::Update(struct MainEngine* engine, float seconds, float deltaSec
     if (engine->currentCamera != this)
         return;
 
-    glm::vec<2, int> currentResolution{};
-    glfwGetFramebufferSize(engine->GetWindow(), &currentResolution.x, &currentResolution.y);
-
-    camera->SetResolution(currentResolution);
+    camera->SetResolution(engine->GetFramebufferSize());
 
     camera->SetPosition(GetWorldPosition());
     camera->SetRotation(GetForwardVector(), GetUpVector());
 }
 
+bool CameraNode::IsUpdateThreadSafe() const {
+    // Queries the framebuffer size
+    return false;
+}
+
 void CameraNode::SetActive() {
     engine->currentCamera = this;
 }
@@ -4,10 +4,12 @@
 #include "Nodes/ModelNode.h"
 #include "Model.h"
 #include "ModelRenderer.h"
+#include "ShaderWrapper.h"
 
 ModelNode::ModelNode(std::shared_ptr<struct Model> ModelPtr, ModelRenderer* Renderer)
         : Node(), ModelPtr(ModelPtr), Renderer(Renderer)
 {
+    TransformUniform = ModelPtr->GetShader()->GetUniform<glm::mat4>("Transform");
     Renderer->AddNode(this);
 }
 
@@ -19,7 +21,7 @@ void ModelNode::Draw(glm::mat4& ParentTransform, bool IsDirty)
         return;
 
     ModelPtr->GetShader()->Activate();
-    ModelPtr->GetShader()->SetMat4F("Transform", *GetWorldTransformMatrix());
+    TransformUniform.Set(*GetWorldTransformMatrix());
     ModelPtr->Draw();
 }
 
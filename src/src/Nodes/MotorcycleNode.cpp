@@ -6,12 +6,14 @@
 #include "LoggingMacros.h"
 #include <array>
 #include "Nodes/CameraNode.h"
+#include "AssetRegistry.h"
 
 MotorcycleNode::MotorcycleNode(MainEngine* engine, ModelRenderer* renderer) {
-    auto modelShader = std::make_shared<ShaderWrapper>("res/shaders/instanced.vert", "res/shaders/motur_model.frag");
-    auto baseModel = std::make_shared<Model>("res/models/Motur/MoturBody.obj", modelShader);
-    auto steeringModel = std::make_shared<Model>("res/models/Motur/MoturSteering.obj", modelShader);
-    auto wheelModel = std::make_shared<Model>("res/models/Motur/MoturWheel.obj", modelShader);
+    AssetRegistry& assets = AssetRegistry::GetInstance();
+    auto modelShader = assets.GetShader("res/shaders/instanced.vert", "res/shaders/motur_model.frag");
+    auto baseModel = assets.GetModel("res/models/Motur/MoturBody.obj", modelShader);
+    auto steeringModel = assets.GetModel("res/models/Motur/MoturSteering.obj", modelShader);
+    auto wheelModel = assets.GetModel("res/models/Motur/MoturWheel.obj", modelShader);
 
     auto root = std::make_shared<Node>();
     root->GetLocalTransform()->SetRotation(glm::rotate(glm::quat(), {0.f, glm::radians(90.f), 0.f}));
@@ -52,6 +54,11 @@ void MotorcycleNode::Update(MainEngine* engine, float seconds, float deltaSecond
     AnimateWheels(deltaSeconds);
 }
 
+bool MotorcycleNode::IsUpdateThreadSafe() const {
+    // Only the active motorcycle reads keyboard input
+    return !isActive;
+}
+
 void MotorcycleNode::AnimateWheels(float deltaSeconds) {
     std::array wheels = {frontWheel, backWheel};
 
@@ -1,70 +1,153 @@
 #include "Nodes/Node.h"
+
+#include <algorithm>
+#include <mutex>
+
+#include "JobSystem.h"
 #include "LoggingMacros.h"
 
-Node::Node() : localTransform(std::make_shared<Transform>()), worldTransformMatrix(1.f) {
+namespace {
+    constexpr size_t UpdateBatchSize = 16;
+
+    struct ParallelUpdateContext {
+        JobSystem* jobSystem;
+        JobSystem::Counter counter;
+
+        std::mutex deferredMutex;
+        std::vector<Node*> deferredNodes;
+    };
+
+    ParallelUpdateContext* parallelUpdate = nullptr;
+}
+
+Node::Node() : localTransform() {
+}
+
+Node::~Node() {
+    ClearChildren();
 }
 
 Transform* Node::GetLocalTransform() {
-    return localTransform.get();
+    return &localTransform;
 }
 
 const glm::mat4* Node::GetWorldTransformMatrix() const {
-    return &worldTransformMatrix;
+    return &TransformStore::GetInstance().GetWorldMatrix(localTransform.handle);
 }
 
 void Node::Draw() {
     glm::mat4 WorldMatrix = *GetWorldTransformMatrix();
-    Draw(WorldMatrix, localTransform->isDirty);
+    Draw(WorldMatrix, TransformStore::GetInstance().IsLocalDirty(localTransform.handle));
 }
 
-void Node::CalculateWorldTransform() {
-    glm::mat4 TempTransformMatrix = glm::mat4(1.f);
-    CalculateWorldTransform(TempTransformMatrix, localTransform->isDirty);
+void Node::CalculateWorldTransform(JobSystem* jobSystem) {
+    TransformStore::GetInstance().CalculateWorldTransforms(jobSystem);
 }
 
 void Node::Draw(glm::mat4& parentTransform, bool isDirty) {
+    glm::mat4 WorldMatrix = *GetWorldTransformMatrix();
     for (const std::shared_ptr<Node>& Child: childrenList) {
-        Child->Draw(worldTransformMatrix, isDirty);
+        Child->Draw(WorldMatrix, isDirty);
     }
 }
 
-void Node::CalculateWorldTransform(glm::mat4& parentTransform, bool isDirty) {
-    isDirty |= localTransform->isDirty;
-    wasDirty = isDirty;
-    if (isDirty) {
-        worldTransformMatrix = parentTransform * localTransform->GetMatrix();
-        localTransform->isDirty = false;
-    }
+void Node::AddChild(std::shared_ptr<Node> newChild) {
+    if (newChild.get() == this || newChild.get() == parent)
+        return;
 
+    newChild->parent = this;
+    childrenList.push_back(newChild);
+    TransformStore::GetInstance().SetParent(newChild->localTransform.handle, localTransform.handle);
+}
 
+void Node::ClearChildren() {
     for (const std::shared_ptr<Node>& child: childrenList) {
-        child->CalculateWorldTransform(worldTransformMatrix, isDirty);
+        child->parent = nullptr;
+        TransformStore::GetInstance().SetParent(child->localTransform.handle, TransformStore::InvalidHandle);
     }
+    childrenList.clear();
 }
 
-void Node::AddChild(std::shared_ptr<Node> newChild) {
-    if (newChild.get() == this || newChild.get() == parent)
+void Node::Update(class MainEngine* engine, float seconds, float deltaSeconds) {
+    if (!parallelUpdate) {
+        for (const std::shared_ptr<Node>& childNode: childrenList) {
+            childNode->Update(engine, seconds, deltaSeconds);
+        }
         return;
+    }
 
-    newChild->parent = this;
-    childrenList.push_back(newChild);
-    newChild->CalculateWorldTransform(worldTransformMatrix, true);
+    JobSystem& jobSystem = *parallelUpdate->jobSystem;
+    std::vector<Node*> batch;
+    auto ScheduleBatch = [&]() {
+        jobSystem.Schedule(parallelUpdate->counter, [batch = std::move(batch), engine, seconds, deltaSeconds]() {
+            for (Node* node: batch) {
+                node->Update(engine, seconds, deltaSeconds);
+            }
+        });
+        batch.clear();
+    };
+
+    for (const std::shared_ptr<Node>& childNode: childrenList) {
+        if (childNode->IsUpdateThreadSafe()) {
+            batch.push_back(childNode.get());
+            if (batch.size() == UpdateBatchSize)
+                ScheduleBatch();
+        } else if (jobSystem.IsWorkerThread()) {
+            std::lock_guard<std::mutex> lock(parallelUpdate->deferredMutex);
+            parallelUpdate->deferredNodes.push_back(childNode.get());
+        } else {
+            childNode->Update(engine, seconds, deltaSeconds);
+        }
+    }
+
+    if (!batch.empty())
+        ScheduleBatch();
 }
 
-void Node::Update(class MainEngine* engine, float seconds, float deltaSeconds) {
-    for (std::shared_ptr<Node> childNode: childrenList) {
-        childNode->Update(engine, seconds, deltaSeconds);
+void Node::UpdateParallel(JobSystem& jobSystem, MainEngine* engine, float seconds, float deltaSeconds) {
+    ParallelUpdateContext context{&jobSystem};
+    parallelUpdate = &context;
+
+    Update(engine, seconds, deltaSeconds);
+
+    // Nodes that have to run on this thread are collected by the workers and run after each join,
+    // in scene order so the result does not depend on scheduling.
+    while (true) {
+        jobSystem.Wait(context.counter);
+
+        std::vector<Node*> deferredNodes;
+        {
+            std::lock_guard<std::mutex> lock(context.deferredMutex);
+            deferredNodes.swap(context.deferredNodes);
+        }
+
+        if (deferredNodes.empty())
+            break;
+
+        TransformStore& store = TransformStore::GetInstance();
+        std::sort(deferredNodes.begin(), deferredNodes.end(), [&store](Node* a, Node* b) {
+            return store.GetSlot(a->localTransform.handle) < store.GetSlot(b->localTransform.handle);
+        });
+
+        for (Node* node: deferredNodes) {
+            node->Update(engine, seconds, deltaSeconds);
+        }
     }
+
+    parallelUpdate = nullptr;
+}
+
+bool Node::IsUpdateThreadSafe() const {
+    return true;
 }
 
 bool Node::WasDirtyThisFrame() const {
-    return wasDirty;
+    return TransformStore::GetInstance().WasDirty(localTransform.handle);
 }
 
 std::shared_ptr<Node> Node::Clone() const {
     auto result = std::make_shared<Node>();
-    result->localTransform = std::make_shared<Transform>(*this->localTransform);
-    result->wasDirty = true;
+    result->localTransform = localTransform;
 
     for (const auto& node: childrenList) {
         result->AddChild(node->Clone());
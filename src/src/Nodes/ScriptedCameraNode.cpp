@@ -0,0 +1,23 @@
+#include "Nodes/ScriptedCameraNode.h"
+
+#include <utility>
+#include <glm/gtc/quaternion.hpp>
+
+ScriptedCameraNode::ScriptedCameraNode(MainEngine* engine, CameraPath path)
+: CameraNode(engine), path(std::move(path)) {
+}
+
+void ScriptedCameraNode::Update(struct MainEngine* engine, float seconds, float deltaSeconds) {
+    glm::vec3 position, target;
+    path.Evaluate(seconds, position, target);
+
+    // Nodes look along their local Z axis
+    glm::vec3 forward = glm::normalize(target - position);
+    glm::vec3 right = glm::normalize(glm::cross(glm::vec3(0.f, 1.f, 0.f), forward));
+    glm::vec3 up = glm::cross(forward, right);
+
+    GetLocalTransform()->SetPosition(position);
+    GetLocalTransform()->SetRotation(glm::quat_cast(glm::mat3(right, up, forward)));
+
+    CameraNode::Update(engine, seconds, deltaSeconds);
+}
@@ -0,0 +1,92 @@
+#include "OffscreenFramebuffer.h"
+
+#include <algorithm>
+
+OffscreenFramebuffer::OffscreenFramebuffer(const glm::ivec2& Size, uint32_t SamplesCount)
+: size(Size)
+{
+    GLint MaxSamples = 1;
+    GLint MaxDepthSamples = 1;
+    glGetIntegerv(GL_MAX_SAMPLES, &MaxSamples);
+    glGetIntegerv(GL_MAX_DEPTH_TEXTURE_SAMPLES, &MaxDepthSamples);
+    samplesCount = std::clamp<uint32_t>(SamplesCount, 1, static_cast<uint32_t>(std::min(MaxSamples, MaxDepthSamples)));
+
+    // Renderbuffers and textures only mix in one multisampled framebuffer with fixed sample locations
+    glGenRenderbuffers(1, &colorBuffer);
+    glBindRenderbuffer(GL_RENDERBUFFER, colorBuffer);
+    if (samplesCount > 1)
+        glRenderbufferStorageMultisample(GL_RENDERBUFFER, static_cast<GLsizei>(samplesCount), GL_RGBA8, size.x, size.y);
+    else
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, size.x, size.y);
+    glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+    GLenum DepthTarget = samplesCount > 1 ? GL_TEXTURE_2D_MULTISAMPLE : GL_TEXTURE_2D;
+    glGenTextures(1, &depthTexture);
+    glBindTexture(DepthTarget, depthTexture);
+    if (samplesCount > 1)
+    {
+        glTexStorage2DMultisample(GL_TEXTURE_2D_MULTISAMPLE, static_cast<GLsizei>(samplesCount), GL_DEPTH24_STENCIL8,
+                                  size.x, size.y, GL_TRUE);
+    }
+    else
+    {
+        glTexStorage2D(GL_TEXTURE_2D, 1, GL_DEPTH24_STENCIL8, size.x, size.y);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    }
+    glBindTexture(DepthTarget, 0);
+
+    glGenFramebuffers(1, &framebuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, colorBuffer);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, DepthTarget, depthTexture, 0);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+OffscreenFramebuffer::~OffscreenFramebuffer()
+{
+    glDeleteFramebuffers(1, &framebuffer);
+    glDeleteRenderbuffers(1, &colorBuffer);
+    glDeleteTextures(1, &depthTexture);
+}
+
+void OffscreenFramebuffer::Bind() const
+{
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+}
+
+void OffscreenFramebuffer::BlitToDefault() const
+{
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+    glBlitFramebuffer(0, 0, size.x, size.y, 0, 0, size.x, size.y, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+bool OffscreenFramebuffer::IsComplete() const
+{
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    bool IsComplete = glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    return IsComplete;
+}
+
+GLuint OffscreenFramebuffer::GetId() const
+{
+    return framebuffer;
+}
+
+const glm::ivec2& OffscreenFramebuffer::GetSize() const
+{
+    return size;
+}
+
+GLuint OffscreenFramebuffer::GetDepthTexture() const
+{
+    return depthTexture;
+}
+
+uint32_t OffscreenFramebuffer::GetSamplesCount() const
+{
+    return samplesCount;
+}
@@ -0,0 +1,94 @@
+#include "PersistentBuffer.h"
+
+#include <cstring>
+
+PersistentBuffer::PersistentBuffer(GLsizeiptr regionSize) : regionSize(regionSize)
+{
+    glGenBuffers(1, &bufferId);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, bufferId);
+
+    GLsizeiptr TotalSize = regionSize * RegionCount;
+    if (IsBufferStorageSupported())
+    {
+        GLbitfield Flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        glBufferStorage(GL_COPY_WRITE_BUFFER, TotalSize, nullptr, Flags);
+        mappedData = static_cast<uint8_t*>(glMapBufferRange(GL_COPY_WRITE_BUFFER, 0, TotalSize, Flags));
+    }
+    else
+    {
+        glBufferData(GL_COPY_WRITE_BUFFER, TotalSize, nullptr, GL_DYNAMIC_DRAW);
+    }
+
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+}
+
+PersistentBuffer::~PersistentBuffer()
+{
+    if (mappedData)
+    {
+        glBindBuffer(GL_COPY_WRITE_BUFFER, bufferId);
+        glUnmapBuffer(GL_COPY_WRITE_BUFFER);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    }
+
+    glDeleteBuffers(1, &bufferId);
+}
+
+void PersistentBuffer::Write(uint32_t region, GLintptr offset, const void* data, GLsizeiptr size)
+{
+    GLintptr BufferOffset = GetRegionOffset(region) + offset;
+
+    if (mappedData)
+    {
+        std::memcpy(mappedData + BufferOffset, data, size);
+        return;
+    }
+
+    glBindBuffer(GL_COPY_WRITE_BUFFER, bufferId);
+    glBufferSubData(GL_COPY_WRITE_BUFFER, BufferOffset, size, data);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+}
+
+GLuint PersistentBuffer::GetId() const
+{
+    return bufferId;
+}
+
+GLsizeiptr PersistentBuffer::GetRegionSize() const
+{
+    return regionSize;
+}
+
+GLintptr PersistentBuffer::GetRegionOffset(uint32_t region) const
+{
+    return region * regionSize;
+}
+
+bool PersistentBuffer::IsPersistentlyMapped() const
+{
+    return mappedData != nullptr;
+}
+
+void PersistentBuffer::LoadBufferStorage(GLADloadproc load)
+{
+    if (GLAD_GL_VERSION_4_4)
+        return;
+
+    GLint ExtensionsCount = 0;
+    glGetIntegerv(GL_NUM_EXTENSIONS, &ExtensionsCount);
+    for (GLint i = 0; i < ExtensionsCount; ++i)
+    {
+        const char* Extension = reinterpret_cast<const char*>(glGetStringi(GL_EXTENSIONS, i));
+        if (Extension != nullptr && std::strcmp(Extension, "GL_ARB_buffer_storage") == 0)
+        {
+            glad_glBufferStorage = reinterpret_cast<PFNGLBUFFERSTORAGEPROC>(load("glBufferStorage"));
+            return;
+        }
+    }
+}
+
+bool PersistentBuffer::IsBufferStorageSupported()
+{
+    // Only set by glad on GL 4.4, or by LoadBufferStorage when the extension is exposed
+    return glBufferStorage != nullptr;
+}
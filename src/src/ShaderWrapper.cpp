@@ -1,66 +1,58 @@
 #include "ShaderWrapper.h"
 
+#include <algorithm>
 #include <fstream>
+#include <random>
+#include <vector>
+#include <sstream>
 #include <glad/glad.h>
 #include <glm/ext.hpp>
 #include <utility>
 #include <LoggingMacros.h>
 
-void ShaderWrapper::SetFloat(const std::string& name, float value) const
+#include "Hash.h"
+
+template<typename T>
+void ShaderWrapper::SetUniform(std::string_view name, const T& value) const
 {
-    GLint UniformLocation = GetUniformLocation(name);
-    if (UniformLocation == -1)
+    UniformHandle<T> Uniform = GetUniform<T>(name);
+    if (!Uniform.IsValid())
     {
-        SPDLOG_WARN(name + " not found");
+        SPDLOG_WARN("{} not found", name);
+        return;
     }
-    glUniform1f(UniformLocation, value);
+    Uniform.Set(value);
 }
 
-void ShaderWrapper::SetInt(const std::string& name, int value) const
+void ShaderWrapper::SetFloat(std::string_view name, float value) const
 {
-    GLint UniformLocation = GetUniformLocation(name);
-    if (UniformLocation == -1)
-    {
-        SPDLOG_WARN(name + " not found");
-    }
-    glUniform1i(UniformLocation, value);
+    SetUniform(name, value);
 }
 
-void ShaderWrapper::SetBool(const std::string& name, bool value) const
+void ShaderWrapper::SetInt(std::string_view name, int value) const
 {
-    GLint UniformLocation = GetUniformLocation(name);
-    if (UniformLocation == -1)
-    {
-        SPDLOG_WARN(name + " not found");
-    }
-    glUniform1i(UniformLocation, static_cast<GLint>(value));
+    SetUniform(name, value);
 }
 
-void ShaderWrapper::SetVec4F(const std::string& name, glm::vec4 value) const
+void ShaderWrapper::SetBool(std::string_view name, bool value) const
 {
-    GLint UniformLocation = GetUniformLocation(name);
-    if (UniformLocation == -1)
-    {
-        SPDLOG_WARN(name + " not found");
-    }
-    glUniform4f(UniformLocation, value.x, value.y, value.z, value.w);
+    SetUniform(name, value);
 }
 
-void ShaderWrapper::SetMat4F(const std::string& name, glm::mat4 value) const
+void ShaderWrapper::SetVec4F(std::string_view name, glm::vec4 value) const
 {
-    GLint UniformLocation = GetUniformLocation(name);
-    if (UniformLocation == -1)
-    {
-        SPDLOG_WARN(name + " not found");
-    }
-    glUniformMatrix4fv(UniformLocation, 1, GL_FALSE, glm::value_ptr(value));
+    SetUniform(name, value);
 }
 
-GLint ShaderWrapper::GetUniformLocation(const std::string& name) const
+void ShaderWrapper::SetMat4F(std::string_view name, glm::mat4 value) const
 {
-    GLint UniformLocation = glGetUniformLocation(shaderProgramId, name.c_str());
+    SetUniform(name, value);
+}
 
-    return UniformLocation;
+GLint ShaderWrapper::GetUniformLocation(std::string_view name) const
+{
+    auto Iterator = uniformLocations.find(name);
+    return Iterator != uniformLocations.end() ? Iterator->second : -1;
 }
 
 GLuint ShaderWrapper::GetShaderProgramId() const
@@ -68,6 +60,14 @@ GLuint ShaderWrapper::GetShaderProgramId() const
     return shaderProgramId;
 }
 
+bool ShaderWrapper::IsLinked() const
+{
+    GLint ProgramLinkingResult = GL_FALSE;
+    if (glIsProgram(shaderProgramId))
+        glGetProgramiv(shaderProgramId, GL_LINK_STATUS, &ProgramLinkingResult);
+    return ProgramLinkingResult == GL_TRUE;
+}
+
 void ShaderWrapper::Activate() const
 {
     glUseProgram(shaderProgramId);
@@ -103,35 +103,73 @@ ShaderWrapper::ShaderWrapper(std::string vertexShaderPath, std::string fragmentS
 ShaderWrapper::ShaderWrapper(std::string vertexShaderPath, std::string fragmentShaderPath,
                              std::string geometryShaderPath)
 {
-    GLuint VertexShader, FragmentShader;
+    bool HasGeometryShader = geometryShaderPath != "${-1}";
 
-    VertexShader = CompileVertexShader(vertexShaderPath);
-    FragmentShader = CompileFragmentShader(fragmentShaderPath);
-    if (geometryShaderPath != "${-1}")
-    {
-        GLuint GeometryShader = CompileGeometryShader(geometryShaderPath);
-        LinkProgram(VertexShader, FragmentShader, GeometryShader);
-    }
-    else
+    std::string VertexShaderCode, FragmentShaderCode, GeometryShaderCode;
+    LoadShader(vertexShaderPath, VertexShaderCode);
+    LoadShader(fragmentShaderPath, FragmentShaderCode);
+    if (HasGeometryShader)
+        LoadShader(geometryShaderPath, GeometryShaderCode);
+
+    std::filesystem::path BinaryPath = GetProgramBinaryPath(VertexShaderCode, FragmentShaderCode, GeometryShaderCode);
+    if (LoadProgramBinary(BinaryPath))
     {
-        LinkProgram(VertexShader, FragmentShader, 0);
+        SPDLOG_DEBUG("Loaded program binary for {} and {}", vertexShaderPath, fragmentShaderPath);
+        ReflectUniforms();
+        return;
     }
 
+    GLuint VertexShader, FragmentShader;
+    GLuint GeometryShader = 0;
+
+    VertexShader = CompileVertexShader(VertexShaderCode);
+    FragmentShader = CompileFragmentShader(FragmentShaderCode);
+    if (HasGeometryShader)
+        GeometryShader = CompileGeometryShader(GeometryShaderCode);
+
+    if (LinkProgram({VertexShader, FragmentShader, GeometryShader}))
+        SaveProgramBinary(BinaryPath);
+
     glDeleteShader(VertexShader);
     glDeleteShader(FragmentShader);
+    if (GeometryShader != 0)
+        glDeleteShader(GeometryShader);
+}
+
+ShaderWrapper::ShaderWrapper(std::string computeShaderPath)
+{
+    std::string ComputeShaderCode;
+    LoadShader(computeShaderPath, ComputeShaderCode);
+
+    // The compute source takes the slot of the fragment source, no graphics program has an empty vertex stage
+    std::filesystem::path BinaryPath = GetProgramBinaryPath("", ComputeShaderCode, "");
+    if (LoadProgramBinary(BinaryPath))
+    {
+        SPDLOG_DEBUG("Loaded program binary for {}", computeShaderPath);
+        ReflectUniforms();
+        return;
+    }
+
+    GLuint ComputeShader = CompileComputeShader(ComputeShaderCode);
+    if (LinkProgram({ComputeShader}))
+        SaveProgramBinary(BinaryPath);
 
+    glDeleteShader(ComputeShader);
 }
 
+ShaderWrapper::~ShaderWrapper()
+{
+    glDeleteProgram(shaderProgramId);
+}
 
-void ShaderWrapper::LinkProgram(GLuint vertexShader, GLuint fragmentShader, GLuint geometryShader = 0)
+bool ShaderWrapper::LinkProgram(std::initializer_list<GLuint> shaders)
 {
     shaderProgramId = glCreateProgram();
-    glAttachShader(shaderProgramId, vertexShader);
-    glAttachShader(shaderProgramId, fragmentShader);
-
-    if (geometryShader != 0)
+    glProgramParameteri(shaderProgramId, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+    for (GLuint Shader : shaders)
     {
-        glAttachShader(shaderProgramId, geometryShader);
+        if (Shader != 0)
+            glAttachShader(shaderProgramId, Shader);
     }
 
     glLinkProgram(shaderProgramId);
@@ -143,42 +181,100 @@ void ShaderWrapper::LinkProgram(GLuint vertexShader, GLuint fragmentShader, GLui
         char Log[512];
         glGetProgramInfoLog(shaderProgramId, 512, nullptr, Log);
         SPDLOG_ERROR("Program linking failed: " + std::string(Log));
+        return false;
+    }
+
+    ReflectUniforms();
+    return true;
+}
+
+void ShaderWrapper::ReflectUniforms()
+{
+    uniformLocations.clear();
+
+    GLint UniformsCount = 0;
+    GLint MaxNameLength = 0;
+    glGetProgramiv(shaderProgramId, GL_ACTIVE_UNIFORMS, &UniformsCount);
+    glGetProgramiv(shaderProgramId, GL_ACTIVE_UNIFORM_MAX_LENGTH, &MaxNameLength);
+
+    std::string NameBuffer(std::max(MaxNameLength, 1), '\0');
+    for (GLint i = 0; i < UniformsCount; ++i)
+    {
+        GLsizei NameLength = 0;
+        GLint ArraySize = 0;
+        GLenum Type;
+        glGetActiveUniform(shaderProgramId, i, MaxNameLength, &NameLength, &ArraySize, &Type, NameBuffer.data());
+
+        std::string Name(NameBuffer.data(), NameLength);
+        GLint Location = glGetUniformLocation(shaderProgramId, Name.c_str());
+
+        // Members of uniform blocks have no location
+        if (Location < 0)
+            continue;
+
+        uniformLocations.emplace(Name, Location);
+
+        // Arrays are reported as "name[0]", make the plain name and every element reachable as well
+        if (Name.ends_with("[0]"))
+        {
+            std::string BaseName = Name.substr(0, Name.size() - 3);
+            uniformLocations.emplace(BaseName, Location);
+
+            for (GLint Element = 1; Element < ArraySize; ++Element)
+            {
+                std::string ElementName = BaseName + "[" + std::to_string(Element) + "]";
+                GLint ElementLocation = glGetUniformLocation(shaderProgramId, ElementName.c_str());
+                if (ElementLocation >= 0)
+                    uniformLocations.emplace(std::move(ElementName), ElementLocation);
+            }
+        }
     }
 }
 
-GLuint ShaderWrapper::CompileFragmentShader(std::string& fragmentShaderPath)
+GLuint ShaderWrapper::CompileFragmentShader(const std::string& fragmentShaderCode)
 {
     GLuint FragmentShader;
     FragmentShader = glCreateShader(GL_FRAGMENT_SHADER);
 
-    CompileShader(fragmentShaderPath, FragmentShader);
+    CompileShader(fragmentShaderCode, FragmentShader);
     LogShaderError(FragmentShader, "Fragment Shader compilation failed: ");
 
     return FragmentShader;
 }
 
-GLuint ShaderWrapper::CompileVertexShader(std::string& vertexShaderPath)
+GLuint ShaderWrapper::CompileVertexShader(const std::string& vertexShaderCode)
 {
     GLuint VertexShader;
     VertexShader = glCreateShader(GL_VERTEX_SHADER);
 
-    CompileShader(vertexShaderPath, VertexShader);
+    CompileShader(vertexShaderCode, VertexShader);
     LogShaderError(VertexShader, "Vertex Shader compilation failed: ");
 
     return VertexShader;
 }
 
-GLuint ShaderWrapper::CompileGeometryShader(std::string& geometryShaderPath)
+GLuint ShaderWrapper::CompileGeometryShader(const std::string& geometryShaderCode)
 {
     GLuint GeometryShader;
     GeometryShader = glCreateShader(GL_GEOMETRY_SHADER);
 
-    CompileShader(geometryShaderPath, GeometryShader);
+    CompileShader(geometryShaderCode, GeometryShader);
     LogShaderError(GeometryShader, "Geometry Shader compilation failed: ");
 
     return GeometryShader;
 }
 
+GLuint ShaderWrapper::CompileComputeShader(const std::string& computeShaderCode)
+{
+    GLuint ComputeShader;
+    ComputeShader = glCreateShader(GL_COMPUTE_SHADER);
+
+    CompileShader(computeShaderCode, ComputeShader);
+    LogShaderError(ComputeShader, "Compute Shader compilation failed: ");
+
+    return ComputeShader;
+}
+
 void ShaderWrapper::LogShaderError(GLuint geometryShader, const std::string& message)
 {
     GLint ShaderCompilationResult;
@@ -191,20 +287,137 @@ void ShaderWrapper::LogShaderError(GLuint geometryShader, const std::string& mes
     }
 }
 
-void ShaderWrapper::CompileShader(std::string& shaderPath, GLuint shader)
+void ShaderWrapper::CompileShader(const std::string& shaderCode, GLuint shader)
 {
-    std::string ShaderCode;
-    LoadShader(shaderPath, ShaderCode);
-    const GLchar* ConstCharPtrShaderCode = ShaderCode.c_str();
+    const GLchar* ConstCharPtrShaderCode = shaderCode.c_str();
     glShaderSource(shader, 1, &ConstCharPtrShaderCode, nullptr);
     glCompileShader(shader);
 }
 
-GLint ShaderWrapper::TrySetVec4f(const std::string& name, glm::vec4 value) const
+std::filesystem::path ShaderWrapper::GetProgramBinaryPath(const std::string& vertexShaderCode,
+                                                          const std::string& fragmentShaderCode,
+                                                          const std::string& geometryShaderCode)
+{
+    // Binaries are only valid for the driver that produced them
+    auto GetString = [](GLenum name)
+    {
+        const GLubyte* Value = glGetString(name);
+        return std::string_view(Value ? reinterpret_cast<const char*>(Value) : "");
+    };
+
+    uint64_t Key = Hash::Fnv1a(GetString(GL_VENDOR));
+    Key = Hash::Fnv1a(GetString(GL_RENDERER), Key);
+    Key = Hash::Fnv1a(GetString(GL_VERSION), Key);
+    for (const std::string* ShaderCode : {&vertexShaderCode, &fragmentShaderCode, &geometryShaderCode})
+    {
+        uint64_t Size = ShaderCode->size();
+        Key = Hash::Fnv1a(&Size, sizeof(Size), Key);
+        Key = Hash::Fnv1a(*ShaderCode, Key);
+    }
+
+    return std::filesystem::path(ProgramBinaryDirectory) / fmt::format("{:016x}.bin", Key);
+}
+
+bool ShaderWrapper::LoadProgramBinary(const std::filesystem::path& binaryPath)
+{
+    if (!IsProgramBinarySupported())
+        return false;
+
+    std::error_code Error;
+    uintmax_t FileSize = std::filesystem::file_size(binaryPath, Error);
+    if (Error || FileSize <= sizeof(ProgramBinaryHeader))
+        return false;
+
+    std::ifstream BinaryFile(binaryPath, std::ios::binary);
+    ProgramBinaryHeader Header{};
+    BinaryFile.read(reinterpret_cast<char*>(&Header), sizeof(Header));
+
+    std::vector<char> Binary(FileSize - sizeof(ProgramBinaryHeader));
+    BinaryFile.read(Binary.data(), static_cast<std::streamsize>(Binary.size()));
+
+    if (!BinaryFile || Header.magic != ProgramBinaryMagic || Header.length != Binary.size())
+    {
+        SPDLOG_WARN("Program binary {} is corrupt", binaryPath.string());
+        return false;
+    }
+
+    shaderProgramId = glCreateProgram();
+    glProgramBinary(shaderProgramId, Header.format, Binary.data(), static_cast<GLsizei>(Binary.size()));
+
+    GLint ProgramLinkingResult;
+    glGetProgramiv(shaderProgramId, GL_LINK_STATUS, &ProgramLinkingResult);
+    if (!ProgramLinkingResult)
+    {
+        // Drivers may reject binaries at any time, for example after an update that kept the version string
+        SPDLOG_WARN("Program binary {} was rejected, compiling from source", binaryPath.string());
+        glDeleteProgram(shaderProgramId);
+        shaderProgramId = 0;
+
+        std::filesystem::remove(binaryPath, Error);
+        return false;
+    }
+
+    return true;
+}
+
+void ShaderWrapper::SaveProgramBinary(const std::filesystem::path& binaryPath) const
+{
+    if (!IsProgramBinarySupported())
+        return;
+
+    GLint BinaryLength = 0;
+    glGetProgramiv(shaderProgramId, GL_PROGRAM_BINARY_LENGTH, &BinaryLength);
+    if (BinaryLength <= 0)
+        return;
+
+    ProgramBinaryHeader Header{ProgramBinaryMagic, 0, static_cast<uint32_t>(BinaryLength)};
+    std::vector<char> Binary(BinaryLength);
+    GLsizei WrittenLength = 0;
+    glGetProgramBinary(shaderProgramId, BinaryLength, &WrittenLength, &Header.format, Binary.data());
+    Header.length = static_cast<uint32_t>(WrittenLength);
+
+    std::error_code Error;
+    std::filesystem::create_directories(binaryPath.parent_path(), Error);
+
+    // Written under a temporary name so a concurrent start never reads a partial binary,
+    // the random suffix keeps two processes saving the same program from writing into one file
+    std::filesystem::path TemporaryPath = binaryPath;
+    TemporaryPath += "." + std::to_string(std::random_device{}()) + ".tmp";
+    {
+        std::ofstream BinaryFile(TemporaryPath, std::ios::binary | std::ios::trunc);
+        BinaryFile.write(reinterpret_cast<const char*>(&Header), sizeof(Header));
+        BinaryFile.write(Binary.data(), WrittenLength);
+        if (!BinaryFile)
+        {
+            SPDLOG_WARN("Failed to write program binary {}", binaryPath.string());
+            BinaryFile.close();
+            std::filesystem::remove(TemporaryPath, Error);
+            return;
+        }
+    }
+
+    std::filesystem::rename(TemporaryPath, binaryPath, Error);
+    if (Error)
+        std::filesystem::remove(TemporaryPath, Error);
+}
+
+bool ShaderWrapper::IsProgramBinarySupported()
+{
+    static const bool IsSupported = []()
+    {
+        GLint FormatsCount = 0;
+        glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &FormatsCount);
+        return FormatsCount > 0;
+    }();
+    return IsSupported;
+}
+
+GLint ShaderWrapper::TrySetVec4f(std::string_view name, glm::vec4 value) const
 {
-    GLint UniformLocation = glGetUniformLocation(shaderProgramId, name.c_str());
-    glUniformMatrix4fv(UniformLocation, 1, GL_FALSE, glm::value_ptr(value));
-    return UniformLocation;
+    UniformHandle<glm::vec4> Uniform = GetUniform<glm::vec4>(name);
+    if (Uniform.IsValid())
+        Uniform.Set(value);
+    return Uniform.GetLocation();
 }
 
 
@@ -0,0 +1,311 @@
+#include "ShadowCascades.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "Camera.h"
+#include "FrameConstants.h"
+#include "LoggingMacros.h"
+#include "ShaderWrapper.h"
+
+namespace
+{
+    constexpr float PolygonOffsetFactor = 2.f;
+    constexpr float PolygonOffsetUnits = 4.f;
+    constexpr float DepthBias = 0.00005f;
+    constexpr float NormalOffsetTexels = 1.5f;
+    // A cascade much larger than its slice wastes resolution, it is fitted again even if it still covers it
+    constexpr float MaxCascadeOversize = 1.5f;
+}
+
+static_assert(sizeof(GpuShadowsBlock) <= FrameConstants::BlockCapacities[static_cast<size_t>(FrameBlock::Shadows)]);
+
+ShadowCascades::ShadowCascades()
+{
+    glGenTextures(1, &depthTexture);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, depthTexture);
+    glTexStorage3D(GL_TEXTURE_2D_ARRAY, 1, GL_DEPTH_COMPONENT32F, Resolution, Resolution, CascadesCount);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_BORDER);
+    // Everything outside of a cascade is lit
+    const float BorderColor[] = {1.f, 1.f, 1.f, 1.f};
+    glTexParameterfv(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_BORDER_COLOR, BorderColor);
+    // Filtered comparisons give 2x2 PCF for free on every sample
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+
+    glGenFramebuffers(1, &framebuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, depthTexture, 0, 0);
+    glDrawBuffer(GL_NONE);
+    glReadBuffer(GL_NONE);
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+        SPDLOG_ERROR("Shadow cascades framebuffer is not complete");
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+    for (Cascade& Current : cascades)
+    {
+        for (TimerQuery& Query : Current.queries)
+        {
+            glGenQueries(1, &Query.start);
+            glGenQueries(1, &Query.end);
+        }
+    }
+
+    WriteBlock();
+}
+
+ShadowCascades::~ShadowCascades()
+{
+    for (Cascade& Current : cascades)
+    {
+        for (TimerQuery& Query : Current.queries)
+        {
+            glDeleteQueries(1, &Query.start);
+            glDeleteQueries(1, &Query.end);
+        }
+    }
+
+    glDeleteFramebuffers(1, &framebuffer);
+    glDeleteTextures(1, &depthTexture);
+}
+
+void ShadowCascades::Update(const Camera& camera, const glm::vec3& direction, bool isVisible)
+{
+    ResolveQueries();
+
+    // A turning sun moves every cascade
+    glm::vec3 Direction = glm::normalize(direction);
+    if (Direction != sunDirection)
+    {
+        sunDirection = Direction;
+        for (Cascade& Current : cascades)
+            Current.bounds = BoundingSphere();
+        InvalidateAll();
+    }
+
+    isSunVisible = isVisible;
+    if (!IsActive())
+    {
+        InvalidateAll();
+        WriteBlock();
+        return;
+    }
+
+    // A slice between two view depths is bounded by the sphere centered on the view axis that is equally far
+    // from its near and far corners, which does not depend on the orientation of the camera
+    glm::ivec2 CameraResolution = glm::max(camera.GetResolution(), glm::ivec2(1));
+    float Aspect = static_cast<float>(CameraResolution.x) / static_cast<float>(CameraResolution.y);
+    float TanHalfFov = std::tan(glm::radians(camera.GetFow()) * 0.5f);
+    float CornerScaleSquared = TanHalfFov * TanHalfFov * (1.f + Aspect * Aspect);
+    glm::mat4 InverseView = glm::inverse(camera.GetViewMatrix());
+
+    float Near = Camera::NearPlane;
+    float Far = std::min(MaxShadowDistance, Camera::FarPlane);
+    float SliceNear = Near;
+    for (uint32_t i = 0; i < CascadesCount; ++i)
+    {
+        float Ratio = static_cast<float>(i + 1) / CascadesCount;
+        float SliceFar = SplitLambda * Near * std::pow(Far / Near, Ratio) +
+                         (1.f - SplitLambda) * (Near + (Far - Near) * Ratio);
+
+        float CenterDepth = std::min((SliceFar + SliceNear) * (1.f + CornerScaleSquared) * 0.5f, SliceFar);
+        float Radius = std::sqrt((SliceFar - CenterDepth) * (SliceFar - CenterDepth) +
+                                 SliceFar * SliceFar * CornerScaleSquared);
+        BoundingSphere Slice{glm::vec3(InverseView * glm::vec4(0.f, 0.f, -CenterDepth, 1.f)), Radius};
+
+        Cascade& Current = cascades[i];
+        bool IsCovered = Current.bounds.radius > 0.f &&
+                         glm::length(Slice.center - Current.bounds.center) + Slice.radius <= Current.bounds.radius &&
+                         Current.bounds.radius <= Slice.radius * CascadePadding * MaxCascadeOversize;
+        if (!IsCovered)
+            FitCascade(Current, Slice);
+
+        stats[i].splitDepth = SliceFar;
+        SliceNear = SliceFar;
+    }
+
+    WriteBlock();
+}
+
+void ShadowCascades::FitCascade(Cascade& cascade, const BoundingSphere& slice)
+{
+    float Radius = slice.radius * CascadePadding;
+    float TexelSize = 2.f * Radius / static_cast<float>(Resolution);
+    glm::vec3 Up = std::abs(sunDirection.y) > 0.99f ? glm::vec3(1.f, 0.f, 0.f) : glm::vec3(0.f, 1.f, 0.f);
+
+    // The center moves in whole texels across the light so every texel keeps covering the same world area
+    glm::mat4 LightRotation = glm::lookAt(glm::vec3(0.f), sunDirection, Up);
+    glm::vec3 LightCenter = glm::vec3(LightRotation * glm::vec4(slice.center, 1.f));
+    LightCenter.x = std::floor(LightCenter.x / TexelSize) * TexelSize;
+    LightCenter.y = std::floor(LightCenter.y / TexelSize) * TexelSize;
+    glm::vec3 Center = glm::vec3(glm::inverse(LightRotation) * glm::vec4(LightCenter, 1.f));
+
+    glm::vec3 Eye = Center - sunDirection * (Radius + CasterDistance);
+    glm::mat4 View = glm::lookAt(Eye, Center, Up);
+    glm::mat4 Projection = glm::ortho(-Radius, Radius, -Radius, Radius, 0.f, 2.f * Radius + CasterDistance);
+
+    cascade.viewProjection = Projection * View;
+    cascade.frustum = Frustum::FromMatrix(cascade.viewProjection);
+    cascade.bounds = {Center, Radius};
+    cascade.texelSize = TexelSize;
+    cascade.isCached = false;
+}
+
+void ShadowCascades::Render(const DrawCallback& drawCasters)
+{
+    for (ShadowCascadeStats& CascadeStats : stats)
+        CascadeStats.wasRendered = false;
+
+    if (!IsActive())
+        return;
+
+    GLint PreviousFramebuffer = 0;
+    GLint PreviousViewport[4] = {};
+    bool IsStateSaved = false;
+    for (uint32_t i = 0; i < CascadesCount; ++i)
+    {
+        Cascade& Current = cascades[i];
+        if (Current.isCached)
+            continue;
+
+        if (!IsStateSaved)
+        {
+            glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &PreviousFramebuffer);
+            glGetIntegerv(GL_VIEWPORT, PreviousViewport);
+            glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+            glViewport(0, 0, Resolution, Resolution);
+            glDepthMask(GL_TRUE);
+            // Casters between the sun and the near plane are flattened onto it instead of being clipped
+            glEnable(GL_DEPTH_CLAMP);
+            glEnable(GL_POLYGON_OFFSET_FILL);
+            glPolygonOffset(PolygonOffsetFactor, PolygonOffsetUnits);
+            IsStateSaved = true;
+        }
+
+        glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, depthTexture, 0, static_cast<GLint>(i));
+        glClear(GL_DEPTH_BUFFER_BIT);
+
+        // Timestamps instead of GL_TIME_ELAPSED, those can not nest in the GPU scopes of the FrameProfiler
+        TimerQuery& Query = Current.queries[Current.nextQuery];
+        Current.nextQuery = (Current.nextQuery + 1) % QueryLatency;
+        if (Query.isPending)
+            ResolveQuery(i, Query, true);
+
+        glQueryCounter(Query.start, GL_TIMESTAMP);
+        stats[i].castersCount = drawCasters(i, Current.frustum, Current.viewProjection);
+        glQueryCounter(Query.end, GL_TIMESTAMP);
+        Query.isPending = true;
+
+        Current.isCached = true;
+        stats[i].wasRendered = true;
+        stats[i].renderedFramesCount++;
+    }
+
+    if (IsStateSaved)
+    {
+        glDisable(GL_POLYGON_OFFSET_FILL);
+        glDisable(GL_DEPTH_CLAMP);
+        glBindFramebuffer(GL_FRAMEBUFFER, PreviousFramebuffer);
+        glViewport(PreviousViewport[0], PreviousViewport[1], PreviousViewport[2], PreviousViewport[3]);
+    }
+}
+
+void ShadowCascades::Bind() const
+{
+    glActiveTexture(GL_TEXTURE0 + TextureUnit);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, depthTexture);
+    glActiveTexture(GL_TEXTURE0);
+}
+
+void ShadowCascades::Invalidate(const BoundingSphere& sphere)
+{
+    for (Cascade& Current : cascades)
+    {
+        if (Current.isCached && Current.frustum.IsSphereVisible(sphere.center, sphere.radius))
+            Current.isCached = false;
+    }
+}
+
+void ShadowCascades::InvalidateAll()
+{
+    for (Cascade& Current : cascades)
+        Current.isCached = false;
+}
+
+void ShadowCascades::ResolveQueries()
+{
+    for (uint32_t i = 0; i < CascadesCount; ++i)
+    {
+        for (TimerQuery& Query : cascades[i].queries)
+        {
+            if (Query.isPending)
+                ResolveQuery(i, Query, false);
+        }
+    }
+}
+
+void ShadowCascades::ResolveQuery(uint32_t cascade, TimerQuery& query, bool shouldWait)
+{
+    if (!shouldWait)
+    {
+        GLint IsAvailable = GL_FALSE;
+        glGetQueryObjectiv(query.end, GL_QUERY_RESULT_AVAILABLE, &IsAvailable);
+        if (!IsAvailable)
+            return;
+    }
+
+    GLuint64 Start = 0, End = 0;
+    glGetQueryObjectui64v(query.start, GL_QUERY_RESULT, &Start);
+    glGetQueryObjectui64v(query.end, GL_QUERY_RESULT, &End);
+    stats[cascade].gpuMilliseconds = static_cast<float>(End - Start) / 1'000'000.f;
+    query.isPending = false;
+}
+
+void ShadowCascades::WriteBlock()
+{
+    GpuShadowsBlock Block{};
+    for (uint32_t i = 0; i < CascadesCount; ++i)
+    {
+        Block.cascadeMatrices[i] = cascades[i].viewProjection;
+        Block.cascadeSplits[i] = stats[i].splitDepth;
+        Block.cascadeTexelSizes[i] = cascades[i].texelSize;
+    }
+    Block.parameters = glm::vec4(IsActive() ? static_cast<float>(CascadesCount) : 0.f, DepthBias,
+                                 NormalOffsetTexels, 0.f);
+
+    FrameConstants::GetInstance().Write(FrameBlock::Shadows, 0, &Block, sizeof(GpuShadowsBlock));
+}
+
+bool ShadowCascades::IsActive() const
+{
+    return isEnabled && isSunVisible;
+}
+
+bool ShadowCascades::IsEnabled() const
+{
+    return isEnabled;
+}
+
+void ShadowCascades::SetEnabled(bool isEnabled)
+{
+    ShadowCascades::isEnabled = isEnabled;
+}
+
+const std::array<ShadowCascadeStats, ShadowCascades::CascadesCount>& ShadowCascades::GetStats() const
+{
+    return stats;
+}
+
+void ShadowCascades::SetSamplerUniform(const ShaderWrapper& shader)
+{
+    shader.Activate();
+    UniformHandle<int> Sampler = shader.GetUniform<int>("ShadowMap");
+    if (Sampler.IsValid())
+        Sampler.Set(TextureUnit);
+}
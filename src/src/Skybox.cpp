@@ -4,16 +4,23 @@
 #include <utility>
 
 #include "LoggingMacros.h"
-#include "stb_image.h"
 #include "ShaderWrapper.h"
+#include "TextureStreamer.h"
 
 Skybox::Skybox(const std::array<std::string, 6>& cubeTextures, std::shared_ptr<ShaderWrapper> shader)
 : shader(std::move(shader)) {
     InitializeBuffers();
     LoadCubeMap(cubeTextures);
+    cubemapUniform = this->shader->GetUniform<int>("cubemap");
 
 }
 
+Skybox::~Skybox() {
+    glDeleteVertexArrays(1, &vao);
+    glDeleteBuffers(1, &vbo);
+    TextureStreamer::GetInstance().DeleteTexture(textureId);
+}
+
 void Skybox::InitializeBuffers() {
     glGenVertexArrays(1, &vao);
     glGenBuffers(1, &vbo);
@@ -28,37 +35,14 @@ void Skybox::InitializeBuffers() {
 }
 
 void Skybox::LoadCubeMap(const std::array<std::string, 6>& cubeTextures) {
-    unsigned int textureId;
-    glGenTextures(1, &textureId);
-    glBindTexture(GL_TEXTURE_CUBE_MAP, textureId);
-
-    int width, height, nrChannels;
-    stbi_set_flip_vertically_on_load(false);
-    for (unsigned int i = 0; i < cubeTextures.size(); i++) {
-        SPDLOG_DEBUG("Loading cubemap texture at path: {}", cubeTextures[i]);
-
-        unsigned char* data = stbi_load(cubeTextures[i].c_str(), &width, &height, &nrChannels, 0);
-        if (data) {
-            glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_RGB, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, data);
-            stbi_image_free(data);
-        } else {
-            SPDLOG_ERROR("Cubemap texure failed to load at path: {}", cubeTextures[i]);
-            stbi_image_free(data);
-        }
-    }
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
-
-    Skybox::textureId = textureId;
+    SPDLOG_DEBUG("Loading cubemap texture at path: {}", cubeTextures[0]);
+    textureId = TextureStreamer::GetInstance().RequestCubeMap(cubeTextures);
 }
 
 void Skybox::Draw() {
     glDepthFunc(GL_LEQUAL);
     shader->Activate();
-    shader->SetInt("cubemap", 0);
+    cubemapUniform.Set(0);
 
     glBindVertexArray(vao);
     glActiveTexture(GL_TEXTURE0);
@@ -0,0 +1,94 @@
+#include "TextureCache.h"
+
+#include <utility>
+
+#include "AssetPath.h"
+#include "TextureStreamer.h"
+
+SharedTexture::SharedTexture(GLuint Id, std::string Path)
+: id(Id), path(std::move(Path))
+{
+}
+
+SharedTexture::~SharedTexture()
+{
+    TextureCache::GetInstance().Evict(*this);
+}
+
+GLuint SharedTexture::GetId() const
+{
+    return id;
+}
+
+const std::string& SharedTexture::GetPath() const
+{
+    return path;
+}
+
+bool SharedTexture::IsUploaded() const
+{
+    return isUploaded;
+}
+
+TextureCache& TextureCache::GetInstance()
+{
+    static TextureCache Instance;
+    return Instance;
+}
+
+std::shared_ptr<SharedTexture> TextureCache::Acquire(const std::string& Path)
+{
+    std::string ResolvedPath = AssetPath::Resolve(Path);
+    stats.requestsCount++;
+
+    std::weak_ptr<SharedTexture>& Entry = textures[ResolvedPath];
+    if (std::shared_ptr<SharedTexture> Texture = Entry.lock())
+    {
+        stats.hitsCount++;
+        return Texture;
+    }
+
+    GLuint TextureId = TextureStreamer::GetInstance().RequestTexture(ResolvedPath, true,
+        [ResolvedPath](size_t UploadedBytes)
+        {
+            TextureCache::GetInstance().OnUploaded(ResolvedPath, UploadedBytes);
+        });
+
+    auto Texture = std::make_shared<SharedTexture>(TextureId, ResolvedPath);
+    Entry = Texture;
+    stats.residentTexturesCount++;
+    return Texture;
+}
+
+void TextureCache::OnUploaded(const std::string& ResolvedPath, size_t UploadedBytes)
+{
+    auto Iterator = textures.find(ResolvedPath);
+    if (Iterator == textures.end())
+        return;
+
+    std::shared_ptr<SharedTexture> Texture = Iterator->second.lock();
+    if (!Texture)
+        return;
+
+    Texture->isUploaded = true;
+    // The mip chain adds a third of the base level
+    Texture->residentBytes = UploadedBytes + UploadedBytes / 3;
+    stats.residentBytes += Texture->residentBytes;
+}
+
+void TextureCache::Evict(SharedTexture& Texture)
+{
+    // A newer texture may already be registered under the same path
+    auto Iterator = textures.find(Texture.path);
+    if (Iterator != textures.end() && Iterator->second.expired())
+        textures.erase(Iterator);
+
+    stats.residentTexturesCount--;
+    stats.residentBytes -= Texture.residentBytes;
+    TextureStreamer::GetInstance().DeleteTexture(Texture.id);
+}
+
+const TextureCacheStats& TextureCache::GetStats() const
+{
+    return stats;
+}
@@ -0,0 +1,330 @@
+#include "TextureStreamer.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include "LoggingMacros.h"
+#include "stb_image.h"
+
+namespace
+{
+    constexpr uint8_t PlaceholderPixel[4] = {128, 128, 128, 255};
+
+    GLenum GetColorFormat(int ComponentsCount)
+    {
+        switch (ComponentsCount)
+        {
+            case 1:
+                return GL_RED;
+            case 2:
+                return GL_RG;
+            case 3:
+                return GL_RGB;
+            default:
+                return GL_RGBA;
+        }
+    }
+
+    // Sized formats, so uploaded textures can be copied into immutable texture arrays
+    GLenum GetInternalFormat(int ComponentsCount)
+    {
+        switch (ComponentsCount)
+        {
+            case 1:
+                return GL_R8;
+            case 2:
+                return GL_RG8;
+            case 3:
+                return GL_RGB8;
+            default:
+                return GL_RGBA8;
+        }
+    }
+}
+
+void TextureStreamer::ImageDeleter::operator()(uint8_t* pixels) const
+{
+    stbi_image_free(pixels);
+}
+
+TextureStreamer& TextureStreamer::GetInstance()
+{
+    static TextureStreamer Instance;
+    return Instance;
+}
+
+TextureStreamer::~TextureStreamer()
+{
+    StopDecoders();
+}
+
+GLuint TextureStreamer::RequestTexture(const std::string& Path, bool IsFlippedVertically, UploadCallback OnUploaded)
+{
+    std::shared_ptr<StreamRequest> Request = CreateRequest(GL_TEXTURE_2D, {Path}, IsFlippedVertically,
+                                                           std::move(OnUploaded));
+
+    glBindTexture(GL_TEXTURE_2D, Request->textureId);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, PlaceholderPixel);
+
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+    return Request->textureId;
+}
+
+GLuint TextureStreamer::RequestCubeMap(const std::array<std::string, 6>& FacePaths)
+{
+    std::shared_ptr<StreamRequest> Request = CreateRequest(GL_TEXTURE_CUBE_MAP, {FacePaths.begin(), FacePaths.end()}, false, {});
+
+    glBindTexture(GL_TEXTURE_CUBE_MAP, Request->textureId);
+    for (uint32_t i = 0; i < FacePaths.size(); ++i)
+    {
+        glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_RGBA8, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE,
+                     PlaceholderPixel);
+    }
+
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+
+    return Request->textureId;
+}
+
+std::shared_ptr<TextureStreamer::StreamRequest> TextureStreamer::CreateRequest(GLenum Target, std::vector<std::string> Paths,
+                                                                               bool IsFlippedVertically,
+                                                                               UploadCallback OnUploaded)
+{
+    auto Request = std::make_shared<StreamRequest>();
+    glGenTextures(1, &Request->textureId);
+    Request->target = Target;
+    Request->isFlippedVertically = IsFlippedVertically;
+    Request->onUploaded = std::move(OnUploaded);
+    Request->paths = std::move(Paths);
+    Request->images.resize(Request->paths.size());
+    Request->remainingImagesCount = static_cast<uint32_t>(Request->paths.size());
+
+    {
+        std::lock_guard Lock(decodeMutex);
+        if (decoders.empty())
+        {
+            uint32_t DecodersCount = std::clamp(std::thread::hardware_concurrency() / 2, 1u, 4u);
+            for (uint32_t i = 0; i < DecodersCount; ++i)
+                decoders.emplace_back(&TextureStreamer::DecoderLoop, this);
+        }
+
+        for (uint32_t i = 0; i < Request->paths.size(); ++i)
+            decodeJobs.push_back({Request, i});
+    }
+    decodeCondition.notify_all();
+
+    pendingRequests[Request->textureId] = Request;
+    stats.pendingTexturesCount++;
+    return Request;
+}
+
+void TextureStreamer::DeleteTexture(GLuint TextureId)
+{
+    auto Iterator = pendingRequests.find(TextureId);
+    if (Iterator != pendingRequests.end())
+    {
+        Iterator->second->isCancelled = true;
+        return;
+    }
+
+    glDeleteTextures(1, &TextureId);
+}
+
+void TextureStreamer::DecoderLoop()
+{
+    while (true)
+    {
+        DecodeJob Job;
+        {
+            std::unique_lock Lock(decodeMutex);
+            decodeCondition.wait(Lock, [this]() { return !isRunning || !decodeJobs.empty(); });
+            if (!isRunning)
+                return;
+
+            Job = std::move(decodeJobs.front());
+            decodeJobs.pop_front();
+        }
+
+        Decode(*Job.request, Job.imageIndex);
+
+        // Whoever decodes the last image of a request hands it over to the GL thread
+        if (Job.request->remainingImagesCount.fetch_sub(1, std::memory_order_acq_rel) == 1)
+            decodedRequests.Push(std::move(Job.request));
+    }
+}
+
+void TextureStreamer::Decode(StreamRequest& Request, uint32_t ImageIndex)
+{
+    const std::string& Path = Request.paths[ImageIndex];
+    SPDLOG_DEBUG("Decoding texture at path: {}", Path);
+
+    // stbi_set_flip_vertically_on_load is global state, so rows are flipped here instead
+    DecodedImage& Image = Request.images[ImageIndex];
+    Image.pixels.reset(stbi_load(Path.c_str(), &Image.width, &Image.height, &Image.componentsCount, 0));
+    if (!Image.pixels)
+    {
+        SPDLOG_ERROR("Failed to load texture at path: {}", Path);
+        return;
+    }
+
+    if (!Request.isFlippedVertically)
+        return;
+
+    size_t RowSize = static_cast<size_t>(Image.width) * Image.componentsCount;
+    std::vector<uint8_t> Row(RowSize);
+    for (int Top = 0, Bottom = Image.height - 1; Top < Bottom; ++Top, --Bottom)
+    {
+        uint8_t* TopRow = Image.pixels.get() + Top * RowSize;
+        uint8_t* BottomRow = Image.pixels.get() + Bottom * RowSize;
+        std::memcpy(Row.data(), TopRow, RowSize);
+        std::memcpy(TopRow, BottomRow, RowSize);
+        std::memcpy(BottomRow, Row.data(), RowSize);
+    }
+}
+
+void TextureStreamer::Update()
+{
+    UploadReadyRequests(UploadBudgetBytes);
+}
+
+void TextureStreamer::Flush()
+{
+    while (stats.pendingTexturesCount > 0)
+    {
+        if (!UploadReadyRequests(SIZE_MAX))
+            std::this_thread::yield();
+    }
+}
+
+bool TextureStreamer::UploadReadyRequests(size_t BudgetBytes)
+{
+    decodedRequests.PopAll(readyRequests);
+    if (readyRequestsBegin == readyRequests.size())
+        return false;
+
+    if (!pixelBuffer)
+        glGenBuffers(1, &pixelBuffer);
+
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pixelBuffer);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+    // At least one request is uploaded every frame, even when it is bigger than the budget
+    size_t UploadedBytes = 0;
+    while (readyRequestsBegin < readyRequests.size() && UploadedBytes < BudgetBytes)
+    {
+        std::shared_ptr<StreamRequest> Request = std::move(readyRequests[readyRequestsBegin++]);
+        pendingRequests.erase(Request->textureId);
+        stats.pendingTexturesCount--;
+
+        if (Request->isCancelled)
+        {
+            glDeleteTextures(1, &Request->textureId);
+            continue;
+        }
+
+        size_t RequestBytes = Upload(*Request);
+        UploadedBytes += RequestBytes;
+        stats.uploadedTexturesCount++;
+
+        if (Request->onUploaded)
+            Request->onUploaded(RequestBytes);
+    }
+    stats.uploadedBytes += UploadedBytes;
+
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+    if (readyRequestsBegin == readyRequests.size())
+    {
+        readyRequests.clear();
+        readyRequestsBegin = 0;
+    }
+    return true;
+}
+
+size_t TextureStreamer::Upload(StreamRequest& Request)
+{
+    size_t UploadedBytes = 0;
+    glBindTexture(Request.target, Request.textureId);
+
+    for (uint32_t i = 0; i < Request.images.size(); ++i)
+    {
+        DecodedImage& Image = Request.images[i];
+        if (!Image.pixels)
+            continue;
+
+        // Orphaning the buffer lets the driver keep reading the previous image while this one is copied
+        auto Size = static_cast<GLsizeiptr>(Image.width) * Image.height * Image.componentsCount;
+        glBufferData(GL_PIXEL_UNPACK_BUFFER, Size, nullptr, GL_STREAM_DRAW);
+        void* MappedData = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, Size,
+                                            GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+        if (!MappedData)
+        {
+            SPDLOG_ERROR("Failed to map pixel buffer for texture at path: {}", Request.paths[i]);
+            continue;
+        }
+        std::memcpy(MappedData, Image.pixels.get(), Size);
+        glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+        Image.pixels.reset();
+
+        GLenum Target = Request.target == GL_TEXTURE_CUBE_MAP ? GL_TEXTURE_CUBE_MAP_POSITIVE_X + i : Request.target;
+        GLenum ColorFormat = GetColorFormat(Image.componentsCount);
+        glTexImage2D(Target, 0, static_cast<GLint>(GetInternalFormat(Image.componentsCount)), Image.width, Image.height, 0, ColorFormat,
+                     GL_UNSIGNED_BYTE, nullptr);
+        UploadedBytes += Size;
+    }
+
+    if (Request.target == GL_TEXTURE_2D && UploadedBytes > 0)
+        glGenerateMipmap(GL_TEXTURE_2D);
+
+    return UploadedBytes;
+}
+
+void TextureStreamer::Shutdown()
+{
+    StopDecoders();
+
+    readyRequests.clear();
+    readyRequestsBegin = 0;
+    decodedRequests.PopAll(readyRequests);
+    readyRequests.clear();
+    stats.pendingTexturesCount = 0;
+
+    for (const auto& [TextureId, Request] : pendingRequests)
+    {
+        if (Request->isCancelled)
+            glDeleteTextures(1, &TextureId);
+    }
+    pendingRequests.clear();
+
+    if (pixelBuffer)
+        glDeleteBuffers(1, &pixelBuffer);
+    pixelBuffer = 0;
+}
+
+void TextureStreamer::StopDecoders()
+{
+    {
+        std::lock_guard Lock(decodeMutex);
+        isRunning = false;
+        decodeJobs.clear();
+    }
+    decodeCondition.notify_all();
+
+    for (std::thread& Decoder : decoders)
+        Decoder.join();
+    decoders.clear();
+}
+
+const TextureStreamerStats& TextureStreamer::GetStats() const
+{
+    return stats;
+}
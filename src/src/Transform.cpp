@@ -1,44 +1,53 @@
 #include "Transform.h"
 
-#include <glm/gtc/matrix_transform.hpp>
-
 glm::mat4 Transform::GetMatrix() const {
-    glm::mat4 translation = glm::translate(glm::mat4(1.f), position);
-    glm::mat4 scaleMat = glm::scale(glm::mat4(1.f), scale);
-    return translation * glm::toMat4(rotation) * scaleMat;
+    return TransformStore::ComposeMatrix(GetPosition(), GetRotation(), GetScale());
 }
 
 glm::vec3 Transform::GetPosition() const {
-    return position;
+    return TransformStore::GetInstance().GetPosition(handle);
 }
 
 glm::quat Transform::GetRotation() const {
-    return rotation;
+    return TransformStore::GetInstance().GetRotation(handle);
 }
 
 glm::vec3 Transform::GetScale() const {
-    return scale;
+    return TransformStore::GetInstance().GetScale(handle);
 }
 
 void Transform::SetPosition(const glm::vec3& newPosition) {
-    position = newPosition;
-    isDirty = true;
+    TransformStore::GetInstance().SetPosition(handle, newPosition);
 }
 
 void Transform::SetScale(const glm::vec3& newScale) {
-    scale = newScale;
-    isDirty = true;
+    TransformStore::GetInstance().SetScale(handle, newScale);
 }
 
-Transform::Transform() : position(glm::vec3(0.f)), rotation(glm::mat4(1.f)), scale(glm::vec3(1.f)), isDirty(true) {}
+Transform::Transform() : handle(TransformStore::GetInstance().Allocate()) {}
+
+Transform::Transform(const Transform& originalTransform) :
+        handle(TransformStore::GetInstance().Allocate(originalTransform.handle)) {
+}
+
+Transform::Transform(Transform* originalTransform) : Transform(*originalTransform) {
+}
 
-Transform::Transform(Transform* originalTransform) :
-        position(originalTransform->position),
-        rotation(originalTransform->rotation),
-        scale(originalTransform->scale) {
+Transform::~Transform() {
+    TransformStore::GetInstance().Release(handle);
+}
+
+Transform& Transform::operator=(const Transform& otherTransform) {
+    SetPosition(otherTransform.GetPosition());
+    SetRotation(otherTransform.GetRotation());
+    SetScale(otherTransform.GetScale());
+    return *this;
 }
 
 void Transform::SetRotation(const glm::quat &newRotation) {
-    rotation = newRotation;
-    isDirty = true;
+    TransformStore::GetInstance().SetRotation(handle, newRotation);
+}
+
+TransformStore::Handle Transform::GetHandle() const {
+    return handle;
 }
@@ -0,0 +1,309 @@
+#include "TransformStore.h"
+
+#include <algorithm>
+#include <type_traits>
+#include <glm/gtx/quaternion.hpp>
+
+#include "JobSystem.h"
+
+TransformStore& TransformStore::GetInstance() {
+    static TransformStore instance;
+    return instance;
+}
+
+TransformStore::Handle TransformStore::Allocate() {
+    Handle handle;
+    if (!freeHandles.empty()) {
+        handle = freeHandles.back();
+        freeHandles.pop_back();
+    } else {
+        handle = static_cast<Handle>(slotOfHandle.size());
+        slotOfHandle.push_back(InvalidSlot);
+    }
+
+    auto slot = static_cast<uint32_t>(handleOfSlot.size());
+    slotOfHandle[handle] = slot;
+
+    handleOfSlot.push_back(handle);
+    parents.push_back(InvalidSlot);
+    positions.emplace_back(0.f);
+    rotations.emplace_back(1.f, 0.f, 0.f, 0.f);
+    scales.emplace_back(1.f);
+    worldMatrices.emplace_back(1.f);
+    localDirty.push_back(1);
+    wasDirty.push_back(1);
+    subtreeEnds.push_back(slot + 1);
+
+    MarkDirty(slot);
+    return handle;
+}
+
+TransformStore::Handle TransformStore::Allocate(Handle source) {
+    Handle handle = Allocate();
+
+    uint32_t sourceSlot = slotOfHandle[source];
+    uint32_t slot = slotOfHandle[handle];
+    positions[slot] = positions[sourceSlot];
+    rotations[slot] = rotations[sourceSlot];
+    scales[slot] = scales[sourceSlot];
+
+    return handle;
+}
+
+void TransformStore::Release(Handle handle) {
+    uint32_t slot = slotOfHandle[handle];
+
+    handleOfSlot[slot] = InvalidHandle;
+    parents[slot] = InvalidSlot;
+    localDirty[slot] = 0;
+
+    slotOfHandle[handle] = InvalidSlot;
+    freeHandles.push_back(handle);
+
+    // Dead slots are only dropped by re-sorting, do it once they take up half of the store
+    deadSlotsCount++;
+    if (deadSlotsCount * 2 > handleOfSlot.size())
+        isOrderDirty = true;
+}
+
+void TransformStore::SetParent(Handle child, Handle parent) {
+    uint32_t childSlot = slotOfHandle[child];
+    uint32_t parentSlot = parent == InvalidHandle ? InvalidSlot : slotOfHandle[parent];
+
+    // Re-sort even when the order stays valid, parallel propagation relies on contiguous subtrees
+    parents[childSlot] = parentSlot;
+    isOrderDirty = true;
+
+    localDirty[childSlot] = 1;
+    MarkDirty(childSlot);
+}
+
+const glm::vec3& TransformStore::GetPosition(Handle handle) const {
+    return positions[slotOfHandle[handle]];
+}
+
+const glm::quat& TransformStore::GetRotation(Handle handle) const {
+    return rotations[slotOfHandle[handle]];
+}
+
+const glm::vec3& TransformStore::GetScale(Handle handle) const {
+    return scales[slotOfHandle[handle]];
+}
+
+void TransformStore::SetPosition(Handle handle, const glm::vec3& newPosition) {
+    uint32_t slot = slotOfHandle[handle];
+    positions[slot] = newPosition;
+    localDirty[slot] = 1;
+    MarkDirty(slot);
+}
+
+void TransformStore::SetRotation(Handle handle, const glm::quat& newRotation) {
+    uint32_t slot = slotOfHandle[handle];
+    rotations[slot] = newRotation;
+    localDirty[slot] = 1;
+    MarkDirty(slot);
+}
+
+void TransformStore::SetScale(Handle handle, const glm::vec3& newScale) {
+    uint32_t slot = slotOfHandle[handle];
+    scales[slot] = newScale;
+    localDirty[slot] = 1;
+    MarkDirty(slot);
+}
+
+const glm::mat4& TransformStore::GetWorldMatrix(Handle handle) const {
+    return worldMatrices[slotOfHandle[handle]];
+}
+
+bool TransformStore::IsLocalDirty(Handle handle) const {
+    return localDirty[slotOfHandle[handle]];
+}
+
+bool TransformStore::WasDirty(Handle handle) const {
+    return wasDirty[slotOfHandle[handle]];
+}
+
+const std::vector<TransformStore::Handle>& TransformStore::GetDirtyHandles() const {
+    return dirtyHandles;
+}
+
+size_t TransformStore::GetSize() const {
+    return handleOfSlot.size() - deadSlotsCount;
+}
+
+uint32_t TransformStore::GetSlot(Handle handle) const {
+    return slotOfHandle[handle];
+}
+
+void TransformStore::MarkDirty(uint32_t slot) {
+    uint32_t current = firstDirtySlot.load(std::memory_order_relaxed);
+    while (slot < current && !firstDirtySlot.compare_exchange_weak(current, slot, std::memory_order_relaxed)) {
+    }
+}
+
+void TransformStore::CalculateWorldTransforms(JobSystem* jobSystem) {
+    if (isOrderDirty)
+        SortTopologically();
+
+    auto size = static_cast<uint32_t>(handleOfSlot.size());
+    uint32_t first = std::min(firstDirtySlot.load(std::memory_order_relaxed), size);
+
+    // Everything before the first dirty slot is clean by construction
+    std::fill(wasDirty.begin(), wasDirty.begin() + first, 0);
+    dirtyHandles.clear();
+
+    if (!jobSystem || jobSystem->GetWorkerCount() == 0 || size - first < 2 * ParallelGrainSize) {
+        CalculateWorldTransformsRange(first, size, dirtyHandles);
+        firstDirtySlot = InvalidSlot;
+        return;
+    }
+
+    // Nodes with big subtrees are processed here in order, runs of small sibling subtrees become jobs.
+    // A job only reads parents that are either inside its own range or were processed before it was scheduled.
+    // Every job lists its dirty handles separately, they are appended once all jobs are done.
+    JobSystem::Counter counter;
+    size_t jobsCount = 0;
+    uint32_t slot = first;
+    while (slot < size) {
+        if (subtreeEnds[slot] - slot > ParallelGrainSize) {
+            CalculateWorldTransformsRange(slot, slot + 1, dirtyHandles);
+            slot++;
+            continue;
+        }
+
+        uint32_t jobEnd = subtreeEnds[slot];
+        while (jobEnd < size && subtreeEnds[jobEnd] - slot <= ParallelGrainSize)
+            jobEnd = subtreeEnds[jobEnd];
+
+        if (jobsCount == jobDirtyHandles.size())
+            jobDirtyHandles.emplace_back();
+        std::vector<Handle>& jobHandles = jobDirtyHandles[jobsCount++];
+        jobHandles.clear();
+
+        jobSystem->Schedule(counter, [this, slot, jobEnd, &jobHandles]() {
+            CalculateWorldTransformsRange(slot, jobEnd, jobHandles);
+        });
+        slot = jobEnd;
+    }
+    jobSystem->Wait(counter);
+
+    for (size_t job = 0; job < jobsCount; ++job)
+        dirtyHandles.insert(dirtyHandles.end(), jobDirtyHandles[job].begin(), jobDirtyHandles[job].end());
+
+    firstDirtySlot = InvalidSlot;
+}
+
+void TransformStore::CalculateWorldTransformsRange(uint32_t begin, uint32_t end, std::vector<Handle>& outDirtyHandles) {
+    for (uint32_t slot = begin; slot < end; ++slot) {
+        uint32_t parent = parents[slot];
+        bool isDirty = localDirty[slot] || (parent != InvalidSlot && wasDirty[parent]);
+        wasDirty[slot] = isDirty;
+
+        if (!isDirty)
+            continue;
+
+        localDirty[slot] = 0;
+        if (handleOfSlot[slot] != InvalidHandle)
+            outDirtyHandles.push_back(handleOfSlot[slot]);
+        glm::mat4 localMatrix = ComposeMatrix(positions[slot], rotations[slot], scales[slot]);
+        worldMatrices[slot] = parent != InvalidSlot ? worldMatrices[parent] * localMatrix : localMatrix;
+    }
+}
+
+void TransformStore::SortTopologically() {
+    auto size = static_cast<uint32_t>(handleOfSlot.size());
+
+    // Children of every slot in CSR form, roots are listed under the virtual slot `size`
+    std::vector<uint32_t> childrenOffsets(size + 2, 0);
+    for (uint32_t slot = 0; slot < size; ++slot) {
+        if (handleOfSlot[slot] == InvalidHandle)
+            continue;
+
+        uint32_t parent = parents[slot];
+        if (parent == InvalidSlot || handleOfSlot[parent] == InvalidHandle)
+            parent = size;
+        childrenOffsets[parent + 1]++;
+    }
+    for (uint32_t i = 1; i < childrenOffsets.size(); ++i)
+        childrenOffsets[i] += childrenOffsets[i - 1];
+
+    std::vector<uint32_t> children(childrenOffsets.back());
+    std::vector<uint32_t> cursor(childrenOffsets.begin(), childrenOffsets.end() - 1);
+    for (uint32_t slot = 0; slot < size; ++slot) {
+        if (handleOfSlot[slot] == InvalidHandle)
+            continue;
+
+        uint32_t parent = parents[slot];
+        if (parent == InvalidSlot || handleOfSlot[parent] == InvalidHandle)
+            parent = size;
+        children[cursor[parent]++] = slot;
+    }
+
+    // Depth-first pre-order keeps every subtree in one contiguous range
+    std::vector<uint32_t> order;
+    order.reserve(size - deadSlotsCount);
+    std::vector<uint32_t> stack;
+    for (uint32_t i = childrenOffsets[size + 1]; i > childrenOffsets[size]; --i)
+        stack.push_back(children[i - 1]);
+
+    while (!stack.empty()) {
+        uint32_t slot = stack.back();
+        stack.pop_back();
+        order.push_back(slot);
+
+        for (uint32_t i = childrenOffsets[slot + 1]; i > childrenOffsets[slot]; --i)
+            stack.push_back(children[i - 1]);
+    }
+
+    std::vector<uint32_t> newSlotOf(size, InvalidSlot);
+    for (uint32_t newSlot = 0; newSlot < order.size(); ++newSlot)
+        newSlotOf[order[newSlot]] = newSlot;
+
+    auto Permute = [&order](auto& array) {
+        std::remove_reference_t<decltype(array)> sorted;
+        sorted.reserve(order.size());
+        for (uint32_t oldSlot : order)
+            sorted.push_back(array[oldSlot]);
+        array.swap(sorted);
+    };
+
+    Permute(handleOfSlot);
+    Permute(parents);
+    Permute(positions);
+    Permute(rotations);
+    Permute(scales);
+    Permute(worldMatrices);
+    Permute(localDirty);
+    Permute(wasDirty);
+
+    firstDirtySlot = InvalidSlot;
+    subtreeEnds.resize(order.size());
+    for (uint32_t slot = 0; slot < order.size(); ++slot) {
+        slotOfHandle[handleOfSlot[slot]] = slot;
+        subtreeEnds[slot] = slot + 1;
+
+        uint32_t& parent = parents[slot];
+        parent = parent == InvalidSlot ? InvalidSlot : newSlotOf[parent];
+
+        if (localDirty[slot])
+            MarkDirty(slot);
+    }
+
+    for (auto slot = static_cast<uint32_t>(order.size()); slot > 0; --slot) {
+        uint32_t parent = parents[slot - 1];
+        if (parent != InvalidSlot)
+            subtreeEnds[parent] = std::max(subtreeEnds[parent], subtreeEnds[slot - 1]);
+    }
+
+    deadSlotsCount = 0;
+    isOrderDirty = false;
+}
+
+glm::mat4 TransformStore::ComposeMatrix(const glm::vec3& position, const glm::quat& rotation, const glm::vec3& scale) {
+    glm::mat4 result = glm::toMat4(rotation);
+    result[0] *= scale.x;
+    result[1] *= scale.y;
+    result[2] *= scale.z;
+    result[3] = glm::vec4(position, 1.f);
+    return result;
+}
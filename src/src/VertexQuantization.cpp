@@ -0,0 +1,116 @@
+#include "VertexQuantization.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include <glm/gtc/packing.hpp>
+
+#include "Bounds.h"
+
+namespace
+{
+    constexpr float PositionSteps = 65535.f;
+    constexpr float NormalSteps = 511.f;
+
+    float SignNotZero(float Value)
+    {
+        return Value >= 0.f ? 1.f : -1.f;
+    }
+
+    uint32_t ToSnorm10(float Value)
+    {
+        auto Steps = static_cast<int32_t>(std::round(std::clamp(Value, -1.f, 1.f) * NormalSteps));
+        return static_cast<uint32_t>(Steps) & 0x3FF;
+    }
+
+    // Same conversion as the GL applies to normalized signed attributes
+    float FromSnorm10(uint32_t Bits)
+    {
+        int32_t Steps = static_cast<int32_t>(Bits << 22) >> 22;
+        return std::max(static_cast<float>(Steps) / NormalSteps, -1.f);
+    }
+}
+
+bool VertexQuantization::Quantize(std::span<const Vertex> Vertices, const QuantizationBudget& Budget,
+                                  std::vector<CompactVertex>& VerticesOut, PositionDequantization& DequantizationOut)
+{
+    if (Vertices.empty())
+        return false;
+
+    AABB Bounds;
+    for (const Vertex& Source : Vertices)
+        Bounds.Extend(Source.position);
+
+    glm::vec3 Extent = Bounds.max - Bounds.min;
+    DequantizationOut = {Bounds.min, Extent};
+
+    float MinNormalCosine = std::cos(Budget.maxNormalError);
+    VerticesOut.resize(Vertices.size());
+    for (size_t i = 0; i < Vertices.size(); ++i)
+    {
+        const Vertex& Source = Vertices[i];
+        CompactVertex& Compact = VerticesOut[i];
+
+        for (int Axis = 0; Axis < 3; ++Axis)
+        {
+            float Normalized = Extent[Axis] > 0.f ? (Source.position[Axis] - Bounds.min[Axis]) / Extent[Axis] : 0.f;
+            Compact.position[Axis] = static_cast<uint16_t>(std::round(std::clamp(Normalized, 0.f, 1.f) * PositionSteps));
+        }
+        Compact.padding = 0;
+        Compact.normal = EncodeNormal(Source.normal);
+        Compact.texCoord[0] = glm::packHalf1x16(Source.texCoord.x);
+        Compact.texCoord[1] = glm::packHalf1x16(Source.texCoord.y);
+
+        // Errors are measured on what the vertex shader will see, NaN fails every comparison and the budget
+        Vertex Decoded = Dequantize(Compact, DequantizationOut);
+        if (!(glm::length(Decoded.position - Source.position) <= Budget.maxPositionError))
+            return false;
+
+        float NormalLength = glm::length(Source.normal);
+        if (NormalLength > 0.f && !(glm::dot(Decoded.normal, Source.normal / NormalLength) >= MinNormalCosine))
+            return false;
+
+        glm::vec2 TexCoordError = glm::abs(Decoded.texCoord - Source.texCoord);
+        if (!(std::max(TexCoordError.x, TexCoordError.y) <= Budget.maxTexCoordError))
+            return false;
+    }
+    return true;
+}
+
+Vertex VertexQuantization::Dequantize(const CompactVertex& Compact, const PositionDequantization& Dequantization)
+{
+    Vertex Decoded{};
+    glm::vec3 Normalized(Compact.position[0], Compact.position[1], Compact.position[2]);
+    Decoded.position = Normalized / PositionSteps * Dequantization.scale + Dequantization.offset;
+    Decoded.normal = DecodeNormal(Compact.normal);
+    Decoded.texCoord = glm::vec2(glm::unpackHalf1x16(Compact.texCoord[0]), glm::unpackHalf1x16(Compact.texCoord[1]));
+    return Decoded;
+}
+
+uint32_t VertexQuantization::EncodeNormal(const glm::vec3& Normal)
+{
+    float Length = std::abs(Normal.x) + std::abs(Normal.y) + std::abs(Normal.z);
+    if (Length == 0.f)
+        return 0;
+
+    // Projected on the octahedron, the lower half is folded over the diagonals
+    glm::vec3 Projected = Normal / Length;
+    glm::vec2 Encoded(Projected.x, Projected.y);
+    if (Projected.z < 0.f)
+    {
+        Encoded = glm::vec2((1.f - std::abs(Projected.y)) * SignNotZero(Projected.x),
+                            (1.f - std::abs(Projected.x)) * SignNotZero(Projected.y));
+    }
+    return ToSnorm10(Encoded.x) | (ToSnorm10(Encoded.y) << 10);
+}
+
+glm::vec3 VertexQuantization::DecodeNormal(uint32_t Packed)
+{
+    glm::vec2 Encoded(FromSnorm10(Packed & 0x3FF), FromSnorm10((Packed >> 10) & 0x3FF));
+    glm::vec3 Normal(Encoded.x, Encoded.y, 1.f - std::abs(Encoded.x) - std::abs(Encoded.y));
+
+    float Fold = std::max(-Normal.z, 0.f);
+    Normal.x += Normal.x >= 0.f ? -Fold : Fold;
+    Normal.y += Normal.y >= 0.f ? -Fold : Fold;
+    return glm::normalize(Normal);
+}